@@ -26,8 +26,13 @@ def _getFrozendictJsonEncoder(BaseJsonEncoder = None):
     class FrozendictJsonEncoderInternal(BaseJsonEncoder):
         def default(self, obj):
             if isinstance(obj, frozendict):  # pragma: no cover
-                # TODO create a C serializer
-                return dict(obj)
+                # json_dumps() serializes frozendicts without this copy
+                return obj.to_dict()
+            
+            materialized = cool._materializeLazy(obj)
+            
+            if materialized is not obj:
+                return materialized
             
             return BaseJsonEncoder.default(
                 self,
@@ -38,6 +43,38 @@ def _getFrozendictJsonEncoder(BaseJsonEncoder = None):
 
 
 FrozendictJsonEncoder = _getFrozendictJsonEncoder()
+
+_json_dumps = json_dumps
+_lazy_json_default = cool._getLazyJsonDefault()
+
+
+def json_dumps(obj, *, default = None, **kwargs):
+    r"""
+    Serializes obj to a JSON str, as json.dumps() without indent.
+    frozendicts are serialized as dicts, and the lazy proxies of
+    deepfreeze() as the objects they materialize to.
+    """
+    
+    if default is None:
+        default = _lazy_json_default
+    else:
+        default = cool._getLazyJsonDefault(default)
+    
+    return _json_dumps(obj, default = default, **kwargs)
+
+
+def json_loads_lines(fp):
+    r"""
+    Iterates the JSON documents in the lines of fp, a file opened in text
+    or binary mode or any other iterable of lines, parsed by json_loads().
+    The blank lines are skipped.
+    """
+    
+    for line in fp:
+        if line.strip():
+            yield json_loads(line)
+
+
 monkeypatch.patchOrUnpatchAll(patch = True, warn = False)
 
 
@@ -45,11 +82,30 @@ from collections.abc import Mapping
 
 # noinspection PyUnresolvedReferences
 Mapping.register(frozendict)
+
+if c_ext:  # pragma: no cover
+    from collections.abc import KeysView, ValuesView, ItemsView
+    
+    # noinspection PyUnresolvedReferences
+    Mapping.register(frozenmap)
+    KeysView.register(type(frozenmap().keys()))
+    ValuesView.register(type(frozenmap().values()))
+    ItemsView.register(type(frozenmap().items()))
+    
+    del KeysView
+    del ValuesView
+    del ItemsView
+
 del Mapping
 
 
 if c_ext:  # pragma: no cover
-    __all__ = (frozendict.__name__, )
+    __all__ = (
+        frozendict.__name__,
+        frozenmap.__name__,
+        json_dumps.__name__,
+        json_loads.__name__,
+    )
 else:
     __all__ = _frozendict_py.__all__
     del _frozendict_py
@@ -58,4 +114,8 @@ else:
 FrozenOrderedDict = frozendict
 
 __all__ += cool.__all__
-__all__ += (FrozendictJsonEncoder.__name__, "FrozenOrderedDict")
+__all__ += (
+    FrozendictJsonEncoder.__name__,
+    json_loads_lines.__name__,
+    "FrozenOrderedDict",
+)
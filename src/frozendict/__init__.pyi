@@ -10,26 +10,32 @@ from typing import (
     Any,
     Dict,
     Callable,
+    Generic,
 )
 
 from collections.abc import Hashable
 
 try:
-    from typing import Mapping, Iterable, Iterator, Tuple, Type
+    from typing import Mapping, Iterable, Iterator, Tuple, Type, AbstractSet, FrozenSet
 except ImportError:
     from collections.abc import Mapping, Iterable, Iterator
+    from collections.abc import Set as AbstractSet
     Tuple = tuple
     Type = type
+    FrozenSet = frozenset
 
 if sys.version_info >= (3, 11):
     from typing import Self as SelfT
+    from typing import Self as MapSelfT
 else:
     SelfT = TypeVar("SelfT", bound=frozendict[K, V])
+    MapSelfT = TypeVar("MapSelfT", bound=frozenmap[K, V])
 
 K = TypeVar("K")
 V = TypeVar("V", covariant=True)
 K2 = TypeVar("K2")
 V2 = TypeVar("V2", covariant=True)
+BuiltT = TypeVar("BuiltT")
 
 # noinspection PyPep8Naming
 class frozendict(Mapping[K, V]):
@@ -48,6 +54,7 @@ class frozendict(Mapping[K, V]):
     def __hash__(self: SelfT) -> int: ...
     def __reversed__(self: SelfT) -> Iterator[K]: ...
     def copy(self: SelfT) -> SelfT: ...
+    def to_dict(self: SelfT, *, deep: bool = False) -> Dict[K, V]: ...
     def __copy__(self: SelfT) -> SelfT: ...
     def __deepcopy__(self: SelfT) -> SelfT: ...
     def delete(self: SelfT, key: K) -> SelfT: ...
@@ -91,6 +98,40 @@ class frozendict(Mapping[K, V]):
     def setdefault(self: SelfT, key: K, default: V2) -> frozendict[K, Union[V, V2]]: ...
     @overload
     def setdefault(self: SelfT, key: K2, default: V2) -> frozendict[Union[K, K2], Union[V, V2]]: ...
+    @overload
+    def set_many(self: SelfT, mapping_or_pairs: Mapping[K, V]) -> SelfT: ...
+    @overload
+    def set_many(self: SelfT, mapping_or_pairs: Iterable[Tuple[K, V]]) -> SelfT: ...
+    @overload
+    def set_many(self: SelfT, mapping_or_pairs: Mapping[K2, V2]) -> frozendict[Union[K, K2], Union[V, V2]]: ...
+    @overload
+    def set_many(self: SelfT, mapping_or_pairs: Iterable[Tuple[K2, V2]]) -> frozendict[Union[K, K2], Union[V, V2]]: ...
+    def delete_many(self: SelfT, keys: Iterable[K]) -> SelfT: ...
+    def optimize(self: SelfT, *, index: str = ...) -> SelfT: ...
+    def __and__(self: SelfT, other: Union[Mapping[Any, Any], AbstractSet[Any]]) -> SelfT: ...
+    def __sub__(self: SelfT, other: Union[Mapping[Any, Any], AbstractSet[Any]]) -> SelfT: ...
+    def __xor__(self: SelfT, other: Mapping[K2, V2]) -> frozendict[Union[K, K2], Union[V, V2]]: ...
+    def __le__(self: SelfT, other: Mapping[Any, Any]) -> bool: ...
+    def __lt__(self: SelfT, other: Mapping[Any, Any]) -> bool: ...
+    def __ge__(self: SelfT, other: Mapping[Any, Any]) -> bool: ...
+    def __gt__(self: SelfT, other: Mapping[Any, Any]) -> bool: ...
+    def keys_frozenset(self: SelfT) -> FrozenSet[K]: ...
+    def union(self: SelfT, *others: Union[Mapping[K2, V2], Iterable[Tuple[K2, V2]]]) -> frozendict[Union[K, K2], Union[V, V2]]: ...
+    def intersection(self: SelfT, *others: Iterable[Any]) -> SelfT: ...
+    def difference(self: SelfT, *others: Iterable[Any]) -> SelfT: ...
+    def symmetric_difference(self: SelfT, other: Union[Mapping[K2, V2], Iterable[Tuple[K2, V2]]]) -> frozendict[Union[K, K2], Union[V, V2]]: ...
+    def issubset(self: SelfT, other: Union[Mapping[Any, Any], Iterable[Tuple[Any, Any]]]) -> bool: ...
+    def issuperset(self: SelfT, other: Union[Mapping[Any, Any], Iterable[Tuple[Any, Any]]]) -> bool: ...
+    @overload
+    def update(self: SelfT, **kwargs: V) -> SelfT: ...
+    @overload
+    def update(self: SelfT, mapping_or_pairs: Mapping[K, V], **kwargs: V) -> SelfT: ...
+    @overload
+    def update(self: SelfT, mapping_or_pairs: Iterable[Tuple[K, V]], **kwargs: V) -> SelfT: ...
+    @overload
+    def update(self: SelfT, mapping_or_pairs: Mapping[K2, V2], **kwargs: V2) -> frozendict[Union[K, K2, str], Union[V, V2]]: ...
+    @overload
+    def update(self: SelfT, mapping_or_pairs: Iterable[Tuple[K2, V2]], **kwargs: V2) -> frozendict[Union[K, K2, str], Union[V, V2]]: ...
     
     @classmethod
     def fromkeys(
@@ -98,11 +139,121 @@ class frozendict(Mapping[K, V]):
         seq: Iterable[K], 
         value: Optional[V] = None
     ) -> SelfT: ...
+    
+    @classmethod
+    def schema(
+        cls: Type[SelfT], 
+        keys: Iterable[K]
+    ) -> Callable[[Iterable[V]], SelfT]: ...
+    
+    @classmethod
+    def take(cls: Type[SelfT], d: Dict[K, V]) -> SelfT: ...
+    
+    @classmethod
+    def intern(cls, fd: SelfT) -> SelfT: ...
+    
+    @classmethod
+    def from_object(cls: Type[SelfT], o: Any) -> SelfT: ...
+    
+    @classmethod
+    def builder(
+        cls: Type[SelfT], 
+        *, 
+        reserve: int = 0
+    ) -> _builder[Any, Any, SelfT]: ...
+    
+    def evolver(self: SelfT) -> _builder[K, Any, SelfT]: ...
+
+
+# noinspection PyPep8Naming
+class _builder(Generic[K, V2, BuiltT]):
+    def __getitem__(self, key: K) -> V2: ...
+    def __setitem__(self, key: K, value: V2) -> None: ...
+    def __delitem__(self, key: K) -> None: ...
+    def __contains__(self, key: object) -> bool: ...
+    def __len__(self) -> int: ...
+    @overload
+    def update(self, **kwargs: V2) -> None: ...
+    @overload
+    def update(self, mapping_or_pairs: Mapping[K, V2], **kwargs: V2) -> None: ...
+    @overload
+    def update(self, mapping_or_pairs: Iterable[Tuple[K, V2]], **kwargs: V2) -> None: ...
+    def finish(self) -> BuiltT: ...
+
+
+# noinspection PyPep8Naming
+class frozenmap(Mapping[K, V]):
+    @overload
+    def __new__(cls: Type[MapSelfT]) -> MapSelfT: ...
+    @overload
+    def __new__(cls: Type[MapSelfT], **kwargs: V) -> frozenmap[str, V]: ...
+    @overload
+    def __new__(cls: Type[MapSelfT], mapping: Mapping[K, V]) -> MapSelfT: ...
+    @overload
+    def __new__(cls: Type[MapSelfT], iterable: Iterable[Tuple[K, V]]) -> MapSelfT: ...
+    
+    def __getitem__(self: MapSelfT, key: K) -> V: ...
+    def __len__(self: MapSelfT) -> int: ...
+    def __iter__(self: MapSelfT) -> Iterator[K]: ...
+    def __hash__(self: MapSelfT) -> int: ...
+    def copy(self: MapSelfT) -> MapSelfT: ...
+    def __copy__(self: MapSelfT) -> MapSelfT: ...
+    def delete(self: MapSelfT, key: K) -> MapSelfT: ...
+    @overload
+    def key(self: MapSelfT, index: int) -> K: ...
+    @overload
+    def key(self: MapSelfT) -> K: ...
+    @overload
+    def value(self: MapSelfT, index: int) -> V: ...
+    @overload
+    def value(self: MapSelfT) -> V: ...
+    @overload
+    def item(self: MapSelfT, index: int) -> Tuple[K, V]: ...
+    @overload
+    def item(self: MapSelfT) -> Tuple[K, V]: ...
+    @overload
+    def __or__(self: MapSelfT, other: Mapping[K, V]) -> MapSelfT: ...
+    @overload
+    def __or__(self: MapSelfT, other: Mapping[K2, V2]) -> frozenmap[Union[K, K2], Union[V, V2]]: ...
+    @overload
+    def set(self: MapSelfT, key: K, value: V) -> MapSelfT: ...
+    @overload
+    def set(self: MapSelfT, key: K2, value: V2) -> frozenmap[Union[K, K2], Union[V, V2]]: ...
+    @overload
+    def setdefault(self: MapSelfT, key: K) -> MapSelfT: ...
+    @overload
+    def setdefault(self: MapSelfT, key: K, default: V) -> MapSelfT: ...
+    @overload
+    def setdefault(self: MapSelfT, key: K2, default: V2) -> frozenmap[Union[K, K2], Union[V, V2]]: ...
+    
+    @classmethod
+    def fromkeys(
+        cls: Type[MapSelfT], 
+        seq: Iterable[K], 
+        value: Optional[V] = None
+    ) -> MapSelfT: ...
 
 
 FrozenOrderedDict = frozendict
 c_ext: bool
 
+def json_dumps(
+    obj: Any,
+    *,
+    skipkeys: bool = False,
+    ensure_ascii: bool = True,
+    allow_nan: bool = True,
+    sort_keys: bool = False,
+    separators: Optional[Tuple[str, str]] = None,
+    default: Optional[Callable[[Any], Any]] = None
+) -> str: ...
+
+def json_loads(s: Union[str, bytes, bytearray]) -> Any: ...
+
+def json_loads_lines(
+    fp: Iterable[Union[str, bytes, bytearray]]
+) -> Iterator[Any]: ...
+
 class FreezeError(Exception):  pass
 
 
@@ -113,6 +264,15 @@ class FreezeWarning(UserWarning):  pass
 def deepfreeze(
         o: Any,
         custom_converters: Optional[Dict[Any, Callable[[Any], Hashable]]] = None,
+        custom_inverse_converters: Optional[Dict[Any, Callable[[Any], Any]]] = None,
+        *,
+        previous: Any = None,
+        lazy: bool = False,
+        intern: bool = False
+) -> Any: ...
+
+def deepthaw(
+        o: Any,
         custom_inverse_converters: Optional[Dict[Any, Callable[[Any], Any]]] = None
 ) -> Any: ...
 
@@ -1,4 +1,5 @@
 from copy import deepcopy
+from weakref import ref as weakref_ref
 
 
 def immutable(self, *_args, **_kwargs):
@@ -14,6 +15,41 @@ def immutable(self, *_args, **_kwargs):
 _empty_frozendict = None
 _module_name = "frozendict"
 
+# hash -> the weak references to the canonical frozendicts of intern()
+# with that hash
+_intern_table = {}
+
+# the other operands of & and - that can tell if they have a key
+_keys_operand_types = (dict, set, frozenset, type({}.keys()))
+
+
+def _intern_remove(ref):
+    # the hash of ref is cached by intern(), so it's still known after
+    # the death of the frozendict
+    hash_fd = hash(ref)
+    bucket = _intern_table.get(hash_fd)
+    
+    if bucket is None:
+        return
+    
+    for i, other in enumerate(bucket):
+        if other is ref:
+            del bucket[i]
+            break
+    
+    if not bucket:
+        del _intern_table[hash_fd]
+
+
+def _mangle(cls, name):
+    # the name of the attribute of a private name used in the class cls
+    if not name.startswith("__") or name.endswith("__"):
+        return name
+    
+    cls_name = cls.__name__.lstrip("_")
+    
+    return f"_{cls_name}{name}" if cls_name else name
+
 
 # noinspection PyPep8Naming
 class frozendict(dict):
@@ -26,6 +62,7 @@ class frozendict(dict):
             
     __slots__ = (
         "_hash",
+        "__weakref__",
     )
     
     @classmethod
@@ -36,6 +73,148 @@ class frozendict(dict):
         
         return cls(dict.fromkeys(*args, **kwargs))
     
+    @classmethod
+    def schema(cls, keys):
+        r"""
+        Returns a callable that creates dictionaries with the keys, in
+        order, from an iterable of as many values. The shared keys are
+        implemented only by the C extension, so the dictionaries are
+        regular ones.
+        """
+        
+        return _schema(cls, keys)
+    
+    @classmethod
+    def take(cls, d):
+        r"""
+        Returns a new dictionary with the items of the dict d, and leaves
+        d empty. The items are moved only by the C extension, so here
+        they're copied.
+        """
+        
+        if type(d) is not dict:
+            raise TypeError(
+                f"take() argument must be a dict, not {type(d).__name__}"
+            )
+        
+        res = cls(d)
+        d.clear()
+        
+        return res
+    
+    @classmethod
+    def intern(cls, fd):
+        r"""
+        Returns the canonical frozendict equal to fd, that is fd itself
+        if no equal frozendict was interned before and is still alive.
+        The canonical frozendicts are referenced weakly.
+        """
+        
+        if not isinstance(fd, frozendict):
+            raise TypeError(
+                "intern() argument must be a frozendict, not " +
+                type(fd).__name__
+            )
+        
+        from frozendict.cool import _freezeSame
+        
+        hash_fd = hash(fd)
+        
+        # the comparisons can run arbitrary code, that can change the
+        # bucket
+        for ref in tuple(_intern_table.get(hash_fd, ())):
+            canon = ref()
+            
+            if canon is not None and _freezeSame(fd, canon):
+                return canon
+        
+        ref = weakref_ref(fd, _intern_remove)
+        hash(ref)
+        _intern_table.setdefault(hash_fd, []).append(ref)
+        
+        return fd
+    
+    @classmethod
+    def from_object(cls, o):
+        r"""
+        Returns a new dictionary with the state of the object o: the
+        fields of a namedtuple, or the values of the __slots__ that are
+        set, followed by the items of the __dict__.
+        """
+        
+        type_o = type(o)
+        fields = getattr(type_o, "_fields", None)
+        
+        if (
+            isinstance(o, tuple) and
+            isinstance(fields, tuple) and
+            len(fields) == len(o)
+        ):
+            return cls(zip(fields, o))
+        
+        res = {}
+        has_slots = False
+        
+        for base in reversed(type_o.__mro__):
+            slots = base.__dict__.get("__slots__")
+            
+            if slots is None:
+                continue
+            
+            has_slots = True
+            
+            if isinstance(slots, str):
+                slots = (slots, )
+            
+            # the order of the members of the C extension
+            names = sorted(
+                _mangle(base, name)
+                for name in slots
+                if name not in ("__dict__", "__weakref__")
+            )
+            
+            for name in names:
+                try:
+                    res[name] = base.__dict__[name].__get__(o, type_o)
+                except AttributeError:
+                    # an unset slot
+                    pass
+        
+        try:
+            d = object.__getattribute__(o, "__dict__")
+        except AttributeError:
+            if not has_slots:
+                raise TypeError(
+                    "from_object() argument must have a __dict__, " +
+                    f"__slots__ or _fields, not {type_o.__name__}"
+                ) from None
+        else:
+            res.update(d)
+        
+        return cls(res)
+    
+    @classmethod
+    def builder(cls, *, reserve=0):
+        r"""
+        Returns a builder of a new dictionary. The builder supports item
+        assignment, deletion and update(), and finish() returns the
+        dictionary built. reserve is used only by the C extension.
+        """
+        
+        if reserve < 0:
+            raise ValueError("reserve must be non-negative")
+        
+        return _builder(cls, None)
+    
+    def evolver(self):
+        r"""
+        Returns a builder that starts from the dictionary. The
+        dictionary is copied only at the first change, so if nothing
+        changed finish() returns the dictionary itself.
+        """
+        
+        return _builder(self.__class__, self)
+    
     # noinspection PyMethodParameters
     def __new__(e4b37cdf_d78a_4632_bade_6f0579d8efac, *args, **kwargs):
         cls = e4b37cdf_d78a_4632_bade_6f0579d8efac
@@ -123,6 +302,25 @@ class frozendict(dict):
         
         return klass(self)
     
+    def to_dict(self, *, deep=False):
+        r"""
+        Returns a new dict with the items of the dictionary. If deep is
+        true, the values that are frozendicts are converted too,
+        recursively.
+        """
+        
+        if not deep:
+            return dict(self)
+        
+        return {
+            key: (
+                value.to_dict(deep=True)
+                if isinstance(value, frozendict)
+                else value
+            )
+            for key, value in dict.items(self)
+        }
+    
     def __copy__(self, *args, **kwargs):
         r"""
         See copy().
@@ -184,6 +382,168 @@ class frozendict(dict):
         
         return self.__class__()
     
+    def set_many(self, mapping_or_pairs):
+        new_self = dict(self)
+        new_self.update(mapping_or_pairs)
+        
+        return self.__class__(new_self)
+    
+    def delete_many(self, keys):
+        new_self = dict(self)
+        
+        for key in keys:
+            if key not in self:
+                raise KeyError(key)
+            
+            new_self.pop(key, None)
+        
+        if len(new_self) == len(self):
+            return self
+        
+        if new_self:
+            return self.__class__(new_self)
+        
+        return self.__class__()
+    
+    def update(self, *args, **kwargs):
+        new_self = dict(self)
+        new_self.update(*args, **kwargs)
+        
+        return self.__class__(new_self)
+    
+    def _filter_keys(self, other, keep):
+        if not isinstance(other, _keys_operand_types):
+            other = set(other)
+        
+        new_self = {k: v for k, v in self.items() if (k in other) == keep}
+        
+        if len(new_self) == len(self):
+            return self
+        
+        if new_self:
+            return self.__class__(new_self)
+        
+        return self.__class__()
+    
+    def keys_frozenset(self):
+        r"""
+        The cache of the frozenset is implemented only by the C
+        extension, so it returns a new frozenset every time.
+        """
+        
+        return frozenset(self)
+    
+    def union(self, *others):
+        res = self
+        
+        for other in others:
+            if isinstance(other, dict):
+                if not other:
+                    continue
+                
+                if not res and other.__class__ == res.__class__:
+                    res = other
+                    continue
+            
+            res = res.set_many(other)
+        
+        return res
+    
+    def intersection(self, *others):
+        res = self
+        
+        for other in others:
+            res = res._filter_keys(other, True)
+        
+        return res
+    
+    def difference(self, *others):
+        res = self
+        
+        for other in others:
+            res = res._filter_keys(other, False)
+        
+        return res
+    
+    def symmetric_difference(self, other):
+        if not isinstance(other, dict):
+            other = dict(other)
+        
+        if not other:
+            return self
+        
+        new_self = {k: v for k, v in self.items() if k not in other}
+        new_self.update((k, v) for k, v in other.items() if k not in self)
+        
+        return self.__class__(new_self)
+    
+    def issubset(self, other):
+        if not isinstance(other, dict):
+            other = dict(other)
+        
+        return dict.items(self) <= other.items()
+    
+    def issuperset(self, other):
+        if not isinstance(other, dict):
+            other = dict(other)
+        
+        return dict.items(self) >= other.items()
+    
+    def __and__(self, other):
+        if not isinstance(other, _keys_operand_types):
+            return NotImplemented
+        
+        return self._filter_keys(other, True)
+    
+    def __sub__(self, other):
+        if not isinstance(other, _keys_operand_types):
+            return NotImplemented
+        
+        return self._filter_keys(other, False)
+    
+    def __xor__(self, other):
+        if not isinstance(other, dict):
+            return NotImplemented
+        
+        return self.symmetric_difference(other)
+    
+    def __le__(self, other):
+        if not isinstance(other, dict):
+            return NotImplemented
+        
+        return dict.items(self) <= other.items()
+    
+    def __lt__(self, other):
+        if not isinstance(other, dict):
+            return NotImplemented
+        
+        return dict.items(self) < other.items()
+    
+    def __ge__(self, other):
+        if not isinstance(other, dict):
+            return NotImplemented
+        
+        return dict.items(self) >= other.items()
+    
+    def __gt__(self, other):
+        if not isinstance(other, dict):
+            return NotImplemented
+        
+        return dict.items(self) > other.items()
+    
+    def optimize(self, *, index="perfect"):
+        r"""
+        The indexes of the keys are implemented only by the C extension,
+        so it returns self.
+        """
+        
+        if index not in ("perfect", "groups"):
+            raise ValueError(
+                f"index must be 'perfect' or 'groups', not {index!r}"
+            )
+        
+        return self
+    
     def _get_by_index(self, collection, index):
         try:
             return collection[index]
@@ -230,6 +590,111 @@ def frozendict_or(self, other, *_args, **_kwargs):
     return self.__class__(res)
 
 
+class _schema:
+    r"""
+    Creates dictionaries with the keys of the schema, in order, and the
+    values of the iterable passed.
+    """
+    
+    __slots__ = ("_cls", "keys")
+    
+    def __init__(self, cls, keys):
+        keys = tuple(keys)
+        
+        if len(dict.fromkeys(keys)) != len(keys):
+            raise ValueError("schema keys must be unique")
+        
+        self._cls = cls
+        self.keys = keys
+    
+    def __call__(self, values):
+        values = tuple(values)
+        
+        if len(values) != len(self.keys):
+            raise ValueError(
+                f"schema expected {len(self.keys)} values, got "
+                f"{len(values)}"
+            )
+        
+        if not values:
+            return self._cls()
+        
+        return self._cls(zip(self.keys, values))
+    
+    def __repr__(self):
+        klass = self._cls
+        
+        if klass == frozendict:
+            name = f"{_module_name}.{klass.__name__}"
+        else:
+            name = klass.__name__
+        
+        return f"{name}.schema({self.keys!r})"
+
+
+_schema.__name__ = "schema"
+_schema.__qualname__ = "schema"
+_schema.__module__ = _module_name
+
+
+class _builder:
+    r"""
+    Builds a dictionary in place, without intermediate dicts. finish()
+    returns the dictionary built.
+    """
+    
+    __slots__ = ("_cls", "_base", "_dict")
+    
+    def __init__(self, cls, base):
+        self._cls = cls
+        self._base = base
+        self._dict = {} if base is None else None
+    
+    def _current(self):
+        if self._dict is None:
+            return self._base
+        
+        return self._dict
+    
+    def _writable(self):
+        if self._dict is None:
+            self._dict = dict(self._base)
+        
+        return self._dict
+    
+    def __getitem__(self, key):
+        return dict.__getitem__(self._current(), key)
+    
+    def __contains__(self, key):
+        return dict.__contains__(self._current(), key)
+    
+    def __len__(self):
+        return dict.__len__(self._current())
+    
+    def __setitem__(self, key, value):
+        self._writable()[key] = value
+    
+    def __delitem__(self, key):
+        del self._writable()[key]
+    
+    def update(self, *args, **kwargs):
+        self._writable().update(*args, **kwargs)
+    
+    def finish(self):
+        if self._dict is not None:
+            self._base = self._cls(self._dict)
+            self._dict = None
+        
+        return self._base
+    
+    __hash__ = None
+
+
+_builder.__name__ = "builder"
+_builder.__qualname__ = "builder"
+_builder.__module__ = _module_name
+
+
 frozendict.__or__ = frozendict_or
 frozendict.__ior__ = frozendict_or
 
@@ -246,9 +711,71 @@ except AttributeError:  # pragma: no cover
 frozendict.clear = immutable
 frozendict.pop = immutable
 frozendict.popitem = immutable
-frozendict.update = immutable
 frozendict.__delattr__ = immutable
 frozendict.__setattr__ = immutable
 frozendict.__module__ = _module_name
 
-__all__ = (frozendict.__name__,)
+
+
+def json_dumps(
+    obj,
+    *,
+    skipkeys = False,
+    ensure_ascii = True,
+    allow_nan = True,
+    sort_keys = False,
+    separators = None,
+    default = None
+):
+    r"""
+    Serializes obj to a JSON str, as json.dumps() without indent.
+    frozendicts are serialized as dicts.
+    """
+    
+    import json
+    
+    return json.dumps(
+        obj,
+        skipkeys = skipkeys,
+        ensure_ascii = ensure_ascii,
+        allow_nan = allow_nan,
+        sort_keys = sort_keys,
+        separators = separators,
+        default = default,
+    )
+
+
+def _json_array(value):
+    if type(value) is list:
+        return tuple(_json_array(x) for x in value)
+    
+    return value
+
+
+def _json_object(pairs):
+    from sys import intern
+    
+    return frozendict(
+        (intern(key), _json_array(value)) for key, value in pairs
+    )
+
+
+def json_loads(s):
+    r"""
+    Parses the JSON document s, a str or UTF-8 bytes, as json.loads().
+    The objects are returned as frozendicts and the arrays as tuples.
+    """
+    
+    import json
+    
+    return _json_array(json.loads(s, object_pairs_hook = _json_object))
+
+
+from ._frozenmap_py import frozenmap
+
+__all__ = (
+    frozendict.__name__,
+    frozenmap.__name__,
+    json_dumps.__name__,
+    json_loads.__name__,
+)
@@ -0,0 +1,564 @@
+r"""
+Pure python implementation of frozenmap, an immutable mapping based on
+a hash array mapped trie. See the C implementation for the details.
+"""
+
+from collections.abc import Mapping
+from sys import hash_info
+
+_module_name = "frozendict"
+
+_bits = 5
+_mask = (1 << _bits) - 1
+_max_shift = 30
+_hash_width = hash_info.width
+_hash_mask = (1 << _hash_width) - 1
+
+# marks an entry that contains a subnode in place of the value
+_subnode = object()
+
+
+def _hash32(h):
+    h &= _hash_mask
+
+    if _hash_width > 32:
+        h ^= h >> 32
+
+    return h & 0xFFFFFFFF
+
+
+def _bit(h, shift):
+    return 1 << ((_hash32(h) >> shift) & _mask)
+
+
+def _index(bitmap, bit):
+    return bin(bitmap & (bit - 1)).count("1")
+
+
+class _Node:
+    __slots__ = ("bitmap", "entries", "size", "collision")
+
+    def __init__(self, bitmap, entries, size, collision=False):
+        self.bitmap = bitmap
+        # tuple of (key, value, hash) entries
+        self.entries = entries
+        self.size = size
+        self.collision = collision
+
+
+def _match(entry, key, h):
+    entry_key = entry[0]
+
+    if entry_key is key:
+        return True
+
+    return entry[2] == h and entry_key == key
+
+
+def _pair(shift, entry1, entry2):
+    if shift > _max_shift:
+        return _Node(0, (entry1, entry2), 2, True)
+
+    bit1 = _bit(entry1[2], shift)
+    bit2 = _bit(entry2[2], shift)
+
+    if bit1 == bit2:
+        sub = _pair(shift + _bits, entry1, entry2)
+        return _Node(bit1, ((_subnode, sub, 0), ), 2)
+
+    if bit1 > bit2:
+        entry1, entry2 = entry2, entry1
+
+    return _Node(bit1 | bit2, (entry1, entry2), 2)
+
+
+def _find(node, key, h, default):
+    shift = 0
+
+    while node is not None:
+        if node.collision:
+            for entry in node.entries:
+                if _match(entry, key, h):
+                    return entry[1]
+
+            return default
+
+        bit = _bit(h, shift)
+
+        if not node.bitmap & bit:
+            return default
+
+        entry = node.entries[_index(node.bitmap, bit)]
+
+        if entry[0] is _subnode:
+            node = entry[1]
+            shift += _bits
+            continue
+
+        if _match(entry, key, h):
+            return entry[1]
+
+        return default
+
+    return default
+
+
+def _replace(entries, i, entry):
+    return entries[:i] + (entry, ) + entries[i + 1:]
+
+
+def _assoc(node, shift, key, h, value):
+    r"""
+    Returns the new node and the old value, or _subnode if key was not
+    present.
+    """
+
+    entries = node.entries
+
+    if node.collision:
+        for i, entry in enumerate(entries):
+            if _match(entry, key, h):
+                old_value = entry[1]
+
+                if old_value is value:
+                    return node, old_value
+
+                new_entries = _replace(entries, i, (entry[0], value, h))
+                return _Node(0, new_entries, node.size, True), old_value
+
+        new_entries = entries + ((key, value, h), )
+        return _Node(0, new_entries, node.size + 1, True), _subnode
+
+    bit = _bit(h, shift)
+    i = _index(node.bitmap, bit)
+
+    if not node.bitmap & bit:
+        new_entries = entries[:i] + ((key, value, h), ) + entries[i:]
+        new_node = _Node(node.bitmap | bit, new_entries, node.size + 1)
+        return new_node, _subnode
+
+    entry = entries[i]
+
+    if entry[0] is _subnode:
+        sub = entry[1]
+        new_sub, old_value = _assoc(sub, shift + _bits, key, h, value)
+
+        if new_sub is sub:
+            return node, old_value
+
+        size = node.size + (old_value is _subnode)
+        new_entries = _replace(entries, i, (_subnode, new_sub, 0))
+        return _Node(node.bitmap, new_entries, size), old_value
+
+    if _match(entry, key, h):
+        old_value = entry[1]
+
+        if old_value is value:
+            return node, old_value
+
+        new_entries = _replace(entries, i, (entry[0], value, h))
+        return _Node(node.bitmap, new_entries, node.size), old_value
+
+    sub = _pair(shift + _bits, entry, (key, value, h))
+    new_entries = _replace(entries, i, (_subnode, sub, 0))
+    return _Node(node.bitmap, new_entries, node.size + 1), _subnode
+
+
+def _without(node, shift, key, h):
+    r"""
+    Returns the new node, that is None if empty, and the old value, or
+    _subnode if key was not present.
+    """
+
+    entries = node.entries
+
+    if node.collision:
+        for i, entry in enumerate(entries):
+            if _match(entry, key, h):
+                if len(entries) == 1:
+                    return None, entry[1]
+
+                new_entries = entries[:i] + entries[i + 1:]
+                new_node = _Node(0, new_entries, node.size - 1, True)
+                return new_node, entry[1]
+
+        return node, _subnode
+
+    bit = _bit(h, shift)
+
+    if not node.bitmap & bit:
+        return node, _subnode
+
+    i = _index(node.bitmap, bit)
+    entry = entries[i]
+
+    if entry[0] is not _subnode:
+        if not _match(entry, key, h):
+            return node, _subnode
+
+        if len(entries) == 1:
+            return None, entry[1]
+
+        new_entries = entries[:i] + entries[i + 1:]
+        new_node = _Node(node.bitmap & ~bit, new_entries, node.size - 1)
+        return new_node, entry[1]
+
+    new_sub, old_value = _without(entry[1], shift + _bits, key, h)
+
+    if old_value is _subnode:
+        return node, _subnode
+
+    if new_sub is None:
+        if len(entries) == 1:
+            return None, old_value
+
+        new_entries = entries[:i] + entries[i + 1:]
+        new_node = _Node(node.bitmap & ~bit, new_entries, node.size - 1)
+        return new_node, old_value
+
+    sub_entries = new_sub.entries
+
+    if len(sub_entries) == 1 and sub_entries[0][0] is not _subnode:
+        # a subnode with only an item is replaced by the item
+        new_entry = sub_entries[0]
+    else:
+        new_entry = (_subnode, new_sub, 0)
+
+    new_entries = _replace(entries, i, new_entry)
+    return _Node(node.bitmap, new_entries, node.size - 1), old_value
+
+
+def _iter_entries(node):
+    if node is None:
+        return
+
+    stack = [iter(node.entries)]
+
+    while stack:
+        for entry in stack[-1]:
+            if entry[0] is _subnode:
+                stack.append(iter(entry[1].entries))
+                break
+
+            yield entry
+        else:
+            stack.pop()
+
+
+def _entry_at(node, index):
+    while True:
+        for entry in node.entries:
+            if entry[0] is not _subnode:
+                if index == 0:
+                    return entry
+
+                index -= 1
+                continue
+
+            sub_size = entry[1].size
+
+            if index < sub_size:
+                node = entry[1]
+                break
+
+            index -= sub_size
+
+
+# noinspection PyPep8Naming
+class frozenmap(Mapping):
+    r"""
+    An immutable mapping with the API of frozendict, based on a hash
+    array mapped trie. set(), delete() and setdefault() are O(log n),
+    since the new map shares all the unchanged nodes with the original
+    one. Unlike frozendict, the items are not in insertion order.
+    """
+
+    __slots__ = ("_root", "_size", "_hash")
+
+    @classmethod
+    def fromkeys(cls, *args, **kwargs):
+        r"""
+        Identical to dict.fromkeys().
+        """
+
+        return cls(dict.fromkeys(*args, **kwargs))
+
+    def __new__(cls, *args, **kwargs):
+        if len(args) > 1:
+            raise TypeError(
+                f"{cls.__name__} expected at most 1 argument, got " +
+                f"{len(args)}"
+            )
+
+        if (
+            len(args) == 1 and
+            not kwargs and
+            args[0].__class__ == frozenmap and
+            cls == frozenmap
+        ):
+            return args[0]
+
+        self = object.__new__(cls)
+        self._root = None
+        self._size = 0
+        self._hash = -1
+
+        if args:
+            arg = args[0]
+
+            if isinstance(arg, frozenmap):
+                self._root = arg._root
+                self._size = arg._size
+            else:
+                self._merge(arg)
+
+        if kwargs:
+            self._merge(kwargs)
+
+        return self
+
+    def _merge(self, arg):
+        if hasattr(arg, "keys"):
+            items = ((key, arg[key]) for key in arg.keys())
+        else:
+            items = arg
+
+        for i, item in enumerate(items):
+            try:
+                key, value = item
+            except TypeError:
+                raise TypeError(
+                    f"cannot convert {_module_name}.frozenmap update " +
+                    f"sequence element #{i} to a sequence"
+                ) from None
+            except ValueError:
+                raise ValueError(
+                    f"{_module_name}.frozenmap update sequence element " +
+                    f"#{i} has length {len(item)}; 2 is required"
+                ) from None
+
+            self._root, self._size = self._assoc(key, value)[:2]
+
+    def _assoc(self, key, value):
+        h = hash(key)
+        root = self._root
+
+        if root is None:
+            return _Node(_bit(h, 0), ((key, value, h), ), 1), 1, _subnode
+
+        new_root, old_value = _assoc(root, 0, key, h, value)
+        size = self._size + (old_value is _subnode)
+
+        return new_root, size, old_value
+
+    def _from_root(self, root, size):
+        new_self = object.__new__(self.__class__)
+        new_self._root = root
+        new_self._size = size
+        new_self._hash = -1
+
+        return new_self
+
+    def __getitem__(self, key):
+        value = _find(self._root, key, hash(key), _subnode)
+
+        if value is _subnode:
+            raise KeyError(key)
+
+        return value
+
+    def __contains__(self, key):
+        return _find(self._root, key, hash(key), _subnode) is not _subnode
+
+    def get(self, key, default=None):
+        r"""
+        Return the value for key if key is in the map, else default.
+        """
+
+        value = _find(self._root, key, hash(key), _subnode)
+
+        if value is _subnode:
+            return default
+
+        return value
+
+    def __len__(self):
+        return self._size
+
+    def __iter__(self):
+        for entry in _iter_entries(self._root):
+            yield entry[0]
+
+    def __hash__(self):
+        r"""
+        Calculates the hash if all values are hashable, otherwise
+        raises a TypeError.
+        """
+
+        if self._hash == -1:
+            self._hash = hash(frozenset(self.items()))
+
+        return self._hash
+
+    def __eq__(self, other):
+        if not isinstance(other, (frozenmap, dict)):
+            return NotImplemented
+
+        if len(self) != len(other):
+            return False
+
+        if isinstance(other, frozenmap) and self._root is other._root:
+            return True
+
+        for key, value, h in _iter_entries(self._root):
+            try:
+                other_value = other[key]
+            except KeyError:
+                return False
+
+            if not (value is other_value or value == other_value):
+                return False
+
+        return True
+
+    def __ne__(self, other):
+        res = self.__eq__(other)
+
+        if res is NotImplemented:
+            return res
+
+        return not res
+
+    def __repr__(self):
+        klass = self.__class__
+
+        if klass == frozenmap:
+            name = f"{_module_name}.{klass.__name__}"
+        else:
+            name = klass.__name__
+
+        return f"{name}({dict(self)!r})"
+
+    def copy(self):
+        r"""
+        Return the object itself, as it's an immutable.
+        """
+
+        if self.__class__ == frozenmap:
+            return self
+
+        return self._from_root(self._root, self._size)
+
+    def __copy__(self):
+        r"""
+        See copy().
+        """
+
+        return self.copy()
+
+    def __reduce__(self):
+        r"""
+        Support for `pickle`.
+        """
+
+        return (self.__class__, (dict(self), ))
+
+    def set(self, key, value):
+        r"""
+        Returns a copy of the map with the new (key, value) item. The
+        copy shares all the unchanged nodes with the original map.
+        """
+
+        root, size, old_value = self._assoc(key, value)
+
+        if root is self._root:
+            return self
+
+        return self._from_root(root, size)
+
+    def setdefault(self, key, default=None):
+        r"""
+        If key is in the map, it returns the map unchanged. Otherwise,
+        it returns a copy of the map with the new (key, default) item.
+        """
+
+        if key in self:
+            return self
+
+        return self.set(key, default)
+
+    def delete(self, key):
+        r"""
+        Returns a copy of the map without the item of the corresponding
+        key. The copy shares all the unchanged nodes with the original
+        map.
+        """
+
+        root = self._root
+
+        if root is None:
+            raise KeyError(key)
+
+        new_root, old_value = _without(root, 0, key, hash(key))
+
+        if old_value is _subnode:
+            raise KeyError(key)
+
+        return self._from_root(new_root, self._size - 1)
+
+    def _entry_at(self, index):
+        size = self._size
+
+        if index < 0:
+            index += size
+
+        if not 0 <= index < size:
+            raise IndexError(
+                f"{self.__class__.__name__} index {index} out of range " +
+                f"{size - 1}"
+            )
+
+        return _entry_at(self._root, index)
+
+    def key(self, index=0):
+        r"""
+        Get the key at the specified index (iteration order).
+        """
+
+        return self._entry_at(index)[0]
+
+    def value(self, index=0):
+        r"""
+        Get the value at the specified index (iteration order).
+        """
+
+        return self._entry_at(index)[1]
+
+    def item(self, index=0):
+        r"""
+        Get the (key, value) item at the specified index (iteration
+        order).
+        """
+
+        return self._entry_at(index)[:2]
+
+    def __or__(self, other):
+        if not isinstance(other, (frozenmap, dict)):
+            return NotImplemented
+
+        new_self = self._from_root(self._root, self._size)
+        new_self._merge(other)
+
+        return new_self
+
+
+try:
+    from types import GenericAlias
+except ImportError:  # pragma: no cover
+    pass
+else:
+    frozenmap.__class_getitem__ = classmethod(GenericAlias)
+
+frozenmap.__module__ = _module_name
+
+__all__ = (frozenmap.__name__,)
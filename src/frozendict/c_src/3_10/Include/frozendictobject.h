@@ -60,6 +60,11 @@ static PyTypeObject PyFrozenDictValues_Type;
 // PyAPI_DATA(PyTypeObject) PyFrozenDictItems_Type;
 static PyTypeObject PyFrozenDictItems_Type;
 
+// PyAPI_DATA(PyTypeObject) PyFrozenDictSchema_Type;
+static PyTypeObject PyFrozenDictSchema_Type;
+// PyAPI_DATA(PyTypeObject) PyFrozenDictBuilder_Type;
+static PyTypeObject PyFrozenDictBuilder_Type;
+
 #define PyAnyDictKeys_Check(op) (PyDictKeys_Check(op) || PyObject_TypeCheck(op, &PyFrozenDictKeys_Type))
 #define PyAnyDictValues_Check(op) (PyDictValues_Check(op) || PyObject_TypeCheck(op, &PyFrozenDictValues_Type))
 #define PyAnyDictItems_Check(op) (PyDictItems_Check(op) || PyObject_TypeCheck(op, &PyFrozenDictItems_Type))
@@ -0,0 +1,1591 @@
+/* JSON encoder
+ *
+ * json_dumps() serializes frozendicts, dicts, lists, tuples, strs, ints,
+ * floats, bools and None with the same output of json.dumps() without
+ * indent. The items of the frozendicts are read directly from their
+ * tables, so they're not copied to a dict, as FrozendictJsonEncoder
+ * does. The other objects are passed to default, if given.
+ *
+ * As json.dumps(), the ids of the containers being encoded are kept in
+ * markers, so a container that contains itself raises ValueError. */
+
+typedef struct {
+    _PyUnicodeWriter writer;
+    PyObject* item_separator;
+    PyObject* key_separator;
+    PyObject* default_func;
+    PyObject* markers;
+    int skipkeys;
+    int ensure_ascii;
+    int allow_nan;
+    int sort_keys;
+} FrozendictJsonEncoder;
+
+static int frozendict_json_encode(
+    FrozendictJsonEncoder* enc,
+    PyObject* obj
+);
+
+static inline int frozendict_json_write_ascii(
+    FrozendictJsonEncoder* enc,
+    const char* ascii
+) {
+    return _PyUnicodeWriter_WriteASCIIString(
+        &enc->writer,
+        ascii,
+        (Py_ssize_t) strlen(ascii)
+    );
+}
+
+/* Returns 1 if JSON needs an escape sequence for the character c. */
+
+static inline int frozendict_json_must_escape(
+    const Py_UCS4 c,
+    const int ensure_ascii
+) {
+    if (c < 0x20 || c == '"' || c == '\\') {
+        return 1;
+    }
+
+    return ensure_ascii && c > 0x7e;
+}
+
+/* Writes in buf the escape sequence \uXXXX of c, that is at most
+ * 0xffff, and returns its length. */
+
+static inline Py_ssize_t frozendict_json_u_escape(char* buf, Py_UCS4 c) {
+    static const char hex[] = "0123456789abcdef";
+
+    buf[0] = '\\';
+    buf[1] = 'u';
+    buf[2] = hex[(c >> 12) & 0xf];
+    buf[3] = hex[(c >> 8) & 0xf];
+    buf[4] = hex[(c >> 4) & 0xf];
+    buf[5] = hex[c & 0xf];
+
+    return 6;
+}
+
+/* Writes the escape sequence of the character c. The characters out of
+ * the Basic Multilingual Plane are written as a surrogate pair. */
+
+static int frozendict_json_write_escape(
+    FrozendictJsonEncoder* enc,
+    Py_UCS4 c
+) {
+    char buf[12];
+    Py_ssize_t len = 2;
+    buf[0] = '\\';
+
+    switch (c) {
+        case '"': buf[1] = '"'; break;
+        case '\\': buf[1] = '\\'; break;
+        case '\b': buf[1] = 'b'; break;
+        case '\f': buf[1] = 'f'; break;
+        case '\n': buf[1] = 'n'; break;
+        case '\r': buf[1] = 'r'; break;
+        case '\t': buf[1] = 't'; break;
+        default:
+            if (c >= 0x10000) {
+                c -= 0x10000;
+                len = frozendict_json_u_escape(buf, 0xd800 | (c >> 10));
+                len += frozendict_json_u_escape(
+                    buf + len,
+                    0xdc00 | (c & 0x3ff)
+                );
+            }
+            else {
+                len = frozendict_json_u_escape(buf, c);
+            }
+    }
+
+    return _PyUnicodeWriter_WriteASCIIString(&enc->writer, buf, len);
+}
+
+/* Writes the str s as a JSON string. The runs of characters that don't
+ * need an escape sequence are copied at once. */
+
+static int frozendict_json_write_str(
+    FrozendictJsonEncoder* enc,
+    PyObject* s
+) {
+    if (PyUnicode_READY(s) < 0) {
+        return -1;
+    }
+
+    _PyUnicodeWriter* writer = &enc->writer;
+    const int kind = PyUnicode_KIND(s);
+    const void* data = PyUnicode_DATA(s);
+    const Py_ssize_t len = PyUnicode_GET_LENGTH(s);
+    const int ensure_ascii = enc->ensure_ascii;
+    Py_ssize_t start = 0;
+    Py_UCS4 c;
+
+    if (_PyUnicodeWriter_WriteChar(writer, '"') < 0) {
+        return -1;
+    }
+
+    for (Py_ssize_t i = 0; i < len; i++) {
+        c = PyUnicode_READ(kind, data, i);
+
+        if (! frozendict_json_must_escape(c, ensure_ascii)) {
+            continue;
+        }
+
+        if (
+            i > start
+            && _PyUnicodeWriter_WriteSubstring(writer, s, start, i) < 0
+        ) {
+            return -1;
+        }
+
+        if (frozendict_json_write_escape(enc, c) < 0) {
+            return -1;
+        }
+
+        start = i + 1;
+    }
+
+    if (start == 0) {
+        if (len > 0 && _PyUnicodeWriter_WriteStr(writer, s) < 0) {
+            return -1;
+        }
+    }
+    else if (
+        len > start
+        && _PyUnicodeWriter_WriteSubstring(writer, s, start, len) < 0
+    ) {
+        return -1;
+    }
+
+    return _PyUnicodeWriter_WriteChar(writer, '"');
+}
+
+/* Writes the int obj, as int.__repr__(). The exact ints that fit in a
+ * long long are formatted without creating a str. */
+
+static int frozendict_json_write_int(
+    FrozendictJsonEncoder* enc,
+    PyObject* obj
+) {
+    if (PyLong_CheckExact(obj)) {
+        int overflow;
+        const long long v = PyLong_AsLongLongAndOverflow(obj, &overflow);
+
+        if (overflow == 0) {
+            char buf[32];
+            const int len = PyOS_snprintf(buf, sizeof(buf), "%lld", v);
+
+            return _PyUnicodeWriter_WriteASCIIString(&enc->writer, buf, len);
+        }
+    }
+
+    PyObject* repr = PyLong_Type.tp_repr(obj);
+
+    if (repr == NULL) {
+        return -1;
+    }
+
+    const int res = _PyUnicodeWriter_WriteStr(&enc->writer, repr);
+    Py_DECREF(repr);
+
+    return res;
+}
+
+/* Writes the float obj, as float.__repr__(), or as NaN, Infinity or
+ * -Infinity if allow_nan is true. */
+
+static int frozendict_json_write_float(
+    FrozendictJsonEncoder* enc,
+    PyObject* obj
+) {
+    const double d = PyFloat_AS_DOUBLE(obj);
+
+    if (! Py_IS_FINITE(d)) {
+        if (! enc->allow_nan) {
+            PyErr_SetString(
+                PyExc_ValueError,
+                "Out of range float values are not JSON compliant"
+            );
+
+            return -1;
+        }
+
+        if (Py_IS_NAN(d)) {
+            return frozendict_json_write_ascii(enc, "NaN");
+        }
+
+        return frozendict_json_write_ascii(
+            enc,
+            d > 0 ? "Infinity" : "-Infinity"
+        );
+    }
+
+    char* repr = PyOS_double_to_string(d, 'r', 0, Py_DTSF_ADD_DOT_0, NULL);
+
+    if (repr == NULL) {
+        return -1;
+    }
+
+    const int res = frozendict_json_write_ascii(enc, repr);
+    PyMem_Free(repr);
+
+    return res;
+}
+
+/* Writes obj if it's None, a bool, a str, an int or a float. Returns 1
+ * if obj is not one of them, and nothing is written. */
+
+static int frozendict_json_write_scalar(
+    FrozendictJsonEncoder* enc,
+    PyObject* obj
+) {
+    if (obj == Py_None) {
+        return frozendict_json_write_ascii(enc, "null");
+    }
+
+    if (obj == Py_True) {
+        return frozendict_json_write_ascii(enc, "true");
+    }
+
+    if (obj == Py_False) {
+        return frozendict_json_write_ascii(enc, "false");
+    }
+
+    if (PyUnicode_Check(obj)) {
+        return frozendict_json_write_str(enc, obj);
+    }
+
+    if (PyLong_Check(obj)) {
+        return frozendict_json_write_int(enc, obj);
+    }
+
+    if (PyFloat_Check(obj)) {
+        return frozendict_json_write_float(enc, obj);
+    }
+
+    return 1;
+}
+
+/* Writes the item of an object, preceded by the item separator if it's
+ * not the first one. The keys that are not strs are converted as
+ * json.dumps() does, and the ones that can't be converted are skipped
+ * if skipkeys is true. */
+
+static int frozendict_json_write_item(
+    FrozendictJsonEncoder* enc,
+    PyObject* key,
+    PyObject* value,
+    int* first
+) {
+    const int is_str = PyUnicode_Check(key);
+
+    if (
+        ! is_str
+        && ! PyLong_Check(key)
+        && ! PyFloat_Check(key)
+        && key != Py_None
+    ) {
+        if (enc->skipkeys) {
+            return 0;
+        }
+
+        PyErr_Format(
+            PyExc_TypeError,
+            "keys must be str, int, float, bool or None, not %.100s",
+            Py_TYPE(key)->tp_name
+        );
+
+        return -1;
+    }
+
+    _PyUnicodeWriter* writer = &enc->writer;
+
+    if (*first) {
+        *first = 0;
+    }
+    else if (_PyUnicodeWriter_WriteStr(writer, enc->item_separator) < 0) {
+        return -1;
+    }
+
+    if (is_str) {
+        if (frozendict_json_write_str(enc, key) < 0) {
+            return -1;
+        }
+    }
+    else if (
+        _PyUnicodeWriter_WriteChar(writer, '"') < 0
+        || frozendict_json_write_scalar(enc, key) < 0
+        || _PyUnicodeWriter_WriteChar(writer, '"') < 0
+    ) {
+        return -1;
+    }
+
+    if (_PyUnicodeWriter_WriteStr(writer, enc->key_separator) < 0) {
+        return -1;
+    }
+
+    return frozendict_json_encode(enc, value);
+}
+
+/* Writes the items of a list of pairs, as returned by items(), sorted
+ * if sort_keys is true. */
+
+static int frozendict_json_write_items(
+    FrozendictJsonEncoder* enc,
+    PyObject* obj
+) {
+    _Py_IDENTIFIER(items);
+
+    PyObject* view = _PyObject_CallMethodId(obj, &PyId_items, NULL);
+
+    if (view == NULL) {
+        return -1;
+    }
+
+    PyObject* items = PySequence_List(view);
+    Py_DECREF(view);
+
+    if (items == NULL) {
+        return -1;
+    }
+
+    if (enc->sort_keys && PyList_Sort(items) < 0) {
+        Py_DECREF(items);
+        return -1;
+    }
+
+    int first = 1;
+    PyObject* item;
+
+    for (Py_ssize_t i = 0; i < PyList_GET_SIZE(items); i++) {
+        item = PyList_GET_ITEM(items, i);
+
+        if (! PyTuple_Check(item) || PyTuple_GET_SIZE(item) != 2) {
+            PyErr_SetString(PyExc_ValueError, "items must return 2-tuples");
+            Py_DECREF(items);
+            return -1;
+        }
+
+        if (frozendict_json_write_item(
+            enc,
+            PyTuple_GET_ITEM(item, 0),
+            PyTuple_GET_ITEM(item, 1),
+            &first
+        ) < 0) {
+            Py_DECREF(items);
+            return -1;
+        }
+    }
+
+    Py_DECREF(items);
+
+    return 0;
+}
+
+/* Writes the items of the dict or frozendict obj, as a JSON object. The
+ * items of frozendicts and exact dicts are read from their table, unless
+ * they must be sorted. */
+
+static int frozendict_json_write_dict(
+    FrozendictJsonEncoder* enc,
+    PyObject* obj
+) {
+    if (((PyDictObject*) obj)->ma_used == 0) {
+        return frozendict_json_write_ascii(enc, "{}");
+    }
+
+    if (_PyUnicodeWriter_WriteChar(&enc->writer, '{') < 0) {
+        return -1;
+    }
+
+    int first = 1;
+
+    if (enc->sort_keys || (PyDict_Check(obj) && ! PyDict_CheckExact(obj))) {
+        if (frozendict_json_write_items(enc, obj) < 0) {
+            return -1;
+        }
+    }
+    else if (PyDict_CheckExact(obj)) {
+        // default() can change the dict, so the items are kept alive
+        // while they're written
+        const Py_ssize_t size = ((PyDictObject*) obj)->ma_used;
+        Py_ssize_t pos = 0;
+        PyObject* key;
+        PyObject* value;
+        int res;
+
+        while (PyDict_Next(obj, &pos, &key, &value)) {
+            Py_INCREF(key);
+            Py_INCREF(value);
+            res = frozendict_json_write_item(enc, key, value, &first);
+            Py_DECREF(key);
+            Py_DECREF(value);
+
+            if (res < 0) {
+                return -1;
+            }
+
+            if (((PyDictObject*) obj)->ma_used != size) {
+                PyErr_SetString(
+                    PyExc_RuntimeError,
+                    "dictionary changed size during iteration"
+                );
+
+                return -1;
+            }
+        }
+    }
+    else {
+        PyDictObject* mp = (PyDictObject*) obj;
+        const PyDictKeyEntry* entries = DK_ENTRIES(mp->ma_keys);
+        PyObject* value;
+
+        for (Py_ssize_t i = 0; i < mp->ma_keys->dk_nentries; i++) {
+            value = frozendict_entry_value(mp, i);
+
+            if (value == NULL) {
+                continue;
+            }
+
+            if (frozendict_json_write_item(
+                enc,
+                entries[i].me_key,
+                value,
+                &first
+            ) < 0) {
+                return -1;
+            }
+        }
+    }
+
+    return _PyUnicodeWriter_WriteChar(&enc->writer, '}');
+}
+
+/* Writes the items of the list or tuple obj, as a JSON array. The size
+ * of a list is read again at every item, since default() can change
+ * it. */
+
+static int frozendict_json_write_array(
+    FrozendictJsonEncoder* enc,
+    PyObject* obj
+) {
+    const int is_list = PyList_Check(obj);
+
+    if (Py_SIZE(obj) == 0) {
+        return frozendict_json_write_ascii(enc, "[]");
+    }
+
+    if (_PyUnicodeWriter_WriteChar(&enc->writer, '[') < 0) {
+        return -1;
+    }
+
+    PyObject* item;
+    int res;
+
+    for (Py_ssize_t i = 0; i < Py_SIZE(obj); i++) {
+        if (
+            i > 0 &&
+            _PyUnicodeWriter_WriteStr(&enc->writer, enc->item_separator) < 0
+        ) {
+            return -1;
+        }
+
+        item = (
+            is_list
+            ? PyList_GET_ITEM(obj, i)
+            : PyTuple_GET_ITEM(obj, i)
+        );
+
+        Py_INCREF(item);
+        res = frozendict_json_encode(enc, item);
+        Py_DECREF(item);
+
+        if (res < 0) {
+            return -1;
+        }
+    }
+
+    return _PyUnicodeWriter_WriteChar(&enc->writer, ']');
+}
+
+/* Writes the object obj, converted by default if it's not one of the
+ * types supported. */
+
+static int frozendict_json_write_default(
+    FrozendictJsonEncoder* enc,
+    PyObject* obj
+) {
+    if (enc->default_func == NULL) {
+        const char* name = strrchr(Py_TYPE(obj)->tp_name, '.');
+
+        PyErr_Format(
+            PyExc_TypeError,
+            "Object of type %.100s is not JSON serializable",
+            name == NULL ? Py_TYPE(obj)->tp_name : name + 1
+        );
+
+        return -1;
+    }
+
+    PyObject* new_obj = PyObject_CallFunctionObjArgs(
+        enc->default_func,
+        obj,
+        NULL
+    );
+
+    if (new_obj == NULL) {
+        return -1;
+    }
+
+    const int res = frozendict_json_encode(enc, new_obj);
+    Py_DECREF(new_obj);
+
+    return res;
+}
+
+/* Adds the id of obj to the markers, and returns it. Raises ValueError
+ * if it's already there, that is obj is contained in itself. */
+
+static PyObject* frozendict_json_mark(
+    FrozendictJsonEncoder* enc,
+    PyObject* obj
+) {
+    PyObject* ident = PyLong_FromVoidPtr(obj);
+
+    if (ident == NULL) {
+        return NULL;
+    }
+
+    int res = PySet_Contains(enc->markers, ident);
+
+    if (res > 0) {
+        PyErr_SetString(PyExc_ValueError, "Circular reference detected");
+    }
+    else if (res == 0) {
+        res = PySet_Add(enc->markers, ident);
+    }
+
+    if (res != 0) {
+        Py_DECREF(ident);
+        return NULL;
+    }
+
+    return ident;
+}
+
+static int frozendict_json_encode(
+    FrozendictJsonEncoder* enc,
+    PyObject* obj
+) {
+    int res = frozendict_json_write_scalar(enc, obj);
+
+    if (res <= 0) {
+        return res;
+    }
+
+    PyObject* ident = frozendict_json_mark(enc, obj);
+
+    if (ident == NULL) {
+        return -1;
+    }
+
+    if (Py_EnterRecursiveCall(" while encoding a JSON object")) {
+        Py_DECREF(ident);
+        return -1;
+    }
+
+    // the callers can hold only borrowed references of obj, and
+    // default() can drop the others
+    Py_INCREF(obj);
+
+    if (PyList_Check(obj) || PyTuple_Check(obj)) {
+        res = frozendict_json_write_array(enc, obj);
+    }
+    else if (PyDict_Check(obj) || PyAnyFrozenDict_Check(obj)) {
+        res = frozendict_json_write_dict(enc, obj);
+    }
+    else {
+        res = frozendict_json_write_default(enc, obj);
+    }
+
+    Py_DECREF(obj);
+    Py_LeaveRecursiveCall();
+
+    if (res == 0 && PySet_Discard(enc->markers, ident) < 0) {
+        res = -1;
+    }
+
+    Py_DECREF(ident);
+
+    return res;
+}
+
+/* Reads in enc the separators, that are None or a pair of strs. */
+
+static int frozendict_json_separators(
+    FrozendictJsonEncoder* enc,
+    PyObject* separators
+) {
+    _Py_static_string(PyId_item_separator, ", ");
+    _Py_static_string(PyId_key_separator, ": ");
+
+    if (separators == Py_None) {
+        enc->item_separator = _PyUnicode_FromId(&PyId_item_separator);
+        enc->key_separator = _PyUnicode_FromId(&PyId_key_separator);
+
+        if (enc->item_separator == NULL || enc->key_separator == NULL) {
+            return -1;
+        }
+
+        Py_INCREF(enc->item_separator);
+        Py_INCREF(enc->key_separator);
+
+        return 0;
+    }
+
+    PyObject* seps = PySequence_Tuple(separators);
+
+    if (seps == NULL) {
+        return -1;
+    }
+
+    if (
+        PyTuple_GET_SIZE(seps) != 2
+        || ! PyUnicode_Check(PyTuple_GET_ITEM(seps, 0))
+        || ! PyUnicode_Check(PyTuple_GET_ITEM(seps, 1))
+    ) {
+        Py_DECREF(seps);
+
+        PyErr_SetString(
+            PyExc_TypeError,
+            "separators must be a pair of str"
+        );
+
+        return -1;
+    }
+
+    enc->item_separator = PyTuple_GET_ITEM(seps, 0);
+    enc->key_separator = PyTuple_GET_ITEM(seps, 1);
+    Py_INCREF(enc->item_separator);
+    Py_INCREF(enc->key_separator);
+    Py_DECREF(seps);
+
+    return 0;
+}
+
+static PyObject* frozendict_json_dumps(
+    PyObject* Py_UNUSED(module),
+    PyObject* args,
+    PyObject* kwds
+) {
+    static char* kwlist[] = {
+        "obj",
+        "skipkeys",
+        "ensure_ascii",
+        "allow_nan",
+        "sort_keys",
+        "separators",
+        "default",
+        NULL
+    };
+
+    FrozendictJsonEncoder enc;
+    PyObject* obj;
+    PyObject* separators = Py_None;
+    PyObject* default_func = Py_None;
+
+    enc.skipkeys = 0;
+    enc.ensure_ascii = 1;
+    enc.allow_nan = 1;
+    enc.sort_keys = 0;
+
+    if (! PyArg_ParseTupleAndKeywords(
+        args,
+        kwds,
+        "O|$ppppOO:json_dumps",
+        kwlist,
+        &obj,
+        &enc.skipkeys,
+        &enc.ensure_ascii,
+        &enc.allow_nan,
+        &enc.sort_keys,
+        &separators,
+        &default_func
+    )) {
+        return NULL;
+    }
+
+    if (frozendict_json_separators(&enc, separators) < 0) {
+        return NULL;
+    }
+
+    enc.default_func = default_func == Py_None ? NULL : default_func;
+    enc.markers = PySet_New(NULL);
+
+    if (enc.markers == NULL) {
+        Py_DECREF(enc.item_separator);
+        Py_DECREF(enc.key_separator);
+        return NULL;
+    }
+
+    _PyUnicodeWriter_Init(&enc.writer);
+    enc.writer.overallocate = 1;
+
+    const int res = frozendict_json_encode(&enc, obj);
+
+    Py_DECREF(enc.markers);
+    Py_DECREF(enc.item_separator);
+    Py_DECREF(enc.key_separator);
+
+    if (res < 0) {
+        _PyUnicodeWriter_Dealloc(&enc.writer);
+        return NULL;
+    }
+
+    return _PyUnicodeWriter_Finish(&enc.writer);
+}
+
+PyDoc_STRVAR(frozendict_json_dumps_doc,
+"json_dumps($module, obj, /, *, skipkeys=False, ensure_ascii=True, \n"
+"           allow_nan=True, sort_keys=False, separators=None, \n"
+"           default=None)\n"
+"--\n"
+"\n"
+"Serializes obj to a JSON str, as json.dumps() without indent. \n"
+"frozendicts are serialized as dicts, reading their items directly.   ");
+
+/* JSON decoder
+ *
+ * json_loads() parses a JSON document directly into frozendicts, for
+ * the objects, and tuples, for the arrays. The values of a container are
+ * pushed on a stack while they're parsed, so its size is known when the
+ * container is created: tuples and tables are allocated once, with no
+ * room for other items. The keys of the objects are interned, so the
+ * keys repeated in the document, or in other documents, are stored
+ * once. */
+
+typedef struct {
+    PyObject* str;
+    const void* data;
+    int kind;
+    Py_ssize_t len;
+    PyObject** stack;
+    Py_ssize_t stack_len;
+    Py_ssize_t stack_size;
+} FrozendictJsonDecoder;
+
+static PyObject* frozendict_json_parse_value(
+    FrozendictJsonDecoder* dec,
+    Py_ssize_t pos,
+    Py_ssize_t* next
+);
+
+#define FROZENDICT_JSON_CHAR(dec, i) \
+    PyUnicode_READ((dec)->kind, (dec)->data, (i))
+
+/* Raises json.JSONDecodeError with the message msg at the position pos
+ * of the document. */
+
+static void frozendict_json_error(
+    FrozendictJsonDecoder* dec,
+    const char* msg,
+    const Py_ssize_t pos
+) {
+    PyObject* decoder = PyImport_ImportModule("json.decoder");
+
+    if (decoder == NULL) {
+        return;
+    }
+
+    PyObject* exc_type = PyObject_GetAttrString(decoder, "JSONDecodeError");
+    Py_DECREF(decoder);
+
+    if (exc_type == NULL) {
+        return;
+    }
+
+    PyObject* exc = PyObject_CallFunction(
+        exc_type,
+        "sOn",
+        msg,
+        dec->str,
+        pos
+    );
+
+    if (exc != NULL) {
+        PyErr_SetObject(exc_type, exc);
+        Py_DECREF(exc);
+    }
+
+    Py_DECREF(exc_type);
+}
+
+static inline Py_ssize_t frozendict_json_skip_ws(
+    FrozendictJsonDecoder* dec,
+    Py_ssize_t pos
+) {
+    Py_UCS4 c;
+
+    while (pos < dec->len) {
+        c = FROZENDICT_JSON_CHAR(dec, pos);
+
+        if (c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+            break;
+        }
+
+        pos++;
+    }
+
+    return pos;
+}
+
+/* Pushes obj on the stack, stealing its reference. */
+
+static int frozendict_json_push(FrozendictJsonDecoder* dec, PyObject* obj) {
+    if (dec->stack_len == dec->stack_size) {
+        const Py_ssize_t new_size = dec->stack_size * 2;
+        PyObject** stack = PyMem_Realloc(
+            dec->stack,
+            new_size * sizeof(PyObject*)
+        );
+
+        if (stack == NULL) {
+            Py_DECREF(obj);
+            PyErr_NoMemory();
+            return -1;
+        }
+
+        dec->stack = stack;
+        dec->stack_size = new_size;
+    }
+
+    dec->stack[dec->stack_len++] = obj;
+
+    return 0;
+}
+
+/* Returns 1 if the text of the document at pos is literal. */
+
+static int frozendict_json_match(
+    FrozendictJsonDecoder* dec,
+    const Py_ssize_t pos,
+    const char* literal
+) {
+    const Py_ssize_t len = (Py_ssize_t) strlen(literal);
+
+    if (pos + len > dec->len) {
+        return 0;
+    }
+
+    for (Py_ssize_t i = 0; i < len; i++) {
+        if (FROZENDICT_JSON_CHAR(dec, pos + i) != (Py_UCS4) literal[i]) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/* Returns the value of the 4 hex digits at pos, or -1. */
+
+static long frozendict_json_hex4(
+    FrozendictJsonDecoder* dec,
+    const Py_ssize_t pos
+) {
+    if (pos + 4 > dec->len) {
+        return -1;
+    }
+
+    long res = 0;
+    Py_UCS4 c;
+
+    for (Py_ssize_t i = pos; i < pos + 4; i++) {
+        c = FROZENDICT_JSON_CHAR(dec, i);
+        res <<= 4;
+
+        if (c >= '0' && c <= '9') {
+            res |= c - '0';
+        }
+        else if (c >= 'a' && c <= 'f') {
+            res |= c - 'a' + 10;
+        }
+        else if (c >= 'A' && c <= 'F') {
+            res |= c - 'A' + 10;
+        }
+        else {
+            return -1;
+        }
+    }
+
+    return res;
+}
+
+/* Parses the escape sequence at pos, that is after a backslash and
+ * before the end of the document, and writes its character. */
+
+static int frozendict_json_parse_escape(
+    FrozendictJsonDecoder* dec,
+    _PyUnicodeWriter* writer,
+    Py_ssize_t pos,
+    Py_ssize_t* next
+) {
+    Py_UCS4 c = FROZENDICT_JSON_CHAR(dec, pos);
+
+    switch (c) {
+        case '"': case '\\': case '/': break;
+        case 'b': c = '\b'; break;
+        case 'f': c = '\f'; break;
+        case 'n': c = '\n'; break;
+        case 'r': c = '\r'; break;
+        case 't': c = '\t'; break;
+        case 'u': {
+            long u = frozendict_json_hex4(dec, pos + 1);
+
+            if (u < 0) {
+                frozendict_json_error(dec, "Invalid \\uXXXX escape", pos);
+                return -1;
+            }
+
+            pos += 4;
+            c = (Py_UCS4) u;
+
+            // a high surrogate followed by a low one is a single
+            // character, the lone ones are kept as they are
+            if (
+                Py_UNICODE_IS_HIGH_SURROGATE(c)
+                && frozendict_json_match(dec, pos + 1, "\\u")
+            ) {
+                u = frozendict_json_hex4(dec, pos + 3);
+
+                if (u < 0) {
+                    frozendict_json_error(
+                        dec,
+                        "Invalid \\uXXXX escape",
+                        pos + 2
+                    );
+
+                    return -1;
+                }
+
+                if (Py_UNICODE_IS_LOW_SURROGATE(u)) {
+                    c = Py_UNICODE_JOIN_SURROGATES(c, (Py_UCS4) u);
+                    pos += 6;
+                }
+            }
+
+            break;
+        }
+        default:
+            frozendict_json_error(dec, "Invalid \\escape", pos - 1);
+            return -1;
+    }
+
+    *next = pos + 1;
+
+    return _PyUnicodeWriter_WriteChar(writer, c);
+}
+
+/* Parses the string that starts after the quote at pos. The strings
+ * without escape sequences are simply sliced from the document. */
+
+static PyObject* frozendict_json_parse_str(
+    FrozendictJsonDecoder* dec,
+    const Py_ssize_t pos,
+    Py_ssize_t* next
+) {
+    Py_ssize_t i = pos;
+    Py_UCS4 c = 0;
+
+    for (; i < dec->len; i++) {
+        c = FROZENDICT_JSON_CHAR(dec, i);
+
+        if (c == '"' || c == '\\' || c < 0x20) {
+            break;
+        }
+    }
+
+    if (i < dec->len && c == '"') {
+        *next = i + 1;
+        return PyUnicode_Substring(dec->str, pos, i);
+    }
+
+    _PyUnicodeWriter writer;
+    _PyUnicodeWriter_Init(&writer);
+    writer.overallocate = 1;
+
+    Py_ssize_t start = pos;
+
+    while (1) {
+        // a backslash needs at least the character after it
+        if (
+            i >= dec->len
+            || (FROZENDICT_JSON_CHAR(dec, i) == '\\' && i + 1 >= dec->len)
+        ) {
+            frozendict_json_error(
+                dec,
+                "Unterminated string starting at",
+                pos - 1
+            );
+
+            goto error;
+        }
+
+        c = FROZENDICT_JSON_CHAR(dec, i);
+
+        if (c == '"' || c == '\\') {
+            if (
+                i > start
+                && _PyUnicodeWriter_WriteSubstring(
+                    &writer,
+                    dec->str,
+                    start,
+                    i
+                ) < 0
+            ) {
+                goto error;
+            }
+
+            if (c == '"') {
+                break;
+            }
+
+            if (frozendict_json_parse_escape(dec, &writer, i + 1, &i) < 0) {
+                goto error;
+            }
+
+            start = i;
+        }
+        else if (c < 0x20) {
+            frozendict_json_error(dec, "Invalid control character at", i);
+            goto error;
+        }
+        else {
+            i++;
+        }
+    }
+
+    *next = i + 1;
+
+    return _PyUnicodeWriter_Finish(&writer);
+
+error:
+    _PyUnicodeWriter_Dealloc(&writer);
+    return NULL;
+}
+
+/* Parses the number at pos, as json.loads(). The ints with at most 18
+ * digits are computed directly. */
+
+static PyObject* frozendict_json_parse_number(
+    FrozendictJsonDecoder* dec,
+    const Py_ssize_t pos,
+    Py_ssize_t* next
+) {
+    Py_ssize_t i = pos;
+    const Py_ssize_t len = dec->len;
+    int is_float = 0;
+
+    if (i < len && FROZENDICT_JSON_CHAR(dec, i) == '-') {
+        i++;
+    }
+
+    const Py_ssize_t digits_start = i;
+
+    if (i < len && FROZENDICT_JSON_CHAR(dec, i) == '0') {
+        i++;
+    }
+    else if (
+        i < len
+        && FROZENDICT_JSON_CHAR(dec, i) >= '1'
+        && FROZENDICT_JSON_CHAR(dec, i) <= '9'
+    ) {
+        i++;
+
+        while (
+            i < len
+            && FROZENDICT_JSON_CHAR(dec, i) >= '0'
+            && FROZENDICT_JSON_CHAR(dec, i) <= '9'
+        ) {
+            i++;
+        }
+    }
+    else {
+        frozendict_json_error(dec, "Expecting value", pos);
+        return NULL;
+    }
+
+    const Py_ssize_t digits_end = i;
+
+    // a fraction or an exponent without digits is not part of the
+    // number
+    if (
+        i + 1 < len
+        && FROZENDICT_JSON_CHAR(dec, i) == '.'
+        && FROZENDICT_JSON_CHAR(dec, i + 1) >= '0'
+        && FROZENDICT_JSON_CHAR(dec, i + 1) <= '9'
+    ) {
+        is_float = 1;
+        i += 2;
+
+        while (
+            i < len
+            && FROZENDICT_JSON_CHAR(dec, i) >= '0'
+            && FROZENDICT_JSON_CHAR(dec, i) <= '9'
+        ) {
+            i++;
+        }
+    }
+
+    if (
+        i < len
+        && (
+            FROZENDICT_JSON_CHAR(dec, i) == 'e'
+            || FROZENDICT_JSON_CHAR(dec, i) == 'E'
+        )
+    ) {
+        Py_ssize_t e = i + 1;
+
+        if (
+            e < len
+            && (
+                FROZENDICT_JSON_CHAR(dec, e) == '+'
+                || FROZENDICT_JSON_CHAR(dec, e) == '-'
+            )
+        ) {
+            e++;
+        }
+
+        const Py_ssize_t exp_start = e;
+
+        while (
+            e < len
+            && FROZENDICT_JSON_CHAR(dec, e) >= '0'
+            && FROZENDICT_JSON_CHAR(dec, e) <= '9'
+        ) {
+            e++;
+        }
+
+        if (e > exp_start) {
+            is_float = 1;
+            i = e;
+        }
+    }
+
+    *next = i;
+
+    if (! is_float && digits_end - digits_start <= 18) {
+        long long v = 0;
+
+        for (Py_ssize_t j = digits_start; j < digits_end; j++) {
+            v = v * 10 + (FROZENDICT_JSON_CHAR(dec, j) - '0');
+        }
+
+        return PyLong_FromLongLong(digits_start > pos ? -v : v);
+    }
+
+    // the number is ASCII, so it can be parsed from a copy as a char*
+    const Py_ssize_t num_len = i - pos;
+    char* buf = PyMem_Malloc(num_len + 1);
+
+    if (buf == NULL) {
+        return PyErr_NoMemory();
+    }
+
+    for (Py_ssize_t j = 0; j < num_len; j++) {
+        buf[j] = (char) FROZENDICT_JSON_CHAR(dec, pos + j);
+    }
+
+    buf[num_len] = '\0';
+
+    PyObject* res;
+
+    if (is_float) {
+        const double d = PyOS_string_to_double(buf, NULL, NULL);
+        res = (d == -1.0 && PyErr_Occurred()) ? NULL : PyFloat_FromDouble(d);
+    }
+    else {
+        res = PyLong_FromString(buf, NULL, 10);
+    }
+
+    PyMem_Free(buf);
+
+    return res;
+}
+
+/* Returns a new, exact frozendict with the n keys and values on the top
+ * of the stack, and pops them. The table has room for exactly n items,
+ * and a key repeated in the object keeps its last value, as
+ * json.loads(). */
+
+static PyObject* frozendict_json_new_object(
+    FrozendictJsonDecoder* dec,
+    const Py_ssize_t n
+) {
+    PyObject** items = dec->stack + dec->stack_len - 2 * n;
+    PyObject* self = frozendict_new_barebone(&PyFrozenDict_Type);
+
+    if (self == NULL) {
+        return NULL;
+    }
+
+    if (n == 0) {
+        return frozendict_create_empty(
+            (PyFrozenDictObject*) self,
+            &PyFrozenDict_Type,
+            1
+        );
+    }
+
+    PyFrozenDictObject* mp = (PyFrozenDictObject*) self;
+    mp->ma_keys = frozendict_new_keys_fit(n);
+
+    if (mp->ma_keys == NULL) {
+        Py_DECREF(self);
+        return NULL;
+    }
+
+    // the keys are exact strs, and their hash is already computed by
+    // the interning
+    for (Py_ssize_t i = 0; i < 2 * n; i += 2) {
+        if (frozendict_setitem(self, items[i], items[i + 1], 0) < 0) {
+            Py_DECREF(self);
+            return NULL;
+        }
+    }
+
+    for (Py_ssize_t i = 0; i < 2 * n; i++) {
+        Py_DECREF(items[i]);
+    }
+
+    dec->stack_len -= 2 * n;
+    mp->ma_version_tag = DICT_NEXT_VERSION();
+
+    return frozendict_compact(self);
+}
+
+/* Parses the object that starts after the brace at pos. */
+
+static PyObject* frozendict_json_parse_object(
+    FrozendictJsonDecoder* dec,
+    Py_ssize_t pos,
+    Py_ssize_t* next
+) {
+    Py_ssize_t n = 0;
+    PyObject* obj;
+
+    pos = frozendict_json_skip_ws(dec, pos);
+
+    if (pos < dec->len && FROZENDICT_JSON_CHAR(dec, pos) == '}') {
+        *next = pos + 1;
+        return frozendict_json_new_object(dec, 0);
+    }
+
+    while (1) {
+        if (pos >= dec->len || FROZENDICT_JSON_CHAR(dec, pos) != '"') {
+            frozendict_json_error(
+                dec,
+                "Expecting property name enclosed in double quotes",
+                pos
+            );
+
+            return NULL;
+        }
+
+        obj = frozendict_json_parse_str(dec, pos + 1, &pos);
+
+        if (obj == NULL) {
+            return NULL;
+        }
+
+        PyUnicode_InternInPlace(&obj);
+
+        if (frozendict_json_push(dec, obj) < 0) {
+            return NULL;
+        }
+
+        pos = frozendict_json_skip_ws(dec, pos);
+
+        if (pos >= dec->len || FROZENDICT_JSON_CHAR(dec, pos) != ':') {
+            frozendict_json_error(dec, "Expecting ':' delimiter", pos);
+            return NULL;
+        }
+
+        pos = frozendict_json_skip_ws(dec, pos + 1);
+        obj = frozendict_json_parse_value(dec, pos, &pos);
+
+        if (obj == NULL || frozendict_json_push(dec, obj) < 0) {
+            return NULL;
+        }
+
+        n++;
+        pos = frozendict_json_skip_ws(dec, pos);
+
+        if (pos < dec->len && FROZENDICT_JSON_CHAR(dec, pos) == '}') {
+            break;
+        }
+
+        if (pos >= dec->len || FROZENDICT_JSON_CHAR(dec, pos) != ',') {
+            frozendict_json_error(dec, "Expecting ',' delimiter", pos);
+            return NULL;
+        }
+
+        pos = frozendict_json_skip_ws(dec, pos + 1);
+    }
+
+    *next = pos + 1;
+
+    return frozendict_json_new_object(dec, n);
+}
+
+/* Parses the array that starts after the bracket at pos, as a tuple. */
+
+static PyObject* frozendict_json_parse_array(
+    FrozendictJsonDecoder* dec,
+    Py_ssize_t pos,
+    Py_ssize_t* next
+) {
+    const Py_ssize_t base = dec->stack_len;
+    PyObject* obj;
+
+    pos = frozendict_json_skip_ws(dec, pos);
+
+    if (pos < dec->len && FROZENDICT_JSON_CHAR(dec, pos) == ']') {
+        *next = pos + 1;
+        return PyTuple_New(0);
+    }
+
+    while (1) {
+        obj = frozendict_json_parse_value(dec, pos, &pos);
+
+        if (obj == NULL || frozendict_json_push(dec, obj) < 0) {
+            return NULL;
+        }
+
+        pos = frozendict_json_skip_ws(dec, pos);
+
+        if (pos < dec->len && FROZENDICT_JSON_CHAR(dec, pos) == ']') {
+            break;
+        }
+
+        if (pos >= dec->len || FROZENDICT_JSON_CHAR(dec, pos) != ',') {
+            frozendict_json_error(dec, "Expecting ',' delimiter", pos);
+            return NULL;
+        }
+
+        pos = frozendict_json_skip_ws(dec, pos + 1);
+    }
+
+    *next = pos + 1;
+
+    const Py_ssize_t n = dec->stack_len - base;
+    PyObject* res = PyTuple_New(n);
+
+    if (res == NULL) {
+        return NULL;
+    }
+
+    // the references are moved from the stack to the tuple
+    memcpy(
+        &PyTuple_GET_ITEM(res, 0),
+        dec->stack + base,
+        n * sizeof(PyObject*)
+    );
+
+    dec->stack_len = base;
+
+    return res;
+}
+
+static PyObject* frozendict_json_parse_value(
+    FrozendictJsonDecoder* dec,
+    Py_ssize_t pos,
+    Py_ssize_t* next
+) {
+    if (pos >= dec->len) {
+        frozendict_json_error(dec, "Expecting value", pos);
+        return NULL;
+    }
+
+    PyObject* res;
+
+    switch (FROZENDICT_JSON_CHAR(dec, pos)) {
+        case '"':
+            return frozendict_json_parse_str(dec, pos + 1, next);
+        case '{':
+        case '[':
+            if (Py_EnterRecursiveCall(" while decoding a JSON document")) {
+                return NULL;
+            }
+
+            if (FROZENDICT_JSON_CHAR(dec, pos) == '{') {
+                res = frozendict_json_parse_object(dec, pos + 1, next);
+            }
+            else {
+                res = frozendict_json_parse_array(dec, pos + 1, next);
+            }
+
+            Py_LeaveRecursiveCall();
+
+            return res;
+        case 'n':
+            if (frozendict_json_match(dec, pos, "null")) {
+                *next = pos + 4;
+                Py_RETURN_NONE;
+            }
+
+            break;
+        case 't':
+            if (frozendict_json_match(dec, pos, "true")) {
+                *next = pos + 4;
+                Py_RETURN_TRUE;
+            }
+
+            break;
+        case 'f':
+            if (frozendict_json_match(dec, pos, "false")) {
+                *next = pos + 5;
+                Py_RETURN_FALSE;
+            }
+
+            break;
+        case 'N':
+            if (frozendict_json_match(dec, pos, "NaN")) {
+                *next = pos + 3;
+                return PyFloat_FromDouble(Py_NAN);
+            }
+
+            break;
+        case 'I':
+            if (frozendict_json_match(dec, pos, "Infinity")) {
+                *next = pos + 8;
+                return PyFloat_FromDouble(Py_HUGE_VAL);
+            }
+
+            break;
+        case '-':
+            if (frozendict_json_match(dec, pos, "-Infinity")) {
+                *next = pos + 9;
+                return PyFloat_FromDouble(-Py_HUGE_VAL);
+            }
+
+            return frozendict_json_parse_number(dec, pos, next);
+        default:
+            return frozendict_json_parse_number(dec, pos, next);
+    }
+
+    frozendict_json_error(dec, "Expecting value", pos);
+
+    return NULL;
+}
+
+/* Returns the document s as a str. bytes and bytearray are decoded from
+ * UTF-8, skipping the BOM. */
+
+static PyObject* frozendict_json_document(PyObject* s) {
+    const char* buf;
+    Py_ssize_t len;
+
+    if (PyUnicode_Check(s)) {
+        if (PyUnicode_READY(s) < 0) {
+            return NULL;
+        }
+
+        Py_INCREF(s);
+        return s;
+    }
+
+    if (PyBytes_Check(s)) {
+        buf = PyBytes_AS_STRING(s);
+        len = PyBytes_GET_SIZE(s);
+    }
+    else if (PyByteArray_Check(s)) {
+        buf = PyByteArray_AS_STRING(s);
+        len = PyByteArray_GET_SIZE(s);
+    }
+    else {
+        PyErr_Format(
+            PyExc_TypeError,
+            "the JSON object must be str, bytes or bytearray, not %.100s",
+            Py_TYPE(s)->tp_name
+        );
+
+        return NULL;
+    }
+
+    if (len >= 3 && memcmp(buf, "\xef\xbb\xbf", 3) == 0) {
+        buf += 3;
+        len -= 3;
+    }
+
+    return PyUnicode_DecodeUTF8(buf, len, "surrogatepass");
+}
+
+static PyObject* frozendict_json_loads(
+    PyObject* Py_UNUSED(module),
+    PyObject* s
+) {
+    FrozendictJsonDecoder dec;
+    PyObject* res = NULL;
+
+    dec.str = frozendict_json_document(s);
+
+    if (dec.str == NULL) {
+        return NULL;
+    }
+
+    dec.data = PyUnicode_DATA(dec.str);
+    dec.kind = PyUnicode_KIND(dec.str);
+    dec.len = PyUnicode_GET_LENGTH(dec.str);
+    dec.stack_len = 0;
+    dec.stack_size = 64;
+    dec.stack = PyMem_New(PyObject*, dec.stack_size);
+
+    if (dec.stack == NULL) {
+        Py_DECREF(dec.str);
+        return PyErr_NoMemory();
+    }
+
+    if (dec.len > 0 && FROZENDICT_JSON_CHAR(&dec, 0) == 0xfeff) {
+        frozendict_json_error(
+            &dec,
+            "Unexpected UTF-8 BOM (decode using utf-8-sig)",
+            0
+        );
+
+        goto end;
+    }
+
+    Py_ssize_t pos = frozendict_json_skip_ws(&dec, 0);
+    res = frozendict_json_parse_value(&dec, pos, &pos);
+
+    if (res == NULL) {
+        goto end;
+    }
+
+    pos = frozendict_json_skip_ws(&dec, pos);
+
+    if (pos != dec.len) {
+        Py_CLEAR(res);
+        frozendict_json_error(&dec, "Extra data", pos);
+    }
+
+end:
+    // on errors, the values of the unfinished containers are left on the
+    // stack
+    for (Py_ssize_t i = 0; i < dec.stack_len; i++) {
+        Py_DECREF(dec.stack[i]);
+    }
+
+    PyMem_Free(dec.stack);
+    Py_DECREF(dec.str);
+
+    return res;
+}
+
+PyDoc_STRVAR(frozendict_json_loads_doc,
+"json_loads($module, s, /)\n"
+"--\n"
+"\n"
+"Parses the JSON document s, a str or UTF-8 bytes, as json.loads(). \n"
+"The objects are returned as frozendicts and the arrays as tuples.   ");
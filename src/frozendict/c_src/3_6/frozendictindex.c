@@ -0,0 +1,824 @@
+/* Alternative indexes of the keys of optimized frozendicts, see
+ * frozendict_optimize(), and of small frozendicts.
+ *
+ * An index is built once over the dense entries of the table and
+ * replaces the dk_lookup of the keys with its own lookup. The index is
+ * owned by the frozendict, and the keys can be copied by the other
+ * methods without it, so the copies restore base_lookup. */
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FROZENDICT_GROUPS_SSE2
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#define FROZENDICT_INDEX_MAX_SIZE (INT32_MAX / 2)
+
+struct _frozendict_index {
+    dict_lookup_func base_lookup;
+    Py_ssize_t memsize;
+};
+
+static inline uint64_t frozendict_index_mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+
+    return x;
+}
+
+/* Compares startkey, the key of an entry with the same hash of key,
+ * with key. Returns 1 if they're equal, 0 if not and -1 on errors. */
+
+static inline int frozendict_index_key_eq(PyObject* startkey, PyObject* key) {
+    if (PyUnicode_CheckExact(key) && PyUnicode_CheckExact(startkey)) {
+        return unicode_eq(startkey, key);
+    }
+
+    Py_INCREF(startkey);
+    const int cmp = PyObject_RichCompareBool(startkey, key, Py_EQ);
+    Py_DECREF(startkey);
+
+    return cmp;
+}
+
+/* Perfect hash index, see frozendict_perfect_new().
+ *
+ * The keys are mapped to the positions [0, size) by a "hash and
+ * displace" function, as in PTHash: the mixed hash of the key selects
+ * a bucket, and the pilot of the bucket displaces the key to its
+ * position in a table a little bigger than size. The positions greater
+ * than size are remapped to the free ones, so the function is minimal,
+ * and slots maps the positions to the indexes of the entries. A lookup
+ * is a single probe, and a miss is a single comparison of hashes. */
+
+typedef struct {
+    PyFrozenDictIndex base;
+    uint64_t seed;
+    Py_ssize_t size;
+    Py_ssize_t table_size;
+    Py_ssize_t buckets_num;
+    int32_t* slots;
+    int32_t* remap;
+    uint16_t* pilots;
+} PyFrozenDictPerfect;
+
+static inline Py_ssize_t frozendict_perfect_bucket(
+    const PyFrozenDictPerfect* ph,
+    const uint64_t h
+) {
+    return (Py_ssize_t) (((h >> 32) * (uint64_t) ph->buckets_num) >> 32);
+}
+
+static inline Py_ssize_t frozendict_perfect_position(
+    const PyFrozenDictPerfect* ph,
+    const uint64_t h,
+    const uint16_t pilot
+) {
+    const uint64_t x = (h ^ frozendict_index_mix(pilot)) & 0xffffffffULL;
+    return (Py_ssize_t) ((x * (uint64_t) ph->table_size) >> 32);
+}
+
+static Py_ssize_t _Py_HOT_FUNCTION
+frozendict_lookup_perfect(
+    PyDictObject* mp,
+    PyObject* key,
+    Py_hash_t hash,
+    PyObject*** value_addr,
+    Py_ssize_t* hashpos
+) {
+    const PyFrozenDictPerfect* ph = (
+        (const PyFrozenDictPerfect*) ((PyFrozenDictObject*) mp)->ma_index
+    );
+
+    // the position in the indices is known only by the probing
+    if (ph == NULL || hashpos != NULL) {
+        return lookdict(mp, key, hash, value_addr, hashpos);
+    }
+
+    const uint64_t h = frozendict_index_mix((uint64_t) hash ^ ph->seed);
+    const uint16_t pilot = ph->pilots[frozendict_perfect_bucket(ph, h)];
+    Py_ssize_t pos = frozendict_perfect_position(ph, h, pilot);
+
+    if (pos >= ph->size) {
+        pos = ph->remap[pos - ph->size];
+    }
+
+    const Py_ssize_t ix = ph->slots[pos];
+    PyDictKeyEntry* ep = &DK_ENTRIES(mp->ma_keys)[ix];
+
+    if (ep->me_key == key) {
+        *value_addr = &ep->me_value;
+        return ix;
+    }
+
+    if (ep->me_hash == hash) {
+        const int cmp = frozendict_index_key_eq(ep->me_key, key);
+
+        if (cmp < 0) {
+            *value_addr = NULL;
+            return DKIX_ERROR;
+        }
+
+        if (cmp > 0) {
+            *value_addr = &ep->me_value;
+            return ix;
+        }
+    }
+
+    // the hashes of the keys are all different, so key is not present
+    *value_addr = NULL;
+    return DKIX_EMPTY;
+}
+
+/* Group probing index, see frozendict_groups_new().
+ *
+ * As in SwissTable, every slot of the table has a control byte, that
+ * is FROZENDICT_CTRL_EMPTY or the lowest 7 bits of the mixed hash of
+ * the key in the slot. The other bits select the first group of
+ * FROZENDICT_GROUP_WIDTH slots to probe, and the control bytes of a
+ * whole group are compared with the 7 bits of the key at once, with
+ * SSE2 if available. The entries are touched only when their control
+ * byte matches, and a group with an empty slot ends the probing, so a
+ * miss usually reads only the control bytes. The first control bytes
+ * are mirrored after the last one, so a group can start at any
+ * slot. */
+
+#define FROZENDICT_GROUP_WIDTH 16
+#define FROZENDICT_CTRL_EMPTY 0x80
+
+typedef struct {
+    PyFrozenDictIndex base;
+    size_t mask;
+    int32_t* slots;
+    uint8_t* ctrl;
+} PyFrozenDictGroups;
+
+/* Returns a bitmask of the control bytes of the group equal to h2. */
+
+static inline uint32_t frozendict_group_match(
+    const uint8_t* group,
+    const uint8_t h2
+) {
+#ifdef FROZENDICT_GROUPS_SSE2
+    const __m128i ctrl = _mm_loadu_si128((const __m128i*) group);
+
+    return (uint32_t) _mm_movemask_epi8(
+        _mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char) h2))
+    );
+#else
+    uint32_t res = 0;
+
+    for (int i = 0; i < FROZENDICT_GROUP_WIDTH; i++) {
+        res |= (uint32_t) (group[i] == h2) << i;
+    }
+
+    return res;
+#endif
+}
+
+/* Returns a bitmask of the empty slots of the group. */
+
+static inline uint32_t frozendict_group_match_empty(const uint8_t* group) {
+#ifdef FROZENDICT_GROUPS_SSE2
+    // only the empty control bytes have the highest bit set
+    return (uint32_t) _mm_movemask_epi8(
+        _mm_loadu_si128((const __m128i*) group)
+    );
+#else
+    uint32_t res = 0;
+
+    for (int i = 0; i < FROZENDICT_GROUP_WIDTH; i++) {
+        res |= (uint32_t) (group[i] >> 7) << i;
+    }
+
+    return res;
+#endif
+}
+
+static inline int frozendict_ctz(uint32_t x) {
+    assert(x != 0);
+
+#if defined(_MSC_VER)
+    unsigned long res;
+    _BitScanForward(&res, x);
+    return (int) res;
+#elif defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctz(x);
+#else
+    int res = 0;
+
+    while (! (x & 1)) {
+        x >>= 1;
+        res++;
+    }
+
+    return res;
+#endif
+}
+
+static Py_ssize_t _Py_HOT_FUNCTION
+frozendict_lookup_groups(
+    PyDictObject* mp,
+    PyObject* key,
+    Py_hash_t hash,
+    PyObject*** value_addr,
+    Py_ssize_t* hashpos
+) {
+    const PyFrozenDictGroups* gi = (
+        (const PyFrozenDictGroups*) ((PyFrozenDictObject*) mp)->ma_index
+    );
+
+    // the position in the indices is known only by the probing
+    if (gi == NULL || hashpos != NULL) {
+        return lookdict(mp, key, hash, value_addr, hashpos);
+    }
+
+    const uint64_t h = frozendict_index_mix((uint64_t) hash);
+    const uint8_t h2 = (uint8_t) (h & 0x7f);
+    const size_t mask = gi->mask;
+    size_t pos = (size_t) (h >> 7) & mask;
+    PyDictKeyEntry* ep0 = DK_ENTRIES(mp->ma_keys);
+    PyDictKeyEntry* ep;
+    const uint8_t* group;
+    uint32_t match;
+    Py_ssize_t ix;
+    int cmp;
+
+    for (size_t step = FROZENDICT_GROUP_WIDTH; ; step += FROZENDICT_GROUP_WIDTH) {
+        group = gi->ctrl + pos;
+
+        for (
+            match = frozendict_group_match(group, h2);
+            match != 0;
+            match &= match - 1
+        ) {
+            ix = gi->slots[(pos + frozendict_ctz(match)) & mask];
+            ep = &ep0[ix];
+
+            if (ep->me_key == key) {
+                *value_addr = &ep->me_value;
+                return ix;
+            }
+
+            if (ep->me_hash == hash) {
+                cmp = frozendict_index_key_eq(ep->me_key, key);
+
+                if (cmp < 0) {
+                    *value_addr = NULL;
+                    return DKIX_ERROR;
+                }
+
+                if (cmp > 0) {
+                    *value_addr = &ep->me_value;
+                    return ix;
+                }
+            }
+        }
+
+        if (frozendict_group_match_empty(group) != 0) {
+            *value_addr = NULL;
+            return DKIX_EMPTY;
+        }
+
+        // triangular probing visits all the groups, since the
+        // capacity is a power of 2
+        pos = (pos + step) & mask;
+    }
+}
+
+/* Small layout of the frozendicts with at most FROZENDICT_SMALL_MAX_SIZE
+ * items, see frozendict_new_small().
+ *
+ * The object, this index and the table are allocated in a single block.
+ * The hashes of the entries are copied in a contiguous array, so a lookup
+ * compares the hash with all of them at once, without the indirection of
+ * the indices. The array is padded to an even size with -1, that is never
+ * the hash of an object. The table keeps its indices, so it can be copied
+ * by the other methods as usual. */
+
+#define FROZENDICT_SMALL_MAX_SIZE 8
+
+#if defined(FROZENDICT_GROUPS_SSE2) && SIZEOF_VOID_P == 8
+#define FROZENDICT_SMALL_SSE2
+#endif
+
+typedef struct {
+    PyFrozenDictIndex base;
+    Py_hash_t hashes[];
+} PyFrozenDictSmall;
+
+/* Returns a bitmask of the positions of hashes, an array of num hashes,
+ * with num even, that are equal to hash. */
+
+static inline uint32_t frozendict_small_match(
+    const Py_hash_t* hashes,
+    const Py_ssize_t num,
+    const Py_hash_t hash
+) {
+    uint32_t res = 0;
+
+#ifdef FROZENDICT_SMALL_SSE2
+    // SSE2 compares only 32 bit integers, so both the halves of a hash
+    // must match
+    const __m128i h = _mm_set1_epi64x((long long) hash);
+    __m128i eq;
+
+    for (Py_ssize_t i = 0; i < num; i += 2) {
+        eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*) &hashes[i]), h);
+        eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+        res |= (uint32_t) _mm_movemask_pd(_mm_castsi128_pd(eq)) << i;
+    }
+#else
+    for (Py_ssize_t i = 0; i < num; i++) {
+        res |= (uint32_t) (hashes[i] == hash) << i;
+    }
+#endif
+
+    return res;
+}
+
+static Py_ssize_t _Py_HOT_FUNCTION
+frozendict_lookup_small(
+    PyDictObject* mp,
+    PyObject* key,
+    Py_hash_t hash,
+    PyObject*** value_addr,
+    Py_ssize_t* hashpos
+) {
+    const PyFrozenDictSmall* si = (
+        (const PyFrozenDictSmall*) ((PyFrozenDictObject*) mp)->ma_index
+    );
+
+    // the position in the indices is known only by the probing
+    if (si == NULL || hashpos != NULL) {
+        return lookdict(mp, key, hash, value_addr, hashpos);
+    }
+
+    PyDictKeyEntry* ep0 = DK_ENTRIES(mp->ma_keys);
+    PyDictKeyEntry* ep;
+    uint32_t match;
+    Py_ssize_t ix;
+    int cmp;
+
+    for (
+        match = frozendict_small_match(
+            si->hashes,
+            (mp->ma_used + 1) & ~((Py_ssize_t) 1),
+            hash
+        );
+        match != 0;
+        match &= match - 1
+    ) {
+        ix = frozendict_ctz(match);
+        ep = &ep0[ix];
+
+        if (ep->me_key != key) {
+            cmp = frozendict_index_key_eq(ep->me_key, key);
+
+            if (cmp < 0) {
+                *value_addr = NULL;
+                return DKIX_ERROR;
+            }
+
+            if (cmp == 0) {
+                continue;
+            }
+        }
+
+        *value_addr = &ep->me_value;
+        return ix;
+    }
+
+    *value_addr = NULL;
+    return DKIX_EMPTY;
+}
+
+/* Returns 1 if mp has the small layout, see frozendict_new_small(). */
+
+static inline int frozendict_is_small(const PyFrozenDictObject* mp) {
+    return (
+        mp->ma_keys != NULL
+        && mp->ma_keys->dk_lookup == frozendict_lookup_small
+    );
+}
+
+/* Lookup of the tables shared by the split frozendicts, see
+ * frozendict_new_split(). The values are stored in ma_values. */
+
+static Py_ssize_t _Py_HOT_FUNCTION
+frozendict_lookup_split(
+    PyDictObject* mp,
+    PyObject* key,
+    Py_hash_t hash,
+    PyObject*** value_addr,
+    Py_ssize_t* hashpos
+) {
+    const Py_ssize_t ix = lookdict(mp, key, hash, value_addr, hashpos);
+
+    if (ix >= 0) {
+        *value_addr = &mp->ma_values[ix];
+    }
+
+    return ix;
+}
+
+/* Returns the lookup function of the keys of mp. The lookups of the
+ * indexes are not returned, since the index is owned by mp and can't
+ * be copied with the keys, and neither the lookup of the shared
+ * tables, since the copies have their own values. */
+
+static inline dict_lookup_func frozendict_keys_lookup(PyDictObject* mp) {
+    const dict_lookup_func lookup = mp->ma_keys->dk_lookup;
+
+    if (lookup == frozendict_lookup_split) {
+        return lookdict;
+    }
+
+    if (
+        lookup == frozendict_lookup_perfect
+        || lookup == frozendict_lookup_groups
+        || lookup == frozendict_lookup_small
+    ) {
+        const PyFrozenDictIndex* index = ((PyFrozenDictObject*) mp)->ma_index;
+
+        if (index == NULL) {
+            return lookdict;
+        }
+
+        return index->base_lookup;
+    }
+
+    return lookup;
+}
+
+static PyDictKeysObject* frozendict_clone_keys(PyDictObject* orig) {
+    if (orig->ma_values != NULL) {
+        return frozendict_clone_split_keys(orig);
+    }
+
+    PyDictKeysObject* keys = clone_combined_dict_keys(orig);
+
+    if (keys != NULL) {
+        keys->dk_lookup = frozendict_keys_lookup(orig);
+    }
+
+    return keys;
+}
+
+#define FROZENDICT_PERFECT_MAX_PILOT 0xffff
+#define FROZENDICT_PERFECT_SEEDS 8
+
+/* Searches the pilots of the buckets of the perfect hash ph, with the
+ * seed ph->seed. The buckets are placed from the biggest to the
+ * smallest. Returns 0 on success, 1 if a bucket can't be placed with
+ * this seed, -1 if some keys have the same hash, so the perfect hash
+ * can't be built at all, and -2 on memory errors. */
+
+static int frozendict_perfect_search(
+    PyFrozenDictPerfect* ph,
+    const PyDictKeyEntry* entries,
+    uint64_t* hs,
+    int32_t* keys_by_bucket,
+    int32_t* bucket_start,
+    int32_t* buckets_order,
+    char* taken
+) {
+    const Py_ssize_t size = ph->size;
+    const Py_ssize_t buckets_num = ph->buckets_num;
+    Py_ssize_t i;
+    Py_ssize_t j;
+    Py_ssize_t k;
+    Py_ssize_t b;
+
+    memset(bucket_start, 0, (buckets_num + 1) * sizeof(int32_t));
+
+    for (i = 0; i < size; i++) {
+        hs[i] = frozendict_index_mix((uint64_t) entries[i].me_hash ^ ph->seed);
+        bucket_start[frozendict_perfect_bucket(ph, hs[i]) + 1]++;
+    }
+
+    Py_ssize_t max_bucket_size = 0;
+
+    for (b = 0; b < buckets_num; b++) {
+        if (bucket_start[b + 1] > max_bucket_size) {
+            max_bucket_size = bucket_start[b + 1];
+        }
+
+        bucket_start[b + 1] += bucket_start[b];
+    }
+
+    // counting sort of the keys by bucket, using buckets_order as cursor
+    memcpy(buckets_order, bucket_start, buckets_num * sizeof(int32_t));
+
+    for (i = 0; i < size; i++) {
+        b = frozendict_perfect_bucket(ph, hs[i]);
+        keys_by_bucket[buckets_order[b]++] = (int32_t) i;
+    }
+
+    // counting sort of the buckets by size, in descending order
+    int32_t* sizes_start = PyMem_Calloc(max_bucket_size + 2, sizeof(int32_t));
+    Py_ssize_t* positions = PyMem_Malloc(
+        (max_bucket_size + 1) * sizeof(Py_ssize_t)
+    );
+    int res = 0;
+
+    if (sizes_start == NULL || positions == NULL) {
+        PyErr_NoMemory();
+        res = -2;
+        goto end;
+    }
+
+    for (b = 0; b < buckets_num; b++) {
+        sizes_start[max_bucket_size - (bucket_start[b + 1] - bucket_start[b]) + 1]++;
+    }
+
+    for (k = 0; k <= max_bucket_size; k++) {
+        sizes_start[k + 1] += sizes_start[k];
+    }
+
+    for (b = 0; b < buckets_num; b++) {
+        k = max_bucket_size - (bucket_start[b + 1] - bucket_start[b]);
+        buckets_order[sizes_start[k]++] = (int32_t) b;
+    }
+
+    memset(taken, 0, ph->table_size);
+
+    Py_ssize_t bucket_size;
+    int32_t* bucket_keys;
+    Py_ssize_t pos;
+    uint32_t pilot;
+
+    for (Py_ssize_t o = 0; o < buckets_num; o++) {
+        b = buckets_order[o];
+        bucket_keys = &keys_by_bucket[bucket_start[b]];
+        bucket_size = bucket_start[b + 1] - bucket_start[b];
+
+        if (bucket_size == 0) {
+            // the other buckets are empty too
+            break;
+        }
+
+        for (j = 1; j < bucket_size; j++) {
+            for (k = 0; k < j; k++) {
+                if (hs[bucket_keys[j]] == hs[bucket_keys[k]]) {
+                    res = -1;
+                    goto end;
+                }
+            }
+        }
+
+        for (pilot = 0; pilot <= FROZENDICT_PERFECT_MAX_PILOT; pilot++) {
+            for (j = 0; j < bucket_size; j++) {
+                pos = frozendict_perfect_position(
+                    ph,
+                    hs[bucket_keys[j]],
+                    (uint16_t) pilot
+                );
+
+                if (taken[pos]) {
+                    break;
+                }
+
+                for (k = 0; k < j; k++) {
+                    if (positions[k] == pos) {
+                        break;
+                    }
+                }
+
+                if (k < j) {
+                    break;
+                }
+
+                positions[j] = pos;
+            }
+
+            if (j == bucket_size) {
+                break;
+            }
+        }
+
+        if (pilot > FROZENDICT_PERFECT_MAX_PILOT) {
+            res = 1;
+            goto end;
+        }
+
+        ph->pilots[b] = (uint16_t) pilot;
+
+        for (j = 0; j < bucket_size; j++) {
+            taken[positions[j]] = 1;
+            pos = positions[j];
+
+            if (pos < ph->size) {
+                ph->slots[pos] = bucket_keys[j];
+            }
+        }
+    }
+
+    // remap the positions over size to the free ones under size
+    Py_ssize_t free_pos = 0;
+
+    for (pos = ph->size; pos < ph->table_size; pos++) {
+        if (! taken[pos]) {
+            ph->remap[pos - ph->size] = 0;
+            continue;
+        }
+
+        while (taken[free_pos]) {
+            free_pos++;
+        }
+
+        taken[free_pos] = 1;
+        ph->remap[pos - ph->size] = (int32_t) free_pos;
+    }
+
+    // and store there the indexes of the entries
+    for (i = 0; i < size; i++) {
+        pos = frozendict_perfect_position(
+            ph,
+            hs[i],
+            ph->pilots[frozendict_perfect_bucket(ph, hs[i])]
+        );
+
+        if (pos >= ph->size) {
+            ph->slots[ph->remap[pos - ph->size]] = (int32_t) i;
+        }
+    }
+
+end:
+    PyMem_Free(sizes_start);
+    PyMem_Free(positions);
+
+    return res;
+}
+
+/* Builds the perfect hash of the keys of mp and sets the perfect hash
+ * lookup. If the perfect hash can't be built, mp is left unchanged.
+ * Returns -1 only on memory errors. */
+
+static int frozendict_perfect_new(PyFrozenDictObject* mp) {
+    const Py_ssize_t size = mp->ma_used;
+
+    assert(mp->ma_index == NULL);
+    assert(size > 0 && size <= FROZENDICT_INDEX_MAX_SIZE);
+    assert(mp->ma_keys->dk_nentries == size);
+
+    const Py_ssize_t table_size = size + (size >> 6) + 1;
+    const Py_ssize_t buckets_num = size / 3 + 1;
+    const Py_ssize_t remap_size = table_size - size;
+
+    const Py_ssize_t memsize = (
+        sizeof(PyFrozenDictPerfect)
+        + (size + remap_size) * sizeof(int32_t)
+        + buckets_num * sizeof(uint16_t)
+    );
+
+    PyFrozenDictPerfect* ph = PyMem_Malloc(memsize);
+
+    if (ph == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    ph->base.base_lookup = mp->ma_keys->dk_lookup;
+    ph->base.memsize = memsize;
+    ph->size = size;
+    ph->table_size = table_size;
+    ph->buckets_num = buckets_num;
+    ph->slots = (int32_t*) (ph + 1);
+    ph->remap = ph->slots + size;
+    ph->pilots = (uint16_t*) (ph->remap + remap_size);
+
+    uint64_t* hs = PyMem_Malloc(size * sizeof(uint64_t));
+    int32_t* keys_by_bucket = PyMem_Malloc(size * sizeof(int32_t));
+    int32_t* bucket_start = PyMem_Malloc((buckets_num + 1) * sizeof(int32_t));
+    int32_t* buckets_order = PyMem_Malloc(buckets_num * sizeof(int32_t));
+    char* taken = PyMem_Malloc(table_size);
+    int res = -2;
+
+    if (
+        hs == NULL
+        || keys_by_bucket == NULL
+        || bucket_start == NULL
+        || buckets_order == NULL
+        || taken == NULL
+    ) {
+        PyErr_NoMemory();
+        goto end;
+    }
+
+    for (uint64_t seed_i = 0; seed_i < FROZENDICT_PERFECT_SEEDS; seed_i++) {
+        ph->seed = frozendict_index_mix(seed_i + 0x9e3779b97f4a7c15ULL);
+
+        res = frozendict_perfect_search(
+            ph,
+            DK_ENTRIES(mp->ma_keys),
+            hs,
+            keys_by_bucket,
+            bucket_start,
+            buckets_order,
+            taken
+        );
+
+        if (res <= 0) {
+            break;
+        }
+    }
+
+end:
+    PyMem_Free(hs);
+    PyMem_Free(keys_by_bucket);
+    PyMem_Free(bucket_start);
+    PyMem_Free(buckets_order);
+    PyMem_Free(taken);
+
+    if (res != 0) {
+        PyMem_Free(ph);
+
+        return res == -2 ? -1 : 0;
+    }
+
+    mp->ma_index = &ph->base;
+    mp->ma_keys->dk_lookup = frozendict_lookup_perfect;
+
+    return 0;
+}
+
+/* Builds the group probing index of the keys of mp and sets its lookup.
+ * Returns -1 on memory errors. */
+
+static int frozendict_groups_new(PyFrozenDictObject* mp) {
+    const Py_ssize_t size = mp->ma_used;
+
+    assert(mp->ma_index == NULL);
+    assert(size > 0 && size <= FROZENDICT_INDEX_MAX_SIZE);
+    assert(mp->ma_keys->dk_nentries == size);
+
+    // at most 7/8 of the slots are used, so every probing ends
+    size_t capacity = FROZENDICT_GROUP_WIDTH;
+
+    while (capacity / 8 * 7 < (size_t) size) {
+        capacity <<= 1;
+    }
+
+    const Py_ssize_t memsize = (
+        sizeof(PyFrozenDictGroups)
+        + capacity * sizeof(int32_t)
+        + capacity + FROZENDICT_GROUP_WIDTH - 1
+    );
+
+    PyFrozenDictGroups* gi = PyMem_Malloc(memsize);
+
+    if (gi == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    gi->base.base_lookup = mp->ma_keys->dk_lookup;
+    gi->base.memsize = memsize;
+    gi->mask = capacity - 1;
+    gi->slots = (int32_t*) (gi + 1);
+    gi->ctrl = (uint8_t*) (gi->slots + capacity);
+
+    memset(gi->ctrl, FROZENDICT_CTRL_EMPTY, capacity + FROZENDICT_GROUP_WIDTH - 1);
+
+    const PyDictKeyEntry* entries = DK_ENTRIES(mp->ma_keys);
+    const size_t mask = gi->mask;
+    uint64_t h;
+    uint8_t h2;
+    size_t pos;
+    size_t step;
+    size_t slot;
+    uint32_t empty;
+
+    for (Py_ssize_t i = 0; i < size; i++) {
+        h = frozendict_index_mix((uint64_t) entries[i].me_hash);
+        h2 = (uint8_t) (h & 0x7f);
+        pos = (size_t) (h >> 7) & mask;
+        step = FROZENDICT_GROUP_WIDTH;
+
+        while ((empty = frozendict_group_match_empty(gi->ctrl + pos)) == 0) {
+            pos = (pos + step) & mask;
+            step += FROZENDICT_GROUP_WIDTH;
+        }
+
+        slot = (pos + frozendict_ctz(empty)) & mask;
+        gi->ctrl[slot] = h2;
+
+        if (slot < FROZENDICT_GROUP_WIDTH - 1) {
+            gi->ctrl[capacity + slot] = h2;
+        }
+
+        gi->slots[slot] = (int32_t) i;
+    }
+
+    mp->ma_index = &gi->base;
+    mp->ma_keys->dk_lookup = frozendict_lookup_groups;
+
+    return 0;
+}
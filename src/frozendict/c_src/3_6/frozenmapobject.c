@@ -0,0 +1,2453 @@
+/* frozenmap: an immutable mapping with the API of frozendict,
+ * implemented as a hash array mapped trie (HAMT).
+ *
+ * set(), delete() and setdefault() of frozendict copy the whole hash
+ * table, so they're O(n). frozenmap copies only the nodes on the path
+ * of the key and shares all the others with the original map, so the
+ * same operations are O(log n) in time and memory.
+ *
+ * Every node has a 32 bit bitmap, with a bit for every value of the
+ * 5 bits chunk of the hash of the key used at its level, and a dense
+ * array with an entry for every bit set. An entry is a key with its
+ * hash and value or, if the key is NULL, a subnode. Keys that have the
+ * same 32 bits hash end up in a collision node, that is a simple array
+ * of entries.
+ *
+ * Every node stores also the number of items of its subtree, so
+ * key(i), value(i) and item(i) are O(log n) too. The items are in
+ * trie order, not in insertion order. */
+
+#include <stddef.h>
+
+#define FROZENMAP_BITS 5
+#define FROZENMAP_MASK ((1U << FROZENMAP_BITS) - 1)
+#define FROZENMAP_MAX_SHIFT 30
+#define FROZENMAP_MAX_DEPTH 8
+
+typedef struct {
+    PyObject* key;
+    PyObject* value;
+    Py_hash_t hash;
+} FrozenMapEntry;
+
+typedef struct {
+    PyObject_VAR_HEAD
+    uint32_t bitmap;
+    int collision;
+    Py_ssize_t size;
+    FrozenMapEntry entries[1];
+} FrozenMapNode;
+
+typedef struct {
+    PyObject_HEAD
+    FrozenMapNode* root;
+    Py_ssize_t size;
+    Py_hash_t hash;
+} FrozenMapObject;
+
+typedef struct {
+    PyObject_HEAD
+    FrozenMapObject* map;
+} FrozenMapViewObject;
+
+#define FROZENMAP_ITER_KEYS 0
+#define FROZENMAP_ITER_VALUES 1
+#define FROZENMAP_ITER_ITEMS 2
+
+typedef struct {
+    PyObject_HEAD
+    FrozenMapObject* map;
+    int kind;
+    int depth;
+    Py_ssize_t remaining;
+    FrozenMapNode* nodes[FROZENMAP_MAX_DEPTH];
+    Py_ssize_t pos[FROZENMAP_MAX_DEPTH];
+} FrozenMapIterObject;
+
+static PyTypeObject FrozenMap_Type;
+static PyTypeObject FrozenMapNode_Type;
+static PyTypeObject FrozenMapIter_Type;
+static PyTypeObject FrozenMapKeys_Type;
+static PyTypeObject FrozenMapValues_Type;
+static PyTypeObject FrozenMapItems_Type;
+
+#define FrozenMap_Check(op) PyObject_TypeCheck(op, &FrozenMap_Type)
+#define FrozenMap_CheckExact(op) (Py_TYPE(op) == &FrozenMap_Type)
+
+#define FrozenMapSetView_Check(op) ( \
+    Py_TYPE(op) == &FrozenMapKeys_Type \
+    || Py_TYPE(op) == &FrozenMapItems_Type \
+)
+
+/* Nodes */
+
+static inline uint32_t frozenmap_hash32(const Py_hash_t hash) {
+    const Py_uhash_t h = (Py_uhash_t) hash;
+
+#if SIZEOF_PY_HASH_T > 4
+    return (uint32_t) (h ^ (h >> 32));
+#else
+    return (uint32_t) h;
+#endif
+}
+
+static inline uint32_t frozenmap_bit(const Py_hash_t hash, uint32_t shift) {
+    return 1U << ((frozenmap_hash32(hash) >> shift) & FROZENMAP_MASK);
+}
+
+static inline Py_ssize_t frozenmap_index(uint32_t bitmap, uint32_t bit) {
+    uint32_t x = bitmap & (bit - 1);
+
+    /* popcount */
+    x = x - ((x >> 1) & 0x55555555U);
+    x = (x & 0x33333333U) + ((x >> 2) & 0x33333333U);
+
+    return (Py_ssize_t) ((((x + (x >> 4)) & 0x0F0F0F0FU) * 0x01010101U) >> 24);
+}
+
+static FrozenMapNode* frozenmap_node_new(
+    Py_ssize_t n,
+    uint32_t bitmap,
+    int collision,
+    Py_ssize_t size
+) {
+    FrozenMapNode* node = PyObject_GC_NewVar(
+        FrozenMapNode,
+        &FrozenMapNode_Type,
+        n
+    );
+
+    if (node == NULL) {
+        return NULL;
+    }
+
+    node->bitmap = bitmap;
+    node->collision = collision;
+    node->size = size;
+    memset(node->entries, 0, n * sizeof(FrozenMapEntry));
+
+    return node;
+}
+
+static inline void frozenmap_entry_set(
+    FrozenMapEntry* entry,
+    PyObject* key,
+    PyObject* value,
+    const Py_hash_t hash
+) {
+    Py_XINCREF(key);
+    Py_INCREF(value);
+    entry->key = key;
+    entry->value = value;
+    entry->hash = hash;
+}
+
+/* Copy of node with the entry at index skip removed, if skip >= 0, and
+ * an empty entry at index gap, if gap >= 0. The new node is not
+ * tracked by the GC. */
+
+static FrozenMapNode* frozenmap_node_copy(
+    FrozenMapNode* node,
+    Py_ssize_t skip,
+    Py_ssize_t gap,
+    uint32_t bitmap,
+    Py_ssize_t size
+) {
+    const Py_ssize_t n = Py_SIZE(node);
+    const Py_ssize_t new_n = n - (skip >= 0) + (gap >= 0);
+
+    FrozenMapNode* new_node = frozenmap_node_new(
+        new_n,
+        bitmap,
+        node->collision,
+        size
+    );
+
+    if (new_node == NULL) {
+        return NULL;
+    }
+
+    FrozenMapEntry* entry;
+    Py_ssize_t j = 0;
+
+    for (Py_ssize_t i = 0; i < n; i++) {
+        if (i == skip) {
+            continue;
+        }
+
+        if (j == gap) {
+            j++;
+        }
+
+        entry = &node->entries[i];
+        frozenmap_entry_set(
+            &new_node->entries[j],
+            entry->key,
+            entry->value,
+            entry->hash
+        );
+
+        j++;
+    }
+
+    return new_node;
+}
+
+/* Node with the two entries, that have different keys, starting at
+ * level shift. */
+
+static FrozenMapNode* frozenmap_node_pair(
+    uint32_t shift,
+    FrozenMapEntry* entry1,
+    PyObject* key2,
+    PyObject* value2,
+    const Py_hash_t hash2
+) {
+    FrozenMapNode* node;
+
+    if (shift > FROZENMAP_MAX_SHIFT) {
+        node = frozenmap_node_new(2, 0, 1, 2);
+
+        if (node == NULL) {
+            return NULL;
+        }
+
+        frozenmap_entry_set(
+            &node->entries[0],
+            entry1->key,
+            entry1->value,
+            entry1->hash
+        );
+
+        frozenmap_entry_set(&node->entries[1], key2, value2, hash2);
+
+        PyObject_GC_Track(node);
+        return node;
+    }
+
+    const uint32_t bit1 = frozenmap_bit(entry1->hash, shift);
+    const uint32_t bit2 = frozenmap_bit(hash2, shift);
+
+    if (bit1 == bit2) {
+        FrozenMapNode* sub = frozenmap_node_pair(
+            shift + FROZENMAP_BITS,
+            entry1,
+            key2,
+            value2,
+            hash2
+        );
+
+        if (sub == NULL) {
+            return NULL;
+        }
+
+        node = frozenmap_node_new(1, bit1, 0, 2);
+
+        if (node == NULL) {
+            Py_DECREF(sub);
+            return NULL;
+        }
+
+        node->entries[0].value = (PyObject*) sub;
+
+        PyObject_GC_Track(node);
+        return node;
+    }
+
+    node = frozenmap_node_new(2, bit1 | bit2, 0, 2);
+
+    if (node == NULL) {
+        return NULL;
+    }
+
+    const int first = bit1 > bit2;
+
+    frozenmap_entry_set(
+        &node->entries[first],
+        entry1->key,
+        entry1->value,
+        entry1->hash
+    );
+
+    frozenmap_entry_set(&node->entries[! first], key2, value2, hash2);
+
+    PyObject_GC_Track(node);
+    return node;
+}
+
+/* Returns 1 if the entry has the key, 0 if not, -1 on errors */
+
+static inline int frozenmap_entry_match(
+    FrozenMapEntry* entry,
+    PyObject* key,
+    const Py_hash_t hash
+) {
+    if (entry->key == key) {
+        return 1;
+    }
+
+    if (entry->hash != hash) {
+        return 0;
+    }
+
+    PyObject* entry_key = entry->key;
+
+    Py_INCREF(entry_key);
+    const int cmp = PyObject_RichCompareBool(entry_key, key, Py_EQ);
+    Py_DECREF(entry_key);
+
+    return cmp;
+}
+
+/* Returns a borrowed reference to the value of key, or NULL if not
+ * found. On errors returns NULL with an exception set. */
+
+static PyObject* frozenmap_node_find(
+    FrozenMapNode* node,
+    PyObject* key,
+    const Py_hash_t hash
+) {
+    uint32_t shift = 0;
+    FrozenMapEntry* entry;
+    int cmp;
+
+    while (node != NULL) {
+        if (node->collision) {
+            for (Py_ssize_t i = 0; i < Py_SIZE(node); i++) {
+                entry = &node->entries[i];
+                cmp = frozenmap_entry_match(entry, key, hash);
+
+                if (cmp < 0) {
+                    return NULL;
+                }
+
+                if (cmp) {
+                    return entry->value;
+                }
+            }
+
+            return NULL;
+        }
+
+        const uint32_t bit = frozenmap_bit(hash, shift);
+
+        if (! (node->bitmap & bit)) {
+            return NULL;
+        }
+
+        entry = &node->entries[frozenmap_index(node->bitmap, bit)];
+
+        if (entry->key == NULL) {
+            node = (FrozenMapNode*) entry->value;
+            shift += FROZENMAP_BITS;
+            continue;
+        }
+
+        cmp = frozenmap_entry_match(entry, key, hash);
+
+        if (cmp < 0) {
+            return NULL;
+        }
+
+        if (cmp) {
+            return entry->value;
+        }
+
+        return NULL;
+    }
+
+    return NULL;
+}
+
+/* Returns a new reference to node with key set to value, or NULL on
+ * errors. *old_value is set to a new reference to the old value of
+ * key, or NULL if key was not present. If the value was already set,
+ * node itself is returned.
+ *
+ * If inplace is true and node is referenced only by its parent, the
+ * node is modified instead of copied when possible. It can be used
+ * only if all the ancestors of node are not shared, that is while
+ * building a new map. */
+
+static FrozenMapNode* frozenmap_node_assoc(
+    FrozenMapNode* node,
+    uint32_t shift,
+    PyObject* key,
+    const Py_hash_t hash,
+    PyObject* value,
+    PyObject** old_value,
+    int inplace
+) {
+    FrozenMapNode* new_node;
+    FrozenMapEntry* entry;
+    Py_ssize_t ix;
+    int cmp;
+
+    inplace = inplace && Py_REFCNT(node) == 1;
+    *old_value = NULL;
+
+    if (node->collision) {
+        const Py_ssize_t n = Py_SIZE(node);
+
+        for (ix = 0; ix < n; ix++) {
+            cmp = frozenmap_entry_match(&node->entries[ix], key, hash);
+
+            if (cmp < 0) {
+                return NULL;
+            }
+
+            if (cmp) {
+                break;
+            }
+        }
+
+        if (ix == n) {
+            new_node = frozenmap_node_copy(node, -1, n, 0, n + 1);
+
+            if (new_node == NULL) {
+                return NULL;
+            }
+
+            frozenmap_entry_set(&new_node->entries[n], key, value, hash);
+
+            PyObject_GC_Track(new_node);
+            return new_node;
+        }
+
+        entry = &node->entries[ix];
+    }
+    else {
+        const uint32_t bit = frozenmap_bit(hash, shift);
+        ix = frozenmap_index(node->bitmap, bit);
+
+        if (! (node->bitmap & bit)) {
+            new_node = frozenmap_node_copy(
+                node,
+                -1,
+                ix,
+                node->bitmap | bit,
+                node->size + 1
+            );
+
+            if (new_node == NULL) {
+                return NULL;
+            }
+
+            frozenmap_entry_set(&new_node->entries[ix], key, value, hash);
+
+            PyObject_GC_Track(new_node);
+            return new_node;
+        }
+
+        entry = &node->entries[ix];
+
+        if (entry->key == NULL) {
+            FrozenMapNode* sub = (FrozenMapNode*) entry->value;
+
+            FrozenMapNode* new_sub = frozenmap_node_assoc(
+                sub,
+                shift + FROZENMAP_BITS,
+                key,
+                hash,
+                value,
+                old_value,
+                inplace
+            );
+
+            if (new_sub == NULL) {
+                return NULL;
+            }
+
+            const Py_ssize_t added = *old_value == NULL;
+
+            if (new_sub == sub) {
+                /* unchanged, or modified in place */
+                Py_DECREF(new_sub);
+                node->size += added;
+                Py_INCREF(node);
+                return node;
+            }
+
+            if (inplace) {
+                entry->value = (PyObject*) new_sub;
+                Py_DECREF(sub);
+                node->size += added;
+                Py_INCREF(node);
+                return node;
+            }
+
+            new_node = frozenmap_node_copy(
+                node,
+                -1,
+                -1,
+                node->bitmap,
+                node->size + added
+            );
+
+            if (new_node == NULL) {
+                Py_DECREF(new_sub);
+                Py_XDECREF(*old_value);
+                *old_value = NULL;
+                return NULL;
+            }
+
+            Py_SETREF(new_node->entries[ix].value, (PyObject*) new_sub);
+
+            PyObject_GC_Track(new_node);
+            return new_node;
+        }
+
+        cmp = frozenmap_entry_match(entry, key, hash);
+
+        if (cmp < 0) {
+            return NULL;
+        }
+
+        if (! cmp) {
+            FrozenMapNode* sub = frozenmap_node_pair(
+                shift + FROZENMAP_BITS,
+                entry,
+                key,
+                value,
+                hash
+            );
+
+            if (sub == NULL) {
+                return NULL;
+            }
+
+            if (inplace) {
+                Py_CLEAR(entry->key);
+                Py_SETREF(entry->value, (PyObject*) sub);
+                entry->hash = 0;
+                node->size++;
+                Py_INCREF(node);
+                return node;
+            }
+
+            new_node = frozenmap_node_copy(
+                node,
+                -1,
+                -1,
+                node->bitmap,
+                node->size + 1
+            );
+
+            if (new_node == NULL) {
+                Py_DECREF(sub);
+                return NULL;
+            }
+
+            entry = &new_node->entries[ix];
+            Py_CLEAR(entry->key);
+            Py_SETREF(entry->value, (PyObject*) sub);
+            entry->hash = 0;
+
+            PyObject_GC_Track(new_node);
+            return new_node;
+        }
+    }
+
+    /* the key is present: replace the value */
+
+    Py_INCREF(entry->value);
+    *old_value = entry->value;
+
+    if (entry->value == value) {
+        Py_INCREF(node);
+        return node;
+    }
+
+    if (inplace) {
+        Py_INCREF(value);
+        Py_SETREF(entry->value, value);
+        Py_INCREF(node);
+        return node;
+    }
+
+    new_node = frozenmap_node_copy(
+        node,
+        -1,
+        -1,
+        node->bitmap,
+        node->size
+    );
+
+    if (new_node == NULL) {
+        Py_CLEAR(*old_value);
+        return NULL;
+    }
+
+    Py_INCREF(value);
+    Py_SETREF(new_node->entries[ix].value, value);
+
+    PyObject_GC_Track(new_node);
+    return new_node;
+}
+
+/* Removes key from node. Returns 1 if key was found, and sets *new_node
+ * to a new reference to the resulting node, or to NULL if it's empty,
+ * and *old_value to a new reference to the removed value. Returns 0 if
+ * key was not found and -1 on errors. */
+
+static int frozenmap_node_without(
+    FrozenMapNode* node,
+    uint32_t shift,
+    PyObject* key,
+    const Py_hash_t hash,
+    FrozenMapNode** new_node,
+    PyObject** old_value
+) {
+    FrozenMapEntry* entry;
+    int cmp;
+
+    if (node->collision) {
+        const Py_ssize_t n = Py_SIZE(node);
+
+        for (Py_ssize_t i = 0; i < n; i++) {
+            entry = &node->entries[i];
+            cmp = frozenmap_entry_match(entry, key, hash);
+
+            if (cmp < 0) {
+                return -1;
+            }
+
+            if (cmp) {
+                *new_node = NULL;
+
+                if (n > 1) {
+                    *new_node = frozenmap_node_copy(node, i, -1, 0, n - 1);
+
+                    if (*new_node == NULL) {
+                        return -1;
+                    }
+
+                    PyObject_GC_Track(*new_node);
+                }
+
+                Py_INCREF(entry->value);
+                *old_value = entry->value;
+                return 1;
+            }
+        }
+
+        return 0;
+    }
+
+    const uint32_t bit = frozenmap_bit(hash, shift);
+
+    if (! (node->bitmap & bit)) {
+        return 0;
+    }
+
+    const Py_ssize_t ix = frozenmap_index(node->bitmap, bit);
+    entry = &node->entries[ix];
+
+    if (entry->key != NULL) {
+        cmp = frozenmap_entry_match(entry, key, hash);
+
+        if (cmp <= 0) {
+            return cmp;
+        }
+
+        *new_node = NULL;
+
+        if (Py_SIZE(node) > 1) {
+            *new_node = frozenmap_node_copy(
+                node,
+                ix,
+                -1,
+                node->bitmap & ~bit,
+                node->size - 1
+            );
+
+            if (*new_node == NULL) {
+                return -1;
+            }
+
+            PyObject_GC_Track(*new_node);
+        }
+
+        Py_INCREF(entry->value);
+        *old_value = entry->value;
+        return 1;
+    }
+
+    FrozenMapNode* new_sub;
+
+    const int res = frozenmap_node_without(
+        (FrozenMapNode*) entry->value,
+        shift + FROZENMAP_BITS,
+        key,
+        hash,
+        &new_sub,
+        old_value
+    );
+
+    if (res <= 0) {
+        return res;
+    }
+
+    if (new_sub == NULL) {
+        *new_node = NULL;
+
+        if (Py_SIZE(node) > 1) {
+            *new_node = frozenmap_node_copy(
+                node,
+                ix,
+                -1,
+                node->bitmap & ~bit,
+                node->size - 1
+            );
+
+            if (*new_node == NULL) {
+                Py_CLEAR(*old_value);
+                return -1;
+            }
+
+            PyObject_GC_Track(*new_node);
+        }
+
+        return 1;
+    }
+
+    *new_node = frozenmap_node_copy(
+        node,
+        -1,
+        -1,
+        node->bitmap,
+        node->size - 1
+    );
+
+    if (*new_node == NULL) {
+        Py_DECREF(new_sub);
+        Py_CLEAR(*old_value);
+        return -1;
+    }
+
+    entry = &(*new_node)->entries[ix];
+
+    if (Py_SIZE(new_sub) == 1 && new_sub->entries[0].key != NULL) {
+        /* a subnode with only an item is replaced by the item */
+        FrozenMapEntry* sub_entry = &new_sub->entries[0];
+        Py_INCREF(sub_entry->key);
+        entry->key = sub_entry->key;
+        entry->hash = sub_entry->hash;
+        Py_INCREF(sub_entry->value);
+        Py_SETREF(entry->value, sub_entry->value);
+        Py_DECREF(new_sub);
+    }
+    else {
+        Py_SETREF(entry->value, (PyObject*) new_sub);
+    }
+
+    PyObject_GC_Track(*new_node);
+    return 1;
+}
+
+/* Returns a borrowed reference to the entry at position index, that
+ * must be valid */
+
+static FrozenMapEntry* frozenmap_node_entry_at(
+    FrozenMapNode* node,
+    Py_ssize_t index
+) {
+    FrozenMapEntry* entry;
+    Py_ssize_t sub_size;
+
+    for (;;) {
+        for (Py_ssize_t i = 0; i < Py_SIZE(node); i++) {
+            entry = &node->entries[i];
+
+            if (entry->key != NULL) {
+                if (index == 0) {
+                    return entry;
+                }
+
+                index--;
+                continue;
+            }
+
+            sub_size = ((FrozenMapNode*) entry->value)->size;
+
+            if (index < sub_size) {
+                node = (FrozenMapNode*) entry->value;
+                break;
+            }
+
+            index -= sub_size;
+        }
+    }
+}
+
+static int frozenmap_node_hash(FrozenMapNode* node, Py_uhash_t* acc) {
+    FrozenMapEntry* entry;
+    Py_hash_t item_hash;
+
+    for (Py_ssize_t i = 0; i < Py_SIZE(node); i++) {
+        entry = &node->entries[i];
+
+        if (entry->key == NULL) {
+            if (frozenmap_node_hash((FrozenMapNode*) entry->value, acc)) {
+                return -1;
+            }
+
+            continue;
+        }
+
+        item_hash = frozendict_item_hash(entry->hash, entry->value);
+
+        if (item_hash == MINUSONE_HASH) {
+            return -1;
+        }
+
+        *acc ^= frozendict_shuffle_bits(item_hash);
+    }
+
+    return 0;
+}
+
+static int frozenmap_node_traverse(
+    FrozenMapNode* node,
+    visitproc visit,
+    void* arg
+) {
+    for (Py_ssize_t i = 0; i < Py_SIZE(node); i++) {
+        Py_VISIT(node->entries[i].key);
+        Py_VISIT(node->entries[i].value);
+    }
+
+    return 0;
+}
+
+static void frozenmap_node_dealloc(FrozenMapNode* node) {
+    PyObject_GC_UnTrack(node);
+
+    for (Py_ssize_t i = 0; i < Py_SIZE(node); i++) {
+        Py_XDECREF(node->entries[i].key);
+        Py_XDECREF(node->entries[i].value);
+    }
+
+    PyObject_GC_Del(node);
+}
+
+static PyTypeObject FrozenMapNode_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = FROZENDICT_MODULE_NAME ".frozenmap_node",
+    .tp_basicsize = offsetof(FrozenMapNode, entries),
+    .tp_itemsize = sizeof(FrozenMapEntry),
+    .tp_dealloc = (destructor) frozenmap_node_dealloc,
+    .tp_getattro = PyObject_GenericGetAttr,
+    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,
+    .tp_traverse = (traverseproc) frozenmap_node_traverse,
+};
+
+/* frozenmap */
+
+static inline Py_hash_t frozenmap_key_hash(PyObject* key) {
+    Py_hash_t hash;
+
+    if (!PyUnicode_CheckExact(key) ||
+        (hash = ((PyASCIIObject *) key)->hash) == -1) {
+        hash = PyObject_Hash(key);
+    }
+
+    return hash;
+}
+
+static FrozenMapObject* frozenmap_new_barebone(PyTypeObject* type) {
+    FrozenMapObject* mp = (FrozenMapObject*) type->tp_alloc(type, 0);
+
+    if (mp == NULL) {
+        return NULL;
+    }
+
+    mp->root = NULL;
+    mp->size = 0;
+    mp->hash = MINUSONE_HASH;
+
+    return mp;
+}
+
+/* Returns a new map that uses root, that is stolen */
+
+static PyObject* frozenmap_from_root(
+    PyTypeObject* type,
+    FrozenMapNode* root,
+    Py_ssize_t size
+) {
+    FrozenMapObject* mp = frozenmap_new_barebone(type);
+
+    if (mp == NULL) {
+        Py_XDECREF(root);
+        return NULL;
+    }
+
+    mp->root = root;
+    mp->size = size;
+
+    return (PyObject*) mp;
+}
+
+/* Sets key to value in mp, that must be not yet visible to other code,
+ * modifying its nodes in place when possible */
+
+static int frozenmap_insert(
+    FrozenMapObject* mp,
+    PyObject* key,
+    const Py_hash_t hash,
+    PyObject* value
+) {
+    if (mp->root == NULL) {
+        FrozenMapNode* root = frozenmap_node_new(
+            1,
+            frozenmap_bit(hash, 0),
+            0,
+            1
+        );
+
+        if (root == NULL) {
+            return -1;
+        }
+
+        frozenmap_entry_set(&root->entries[0], key, value, hash);
+        PyObject_GC_Track(root);
+
+        mp->root = root;
+        mp->size = 1;
+
+        return 0;
+    }
+
+    PyObject* old_value;
+
+    FrozenMapNode* new_root = frozenmap_node_assoc(
+        mp->root,
+        0,
+        key,
+        hash,
+        value,
+        &old_value,
+        1
+    );
+
+    if (new_root == NULL) {
+        return -1;
+    }
+
+    Py_SETREF(mp->root, new_root);
+
+    if (old_value == NULL) {
+        mp->size++;
+    }
+    else {
+        Py_DECREF(old_value);
+    }
+
+    return 0;
+}
+
+static int frozenmap_setitem(
+    FrozenMapObject* mp,
+    PyObject* key,
+    PyObject* value
+) {
+    const Py_hash_t hash = frozenmap_key_hash(key);
+
+    if (hash == -1) {
+        return -1;
+    }
+
+    return frozenmap_insert(mp, key, hash, value);
+}
+
+static int frozenmap_merge_pairs(FrozenMapObject* mp, PyObject* iterable) {
+    PyObject* it = PyObject_GetIter(iterable);
+
+    if (it == NULL) {
+        return -1;
+    }
+
+    PyObject* item;
+    PyObject* fast;
+    Py_ssize_t i = 0;
+    int res = 0;
+
+    while ((item = PyIter_Next(it)) != NULL) {
+        fast = PySequence_Fast(item, "");
+
+        if (fast == NULL) {
+            if (PyErr_ExceptionMatches(PyExc_TypeError)) {
+                PyErr_Format(
+                    PyExc_TypeError,
+                    "cannot convert " FROZENDICT_MODULE_NAME
+                    ".frozenmap update sequence element #%zd to a sequence",
+                    i
+                );
+            }
+
+            Py_DECREF(item);
+            res = -1;
+            break;
+        }
+
+        if (PySequence_Fast_GET_SIZE(fast) != 2) {
+            PyErr_Format(
+                PyExc_ValueError,
+                FROZENDICT_MODULE_NAME ".frozenmap update sequence element "
+                "#%zd has length %zd; 2 is required",
+                i,
+                PySequence_Fast_GET_SIZE(fast)
+            );
+
+            Py_DECREF(fast);
+            Py_DECREF(item);
+            res = -1;
+            break;
+        }
+
+        res = frozenmap_setitem(
+            mp,
+            PySequence_Fast_GET_ITEM(fast, 0),
+            PySequence_Fast_GET_ITEM(fast, 1)
+        );
+
+        Py_DECREF(fast);
+        Py_DECREF(item);
+
+        if (res) {
+            break;
+        }
+
+        i++;
+    }
+
+    Py_DECREF(it);
+
+    if (res == 0 && PyErr_Occurred()) {
+        res = -1;
+    }
+
+    return res;
+}
+
+static int frozenmap_merge_node(FrozenMapObject* mp, FrozenMapNode* node) {
+    FrozenMapEntry* entry;
+
+    for (Py_ssize_t i = 0; i < Py_SIZE(node); i++) {
+        entry = &node->entries[i];
+
+        if (entry->key == NULL) {
+            if (frozenmap_merge_node(mp, (FrozenMapNode*) entry->value)) {
+                return -1;
+            }
+        }
+        else if (frozenmap_insert(mp, entry->key, entry->hash, entry->value)) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* Merges arg, a mapping or an iterable of pairs, into mp, that must be
+ * not yet visible to other code */
+
+static int frozenmap_merge(FrozenMapObject* mp, PyObject* arg) {
+    if (FrozenMap_Check(arg)) {
+        FrozenMapObject* other = (FrozenMapObject*) arg;
+
+        if (other->root == NULL) {
+            return 0;
+        }
+
+        if (mp->root == NULL) {
+            Py_INCREF(other->root);
+            mp->root = other->root;
+            mp->size = other->size;
+            return 0;
+        }
+
+        return frozenmap_merge_node(mp, other->root);
+    }
+
+    if (
+        PyAnyDict_Check(arg) &&
+        (
+            Py_TYPE(arg)->tp_iter == PyDict_Type.tp_iter ||
+            Py_TYPE(arg)->tp_iter == (getiterfunc)frozendict_iter
+        )
+    ) {
+        Py_ssize_t pos = 0;
+        PyObject* key;
+        PyObject* value;
+        Py_hash_t hash;
+        int res;
+
+        while (_d_PyDict_Next(arg, &pos, &key, &value, &hash)) {
+            Py_INCREF(key);
+            Py_INCREF(value);
+            res = frozenmap_insert(mp, key, hash, value);
+            Py_DECREF(key);
+            Py_DECREF(value);
+
+            if (res) {
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    _Py_IDENTIFIER(keys);
+
+    if (! _PyObject_HasAttrId(arg, &PyId_keys)) {
+        return frozenmap_merge_pairs(mp, arg);
+    }
+
+    PyObject* keys = PyMapping_Keys(arg);
+
+    if (keys == NULL) {
+        return -1;
+    }
+
+    PyObject* it = PyObject_GetIter(keys);
+    Py_DECREF(keys);
+
+    if (it == NULL) {
+        return -1;
+    }
+
+    PyObject* key;
+    PyObject* value;
+    int res = 0;
+
+    while ((key = PyIter_Next(it)) != NULL) {
+        value = PyObject_GetItem(arg, key);
+
+        if (value == NULL) {
+            Py_DECREF(key);
+            res = -1;
+            break;
+        }
+
+        res = frozenmap_setitem(mp, key, value);
+        Py_DECREF(key);
+        Py_DECREF(value);
+
+        if (res) {
+            break;
+        }
+    }
+
+    Py_DECREF(it);
+
+    if (res == 0 && PyErr_Occurred()) {
+        res = -1;
+    }
+
+    return res;
+}
+
+static PyObject* frozenmap_new(
+    PyTypeObject* type,
+    PyObject* args,
+    PyObject* kwds
+) {
+    PyObject* arg = NULL;
+
+    if (! PyArg_UnpackTuple(args, type->tp_name, 0, 1, &arg)) {
+        return NULL;
+    }
+
+    const int has_kwds = kwds != NULL && PyDict_Size(kwds) != 0;
+
+    if (
+        arg != NULL &&
+        ! has_kwds &&
+        FrozenMap_CheckExact(arg) &&
+        type == &FrozenMap_Type
+    ) {
+        Py_INCREF(arg);
+        return arg;
+    }
+
+    FrozenMapObject* mp = frozenmap_new_barebone(type);
+
+    if (mp == NULL) {
+        return NULL;
+    }
+
+    if (arg != NULL && frozenmap_merge(mp, arg)) {
+        Py_DECREF(mp);
+        return NULL;
+    }
+
+    if (has_kwds && frozenmap_merge(mp, kwds)) {
+        Py_DECREF(mp);
+        return NULL;
+    }
+
+    return (PyObject*) mp;
+}
+
+static int frozenmap_traverse(FrozenMapObject* mp, visitproc visit, void* arg) {
+    Py_VISIT(mp->root);
+    return 0;
+}
+
+static int frozenmap_tp_clear(FrozenMapObject* mp) {
+    Py_CLEAR(mp->root);
+    return 0;
+}
+
+static void frozenmap_dealloc(FrozenMapObject* mp) {
+    PyObject_GC_UnTrack(mp);
+    Py_XDECREF(mp->root);
+    Py_TYPE(mp)->tp_free((PyObject*) mp);
+}
+
+static Py_ssize_t frozenmap_length(FrozenMapObject* mp) {
+    return mp->size;
+}
+
+/* Returns a borrowed reference to the value of key, or NULL. On
+ * errors NULL is returned with an exception set. */
+
+static PyObject* frozenmap_lookup(FrozenMapObject* mp, PyObject* key) {
+    const Py_hash_t hash = frozenmap_key_hash(key);
+
+    if (hash == -1) {
+        return NULL;
+    }
+
+    return frozenmap_node_find(mp->root, key, hash);
+}
+
+static PyObject* frozenmap_subscript(FrozenMapObject* mp, PyObject* key) {
+    PyObject* value = frozenmap_lookup(mp, key);
+
+    if (value == NULL) {
+        if (! PyErr_Occurred()) {
+            _PyErr_SetKeyError(key);
+        }
+
+        return NULL;
+    }
+
+    Py_INCREF(value);
+    return value;
+}
+
+static int frozenmap_contains(FrozenMapObject* mp, PyObject* key) {
+    if (frozenmap_lookup(mp, key) != NULL) {
+        return 1;
+    }
+
+    return PyErr_Occurred() ? -1 : 0;
+}
+
+static Py_hash_t frozenmap_hash(FrozenMapObject* mp) {
+    if (mp->hash != MINUSONE_HASH) {
+        return mp->hash;
+    }
+
+    Py_uhash_t acc = 0;
+
+    if (mp->root != NULL && frozenmap_node_hash(mp->root, &acc)) {
+        return MINUSONE_HASH;
+    }
+
+    mp->hash = frozendict_hash_finalize(acc, mp->size);
+
+    return mp->hash;
+}
+
+/* Sets the hash of new_mp, if the hash of mp is cached, replacing the
+ * old item of key, if any, with the new one, if value is not NULL */
+
+static void frozenmap_derive_hash(
+    FrozenMapObject* mp,
+    FrozenMapObject* new_mp,
+    const Py_hash_t hash,
+    PyObject* old_value,
+    PyObject* value
+) {
+    Py_uhash_t acc;
+
+    if (
+        mp->hash == MINUSONE_HASH ||
+        frozendict_hash_unfinalize(mp->hash, mp->size, &acc)
+    ) {
+        return;
+    }
+
+    if (
+        old_value != NULL &&
+        frozendict_hash_toggle_item(&acc, hash, old_value)
+    ) {
+        return;
+    }
+
+    if (value != NULL && frozendict_hash_toggle_item(&acc, hash, value)) {
+        return;
+    }
+
+    new_mp->hash = frozendict_hash_finalize(acc, new_mp->size);
+}
+
+static int frozenmap_equal(FrozenMapObject* mp, PyObject* other);
+
+static PyObject* frozenmap_richcompare(
+    PyObject* self,
+    PyObject* other,
+    int op
+) {
+    if (
+        (op != Py_EQ && op != Py_NE) ||
+        ! (FrozenMap_Check(other) || PyAnyDict_Check(other))
+    ) {
+        Py_RETURN_NOTIMPLEMENTED;
+    }
+
+    const int cmp = frozenmap_equal((FrozenMapObject*) self, other);
+
+    if (cmp < 0) {
+        return NULL;
+    }
+
+    return PyBool_FromLong(cmp == (op == Py_EQ));
+}
+
+static int frozenmap_node_equal(FrozenMapNode* node, PyObject* other) {
+    FrozenMapEntry* entry;
+    PyObject* other_value;
+    PyObject* key;
+    PyObject* value;
+    Py_ssize_t ix;
+    int cmp;
+
+    for (Py_ssize_t i = 0; i < Py_SIZE(node); i++) {
+        entry = &node->entries[i];
+
+        if (entry->key == NULL) {
+            cmp = frozenmap_node_equal((FrozenMapNode*) entry->value, other);
+
+            if (cmp <= 0) {
+                return cmp;
+            }
+
+            continue;
+        }
+
+        key = entry->key;
+
+        if (FrozenMap_Check(other)) {
+            other_value = frozenmap_node_find(
+                ((FrozenMapObject*) other)->root,
+                key,
+                entry->hash
+            );
+        }
+        else if (PyDict_Check(other)) {
+            other_value = _PyDict_GetItem_KnownHash(other, key, entry->hash);
+        }
+        else {
+            ix = frozendict_lookup_index(
+                (PyDictObject*) other,
+                key,
+                entry->hash
+            );
+
+            if (ix == DKIX_ERROR) {
+                return -1;
+            }
+
+            other_value = NULL;
+
+            if (ix >= 0) {
+                other_value = frozendict_entry_value(
+                    (PyDictObject*) other,
+                    ix
+                );
+            }
+        }
+
+        if (other_value == NULL) {
+            return PyErr_Occurred() ? -1 : 0;
+        }
+
+        value = entry->value;
+        Py_INCREF(value);
+        Py_INCREF(other_value);
+        cmp = PyObject_RichCompareBool(value, other_value, Py_EQ);
+        Py_DECREF(value);
+        Py_DECREF(other_value);
+
+        if (cmp <= 0) {
+            return cmp;
+        }
+    }
+
+    return 1;
+}
+
+static int frozenmap_equal(FrozenMapObject* mp, PyObject* other) {
+    if ((PyObject*) mp == other) {
+        return 1;
+    }
+
+    if (FrozenMap_Check(other)) {
+        FrozenMapObject* other_mp = (FrozenMapObject*) other;
+
+        if (mp->size != other_mp->size) {
+            return 0;
+        }
+
+        if (
+            mp->hash != MINUSONE_HASH &&
+            other_mp->hash != MINUSONE_HASH &&
+            mp->hash != other_mp->hash
+        ) {
+            return 0;
+        }
+
+        if (mp->root == other_mp->root) {
+            return 1;
+        }
+    }
+    else if (mp->size != ((PyDictObject*) other)->ma_used) {
+        return 0;
+    }
+
+    if (mp->root == NULL) {
+        return 1;
+    }
+
+    return frozenmap_node_equal(mp->root, other);
+}
+
+static int frozenmap_node_to_dict(FrozenMapNode* node, PyObject* d) {
+    FrozenMapEntry* entry;
+
+    for (Py_ssize_t i = 0; i < Py_SIZE(node); i++) {
+        entry = &node->entries[i];
+
+        if (entry->key == NULL) {
+            if (frozenmap_node_to_dict((FrozenMapNode*) entry->value, d)) {
+                return -1;
+            }
+        }
+        else if (_PyDict_SetItem_KnownHash(
+            d,
+            entry->key,
+            entry->value,
+            entry->hash
+        )) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static PyObject* frozenmap_to_dict(FrozenMapObject* mp) {
+    PyObject* d = PyDict_New();
+
+    if (d == NULL) {
+        return NULL;
+    }
+
+    if (mp->root != NULL && frozenmap_node_to_dict(mp->root, d)) {
+        Py_DECREF(d);
+        return NULL;
+    }
+
+    return d;
+}
+
+static PyObject* frozenmap_repr(FrozenMapObject* mp) {
+    PyObject* self = (PyObject*) mp;
+    const int status = Py_ReprEnter(self);
+
+    if (status != 0) {
+        if (status < 0) {
+            return NULL;
+        }
+
+        return PyUnicode_FromFormat("%s(...)", Py_TYPE(self)->tp_name);
+    }
+
+    PyObject* res = NULL;
+    PyObject* d = frozenmap_to_dict(mp);
+
+    if (d != NULL) {
+        res = PyUnicode_FromFormat("%s(%R)", Py_TYPE(self)->tp_name, d);
+        Py_DECREF(d);
+    }
+
+    Py_ReprLeave(self);
+
+    return res;
+}
+
+static PyObject* frozenmap_iter_new(FrozenMapObject* mp, int kind);
+
+static PyObject* frozenmap_iter(FrozenMapObject* mp) {
+    return frozenmap_iter_new(mp, FROZENMAP_ITER_KEYS);
+}
+
+/* Methods */
+
+static PyObject* frozenmap_get(FrozenMapObject* mp, PyObject* args) {
+    PyObject* key;
+    PyObject* default_value = Py_None;
+
+    if (! PyArg_UnpackTuple(args, "get", 1, 2, &key, &default_value)) {
+        return NULL;
+    }
+
+    PyObject* value = frozenmap_lookup(mp, key);
+
+    if (value == NULL) {
+        if (PyErr_Occurred()) {
+            return NULL;
+        }
+
+        value = default_value;
+    }
+
+    Py_INCREF(value);
+    return value;
+}
+
+static PyObject* frozenmap_view_new(FrozenMapObject* mp, PyTypeObject* type) {
+    FrozenMapViewObject* view = PyObject_GC_New(FrozenMapViewObject, type);
+
+    if (view == NULL) {
+        return NULL;
+    }
+
+    Py_INCREF(mp);
+    view->map = mp;
+
+    PyObject_GC_Track(view);
+    return (PyObject*) view;
+}
+
+static PyObject* frozenmap_keys(
+    FrozenMapObject* mp,
+    PyObject* Py_UNUSED(ignored)
+) {
+    return frozenmap_view_new(mp, &FrozenMapKeys_Type);
+}
+
+static PyObject* frozenmap_values(
+    FrozenMapObject* mp,
+    PyObject* Py_UNUSED(ignored)
+) {
+    return frozenmap_view_new(mp, &FrozenMapValues_Type);
+}
+
+static PyObject* frozenmap_items(
+    FrozenMapObject* mp,
+    PyObject* Py_UNUSED(ignored)
+) {
+    return frozenmap_view_new(mp, &FrozenMapItems_Type);
+}
+
+static PyObject* frozenmap_copy(
+    FrozenMapObject* mp,
+    PyObject* Py_UNUSED(ignored)
+) {
+    if (FrozenMap_CheckExact(mp)) {
+        Py_INCREF(mp);
+        return (PyObject*) mp;
+    }
+
+    Py_XINCREF(mp->root);
+
+    return frozenmap_from_root(Py_TYPE(mp), mp->root, mp->size);
+}
+
+static PyObject* frozenmap_reduce(
+    FrozenMapObject* mp,
+    PyObject* Py_UNUSED(ignored)
+) {
+    PyObject* d = frozenmap_to_dict(mp);
+
+    if (d == NULL) {
+        return NULL;
+    }
+
+    return Py_BuildValue("O(N)", Py_TYPE(mp), d);
+}
+
+static PyObject* frozenmap_fromkeys(PyObject* type, PyObject* args) {
+    PyObject* fromkeys = PyObject_GetAttrString(
+        (PyObject*) &PyDict_Type,
+        "fromkeys"
+    );
+
+    if (fromkeys == NULL) {
+        return NULL;
+    }
+
+    PyObject* d = PyObject_Call(fromkeys, args, NULL);
+    Py_DECREF(fromkeys);
+
+    if (d == NULL) {
+        return NULL;
+    }
+
+    PyObject* res = PyObject_CallFunctionObjArgs(type, d, NULL);
+    Py_DECREF(d);
+
+    return res;
+}
+
+/* Returns a new map with key set to value. If setdefault is true and
+ * key is already present, mp itself is returned. */
+
+static PyObject* frozenmap_assoc(
+    FrozenMapObject* mp,
+    PyObject* key,
+    PyObject* value,
+    int setdefault
+) {
+    const Py_hash_t hash = frozenmap_key_hash(key);
+
+    if (hash == -1) {
+        return NULL;
+    }
+
+    if (mp->root == NULL) {
+        FrozenMapObject* new_mp = frozenmap_new_barebone(Py_TYPE(mp));
+
+        if (new_mp == NULL) {
+            return NULL;
+        }
+
+        if (frozenmap_insert(new_mp, key, hash, value)) {
+            Py_DECREF(new_mp);
+            return NULL;
+        }
+
+        frozenmap_derive_hash(mp, new_mp, hash, NULL, value);
+
+        return (PyObject*) new_mp;
+    }
+
+    if (setdefault) {
+        PyObject* old_value = frozenmap_node_find(mp->root, key, hash);
+
+        if (old_value != NULL) {
+            Py_INCREF(mp);
+            return (PyObject*) mp;
+        }
+
+        if (PyErr_Occurred()) {
+            return NULL;
+        }
+    }
+
+    PyObject* old_value;
+
+    FrozenMapNode* new_root = frozenmap_node_assoc(
+        mp->root,
+        0,
+        key,
+        hash,
+        value,
+        &old_value,
+        0
+    );
+
+    if (new_root == NULL) {
+        return NULL;
+    }
+
+    if (new_root == mp->root) {
+        Py_DECREF(new_root);
+        Py_XDECREF(old_value);
+        Py_INCREF(mp);
+        return (PyObject*) mp;
+    }
+
+    FrozenMapObject* new_mp = (FrozenMapObject*) frozenmap_from_root(
+        Py_TYPE(mp),
+        new_root,
+        mp->size + (old_value == NULL)
+    );
+
+    if (new_mp != NULL) {
+        frozenmap_derive_hash(mp, new_mp, hash, old_value, value);
+    }
+
+    Py_XDECREF(old_value);
+
+    return (PyObject*) new_mp;
+}
+
+static PyObject* frozenmap_set(FrozenMapObject* mp, PyObject* args) {
+    PyObject* key;
+    PyObject* value;
+
+    if (! PyArg_UnpackTuple(args, "set", 2, 2, &key, &value)) {
+        return NULL;
+    }
+
+    return frozenmap_assoc(mp, key, value, 0);
+}
+
+static PyObject* frozenmap_setdefault(FrozenMapObject* mp, PyObject* args) {
+    PyObject* key;
+    PyObject* value = Py_None;
+
+    if (! PyArg_UnpackTuple(args, "setdefault", 1, 2, &key, &value)) {
+        return NULL;
+    }
+
+    return frozenmap_assoc(mp, key, value, 1);
+}
+
+static PyObject* frozenmap_delete(FrozenMapObject* mp, PyObject* key) {
+    const Py_hash_t hash = frozenmap_key_hash(key);
+
+    if (hash == -1) {
+        return NULL;
+    }
+
+    FrozenMapNode* new_root;
+    PyObject* old_value;
+    int res = 0;
+
+    if (mp->root != NULL) {
+        res = frozenmap_node_without(
+            mp->root,
+            0,
+            key,
+            hash,
+            &new_root,
+            &old_value
+        );
+    }
+
+    if (res < 0) {
+        return NULL;
+    }
+
+    if (res == 0) {
+        _PyErr_SetKeyError(key);
+        return NULL;
+    }
+
+    FrozenMapObject* new_mp = (FrozenMapObject*) frozenmap_from_root(
+        Py_TYPE(mp),
+        new_root,
+        mp->size - 1
+    );
+
+    if (new_mp != NULL) {
+        frozenmap_derive_hash(mp, new_mp, hash, old_value, NULL);
+    }
+
+    Py_DECREF(old_value);
+
+    return (PyObject*) new_mp;
+}
+
+/* Returns a borrowed reference to the entry at the index in args, with
+ * the same semantic of frozendict.key() */
+
+static FrozenMapEntry* frozenmap_entry_from_args(
+    FrozenMapObject* mp,
+    PyObject* args,
+    const char* name
+) {
+    PyObject* index_obj = NULL;
+
+    if (! PyArg_UnpackTuple(args, name, 0, 1, &index_obj)) {
+        return NULL;
+    }
+
+    Py_ssize_t index = 0;
+
+    if (index_obj != NULL) {
+        index = PyLong_AsSsize_t(index_obj);
+
+        if (index == -1 && PyErr_Occurred()) {
+            return NULL;
+        }
+    }
+
+    const Py_ssize_t passed_index = index;
+
+    if (index < 0) {
+        index += mp->size;
+    }
+
+    if (index < 0 || index >= mp->size) {
+        PyErr_Format(
+            PyExc_IndexError,
+            "%s index %zd out of range %zd",
+            Py_TYPE(mp)->tp_name,
+            passed_index,
+            mp->size - 1
+        );
+
+        return NULL;
+    }
+
+    return frozenmap_node_entry_at(mp->root, index);
+}
+
+static PyObject* frozenmap_key(FrozenMapObject* mp, PyObject* args) {
+    FrozenMapEntry* entry = frozenmap_entry_from_args(mp, args, "key");
+
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    Py_INCREF(entry->key);
+    return entry->key;
+}
+
+static PyObject* frozenmap_value(FrozenMapObject* mp, PyObject* args) {
+    FrozenMapEntry* entry = frozenmap_entry_from_args(mp, args, "value");
+
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    Py_INCREF(entry->value);
+    return entry->value;
+}
+
+static PyObject* frozenmap_item(FrozenMapObject* mp, PyObject* args) {
+    FrozenMapEntry* entry = frozenmap_entry_from_args(mp, args, "item");
+
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    return PyTuple_Pack(2, entry->key, entry->value);
+}
+
+static PyObject* frozenmap_or(PyObject* self, PyObject* other) {
+    if (
+        ! FrozenMap_Check(self) ||
+        ! (FrozenMap_Check(other) || PyAnyDict_Check(other))
+    ) {
+        Py_RETURN_NOTIMPLEMENTED;
+    }
+
+    FrozenMapObject* mp = (FrozenMapObject*) self;
+    FrozenMapObject* new_mp = frozenmap_new_barebone(Py_TYPE(self));
+
+    if (new_mp == NULL) {
+        return NULL;
+    }
+
+    Py_XINCREF(mp->root);
+    new_mp->root = mp->root;
+    new_mp->size = mp->size;
+
+    if (frozenmap_merge(new_mp, other)) {
+        Py_DECREF(new_mp);
+        return NULL;
+    }
+
+    return (PyObject*) new_mp;
+}
+
+PyDoc_STRVAR(frozenmap_get_doc,
+"get($self, key, default=None, /)\n"
+"--\n"
+"\n"
+"Return the value for key if key is in the map, else default.   ");
+
+PyDoc_STRVAR(frozenmap_keys_doc,
+"D.keys() -> a set-like object providing a view on D's keys");
+
+PyDoc_STRVAR(frozenmap_values_doc,
+"D.values() -> an object providing a view on D's values");
+
+PyDoc_STRVAR(frozenmap_items_doc,
+"D.items() -> a set-like object providing a view on D's items");
+
+PyDoc_STRVAR(frozenmap_copy_doc,
+"copy($self, /)\n"
+"--\n"
+"\n"
+"Return the object itself, as it's an immutable.   ");
+
+PyDoc_STRVAR(frozenmap_fromkeys_doc,
+"fromkeys($type, iterable, value=None, /)\n"
+"--\n"
+"\n"
+"Create a new map with keys from iterable and values set to value.   ");
+
+PyDoc_STRVAR(frozenmap_set_doc,
+"set($self, key, value, /)\n"
+"--\n"
+"\n"
+"Returns a copy of the map with the new (key, value) item. The copy \n"
+"shares all the unchanged nodes with the original map.   ");
+
+PyDoc_STRVAR(frozenmap_setdefault_doc,
+"setdefault($self, key[, default], /)\n"
+"--\n"
+"\n"
+"If key is in the map, it returns the map unchanged. Otherwise, it \n"
+"returns a copy of the map with the new (key, default) item; default \n"
+"argument is optional and is None by default.   ");
+
+PyDoc_STRVAR(frozenmap_delete_doc,
+"delete($self, key, /)\n"
+"--\n"
+"\n"
+"Returns a copy of the map without the item of the corresponding key. \n"
+"The copy shares all the unchanged nodes with the original map.   ");
+
+PyDoc_STRVAR(frozenmap_key_doc,
+"key($self[, index], /)\n"
+"--\n"
+"\n"
+"Get the key at the specified index (iteration order). If index is not \n"
+"passed, it defaults to 0. If index is negative, returns the key at \n"
+"position size + index.   ");
+
+PyDoc_STRVAR(frozenmap_value_doc,
+"value($self[, index], /)\n"
+"--\n"
+"\n"
+"Get the value at the specified index (iteration order). If index is not \n"
+"passed, it defaults to 0. If index is negative, returns the value at \n"
+"position size + index.   ");
+
+PyDoc_STRVAR(frozenmap_item_doc,
+"item($self[, index], /)\n"
+"--\n"
+"\n"
+"Get the (key, value) item at the specified index (iteration order). If \n"
+"index is not passed, it defaults to 0. If index is negative, returns \n"
+"the item at position size + index.   ");
+
+static PyMethodDef frozenmap_methods[] = {
+    {"get", (PyCFunction) frozenmap_get, METH_VARARGS, frozenmap_get_doc},
+    {"keys", (PyCFunction) frozenmap_keys, METH_NOARGS, frozenmap_keys_doc},
+    {"values", (PyCFunction) frozenmap_values, METH_NOARGS,
+    frozenmap_values_doc},
+    {"items", (PyCFunction) frozenmap_items, METH_NOARGS,
+    frozenmap_items_doc},
+    {"copy", (PyCFunction) frozenmap_copy, METH_NOARGS, frozenmap_copy_doc},
+    {"__copy__", (PyCFunction) frozenmap_copy, METH_NOARGS,
+    frozenmap_copy_doc},
+    {"__reduce__", (PyCFunction) frozenmap_reduce, METH_NOARGS, NULL},
+    {"fromkeys", (PyCFunction) frozenmap_fromkeys,
+    METH_VARARGS | METH_CLASS, frozenmap_fromkeys_doc},
+    {"set", (PyCFunction) frozenmap_set, METH_VARARGS, frozenmap_set_doc},
+    {"setdefault", (PyCFunction) frozenmap_setdefault, METH_VARARGS,
+    frozenmap_setdefault_doc},
+    {"delete", (PyCFunction) frozenmap_delete, METH_O, frozenmap_delete_doc},
+    {"key", (PyCFunction) frozenmap_key, METH_VARARGS, frozenmap_key_doc},
+    {"value", (PyCFunction) frozenmap_value, METH_VARARGS,
+    frozenmap_value_doc},
+    {"item", (PyCFunction) frozenmap_item, METH_VARARGS, frozenmap_item_doc},
+    {NULL, NULL}
+};
+
+static PyMappingMethods frozenmap_as_mapping = {
+    .mp_length = (lenfunc) frozenmap_length,
+    .mp_subscript = (binaryfunc) frozenmap_subscript,
+};
+
+static PySequenceMethods frozenmap_as_sequence = {
+    .sq_contains = (objobjproc) frozenmap_contains,
+};
+
+static PyNumberMethods frozenmap_as_number = {
+    .nb_or = frozenmap_or,
+};
+
+PyDoc_STRVAR(frozenmap_doc,
+"An immutable mapping with the API of frozendict, based on a hash array \n"
+"mapped trie. set(), delete() and setdefault() are O(log n), since the \n"
+"new map shares all the unchanged nodes with the original one. Unlike \n"
+"frozendict, the items are not in insertion order.\n"
+"\n"
+FROZENDICT_MODULE_NAME ".frozenmap() -> returns an empty map\n"
+FROZENDICT_MODULE_NAME ".frozenmap(mapping) -> returns a map initialized \n"
+"    from a mapping object's (key, value) pairs\n"
+FROZENDICT_MODULE_NAME ".frozenmap(iterable) -> returns a map initialized \n"
+"    from an iterable of (key, value) pairs\n"
+FROZENDICT_MODULE_NAME ".frozenmap(**kwargs) -> returns a map initialized \n"
+"    with the name=value pairs in the keyword argument list.");
+
+static PyTypeObject FrozenMap_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = FROZENDICT_MODULE_NAME ".frozenmap",
+    .tp_basicsize = sizeof(FrozenMapObject),
+    .tp_dealloc = (destructor) frozenmap_dealloc,
+    .tp_repr = (reprfunc) frozenmap_repr,
+    .tp_as_number = &frozenmap_as_number,
+    .tp_as_sequence = &frozenmap_as_sequence,
+    .tp_as_mapping = &frozenmap_as_mapping,
+    .tp_hash = (hashfunc) frozenmap_hash,
+    .tp_getattro = PyObject_GenericGetAttr,
+    .tp_flags = (
+        Py_TPFLAGS_DEFAULT
+        | Py_TPFLAGS_HAVE_GC
+        | Py_TPFLAGS_BASETYPE
+    ),
+    .tp_doc = frozenmap_doc,
+    .tp_traverse = (traverseproc) frozenmap_traverse,
+    .tp_clear = (inquiry) frozenmap_tp_clear,
+    .tp_richcompare = frozenmap_richcompare,
+    .tp_iter = (getiterfunc) frozenmap_iter,
+    .tp_methods = frozenmap_methods,
+    .tp_alloc = PyType_GenericAlloc,
+    .tp_new = frozenmap_new,
+    .tp_free = PyObject_GC_Del,
+};
+
+/* Iterator */
+
+static PyObject* frozenmap_iter_new(FrozenMapObject* mp, int kind) {
+    FrozenMapIterObject* it = PyObject_GC_New(
+        FrozenMapIterObject,
+        &FrozenMapIter_Type
+    );
+
+    if (it == NULL) {
+        return NULL;
+    }
+
+    Py_INCREF(mp);
+    it->map = mp;
+    it->kind = kind;
+    it->remaining = mp->size;
+    it->depth = -1;
+
+    if (mp->root != NULL) {
+        it->depth = 0;
+        it->nodes[0] = mp->root;
+        it->pos[0] = 0;
+    }
+
+    PyObject_GC_Track(it);
+    return (PyObject*) it;
+}
+
+static FrozenMapEntry* frozenmap_iter_next_entry(FrozenMapIterObject* it) {
+    FrozenMapNode* node;
+    FrozenMapEntry* entry;
+
+    while (it->depth >= 0) {
+        node = it->nodes[it->depth];
+
+        if (it->pos[it->depth] >= Py_SIZE(node)) {
+            it->depth--;
+            continue;
+        }
+
+        entry = &node->entries[it->pos[it->depth]++];
+
+        if (entry->key == NULL) {
+            it->depth++;
+            assert(it->depth < FROZENMAP_MAX_DEPTH);
+            it->nodes[it->depth] = (FrozenMapNode*) entry->value;
+            it->pos[it->depth] = 0;
+            continue;
+        }
+
+        it->remaining--;
+        return entry;
+    }
+
+    return NULL;
+}
+
+static PyObject* frozenmap_iter_next(FrozenMapIterObject* it) {
+    FrozenMapEntry* entry = frozenmap_iter_next_entry(it);
+
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    switch (it->kind) {
+        case FROZENMAP_ITER_KEYS:
+            Py_INCREF(entry->key);
+            return entry->key;
+        case FROZENMAP_ITER_VALUES:
+            Py_INCREF(entry->value);
+            return entry->value;
+        default:
+            return PyTuple_Pack(2, entry->key, entry->value);
+    }
+}
+
+static PyObject* frozenmap_iter_len(
+    FrozenMapIterObject* it,
+    PyObject* Py_UNUSED(ignored)
+) {
+    return PyLong_FromSsize_t(it->remaining);
+}
+
+static int frozenmap_iter_traverse(
+    FrozenMapIterObject* it,
+    visitproc visit,
+    void* arg
+) {
+    Py_VISIT(it->map);
+    return 0;
+}
+
+static void frozenmap_iter_dealloc(FrozenMapIterObject* it) {
+    PyObject_GC_UnTrack(it);
+    Py_XDECREF(it->map);
+    PyObject_GC_Del(it);
+}
+
+static PyMethodDef frozenmap_iter_methods[] = {
+    {"__length_hint__", (PyCFunction) frozenmap_iter_len, METH_NOARGS,
+    PyDoc_STR("Private method returning an estimate of len(list(it)).")},
+    {NULL, NULL}
+};
+
+static PyTypeObject FrozenMapIter_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = FROZENDICT_MODULE_NAME ".frozenmap_iterator",
+    .tp_basicsize = sizeof(FrozenMapIterObject),
+    .tp_dealloc = (destructor) frozenmap_iter_dealloc,
+    .tp_getattro = PyObject_GenericGetAttr,
+    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,
+    .tp_traverse = (traverseproc) frozenmap_iter_traverse,
+    .tp_iter = PyObject_SelfIter,
+    .tp_iternext = (iternextfunc) frozenmap_iter_next,
+    .tp_methods = frozenmap_iter_methods,
+};
+
+/* Views */
+
+static Py_ssize_t frozenmap_view_len(FrozenMapViewObject* view) {
+    return view->map->size;
+}
+
+static int frozenmap_view_traverse(
+    FrozenMapViewObject* view,
+    visitproc visit,
+    void* arg
+) {
+    Py_VISIT(view->map);
+    return 0;
+}
+
+static void frozenmap_view_dealloc(FrozenMapViewObject* view) {
+    PyObject_GC_UnTrack(view);
+    Py_XDECREF(view->map);
+    PyObject_GC_Del(view);
+}
+
+static PyObject* frozenmap_view_repr(FrozenMapViewObject* view) {
+    PyObject* self = (PyObject*) view;
+    const int status = Py_ReprEnter(self);
+    const char* name = strrchr(Py_TYPE(self)->tp_name, '.') + 1;
+
+    if (status != 0) {
+        if (status < 0) {
+            return NULL;
+        }
+
+        return PyUnicode_FromFormat("%s(...)", name);
+    }
+
+    PyObject* res = NULL;
+    PyObject* seq = PySequence_List(self);
+
+    if (seq != NULL) {
+        res = PyUnicode_FromFormat("%s(%R)", name, seq);
+        Py_DECREF(seq);
+    }
+
+    Py_ReprLeave(self);
+
+    return res;
+}
+
+static PyObject* frozenmap_keys_iter(FrozenMapViewObject* view) {
+    return frozenmap_iter_new(view->map, FROZENMAP_ITER_KEYS);
+}
+
+static PyObject* frozenmap_values_iter(FrozenMapViewObject* view) {
+    return frozenmap_iter_new(view->map, FROZENMAP_ITER_VALUES);
+}
+
+static PyObject* frozenmap_items_iter(FrozenMapViewObject* view) {
+    return frozenmap_iter_new(view->map, FROZENMAP_ITER_ITEMS);
+}
+
+static int frozenmap_keys_contains(FrozenMapViewObject* view, PyObject* key) {
+    return frozenmap_contains(view->map, key);
+}
+
+static int frozenmap_values_contains(
+    FrozenMapViewObject* view,
+    PyObject* value
+) {
+    PyObject* it = frozenmap_values_iter(view);
+
+    if (it == NULL) {
+        return -1;
+    }
+
+    PyObject* item;
+    int cmp = 0;
+
+    while ((item = frozenmap_iter_next((FrozenMapIterObject*) it)) != NULL) {
+        cmp = PyObject_RichCompareBool(item, value, Py_EQ);
+        Py_DECREF(item);
+
+        if (cmp) {
+            break;
+        }
+    }
+
+    Py_DECREF(it);
+
+    return cmp;
+}
+
+static int frozenmap_items_contains(
+    FrozenMapViewObject* view,
+    PyObject* item
+) {
+    if (! PyTuple_Check(item) || PyTuple_GET_SIZE(item) != 2) {
+        return 0;
+    }
+
+    PyObject* value = frozenmap_lookup(view->map, PyTuple_GET_ITEM(item, 0));
+
+    if (value == NULL) {
+        return PyErr_Occurred() ? -1 : 0;
+    }
+
+    Py_INCREF(value);
+    const int cmp = PyObject_RichCompareBool(
+        value,
+        PyTuple_GET_ITEM(item, 1),
+        Py_EQ
+    );
+    Py_DECREF(value);
+
+    return cmp;
+}
+
+/* Set operations of keys and items views, as the dict ones: the
+ * result is set(a) updated with b by method */
+
+static PyObject* frozenmap_view_set_op(
+    PyObject* a,
+    PyObject* b,
+    const char* method
+) {
+    PyObject* res = PySet_New(a);
+
+    if (res == NULL) {
+        return NULL;
+    }
+
+    PyObject* tmp = PyObject_CallMethod(res, method, "O", b);
+
+    if (tmp == NULL) {
+        Py_DECREF(res);
+        return NULL;
+    }
+
+    Py_DECREF(tmp);
+
+    return res;
+}
+
+static PyObject* frozenmap_view_and(PyObject* a, PyObject* b) {
+    return frozenmap_view_set_op(a, b, "intersection_update");
+}
+
+static PyObject* frozenmap_view_or(PyObject* a, PyObject* b) {
+    return frozenmap_view_set_op(a, b, "update");
+}
+
+static PyObject* frozenmap_view_sub(PyObject* a, PyObject* b) {
+    return frozenmap_view_set_op(a, b, "difference_update");
+}
+
+static PyObject* frozenmap_view_xor(PyObject* a, PyObject* b) {
+    return frozenmap_view_set_op(a, b, "symmetric_difference_update");
+}
+
+static PyObject* frozenmap_view_isdisjoint(PyObject* self, PyObject* other) {
+    PyObject* s = PySet_New(self);
+
+    if (s == NULL) {
+        return NULL;
+    }
+
+    PyObject* res = PyObject_CallMethod(s, "isdisjoint", "O", other);
+    Py_DECREF(s);
+
+    return res;
+}
+
+static PyObject* frozenmap_view_richcompare(
+    PyObject* self,
+    PyObject* other,
+    int op
+) {
+    if (
+        ! PyAnySet_Check(other) &&
+        ! FrozenMapSetView_Check(other) &&
+        ! PyDictKeys_Check(other) &&
+        ! PyDictItems_Check(other)
+    ) {
+        Py_RETURN_NOTIMPLEMENTED;
+    }
+
+    PyObject* a = PySet_New(self);
+
+    if (a == NULL) {
+        return NULL;
+    }
+
+    PyObject* b;
+
+    if (PyAnySet_Check(other)) {
+        Py_INCREF(other);
+        b = other;
+    }
+    else {
+        b = PySet_New(other);
+
+        if (b == NULL) {
+            Py_DECREF(a);
+            return NULL;
+        }
+    }
+
+    PyObject* res = PyObject_RichCompare(a, b, op);
+    Py_DECREF(a);
+    Py_DECREF(b);
+
+    return res;
+}
+
+static PyNumberMethods frozenmap_view_as_number = {
+    .nb_subtract = frozenmap_view_sub,
+    .nb_and = frozenmap_view_and,
+    .nb_xor = frozenmap_view_xor,
+    .nb_or = frozenmap_view_or,
+};
+
+static PySequenceMethods frozenmap_keys_as_sequence = {
+    .sq_length = (lenfunc) frozenmap_view_len,
+    .sq_contains = (objobjproc) frozenmap_keys_contains,
+};
+
+static PySequenceMethods frozenmap_values_as_sequence = {
+    .sq_length = (lenfunc) frozenmap_view_len,
+    .sq_contains = (objobjproc) frozenmap_values_contains,
+};
+
+static PySequenceMethods frozenmap_items_as_sequence = {
+    .sq_length = (lenfunc) frozenmap_view_len,
+    .sq_contains = (objobjproc) frozenmap_items_contains,
+};
+
+PyDoc_STRVAR(frozenmap_view_isdisjoint_doc,
+"Return True if the view and the given iterable have a null intersection.");
+
+static PyMethodDef frozenmap_setview_methods[] = {
+    {"isdisjoint", (PyCFunction) frozenmap_view_isdisjoint, METH_O,
+    frozenmap_view_isdisjoint_doc},
+    {NULL, NULL}
+};
+
+static PyTypeObject FrozenMapKeys_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = FROZENDICT_MODULE_NAME ".frozenmap_keys",
+    .tp_basicsize = sizeof(FrozenMapViewObject),
+    .tp_dealloc = (destructor) frozenmap_view_dealloc,
+    .tp_repr = (reprfunc) frozenmap_view_repr,
+    .tp_as_number = &frozenmap_view_as_number,
+    .tp_as_sequence = &frozenmap_keys_as_sequence,
+    .tp_getattro = PyObject_GenericGetAttr,
+    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,
+    .tp_traverse = (traverseproc) frozenmap_view_traverse,
+    .tp_richcompare = frozenmap_view_richcompare,
+    .tp_iter = (getiterfunc) frozenmap_keys_iter,
+    .tp_methods = frozenmap_setview_methods,
+};
+
+static PyTypeObject FrozenMapItems_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = FROZENDICT_MODULE_NAME ".frozenmap_items",
+    .tp_basicsize = sizeof(FrozenMapViewObject),
+    .tp_dealloc = (destructor) frozenmap_view_dealloc,
+    .tp_repr = (reprfunc) frozenmap_view_repr,
+    .tp_as_number = &frozenmap_view_as_number,
+    .tp_as_sequence = &frozenmap_items_as_sequence,
+    .tp_getattro = PyObject_GenericGetAttr,
+    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,
+    .tp_traverse = (traverseproc) frozenmap_view_traverse,
+    .tp_richcompare = frozenmap_view_richcompare,
+    .tp_iter = (getiterfunc) frozenmap_items_iter,
+    .tp_methods = frozenmap_setview_methods,
+};
+
+static PyTypeObject FrozenMapValues_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = FROZENDICT_MODULE_NAME ".frozenmap_values",
+    .tp_basicsize = sizeof(FrozenMapViewObject),
+    .tp_dealloc = (destructor) frozenmap_view_dealloc,
+    .tp_repr = (reprfunc) frozenmap_view_repr,
+    .tp_as_sequence = &frozenmap_values_as_sequence,
+    .tp_getattro = PyObject_GenericGetAttr,
+    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,
+    .tp_traverse = (traverseproc) frozenmap_view_traverse,
+    .tp_iter = (getiterfunc) frozenmap_values_iter,
+};
+
+static int frozenmap_exec(PyObject* m) {
+    if (PyType_Ready(&FrozenMapNode_Type) < 0) {
+        return -1;
+    }
+
+    if (PyType_Ready(&FrozenMapIter_Type) < 0) {
+        return -1;
+    }
+
+    if (PyType_Ready(&FrozenMapKeys_Type) < 0) {
+        return -1;
+    }
+
+    if (PyType_Ready(&FrozenMapItems_Type) < 0) {
+        return -1;
+    }
+
+    if (PyType_Ready(&FrozenMapValues_Type) < 0) {
+        return -1;
+    }
+
+    if (PyType_Ready(&FrozenMap_Type) < 0) {
+        return -1;
+    }
+
+    Py_INCREF(&FrozenMap_Type);
+
+    if (PyModule_AddObject(m, "frozenmap", (PyObject*) &FrozenMap_Type) < 0) {
+        Py_DECREF(&FrozenMap_Type);
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,212 @@
+/* intern
+ *
+ * frozendict.intern() hash-conses frozendicts: it returns a canonical
+ * frozendict for every value, so equal frozendicts built separately can
+ * share one object, and can be compared by identity.
+ *
+ * The canonical frozendicts are kept in a dict from their hash to a list
+ * of weak references to them, so interning doesn't keep them alive: the
+ * callback of the weak reference removes it from its list, and the list
+ * from the dict when it's empty. The weak reference caches the hash when
+ * it's created, so the callback can find its list also after the death
+ * of the frozendict.
+ *
+ * Two frozendicts are the same value if frozendict_freeze_same() says
+ * so, that is they have the same type, their keys are in the same order
+ * and their items have the same types: so intern() never replaces True
+ * by 1, as deepfreeze(..., previous=...) doesn't. The frozendicts with
+ * the same hash but not the same value, as {"a": True} and {"a": 1},
+ * have their own canonical frozendict in the same list. */
+
+static PyObject* frozendict_intern_table = NULL;
+static PyObject* frozendict_intern_callback = NULL;
+
+static PyObject* frozendict_intern_remove(
+    PyObject* Py_UNUSED(self),
+    PyObject* ref
+) {
+    const Py_hash_t hash = PyObject_Hash(ref);
+
+    if (hash == -1) {
+        return NULL;
+    }
+
+    PyObject* key = PyLong_FromSsize_t(hash);
+
+    if (key == NULL) {
+        return NULL;
+    }
+
+    PyObject* bucket = PyDict_GetItemWithError(frozendict_intern_table, key);
+    int res = 0;
+
+    if (bucket == NULL) {
+        res = PyErr_Occurred() ? -1 : 0;
+    }
+    else {
+        const Py_ssize_t size = PyList_GET_SIZE(bucket);
+
+        for (Py_ssize_t i = 0; i < size; i++) {
+            if (PyList_GET_ITEM(bucket, i) == ref) {
+                res = PyList_SetSlice(bucket, i, i + 1, NULL);
+                break;
+            }
+        }
+
+        if (res == 0 && PyList_GET_SIZE(bucket) == 0) {
+            res = PyDict_DelItem(frozendict_intern_table, key);
+        }
+    }
+
+    Py_DECREF(key);
+
+    if (res < 0) {
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef frozendict_intern_remove_def = {
+    "_intern_remove",
+    frozendict_intern_remove,
+    METH_O,
+    NULL
+};
+
+/* Returns a new reference to the canonical frozendict in bucket of the
+ * same value of fd, or NULL with no error if there's none. */
+
+static PyObject* frozendict_intern_find(PyObject* bucket, PyObject* fd) {
+    PyObject* canon;
+    int same;
+
+    // the comparisons can run arbitrary code, that can change bucket and
+    // drop canon
+    Py_INCREF(bucket);
+
+    for (Py_ssize_t i = 0; i < PyList_GET_SIZE(bucket); i++) {
+        canon = PyWeakref_GET_OBJECT(PyList_GET_ITEM(bucket, i));
+
+        // a dead referent is removed by its callback
+        if (canon == Py_None) {
+            continue;
+        }
+
+        Py_INCREF(canon);
+        same = frozendict_freeze_same(fd, canon);
+
+        if (same != 0) {
+            Py_DECREF(bucket);
+
+            if (same < 0) {
+                Py_DECREF(canon);
+                return NULL;
+            }
+
+            return canon;
+        }
+
+        Py_DECREF(canon);
+    }
+
+    Py_DECREF(bucket);
+
+    return NULL;
+}
+
+/* Returns a new reference to the canonical frozendict of the same value
+ * of fd, that becomes fd if there's none. Raises TypeError if fd is not
+ * hashable. */
+
+static PyObject* frozendict_intern_impl(PyObject* fd) {
+    assert(PyAnyFrozenDict_Check(fd));
+
+    const Py_hash_t hash = PyObject_Hash(fd);
+
+    if (hash == -1) {
+        return NULL;
+    }
+
+    if (frozendict_intern_table == NULL) {
+        frozendict_intern_table = PyDict_New();
+
+        if (frozendict_intern_table == NULL) {
+            return NULL;
+        }
+
+        frozendict_intern_callback = PyCFunction_NewEx(
+            &frozendict_intern_remove_def,
+            NULL,
+            NULL
+        );
+
+        if (frozendict_intern_callback == NULL) {
+            Py_CLEAR(frozendict_intern_table);
+            return NULL;
+        }
+    }
+
+    PyObject* key = PyLong_FromSsize_t(hash);
+
+    if (key == NULL) {
+        return NULL;
+    }
+
+    PyObject* bucket = PyDict_GetItemWithError(frozendict_intern_table, key);
+
+    if (bucket != NULL) {
+        PyObject* canon = frozendict_intern_find(bucket, fd);
+
+        if (canon != NULL || PyErr_Occurred()) {
+            Py_DECREF(key);
+            return canon;
+        }
+
+        // the comparisons can remove the bucket from the table
+        bucket = PyDict_GetItemWithError(frozendict_intern_table, key);
+    }
+
+    if (bucket == NULL && PyErr_Occurred()) {
+        Py_DECREF(key);
+        return NULL;
+    }
+
+    PyObject* ref = PyWeakref_NewRef(fd, frozendict_intern_callback);
+
+    if (ref == NULL || PyObject_Hash(ref) == -1) {
+        Py_XDECREF(ref);
+        Py_DECREF(key);
+        return NULL;
+    }
+
+    int res;
+
+    if (bucket == NULL) {
+        bucket = PyList_New(1);
+
+        if (bucket == NULL) {
+            Py_DECREF(ref);
+            Py_DECREF(key);
+            return NULL;
+        }
+
+        // steals ref
+        PyList_SET_ITEM(bucket, 0, ref);
+        res = PyDict_SetItem(frozendict_intern_table, key, bucket);
+        Py_DECREF(bucket);
+    }
+    else {
+        res = PyList_Append(bucket, ref);
+        Py_DECREF(ref);
+    }
+
+    Py_DECREF(key);
+
+    if (res < 0) {
+        return NULL;
+    }
+
+    Py_INCREF(fd);
+    return fd;
+}
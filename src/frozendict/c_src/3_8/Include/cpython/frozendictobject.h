@@ -2,13 +2,32 @@
 #  error "this header file must not be included directly"
 #endif
 
+typedef struct _frozendict_index PyFrozenDictIndex;
+
 typedef struct {
     PyObject_HEAD
     
     Py_ssize_t ma_used;
     uint64_t ma_version_tag;
     PyDictKeysObject* ma_keys;
+    
+    /* Values of the split frozendicts, that share ma_keys, or NULL */
     PyObject** ma_values;
     
     Py_hash_t ma_hash;
+    
+    /* The fields below are in the object and not in a side table: the
+     * index is read by every lookup of the small and the optimized
+     * frozendicts, the weak references need a fixed offset, and the
+     * frozenset is visited by the gc. */
+    
+    /* Index of the keys of the small layout or built by optimize(), or
+     * NULL */
+    PyFrozenDictIndex* ma_index;
+    
+    /* Frozenset of the keys built by keys_frozenset(), or NULL */
+    PyObject* ma_keys_set;
+    
+    /* List of weak references to the object, or NULL */
+    PyObject* ma_weakreflist;
 } PyFrozenDictObject;
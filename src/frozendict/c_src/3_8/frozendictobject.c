@@ -1,9 +1,14 @@
 #include <Python.h>
+#include <stddef.h>
+#include <structmember.h>
 #include "frozendictobject.h"
 static PyObject* frozendict_iter(PyDictObject *dict);
 static int frozendict_equal(PyDictObject* a, PyDictObject* b);
+static PyObject* frozendict_intern_impl(PyObject* fd);
+static PyDictKeysObject* frozendict_clone_split_keys(PyDictObject* orig);
 #include "other.c"
 #include "dictobject.c"
+#include "frozendictindex.c"
 
 static void
 frozendict_free_keys_object(PyDictKeysObject *keys, const int decref_items)
@@ -18,7 +23,13 @@ frozendict_free_keys_object(PyDictKeysObject *keys, const int decref_items)
     }
     
 #if PyDict_MAXFREELIST > 0
-    if (keys->dk_size == PyDict_MINSIZE && numfreekeys < PyDict_MAXFREELIST) {
+    // the exact tables of frozendicts are smaller, see
+    // frozendict_new_keys_fit()
+    if (
+        keys->dk_size == PyDict_MINSIZE
+        && keys->dk_usable + keys->dk_nentries == USABLE_FRACTION(PyDict_MINSIZE)
+        && numfreekeys < PyDict_MAXFREELIST
+    ) {
         keys_free_list[numfreekeys++] = keys;
         return;
     }
@@ -38,6 +49,66 @@ frozendict_keys_decref(PyDictKeysObject *dk, const int decref_items)
     }
 }
 
+/* Returns the value of the i-th entry of mp. The values of the split
+ * frozendicts are in ma_values, see frozendict_new_split(). */
+
+static inline PyObject* frozendict_entry_value(
+    const PyDictObject* mp,
+    const Py_ssize_t i
+) {
+    if (mp->ma_values != NULL) {
+        return mp->ma_values[i];
+    }
+
+    return DK_ENTRIES(mp->ma_keys)[i].me_value;
+}
+
+static void frozendict_dealloc(PyFrozenDictObject* mp) {
+    PyDictKeysObject* keys = mp->ma_keys;
+
+    /* bpo-31095: UnTrack is needed before calling any callbacks */
+    PyObject_GC_UnTrack(mp);
+
+    // not dict_dealloc(), since its trashcan works only for the types
+    // that have it as tp_dealloc
+    Py_TRASHCAN_BEGIN(mp, frozendict_dealloc)
+    if (mp->ma_weakreflist != NULL) {
+        PyObject_ClearWeakRefs((PyObject*) mp);
+    }
+
+    Py_XDECREF(mp->ma_keys_set);
+
+    if (frozendict_is_small(mp)) {
+        // the index and the table are in the block of the object
+        PyDictKeyEntry* entries = DK_ENTRIES(keys);
+
+        for (Py_ssize_t i = 0; i < keys->dk_nentries; i++) {
+            Py_DECREF(entries[i].me_key);
+            Py_DECREF(entries[i].me_value);
+        }
+    }
+    else if (mp->ma_values != NULL) {
+        // the values are in the block of the object, and the table is
+        // shared, see frozendict_new_split()
+        for (Py_ssize_t i = 0; i < mp->ma_used; i++) {
+            Py_XDECREF(mp->ma_values[i]);
+        }
+
+        dictkeys_decref(keys);
+    }
+    else {
+        PyMem_Free(mp->ma_index);
+
+        if (keys != NULL) {
+            assert(keys->dk_refcnt == 1 || keys == Py_EMPTY_KEYS);
+            dictkeys_decref(keys);
+        }
+    }
+
+    Py_TYPE(mp)->tp_free((PyObject*) mp);
+    Py_TRASHCAN_END
+}
+
 static int frozendict_resize(PyDictObject* mp, Py_ssize_t minsize) {
     const Py_ssize_t newsize = calculate_keysize(minsize);
     
@@ -66,11 +137,28 @@ static int frozendict_resize(PyDictObject* mp, Py_ssize_t minsize) {
     const Py_ssize_t numentries = mp->ma_used;
     PyDictKeyEntry* newentries = DK_ENTRIES(new_keys);
     
-    memcpy(
-        newentries, 
-        DK_ENTRIES(oldkeys), 
-        numentries * sizeof(PyDictKeyEntry)
-    );
+    if (oldkeys->dk_nentries == numentries) {
+        memcpy(
+            newentries, 
+            DK_ENTRIES(oldkeys), 
+            numentries * sizeof(PyDictKeyEntry)
+        );
+    }
+    else {
+        // the holes left by the deletions of a builder are skipped,
+        // see frozendict_builder_delitem()
+        PyDictKeyEntry* oldentries = DK_ENTRIES(oldkeys);
+        Py_ssize_t j = 0;
+
+        for (Py_ssize_t i = 0; i < oldkeys->dk_nentries; i++) {
+            if (oldentries[i].me_key != NULL) {
+                newentries[j] = oldentries[i];
+                j++;
+            }
+        }
+
+        assert(j == numentries);
+    }
     
     build_indices(new_keys, newentries, numentries);
     new_keys->dk_usable -= numentries;
@@ -84,6 +172,353 @@ static int frozendict_resize(PyDictObject* mp, Py_ssize_t minsize) {
     return 0;
 }
 
+/* Returns the size in bytes of an index of a table of size indices. */
+
+static inline Py_ssize_t frozendict_keys_ixsize(const Py_ssize_t size) {
+    if (size <= 0xff) {
+        return 1;
+    }
+
+    if (size <= 0xffff) {
+        return 2;
+    }
+
+#if SIZEOF_VOID_P > 4
+    if (size <= 0xffffffff) {
+        return 4;
+    }
+#endif
+
+    return sizeof(Py_ssize_t);
+}
+
+/* Returns the size in bytes of a table with room for exactly usable
+ * entries and the smallest indices that keep it at most 2/3 full, and
+ * stores the number of its indices in size. Since frozendicts don't
+ * change after their creation, the tables don't need room to grow, see
+ * frozendict_compact(). Returns -1 if the table is too big. */
+
+static Py_ssize_t frozendict_keys_fit_memsize(
+    const Py_ssize_t usable,
+    Py_ssize_t* size
+) {
+    *size = estimate_keysize(usable);
+
+    if (*size <= 0) {
+        return -1;
+    }
+
+    assert(IS_POWER_OF_2(*size));
+    assert(USABLE_FRACTION(*size) >= usable);
+
+    return (
+        sizeof(PyDictKeysObject)
+        + frozendict_keys_ixsize(*size) * *size
+        + usable * sizeof(PyDictKeyEntry)
+    );
+}
+
+/* Initializes keys as an empty table of size indices with room for
+ * usable entries, see frozendict_keys_fit_memsize(). */
+
+static void frozendict_keys_init(
+    PyDictKeysObject* keys,
+    const Py_ssize_t size,
+    const Py_ssize_t usable
+) {
+    keys->dk_refcnt = 1;
+    keys->dk_size = size;
+    keys->dk_usable = usable;
+    keys->dk_lookup = lookdict_unicode_nodummy;
+    keys->dk_nentries = 0;
+    memset(&keys->dk_indices[0], 0xff, frozendict_keys_ixsize(size) * size);
+    memset(DK_ENTRIES(keys), 0, usable * sizeof(PyDictKeyEntry));
+}
+
+/* Returns a new, empty table with room for exactly usable entries, see
+ * frozendict_keys_fit_memsize(). */
+
+static PyDictKeysObject* frozendict_new_keys_fit(const Py_ssize_t usable) {
+    Py_ssize_t size;
+    const Py_ssize_t memsize = frozendict_keys_fit_memsize(usable, &size);
+
+    if (memsize < 0) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+
+    PyDictKeysObject* keys = PyObject_Malloc(memsize);
+
+    if (keys == NULL) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+
+#ifdef Py_REF_DEBUG
+    _Py_RefTotal++;
+#endif
+    frozendict_keys_init(keys, size, usable);
+
+    return keys;
+}
+
+/* Copies in new_keys, an empty table with room for exactly used entries,
+ * the table keys, that has used entries and no dummies, and leaves no
+ * room for other entries. The references of the keys and values are not
+ * incremented. */
+
+static void frozendict_keys_copy_exact(
+    PyDictKeysObject* new_keys,
+    const PyDictKeysObject* keys,
+    const Py_ssize_t used
+) {
+    assert(keys->dk_nentries == used);
+    assert(new_keys->dk_nentries == 0 && new_keys->dk_usable == used);
+
+    PyDictKeyEntry* entries = DK_ENTRIES(new_keys);
+    memcpy(entries, DK_ENTRIES(keys), used * sizeof(PyDictKeyEntry));
+
+    if (new_keys->dk_size == keys->dk_size) {
+        memcpy(
+            &new_keys->dk_indices[0],
+            &keys->dk_indices[0],
+            DK_IXSIZE(keys) * DK_SIZE(keys)
+        );
+    }
+    else {
+        build_indices(new_keys, entries, used);
+    }
+
+    new_keys->dk_lookup = keys->dk_lookup;
+    new_keys->dk_usable = 0;
+    new_keys->dk_nentries = used;
+}
+
+/* Returns an exact copy of the table keys, see
+ * frozendict_keys_copy_exact(). */
+
+static PyDictKeysObject* frozendict_new_keys_exact(
+    const PyDictKeysObject* keys,
+    const Py_ssize_t used
+) {
+    PyDictKeysObject* new_keys = frozendict_new_keys_fit(used);
+
+    if (new_keys != NULL) {
+        frozendict_keys_copy_exact(new_keys, keys, used);
+    }
+
+    return new_keys;
+}
+
+/* Returns a frozendict with the small layout and the items of mp, that
+ * is fully built, and moves the items out of mp. The object, the hashes
+ * of the keys and the table are allocated in a single block, see
+ * frozendict_lookup_small(). */
+
+static PyObject* frozendict_new_small(PyFrozenDictObject* mp) {
+    const Py_ssize_t used = mp->ma_used;
+
+    assert(Py_TYPE(mp) == &PyFrozenDict_Type);
+    assert(used > 0 && used <= FROZENDICT_SMALL_MAX_SIZE);
+    assert(mp->ma_index == NULL);
+
+    // the hashes are compared two by two
+    const Py_ssize_t hashes_num = (used + 1) & ~((Py_ssize_t) 1);
+    const Py_ssize_t small_memsize = (
+        sizeof(PyFrozenDictSmall)
+        + hashes_num * sizeof(Py_hash_t)
+    );
+
+    Py_ssize_t size;
+    const Py_ssize_t keys_memsize = frozendict_keys_fit_memsize(used, &size);
+
+    PyObject* new_op = _PyObject_GC_Malloc(
+        sizeof(PyFrozenDictObject)
+        + small_memsize
+        + keys_memsize
+    );
+
+    if (new_op == NULL) {
+        return NULL;
+    }
+
+    PyObject_INIT(new_op, &PyFrozenDict_Type);
+
+    PyFrozenDictObject* new_mp = (PyFrozenDictObject*) new_op;
+    PyFrozenDictSmall* small = (PyFrozenDictSmall*) (new_mp + 1);
+    PyDictKeysObject* new_keys = (PyDictKeysObject*) (
+        (char*) small + small_memsize
+    );
+
+    PyDictKeysObject* keys = mp->ma_keys;
+    const PyDictKeyEntry* entries = DK_ENTRIES(keys);
+
+    frozendict_keys_init(new_keys, size, used);
+    frozendict_keys_copy_exact(new_keys, keys, used);
+
+    small->base.base_lookup = new_keys->dk_lookup;
+    small->base.memsize = small_memsize;
+
+    for (Py_ssize_t i = 0; i < used; i++) {
+        small->hashes[i] = entries[i].me_hash;
+    }
+
+    // -1 is never the hash of an object
+    for (Py_ssize_t i = used; i < hashes_num; i++) {
+        small->hashes[i] = -1;
+    }
+
+    new_keys->dk_lookup = frozendict_lookup_small;
+
+    new_mp->ma_used = used;
+    new_mp->ma_version_tag = mp->ma_version_tag;
+    new_mp->ma_keys = new_keys;
+    new_mp->ma_values = NULL;
+    new_mp->ma_hash = mp->ma_hash;
+    new_mp->ma_index = &small->base;
+    new_mp->ma_keys_set = NULL;
+    new_mp->ma_weakreflist = NULL;
+
+    if (_PyObject_GC_IS_TRACKED(mp)) {
+        PyObject_GC_Track(new_op);
+    }
+
+    // the items are moved, so they must not be decrefed
+    mp->ma_keys = NULL;
+    mp->ma_used = 0;
+    frozendict_keys_decref(keys, 0);
+
+    return new_op;
+}
+
+/* Returns self, that is fully built, with a table without room for
+ * other items. The frozendicts with at most FROZENDICT_SMALL_MAX_SIZE
+ * items are moved to a new object with the small layout, see
+ * frozendict_new_small(). The table of the others is replaced with an
+ * exact copy, see frozendict_new_keys_exact(), even if the indices
+ * don't change, since the allocator can shrink a block in place without
+ * releasing memory. Steals the reference to self, and returns NULL on
+ * errors. */
+
+static PyObject* frozendict_compact(PyObject* self) {
+    PyFrozenDictObject* mp = (PyFrozenDictObject*) self;
+    PyDictKeysObject* keys = mp->ma_keys;
+    const Py_ssize_t used = mp->ma_used;
+
+    if (used == 0 || mp->ma_index != NULL) {
+        return self;
+    }
+
+    assert(keys->dk_refcnt == 1);
+
+    if (
+        used <= FROZENDICT_SMALL_MAX_SIZE
+        && Py_TYPE(self) == &PyFrozenDict_Type
+    ) {
+        PyObject* new_op = frozendict_new_small(mp);
+        Py_DECREF(self);
+
+        return new_op;
+    }
+
+    if (keys->dk_usable == 0) {
+        return self;
+    }
+
+    PyDictKeysObject* new_keys = frozendict_new_keys_exact(keys, used);
+
+    if (new_keys == NULL) {
+        Py_DECREF(self);
+        return NULL;
+    }
+
+    // do not decref the keys inside!
+    frozendict_keys_decref(keys, 0);
+
+    mp->ma_keys = new_keys;
+
+    return self;
+}
+
+/* As frozendict_clone_keys(), but the copy is exact, see
+ * frozendict_new_keys_exact(). */
+
+static PyDictKeysObject* frozendict_clone_keys_exact(PyDictObject* orig) {
+    assert(orig->ma_values == NULL);
+
+    PyDictKeysObject* keys = frozendict_new_keys_exact(
+        orig->ma_keys,
+        orig->ma_used
+    );
+
+    if (keys == NULL) {
+        return NULL;
+    }
+
+    keys->dk_lookup = frozendict_keys_lookup(orig);
+
+    PyDictKeyEntry* entries = DK_ENTRIES(keys);
+
+    for (Py_ssize_t i = 0; i < orig->ma_used; i++) {
+        Py_INCREF(entries[i].me_key);
+        Py_INCREF(entries[i].me_value);
+    }
+
+    return keys;
+}
+
+/* Returns an exact, combined copy of the shared table of orig, with the
+ * values of orig, see frozendict_new_split(). */
+
+static PyDictKeysObject* frozendict_clone_split_keys(PyDictObject* orig) {
+    assert(orig->ma_values != NULL);
+
+    PyDictKeysObject* keys = frozendict_new_keys_exact(
+        orig->ma_keys,
+        orig->ma_used
+    );
+
+    if (keys == NULL) {
+        return NULL;
+    }
+
+    keys->dk_lookup = lookdict;
+
+    PyDictKeyEntry* entries = DK_ENTRIES(keys);
+    PyObject* value;
+
+    for (Py_ssize_t i = 0; i < orig->ma_used; i++) {
+        value = orig->ma_values[i];
+        Py_INCREF(entries[i].me_key);
+        Py_INCREF(value);
+        entries[i].me_value = value;
+    }
+
+    return keys;
+}
+
+/* The lookup functions of the tables of the dicts of CPython, that are
+ * not exported. A table given to a dict must use them, since CPython
+ * compares the lookup of a table with its own functions to change it,
+ * see frozendict_init_dict_lookups(). The tables copied or moved from
+ * dicts keep them. */
+
+static dict_lookup_func frozendict_dict_lookup_unicode = NULL;
+static dict_lookup_func frozendict_dict_lookup_unicode_dummy = NULL;
+static dict_lookup_func frozendict_dict_lookup_generic = NULL;
+
+/* Returns 1 if lookup can find only exact str keys: the vendored
+ * lookdict_unicode_nodummy(), or one of the lookups for str keys of
+ * CPython. */
+
+static inline int frozendict_lookup_is_unicode(const dict_lookup_func lookup) {
+    return (
+        lookup == lookdict_unicode_nodummy ||
+        lookup == frozendict_dict_lookup_unicode ||
+        lookup == frozendict_dict_lookup_unicode_dummy
+    );
+}
+
 static int frozendict_insert(PyDictObject *mp, 
                              PyObject *key, 
                              const Py_hash_t hash, 
@@ -123,6 +558,14 @@ static int frozendict_insert(PyDictObject *mp,
             // resize changes keys
             keys = mp->ma_keys;
         }
+
+        // the lookups for str keys can't find the other keys
+        if (
+            frozendict_lookup_is_unicode(keys->dk_lookup) &&
+            ! PyUnicode_CheckExact(key)
+        ) {
+            keys->dk_lookup = lookdict;
+        }
         
         const Py_ssize_t hashpos = find_empty_slot(keys, hash);
         const Py_ssize_t dk_nentries = keys->dk_nentries;
@@ -185,6 +628,13 @@ static PyObject* _frozendict_new(
     const int use_empty_frozendict
 );
 
+static PyObject* frozendict_new_barebone(PyTypeObject* type);
+static PyObject* frozendict_create_empty(
+    PyFrozenDictObject* mp,
+    const PyTypeObject* type,
+    const int use_empty_frozendict
+);
+
 static PyObject *
 frozendict_fromkeys_impl(PyTypeObject *type, PyObject *iterable, PyObject *value)
 {
@@ -223,7 +673,8 @@ frozendict_fromkeys_impl(PyTypeObject *type, PyObject *iterable, PyObject *value
                 return NULL;
             }
         }
-        return d;
+
+        return frozendict_compact(d);
     }
     else if (PyAnySet_CheckExact(iterable)) {
         Py_ssize_t pos = 0;
@@ -271,6 +722,13 @@ frozendict_fromkeys_impl(PyTypeObject *type, PyObject *iterable, PyObject *value
         }
     }
     
+    d = frozendict_compact(d);
+
+    if (d == NULL) {
+        return NULL;
+    }
+
+    mp = (PyDictObject *)d;
     ASSERT_CONSISTENT(mp);
     
     if (type == &PyFrozenDict_Type) {
@@ -405,10 +863,25 @@ static int frozendict_merge(PyObject* a, PyObject* b, int empty) {
         
         if (
             empty 
-            && is_other_combined 
             && numentries == okeys->dk_nentries
         ) {
-            PyDictKeysObject *keys = clone_combined_dict_keys(other);
+            PyDictKeysObject* keys;
+
+            if (is_other_combined) {
+                keys = frozendict_clone_keys_exact(other);
+            }
+            else {
+                // an instance __dict__ that has all the keys of the
+                // shared table: the entries, with their hashes, and the
+                // indices are copied as they are
+                keys = frozendict_clone_split_keys(other);
+
+                // CPython splits only the tables with str keys
+                if (keys != NULL && ! PyAnyFrozenDict_Check(other)) {
+                    keys->dk_lookup = lookdict_unicode_nodummy;
+                }
+            }
+
             if (keys == NULL) {
                 return -1;
             }
@@ -663,70 +1136,175 @@ static PyObject *frozendictvalues_new(PyObject *, PyObject *);
 
 #define MINUSONE_HASH ((Py_hash_t) -1)
 
-static Py_hash_t frozendict_hash(PyObject* self) {
-    PyFrozenDictObject* frozen_self = (PyFrozenDictObject*) self;
-    Py_hash_t hash;
+/* The hash of a frozendict is hash(frozenset(self.items())). It's
+ * calculated here without creating the items and the frozenset:
+ * frozendict_item_hash() is tuplehash() of Objects/tupleobject.c
+ * for a (key, value) tuple, reusing the stored hash of the key, and
+ * the rest is frozenset_hash() of Objects/setobject.c. */
 
-    if (frozen_self->ma_hash != MINUSONE_HASH) {
-        hash = frozen_self->ma_hash;
+static inline Py_uhash_t frozendict_shuffle_bits(Py_uhash_t h) {
+    return ((h ^ 89869747UL) ^ (h << 16)) * 3644798167UL;
+}
+
+static Py_hash_t frozendict_item_hash(Py_hash_t key_hash, PyObject* value) {
+    const Py_uhash_t value_hash = PyObject_Hash(value);
+
+    if (value_hash == (Py_uhash_t) -1) {
+        return MINUSONE_HASH;
     }
-    else {
-        PyObject* frozen_items_tmp = frozendictitems_new(self, NULL);
-        int save_hash = 1;
 
-        if (frozen_items_tmp == NULL) {
-            hash = MINUSONE_HASH;
-            save_hash = 0;
-        }
-        else {
-            PyObject* frozen_items = PyFrozenSet_New(frozen_items_tmp);
-            Py_DECREF(frozen_items_tmp);
+    Py_uhash_t acc = _PyHASH_XXPRIME_5;
 
-            if (frozen_items == NULL) {
-                hash = MINUSONE_HASH;
-                save_hash = 0;
-            }
-            else {
-                hash = PyFrozenSet_Type.tp_hash(frozen_items);
-                Py_DECREF(frozen_items);
-            }
-        }
+    acc += (Py_uhash_t) key_hash * _PyHASH_XXPRIME_2;
+    acc = _PyHASH_XXROTATE(acc);
+    acc *= _PyHASH_XXPRIME_1;
 
-        if (save_hash) {
-            frozen_self->ma_hash = hash;
-        }
-    }
+    acc += value_hash * _PyHASH_XXPRIME_2;
+    acc = _PyHASH_XXROTATE(acc);
+    acc *= _PyHASH_XXPRIME_1;
 
-    return hash;
-}
+    acc += 2 ^ (_PyHASH_XXPRIME_5 ^ 3527539UL);
 
-static PyObject* frozendict_copy(PyObject* o, PyObject* Py_UNUSED(ignored)) {
-    if (PyAnyFrozenDict_CheckExact(o)) {
-        Py_INCREF(o);
-        return o;
+    if (acc == (Py_uhash_t) -1) {
+        return 1546275796;
     }
-    
-    PyObject* args = PyTuple_New(1);
 
-    if (args == NULL) {
-        return NULL;
-    }
+    return acc;
+}
 
-    Py_INCREF(o);
-    PyTuple_SET_ITEM(args, 0, o);
-    
-    PyTypeObject* type = Py_TYPE(o);
+static Py_hash_t frozendict_hash_finalize(Py_uhash_t hash, Py_ssize_t size) {
+    /* Factor in the number of active entries */
+    hash ^= ((Py_uhash_t) size + 1) * 1927868237UL;
 
-    PyObject* res = PyObject_Call((PyObject *) type, args, NULL);
+    /* Disperse patterns arising in nested frozensets */
+    hash ^= (hash >> 11) ^ (hash >> 25);
+    hash = hash * 69069U + 907133923UL;
 
-    Py_DECREF(args);
+    /* -1 is reserved as an error code */
+    if (hash == (Py_uhash_t) -1) {
+        hash = 590923713UL;
+    }
 
-    return res;
+    return hash;
 }
 
-PyObject* frozendict_deepcopy(PyObject* self, PyObject* memo) {
-    if (PyAnyFrozenDict_CheckExact(self)) {
-        frozendict_hash(self);
+static Py_hash_t frozendict_hash(PyObject* self) {
+    PyFrozenDictObject* frozen_self = (PyFrozenDictObject*) self;
+
+    if (frozen_self->ma_hash != MINUSONE_HASH) {
+        return frozen_self->ma_hash;
+    }
+
+    const Py_ssize_t size = frozen_self->ma_used;
+    PyDictKeyEntry* entries = DK_ENTRIES(frozen_self->ma_keys);
+    Py_uhash_t hash = 0;
+    Py_hash_t item_hash;
+
+    for (Py_ssize_t i = 0; i < size; i++) {
+        item_hash = frozendict_item_hash(
+            entries[i].me_hash,
+            frozendict_entry_value((PyDictObject*) frozen_self, i)
+        );
+
+        if (item_hash == MINUSONE_HASH) {
+            return MINUSONE_HASH;
+        }
+
+        hash ^= frozendict_shuffle_bits(item_hash);
+    }
+
+    frozen_self->ma_hash = frozendict_hash_finalize(hash, size);
+
+    return frozen_self->ma_hash;
+}
+
+/* Reverts frozendict_hash_finalize(), so the hash of a frozendict
+ * created from an already hashed one can be derived in O(1), toggling
+ * only the items that changed with frozendict_hash_toggle_item().
+ * Returns -1 if the hash can't be reverted. */
+
+static int frozendict_hash_unfinalize(
+    Py_hash_t hash, 
+    Py_ssize_t size, 
+    Py_uhash_t* acc
+) {
+    Py_uhash_t x = (Py_uhash_t) hash;
+
+    /* it could be also the replacement of -1 */
+    if (x == 590923713UL) {
+        return -1;
+    }
+
+    /* inverse of 69069 modulo 2 ** bits of Py_uhash_t, by Newton's 
+     * method: every step doubles the correct bits */
+    Py_uhash_t inverse = 69069U;
+
+    for (int i = 0; i < 5; i++) {
+        inverse *= 2 - 69069U * inverse;
+    }
+
+    x = (x - 907133923UL) * inverse;
+
+    /* every step fixes at least 11 other high bits of the xorshift */
+    Py_uhash_t y = x;
+
+    for (int i = 0; i < 6; i++) {
+        y = x ^ (y >> 11) ^ (y >> 25);
+    }
+
+    *acc = y ^ (((Py_uhash_t) size + 1) * 1927868237UL);
+
+    return 0;
+}
+
+/* Adds the item to the hash accumulator, or removes it if it was 
+ * already added. Returns -1 and clears the error if value is not 
+ * hashable. */
+
+static int frozendict_hash_toggle_item(
+    Py_uhash_t* acc, 
+    Py_hash_t key_hash, 
+    PyObject* value
+) {
+    const Py_hash_t item_hash = frozendict_item_hash(key_hash, value);
+
+    if (item_hash == MINUSONE_HASH) {
+        PyErr_Clear();
+        return -1;
+    }
+
+    *acc ^= frozendict_shuffle_bits(item_hash);
+
+    return 0;
+}
+
+static PyObject* frozendict_copy(PyObject* o, PyObject* Py_UNUSED(ignored)) {
+    if (PyAnyFrozenDict_CheckExact(o)) {
+        Py_INCREF(o);
+        return o;
+    }
+    
+    PyObject* args = PyTuple_New(1);
+
+    if (args == NULL) {
+        return NULL;
+    }
+
+    Py_INCREF(o);
+    PyTuple_SET_ITEM(args, 0, o);
+    
+    PyTypeObject* type = Py_TYPE(o);
+
+    PyObject* res = PyObject_Call((PyObject *) type, args, NULL);
+
+    Py_DECREF(args);
+
+    return res;
+}
+
+PyObject* frozendict_deepcopy(PyObject* self, PyObject* memo) {
+    if (PyAnyFrozenDict_CheckExact(self)) {
+        frozendict_hash(self);
 
         if (PyErr_Occurred()) {
             PyErr_Clear();
@@ -838,23 +1416,73 @@ static int frozendict_equal(PyDictObject* a, PyDictObject* b) {
         return 0;
     }
 
+    // equal frozendicts have the same hash, so if both hashes are
+    // already cached and they differ, no item must be compared
+    if (
+        PyAnyFrozenDict_Check(a) &&
+        PyAnyFrozenDict_Check(b) &&
+        ((PyFrozenDictObject*) a)->ma_hash != MINUSONE_HASH &&
+        ((PyFrozenDictObject*) b)->ma_hash != MINUSONE_HASH &&
+        ((PyFrozenDictObject*) a)->ma_hash != (
+            ((PyFrozenDictObject*) b)->ma_hash
+        )
+    ) {
+        return 0;
+    }
+
     PyDictKeysObject* keys = a->ma_keys;
+    PyDictKeysObject* b_keys;
     PyDictKeyEntry* ep;
     PyObject* aval;
     int cmp = 1;
     PyObject* bval;
     PyObject* key;
 
+    // the split frozendicts with the same keys share them, so only the
+    // values must be compared
+    if (keys == b->ma_keys && a->ma_values != NULL) {
+        for (Py_ssize_t i = 0; i < a->ma_used; i++) {
+            aval = a->ma_values[i];
+            bval = b->ma_values[i];
+            Py_INCREF(aval);
+            Py_INCREF(bval);
+            cmp = PyObject_RichCompareBool(aval, bval, Py_EQ);
+            Py_DECREF(aval);
+            Py_DECREF(bval);
+
+            if (cmp <= 0) {
+                break;
+            }
+        }
+
+        return cmp;
+    }
+
     /* Same # of entries -- check all of 'em.  Exit early on any diff. */
     for (Py_ssize_t i = 0; i < keys->dk_nentries; i++) {
         ep = &DK_ENTRIES(keys)[i];
-        aval = ep->me_value;
+        aval = frozendict_entry_value(a, i);
         Py_INCREF(aval);
         key = ep->me_key;
         Py_INCREF(key);
+        bval = NULL;
+        b_keys = b->ma_keys;
+
+        // when b has the same key in the same entry, as after set() or
+        // with the keys of the same schema, its value is taken without
+        // hashing or probing. b_keys is read again at every entry, since
+        // b can be a dict changed by the __eq__ of the values
+        if (
+            i < b_keys->dk_nentries &&
+            DK_ENTRIES(b_keys)[i].me_key == key
+        ) {
+            bval = frozendict_entry_value(b, i);
+        }
 
-        /* reuse the known hash value */
-        b->ma_keys->dk_lookup(b, key, ep->me_hash, &bval);
+        if (bval == NULL) {
+            /* reuse the known hash value */
+            b_keys->dk_lookup(b, key, ep->me_hash, &bval);
+        }
 
         if (bval == NULL) {
             if (PyErr_Occurred()) {
@@ -893,199 +1521,363 @@ static Py_ssize_t dict_get_index(PyDictObject *self, PyObject *key) {
     return (self->ma_keys->dk_lookup) (self, key, hash, &val);
 }
 
-static PyObject * frozendict_reduce(
-    PyFrozenDictObject *self,
-    PyObject *Py_UNUSED(ignored)
+static Py_ssize_t frozendict_lookup_index(
+    PyDictObject* mp, 
+    PyObject* key, 
+    const Py_hash_t hash
 ) {
-    const PyObject *o = PyDict_Type.tp_alloc(&PyDict_Type, 0);
+    PyObject* value;
+    return (mp->ma_keys->dk_lookup) (mp, key, hash, &value);
+}
 
-    if (o == NULL) {
-        return NULL;
-    }
+/* Toggles in acc the item of mp with the key, if any, and the new 
+ * item, if value is not NULL. Returns -1 and clears the error if the 
+ * lookup fails or a value is not hashable. */
 
-    PyDictObject *d = (PyDictObject *)o;
-    PyDictKeysObject *keys = clone_combined_dict_keys(
-        (PyDictObject*) self
-    );
+static int frozendict_hash_replace(
+    PyDictObject* mp, 
+    Py_uhash_t* acc, 
+    PyObject* key, 
+    const Py_hash_t hash, 
+    PyObject* value
+) {
+    const Py_ssize_t ix = frozendict_lookup_index(mp, key, hash);
 
-    if (keys == NULL) {
-        Py_DECREF(d);
-        return NULL;
+    if (ix == DKIX_ERROR) {
+        PyErr_Clear();
+        return -1;
     }
 
-    d->ma_keys = keys;
-    d->ma_values = NULL;
-    d->ma_used = self->ma_used;
-    d->ma_version_tag = DICT_NEXT_VERSION();
-    ASSERT_CONSISTENT(d);
-
-    const PyObject *args = PyTuple_Pack(1, d);
-    Py_DECREF(d);
-
-    if (args == NULL) {
-        return NULL;
+    if (
+        ix != DKIX_EMPTY && 
+        frozendict_hash_toggle_item(
+            acc, 
+            hash, 
+            frozendict_entry_value(mp, ix)
+        )
+    ) {
+        return -1;
     }
 
-    const PyObject *tuple = PyTuple_Pack(2, Py_TYPE(self), args);
-    Py_DECREF(args);
+    if (value != NULL && frozendict_hash_toggle_item(acc, hash, value)) {
+        return -1;
+    }
 
-    return tuple;
+    return 0;
 }
-    
-static PyObject* frozendict_clone(PyObject* self) {
-    PyTypeObject* type = Py_TYPE(self);
-    PyObject* new_op = type->tp_alloc(type, 0);
 
-    if (new_op == NULL){
-        return NULL;
-    }
+/* If the hash of self is cached, sets the hash of new_op, that is self
+ * with key set to value, or without key if value is NULL. Otherwise,
+ * or on errors, the hash of new_op will be calculated on request. */
 
-    if (type == &PyFrozenDict_Type) {
-        PyObject_GC_UnTrack(new_op);
+static void frozendict_derive_hash(
+    PyObject* self, 
+    PyObject* new_op, 
+    PyObject* key, 
+    PyObject* value
+) {
+    const PyFrozenDictObject* mp = (PyFrozenDictObject*) self;
+    Py_uhash_t acc;
+
+    if (
+        mp->ma_hash == MINUSONE_HASH || 
+        frozendict_hash_unfinalize(mp->ma_hash, mp->ma_used, &acc)
+    ) {
+        return;
     }
 
-    PyDictObject* mp = (PyDictObject*) self;
+    Py_hash_t hash;
 
-    PyDictKeysObject *keys = clone_combined_dict_keys(mp);
-    
-    if (keys == NULL) {
-        return NULL;
+    if (!PyUnicode_CheckExact(key) ||
+        (hash = ((PyASCIIObject *) key)->hash) == -1) {
+        hash = PyObject_Hash(key);
+
+        if (hash == -1) {
+            PyErr_Clear();
+            return;
+        }
     }
 
-    PyFrozenDictObject* new_mp = (PyFrozenDictObject*) new_op;
-    new_mp->ma_keys = keys;
-    
-    if (_PyObject_GC_IS_TRACKED(mp) && !_PyObject_GC_IS_TRACKED(new_mp)) {
-        PyObject_GC_Track(new_mp);
+    if (frozendict_hash_replace((PyDictObject*) self, &acc, key, hash, value)) {
+        return;
     }
-    
-    new_mp->ma_used = mp->ma_used;
-    new_mp->ma_hash = MINUSONE_HASH;
-    new_mp->ma_version_tag = DICT_NEXT_VERSION();
-    
-    ASSERT_CONSISTENT(new_mp);
-    
-    return new_op;
+
+    PyFrozenDictObject* new_mp = (PyFrozenDictObject*) new_op;
+    new_mp->ma_hash = frozendict_hash_finalize(acc, new_mp->ma_used);
 }
 
-static PyObject* frozendict_set(
+/* As frozendict_derive_hash(), for new_op = self | other. The 
+ * hashes of the values can run arbitrary code, so the hash is not 
+ * derived if other changes in the meanwhile. */
+
+static void frozendict_derive_hash_merge(
     PyObject* self, 
-    PyObject* const* args, 
-    Py_ssize_t nargs
+    PyObject* new_op, 
+    PyObject* other
 ) {
-    if (!_PyArg_CheckPositional("set", nargs, 2, 2)) {
-        return NULL;
+    const PyFrozenDictObject* mp = (PyFrozenDictObject*) self;
+    Py_uhash_t acc;
+
+    if (
+        mp->ma_hash == MINUSONE_HASH || 
+        frozendict_hash_unfinalize(mp->ma_hash, mp->ma_used, &acc)
+    ) {
+        return;
     }
 
-    PyObject* new_op = frozendict_clone(self);
+    const PyDictObject* other_mp = (PyDictObject*) other;
+    const uint64_t version_tag = other_mp->ma_version_tag;
+    Py_ssize_t pos = 0;
+    PyObject* key;
+    PyObject* value;
+    Py_hash_t hash;
+    int res;
 
-    if (new_op == NULL) {
-        return NULL;
-    }
+    while (_d_PyDict_Next(other, &pos, &key, &value, &hash)) {
+        Py_INCREF(key);
+        Py_INCREF(value);
+        res = frozendict_hash_replace(
+            (PyDictObject*) self, 
+            &acc, 
+            key, 
+            hash, 
+            value
+        );
+        Py_DECREF(key);
+        Py_DECREF(value);
 
-    PyObject* set_key = args[0];
-    
-    if (frozendict_setitem(new_op, set_key, args[1], 0)) {
-        Py_DECREF(new_op);
-        return NULL;
+        if (res || other_mp->ma_version_tag != version_tag) {
+            return;
+        }
     }
 
-    if (
-        ((PyDictObject*) self)->ma_keys->dk_lookup == lookdict_unicode_nodummy && 
-        ! PyUnicode_CheckExact(set_key)
-    ) {
-        ((PyFrozenDictObject*) new_op)->ma_keys->dk_lookup = lookdict;
-    }
-    
-    return new_op;
+    PyFrozenDictObject* new_mp = (PyFrozenDictObject*) new_op;
+    new_mp->ma_hash = frozendict_hash_finalize(acc, new_mp->ma_used);
 }
 
-static PyObject* frozendict_setdefault(
-    PyObject* self, 
-    PyObject* const* args, 
-    Py_ssize_t nargs
-) {
-    if (!_PyArg_CheckPositional("setdefault", nargs, 1, 2)) {
-        return NULL;
-    }
-
-    PyObject* set_key = args[0];
-    
-    if (PyDict_Contains(self, set_key)) {
-        Py_INCREF(self);
-        return self;
-    }
+/* Reads the lookup functions of CPython from the table of a dict with
+ * only a str key, from the same table after the deletion of another str
+ * key, and then after adding a key that is not a str. Returns -1 on
+ * errors. */
 
-    PyObject* new_op = frozendict_clone(self);
+static int frozendict_init_dict_lookups(void) {
+    PyObject* d = PyDict_New();
 
-    if (new_op == NULL) {
-        return NULL;
+    if (d == NULL) {
+        return -1;
     }
 
-    PyObject* val;
+    PyDictObject* mp = (PyDictObject*) d;
 
-    if (nargs == 2) {
-        val = args[1];
-    }
-    else {
-        val = Py_None;
+    if (PyDict_SetItemString(d, "a", Py_None) < 0) {
+        Py_DECREF(d);
+        return -1;
     }
-    
-    if (frozendict_setitem(new_op, set_key, val, 0)) {
-        Py_DECREF(new_op);
 
-        return NULL;
-    }
+    frozendict_dict_lookup_unicode = mp->ma_keys->dk_lookup;
 
     if (
-        ((PyDictObject*) self)->ma_keys->dk_lookup == lookdict_unicode_nodummy && 
-        ! PyUnicode_CheckExact(set_key)
+        PyDict_SetItemString(d, "b", Py_None) < 0 ||
+        PyDict_DelItemString(d, "b") < 0
     ) {
-        ((PyFrozenDictObject*) new_op)->ma_keys->dk_lookup = lookdict;
-    }
-    
-    return new_op;
-}
-
-static PyObject* frozendict_delete(
-    PyObject* self, 
-    PyObject *const *args, 
-    Py_ssize_t nargs
-) {
-    if (! _PyArg_CheckPositional("delete", nargs, 1, 1)) {
-        return NULL;
+        Py_DECREF(d);
+        return -1;
     }
 
-    PyDictObject* mp = (PyDictObject*) self;
-    PyObject* del_key = args[0];
-    const Py_ssize_t ix = dict_get_index(mp, del_key);
+    frozendict_dict_lookup_unicode_dummy = mp->ma_keys->dk_lookup;
 
-    if (ix == DKIX_ERROR) {
-        return NULL;
+    if (PyDict_SetItem(d, Py_None, Py_None) < 0) {
+        Py_DECREF(d);
+        return -1;
     }
 
-    if (ix == DKIX_EMPTY) {
-        _PyErr_SetKeyError(del_key);
+    frozendict_dict_lookup_generic = mp->ma_keys->dk_lookup;
+    Py_DECREF(d);
+
+    assert(frozendict_dict_lookup_unicode != frozendict_dict_lookup_generic);
+
+    return 0;
+}
+
+/* Returns a new dict with the items of the frozendict mp. The entries
+ * are copied with a single memcpy, but in a table with the size that
+ * CPython expects from its number of indices, since CPython copies and
+ * recycles the tables of the dicts as if it allocated all of them, while
+ * the tables of the frozendicts are exact, see frozendict_compact(). */
+
+static PyObject* frozendict_new_dict(PyDictObject* mp) {
+    PyObject* d = PyDict_New();
+    const Py_ssize_t used = mp->ma_used;
+
+    if (d == NULL || used == 0) {
+        return d;
+    }
+
+    PyDictKeysObject* keys = mp->ma_keys;
+
+    assert(keys->dk_nentries == used);
+
+    PyDictKeysObject* new_keys = new_keys_object(estimate_keysize(used));
+
+    if (new_keys == NULL) {
+        Py_DECREF(d);
         return NULL;
     }
 
-    const Py_ssize_t size = mp->ma_used;
-    const Py_ssize_t sizemm = size - 1;
+    PyDictKeyEntry* entries = DK_ENTRIES(new_keys);
+    memcpy(entries, DK_ENTRIES(keys), used * sizeof(PyDictKeyEntry));
 
-    if (sizemm == 0) {
-        PyObject* args = PyTuple_New(0);
+    int unicode = 1;
+    PyDictKeyEntry* entry;
 
-        if (args == NULL) {
+    for (Py_ssize_t i = 0; i < used; i++) {
+        entry = &entries[i];
+
+        if (mp->ma_values != NULL) {
+            entry->me_value = mp->ma_values[i];
+        }
+
+        Py_INCREF(entry->me_key);
+        Py_INCREF(entry->me_value);
+
+        if (unicode && ! PyUnicode_CheckExact(entry->me_key)) {
+            unicode = 0;
+        }
+    }
+
+    // only the tables copied from dicts can have dummies, and they keep
+    // the lookup of CPython, see frozendict_clone_keys_exact()
+    const dict_lookup_func lookup = frozendict_keys_lookup(mp);
+
+    if (
+        DK_SIZE(new_keys) == DK_SIZE(keys)
+        && (lookup == lookdict_unicode_nodummy || lookup == lookdict)
+    ) {
+        memcpy(
+            &new_keys->dk_indices[0],
+            &keys->dk_indices[0],
+            DK_IXSIZE(keys) * DK_SIZE(keys)
+        );
+    }
+    else {
+        build_indices(new_keys, entries, used);
+    }
+
+    new_keys->dk_usable -= used;
+    new_keys->dk_nentries = used;
+    new_keys->dk_lookup = (
+        unicode
+        ? frozendict_dict_lookup_unicode
+        : frozendict_dict_lookup_generic
+    );
+
+    // the empty table of CPython is static, so it's never freed here
+    PyDictObject* new_mp = (PyDictObject*) d;
+    dictkeys_decref(new_mp->ma_keys);
+    new_mp->ma_keys = new_keys;
+    new_mp->ma_values = NULL;
+    new_mp->ma_used = used;
+
+    if (_PyObject_GC_IS_TRACKED(mp) && ! _PyObject_GC_IS_TRACKED(d)) {
+        PyObject_GC_Track(d);
+    }
+
+    return d;
+}
+
+/* As frozendict_new_dict(). If deep is true, the values that are
+ * frozendicts are converted too, recursively. */
+
+static PyObject* frozendict_to_dict_impl(PyObject* self, const int deep) {
+    PyObject* d = frozendict_new_dict((PyDictObject*) self);
+
+    if (d == NULL || ! deep) {
+        return d;
+    }
+
+    if (Py_EnterRecursiveCall(" while converting a frozendict to a dict")) {
+        Py_DECREF(d);
+        return NULL;
+    }
+
+    PyDictObject* mp = (PyDictObject*) d;
+    PyDictKeyEntry* entries = DK_ENTRIES(mp->ma_keys);
+    PyObject* value;
+    PyObject* new_value;
+
+    for (Py_ssize_t i = 0; i < mp->ma_used; i++) {
+        value = entries[i].me_value;
+
+        if (! PyAnyFrozenDict_Check(value)) {
+            continue;
+        }
+
+        new_value = frozendict_to_dict_impl(value, 1);
+
+        if (new_value == NULL) {
+            Py_LeaveRecursiveCall();
+            Py_DECREF(d);
             return NULL;
         }
 
-        return PyObject_Call((PyObject*) Py_TYPE(self), args, NULL);
+        entries[i].me_value = new_value;
+        Py_DECREF(value);
+    }
+
+    Py_LeaveRecursiveCall();
+
+    return d;
+}
+
+static PyObject* frozendict_to_dict(
+    PyObject* self,
+    PyObject* args,
+    PyObject* kwds
+) {
+    static char* kwlist[] = {"deep", NULL};
+    int deep = 0;
+
+    if (! PyArg_ParseTupleAndKeywords(
+        args,
+        kwds,
+        "|$p:to_dict",
+        kwlist,
+        &deep
+    )) {
+        return NULL;
+    }
+
+    return frozendict_to_dict_impl(self, deep);
+}
+
+static PyObject * frozendict_reduce(
+    PyFrozenDictObject *self,
+    PyObject *Py_UNUSED(ignored)
+) {
+    PyObject *d = frozendict_new_dict((PyDictObject*) self);
+
+    if (d == NULL) {
+        return NULL;
+    }
+
+    const PyObject *args = PyTuple_Pack(1, d);
+    Py_DECREF(d);
+
+    if (args == NULL) {
+        return NULL;
     }
 
+    const PyObject *tuple = PyTuple_Pack(2, Py_TYPE(self), args);
+    Py_DECREF(args);
+
+    return tuple;
+}
+    
+static PyObject* frozendict_clone(PyObject* self) {
     PyTypeObject* type = Py_TYPE(self);
     PyObject* new_op = type->tp_alloc(type, 0);
 
-    if (new_op == NULL) {
+    if (new_op == NULL){
         return NULL;
     }
 
@@ -1093,237 +1885,2787 @@ static PyObject* frozendict_delete(
         PyObject_GC_UnTrack(new_op);
     }
 
-    const Py_ssize_t newsize = estimate_keysize(sizemm);
-    
-    if (newsize <= 0) {
-        Py_DECREF(new_op);
-        PyErr_NoMemory();
-        return NULL;
-    }
-    
-    assert(IS_POWER_OF_2(newsize));
-    assert(newsize >= PyDict_MINSIZE);
+    PyDictObject* mp = (PyDictObject*) self;
 
-    /* Allocate a new table. */
-    PyDictKeysObject* new_keys = new_keys_object(newsize);
+    PyDictKeysObject *keys = frozendict_clone_keys(mp);
     
-    if (new_keys == NULL) {
-        Py_DECREF(new_op);
+    if (keys == NULL) {
         return NULL;
     }
-    
-    const PyDictKeysObject* old_keys = mp->ma_keys;
-    new_keys->dk_lookup = old_keys->dk_lookup;
-    
+
     PyFrozenDictObject* new_mp = (PyFrozenDictObject*) new_op;
+    new_mp->ma_keys = keys;
     
-    // New table must be large enough.
-    assert(new_keys->dk_usable >= new_mp->ma_used);
+    if (_PyObject_GC_IS_TRACKED(mp) && !_PyObject_GC_IS_TRACKED(new_mp)) {
+        PyObject_GC_Track(new_mp);
+    }
     
-    new_mp->ma_keys = new_keys;
+    new_mp->ma_used = mp->ma_used;
     new_mp->ma_hash = MINUSONE_HASH;
     new_mp->ma_version_tag = DICT_NEXT_VERSION();
+    
+    ASSERT_CONSISTENT(new_mp);
+    
+    return new_op;
+}
 
-    PyObject* key;
+/* Split tables */
+
+/* Returns an exact table with the keys of the first size entries of
+ * keys and without values, that is shared by the frozendicts with these
+ * keys, see frozendict_new_split(). */
+
+static PyDictKeysObject* frozendict_new_split_keys(
+    PyDictKeysObject* keys,
+    const Py_ssize_t size
+) {
+    PyDictKeysObject* new_keys = frozendict_new_keys_exact(keys, size);
+
+    if (new_keys == NULL) {
+        return NULL;
+    }
+
+    PyDictKeyEntry* entries = DK_ENTRIES(new_keys);
+
+    for (Py_ssize_t i = 0; i < size; i++) {
+        Py_INCREF(entries[i].me_key);
+        entries[i].me_value = NULL;
+    }
+
+    new_keys->dk_lookup = frozendict_lookup_split;
+
+    return new_keys;
+}
+
+/* Returns a new frozendict with the shared table keys, and room for its
+ * values inline after the object. The values are NULL, and must be set
+ * with frozendict_split_init_value(). The lookup of the table reads
+ * them from ma_values, see frozendict_lookup_split(). */
+
+static PyObject* frozendict_new_split(
+    PyDictKeysObject* keys,
+    const Py_ssize_t size
+) {
+    PyObject* new_op = _PyObject_GC_Malloc(
+        sizeof(PyFrozenDictObject)
+        + size * sizeof(PyObject*)
+    );
+
+    if (new_op == NULL) {
+        return NULL;
+    }
+
+    PyObject_INIT(new_op, &PyFrozenDict_Type);
+
+    PyFrozenDictObject* mp = (PyFrozenDictObject*) new_op;
+    PyObject** values = (PyObject**) (mp + 1);
+
+    for (Py_ssize_t i = 0; i < size; i++) {
+        values[i] = NULL;
+    }
+
+    dictkeys_incref(keys);
+
+    mp->ma_used = size;
+    mp->ma_version_tag = DICT_NEXT_VERSION();
+    mp->ma_keys = keys;
+    mp->ma_values = values;
+    mp->ma_hash = MINUSONE_HASH;
+    mp->ma_index = NULL;
+    mp->ma_keys_set = NULL;
+    mp->ma_weakreflist = NULL;
+
+    return new_op;
+}
+
+/* Sets the i-th value of the split frozendict mp to a new reference to
+ * value, and tracks mp if value can be tracked. The old value, if any,
+ * is decrefed. */
+
+static inline void frozendict_split_init_value(
+    PyFrozenDictObject* mp,
+    const Py_ssize_t i,
+    PyObject* value
+) {
+    PyObject* old_value = mp->ma_values[i];
+
+    Py_INCREF(value);
+    mp->ma_values[i] = value;
+
+    if (
+        ! _PyObject_GC_IS_TRACKED(mp)
+        && _PyObject_GC_MAY_BE_TRACKED(value)
+    ) {
+        PyObject_GC_Track(mp);
+    }
+
+    Py_XDECREF(old_value);
+}
+
+/* Returns 1 if the copies of mp with different values, but with the
+ * same keys, should share the keys of mp, see frozendict_split_copy().
+ * The small frozendicts are copied, since the copy is cheap and their
+ * lookup is faster. */
+
+static inline int frozendict_can_share_keys(PyFrozenDictObject* mp) {
+    return (
+        Py_TYPE(mp) == &PyFrozenDict_Type
+        && (
+            mp->ma_values != NULL
+            || mp->ma_used > FROZENDICT_SMALL_MAX_SIZE
+        )
+    );
+}
+
+/* Returns a copy of mp, with the same keys and values, that shares the
+ * keys of mp if mp is split, or a new shared table of them otherwise.
+ * Only the values are copied, so the values can be replaced cheaply with
+ * frozendict_split_init_value(). */
+
+static PyObject* frozendict_split_copy(PyFrozenDictObject* mp) {
+    PyDictKeysObject* keys = mp->ma_keys;
+    const Py_ssize_t size = mp->ma_used;
+    const int is_split = mp->ma_values != NULL;
+
+    if (! is_split) {
+        keys = frozendict_new_split_keys(keys, size);
+
+        if (keys == NULL) {
+            return NULL;
+        }
+    }
+
+    PyObject* new_op = frozendict_new_split(keys, size);
+
+    if (! is_split) {
+        // now the table is owned by new_op only
+        dictkeys_decref(keys);
+    }
+
+    if (new_op == NULL) {
+        return NULL;
+    }
+
+    PyObject** values = ((PyFrozenDictObject*) new_op)->ma_values;
     PyObject* value;
+
+    if (is_split) {
+        memcpy(values, mp->ma_values, size * sizeof(PyObject*));
+
+        for (Py_ssize_t i = 0; i < size; i++) {
+            Py_INCREF(values[i]);
+        }
+    }
+    else {
+        const PyDictKeyEntry* entries = DK_ENTRIES(mp->ma_keys);
+
+        for (Py_ssize_t i = 0; i < size; i++) {
+            value = entries[i].me_value;
+            Py_INCREF(value);
+            values[i] = value;
+        }
+    }
+
+    if (_PyObject_GC_IS_TRACKED(mp)) {
+        PyObject_GC_Track(new_op);
+    }
+
+    return new_op;
+}
+
+/* Returns a copy of mp with key set to value, that shares the keys of
+ * mp, if key is in mp and mp can share its keys, see
+ * frozendict_can_share_keys(). Otherwise, returns NULL, and sets an
+ * error only if the lookup fails. */
+
+static PyObject* frozendict_split_set(
+    PyFrozenDictObject* mp,
+    PyObject* key,
+    PyObject* value
+) {
+    if (! frozendict_can_share_keys(mp)) {
+        return NULL;
+    }
+
     Py_hash_t hash;
-    Py_ssize_t hashpos;
-    PyDictKeyEntry* old_entries = DK_ENTRIES(old_keys);
-    PyDictKeyEntry* new_entries = DK_ENTRIES(new_keys);
-    PyDictKeyEntry* old_entry;
-    PyDictKeyEntry* new_entry;
-    Py_ssize_t new_i;
-    int deleted = 0;
 
-    for (Py_ssize_t i = 0; i < size; i++) {
-        if (i == ix) {
-            deleted = 1;
-            continue;
+    if (!PyUnicode_CheckExact(key) ||
+        (hash = ((PyASCIIObject *) key)->hash) == -1) {
+        hash = PyObject_Hash(key);
+
+        if (hash == -1) {
+            return NULL;
+        }
+    }
+
+    const Py_ssize_t ix = frozendict_lookup_index(
+        (PyDictObject*) mp,
+        key,
+        hash
+    );
+
+    if (ix < 0) {
+        return NULL;
+    }
+
+    PyObject* new_op = frozendict_split_copy(mp);
+
+    if (new_op == NULL) {
+        return NULL;
+    }
+
+    frozendict_split_init_value((PyFrozenDictObject*) new_op, ix, value);
+
+    return new_op;
+}
+
+/* As frozendict_split_set(), for all the items of other, that is a
+ * dict or a frozendict. If other changes in the meanwhile, it returns
+ * NULL, so the copy is done as usual. */
+
+static PyObject* frozendict_split_update(
+    PyFrozenDictObject* mp,
+    PyObject* other
+) {
+    PyDictObject* other_mp = (PyDictObject*) other;
+
+    if (
+        ! frozendict_can_share_keys(mp)
+        || other_mp->ma_used == 0
+        || other_mp->ma_used > mp->ma_used
+    ) {
+        return NULL;
+    }
+
+    const uint64_t version_tag = other_mp->ma_version_tag;
+    PyObject* new_op = NULL;
+    Py_ssize_t pos = 0;
+    Py_ssize_t ix;
+    PyObject* key;
+    PyObject* value;
+    Py_hash_t hash;
+
+    while (_d_PyDict_Next(other, &pos, &key, &value, &hash)) {
+        Py_INCREF(key);
+        Py_INCREF(value);
+        ix = frozendict_lookup_index((PyDictObject*) mp, key, hash);
+        Py_DECREF(key);
+
+        if (ix < 0 || other_mp->ma_version_tag != version_tag) {
+            Py_DECREF(value);
+            Py_XDECREF(new_op);
+            return NULL;
+        }
+
+        if (new_op == NULL) {
+            new_op = frozendict_split_copy(mp);
+
+            if (new_op == NULL) {
+                Py_DECREF(value);
+                return NULL;
+            }
+        }
+
+        frozendict_split_init_value((PyFrozenDictObject*) new_op, ix, value);
+        Py_DECREF(value);
+    }
+
+    return new_op;
+}
+
+static PyObject* frozendict_set(
+    PyObject* self, 
+    PyObject* const* args, 
+    Py_ssize_t nargs
+) {
+    if (!_PyArg_CheckPositional("set", nargs, 2, 2)) {
+        return NULL;
+    }
+
+    PyObject* set_key = args[0];
+
+    // if the key is in self, only the values are copied
+    PyObject* new_op = frozendict_split_set(
+        (PyFrozenDictObject*) self,
+        set_key,
+        args[1]
+    );
+
+    if (new_op != NULL) {
+        frozendict_derive_hash(self, new_op, set_key, args[1]);
+        return new_op;
+    }
+
+    if (PyErr_Occurred()) {
+        return NULL;
+    }
+
+    new_op = frozendict_clone(self);
+
+    if (new_op == NULL) {
+        return NULL;
+    }
+    
+    if (frozendict_setitem(new_op, set_key, args[1], 0)) {
+        Py_DECREF(new_op);
+        return NULL;
+    }
+
+    frozendict_derive_hash(self, new_op, set_key, args[1]);
+    
+    return new_op;
+}
+
+static PyObject* frozendict_setdefault(
+    PyObject* self, 
+    PyObject* const* args, 
+    Py_ssize_t nargs
+) {
+    if (!_PyArg_CheckPositional("setdefault", nargs, 1, 2)) {
+        return NULL;
+    }
+
+    PyObject* set_key = args[0];
+    
+    if (PyDict_Contains(self, set_key)) {
+        Py_INCREF(self);
+        return self;
+    }
+
+    PyObject* new_op = frozendict_clone(self);
+
+    if (new_op == NULL) {
+        return NULL;
+    }
+
+    PyObject* val;
+
+    if (nargs == 2) {
+        val = args[1];
+    }
+    else {
+        val = Py_None;
+    }
+    
+    if (frozendict_setitem(new_op, set_key, val, 0)) {
+        Py_DECREF(new_op);
+
+        return NULL;
+    }
+
+    frozendict_derive_hash(self, new_op, set_key, val);
+    
+    return new_op;
+}
+
+static PyObject* frozendict_delete(
+    PyObject* self, 
+    PyObject *const *args, 
+    Py_ssize_t nargs
+) {
+    if (! _PyArg_CheckPositional("delete", nargs, 1, 1)) {
+        return NULL;
+    }
+
+    PyDictObject* mp = (PyDictObject*) self;
+    PyObject* del_key = args[0];
+    const Py_ssize_t ix = dict_get_index(mp, del_key);
+
+    if (ix == DKIX_ERROR) {
+        return NULL;
+    }
+
+    if (ix == DKIX_EMPTY) {
+        _PyErr_SetKeyError(del_key);
+        return NULL;
+    }
+
+    const Py_ssize_t size = mp->ma_used;
+    const Py_ssize_t sizemm = size - 1;
+
+    if (sizemm == 0) {
+        PyObject* args = PyTuple_New(0);
+
+        if (args == NULL) {
+            return NULL;
+        }
+
+        return PyObject_Call((PyObject*) Py_TYPE(self), args, NULL);
+    }
+
+    PyTypeObject* type = Py_TYPE(self);
+    PyObject* new_op = type->tp_alloc(type, 0);
+
+    if (new_op == NULL) {
+        return NULL;
+    }
+
+    if (type == &PyFrozenDict_Type) {
+        PyObject_GC_UnTrack(new_op);
+    }
+
+    const Py_ssize_t newsize = estimate_keysize(sizemm);
+    
+    if (newsize <= 0) {
+        Py_DECREF(new_op);
+        PyErr_NoMemory();
+        return NULL;
+    }
+    
+    assert(IS_POWER_OF_2(newsize));
+    assert(newsize >= PyDict_MINSIZE);
+
+    /* Allocate a new table. */
+    PyDictKeysObject* new_keys = new_keys_object(newsize);
+    
+    if (new_keys == NULL) {
+        Py_DECREF(new_op);
+        return NULL;
+    }
+    
+    const PyDictKeysObject* old_keys = mp->ma_keys;
+    new_keys->dk_lookup = frozendict_keys_lookup(mp);
+    
+    PyFrozenDictObject* new_mp = (PyFrozenDictObject*) new_op;
+    
+    // New table must be large enough.
+    assert(new_keys->dk_usable >= new_mp->ma_used);
+    
+    new_mp->ma_keys = new_keys;
+    new_mp->ma_hash = MINUSONE_HASH;
+    new_mp->ma_version_tag = DICT_NEXT_VERSION();
+
+    PyObject* key;
+    PyObject* value;
+    Py_hash_t hash;
+    Py_ssize_t hashpos;
+    PyDictKeyEntry* old_entries = DK_ENTRIES(old_keys);
+    PyDictKeyEntry* new_entries = DK_ENTRIES(new_keys);
+    PyDictKeyEntry* old_entry;
+    PyDictKeyEntry* new_entry;
+    Py_ssize_t new_i;
+    int deleted = 0;
+
+    for (Py_ssize_t i = 0; i < size; i++) {
+        if (i == ix) {
+            deleted = 1;
+            continue;
+        }
+
+        new_i = i - deleted;
+
+        old_entry = &old_entries[i];
+        hash = old_entry->me_hash;
+        key = old_entry->me_key;
+        value = frozendict_entry_value(mp, i);
+        Py_INCREF(key);
+        Py_INCREF(value);
+        hashpos = find_empty_slot(new_keys, hash);
+        dictkeys_set_index(new_keys, hashpos, new_i);
+        new_entry = &new_entries[new_i];
+        new_entry->me_key = key;
+        new_entry->me_hash = hash;
+        new_entry->me_value = value;
+    }
+
+    new_mp->ma_used = sizemm;
+    new_keys->dk_usable -= sizemm;
+    new_keys->dk_nentries = sizemm;
+
+    frozendict_derive_hash(self, new_op, del_key, NULL);
+
+    ASSERT_CONSISTENT(new_mp);
+    
+    return new_op;
+}
+
+
+/* Returns a new, empty frozendict of type, with the lookup lookup and a
+ * table that can hold size items without resizing. */
+
+static PyObject* frozendict_new_presized_type(
+    PyTypeObject* type,
+    Py_ssize_t size,
+    dict_lookup_func lookup
+) {
+    if (size > PY_SSIZE_T_MAX / 3) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+
+    const Py_ssize_t newsize = estimate_keysize(size);
+
+    if (newsize <= 0) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+
+    assert(IS_POWER_OF_2(newsize));
+    assert(newsize >= PyDict_MINSIZE);
+
+    PyObject* new_op = type->tp_alloc(type, 0);
+
+    if (new_op == NULL) {
+        return NULL;
+    }
+
+    if (type == &PyFrozenDict_Type) {
+        PyObject_GC_UnTrack(new_op);
+    }
+
+    PyDictKeysObject* new_keys = new_keys_object(newsize);
+
+    if (new_keys == NULL) {
+        Py_DECREF(new_op);
+        return NULL;
+    }
+
+    new_keys->dk_lookup = lookup;
+
+    PyFrozenDictObject* new_mp = (PyFrozenDictObject*) new_op;
+    new_mp->ma_keys = new_keys;
+    new_mp->ma_values = NULL;
+    new_mp->ma_used = 0;
+    new_mp->ma_hash = MINUSONE_HASH;
+    new_mp->ma_version_tag = DICT_NEXT_VERSION();
+
+    return new_op;
+}
+
+/* Returns a new, empty frozendict of the same type of self, with a
+ * table that can hold size items without resizing. */
+
+static PyObject* frozendict_new_presized(PyObject* self, Py_ssize_t size) {
+    return frozendict_new_presized_type(
+        Py_TYPE(self),
+        size,
+        frozendict_keys_lookup((PyDictObject*) self)
+    );
+}
+
+/* Copies the items of self in the empty table of new_op, skipping the
+ * ones flagged in skip, if skip is not NULL. The indices are built
+ * once, at the end. */
+
+static void frozendict_copy_entries(
+    PyObject* self,
+    PyObject* new_op,
+    const char* skip
+) {
+    const PyDictObject* mp = (PyDictObject*) self;
+    PyDictObject* new_mp = (PyDictObject*) new_op;
+    PyDictKeysObject* new_keys = new_mp->ma_keys;
+
+    assert(new_mp->ma_used == 0);
+
+    const Py_ssize_t size = mp->ma_used;
+    PyDictKeyEntry* old_entries = DK_ENTRIES(mp->ma_keys);
+    PyDictKeyEntry* new_entries = DK_ENTRIES(new_keys);
+    PyDictKeyEntry* old_entry;
+    PyDictKeyEntry* new_entry;
+    PyObject* value;
+    Py_ssize_t new_i = 0;
+
+    for (Py_ssize_t i = 0; i < size; i++) {
+        if (skip != NULL && skip[i]) {
+            continue;
+        }
+
+        old_entry = &old_entries[i];
+        new_entry = &new_entries[new_i];
+        value = frozendict_entry_value(mp, i);
+        Py_INCREF(old_entry->me_key);
+        Py_INCREF(value);
+        new_entry->me_key = old_entry->me_key;
+        new_entry->me_hash = old_entry->me_hash;
+        new_entry->me_value = value;
+        new_i++;
+    }
+
+    assert(new_keys->dk_usable >= new_i);
+
+    build_indices(new_keys, new_entries, new_i);
+    new_keys->dk_usable -= new_i;
+    new_keys->dk_nentries = new_i;
+    new_mp->ma_used = new_i;
+
+    if (_PyObject_GC_IS_TRACKED(mp) && !_PyObject_GC_IS_TRACKED(new_mp)) {
+        PyObject_GC_Track(new_mp);
+    }
+}
+
+/* Switches mp to the generic lookup if one of the keys appended from
+ * the start-th entry on is not an exact str. */
+
+static void frozendict_check_appended_keys(
+    PyObject* mp,
+    const Py_ssize_t start
+) {
+    PyDictKeysObject* keys = ((PyDictObject*) mp)->ma_keys;
+
+    if (keys->dk_lookup != lookdict_unicode_nodummy) {
+        return;
+    }
+
+    PyDictKeyEntry* entries = DK_ENTRIES(keys);
+
+    for (Py_ssize_t i = start; i < keys->dk_nentries; i++) {
+        if (! PyUnicode_CheckExact(entries[i].me_key)) {
+            keys->dk_lookup = lookdict;
+            return;
+        }
+    }
+}
+
+/* Returns a copy of self updated with arg and kwds, as dict.update().
+ * The table is sized once for all the new items, if arg can tell its
+ * length, and the items of self are copied only once. */
+
+static PyObject* frozendict_update_many(
+    PyObject* self,
+    PyObject* arg,
+    PyObject* kwds
+) {
+    PyDictObject* mp = (PyDictObject*) self;
+    Py_ssize_t extra = 0;
+
+    if (arg != NULL) {
+        extra = PyObject_LengthHint(arg, 0);
+
+        if (extra < 0) {
+            return NULL;
+        }
+    }
+
+    const Py_ssize_t kwds_size = (kwds != NULL
+        ? ((PyDictObject*) kwds)->ma_used
+        : 0
+    );
+
+    if (kwds_size != 0) {
+        if (! PyArg_ValidateKeywordArguments(kwds)) {
+            return NULL;
+        }
+
+        extra += kwds_size;
+    }
+
+    if (extra > PY_SSIZE_T_MAX - mp->ma_used) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+
+    PyObject* new_op;
+    PyObject* other = kwds_size == 0 ? arg : (arg == NULL ? kwds : NULL);
+
+    if (other != NULL && PyAnyDict_CheckExact(other)) {
+        // if all the keys are in self, only the values are copied
+        new_op = frozendict_split_update((PyFrozenDictObject*) mp, other);
+
+        if (new_op != NULL) {
+            frozendict_derive_hash_merge(self, new_op, other);
+            return new_op;
+        }
+
+        if (PyErr_Occurred()) {
+            return NULL;
+        }
+    }
+
+    if (mp->ma_used != 0 && mp->ma_keys->dk_usable >= extra) {
+        // the table of self is already large enough, memcpy it
+        new_op = frozendict_clone(self);
+
+        if (new_op == NULL) {
+            return NULL;
+        }
+    }
+    else {
+        new_op = frozendict_new_presized(self, mp->ma_used + extra);
+
+        if (new_op == NULL) {
+            return NULL;
+        }
+
+        frozendict_copy_entries(self, new_op, NULL);
+    }
+
+    if (arg != NULL && frozendict_update_arg(new_op, arg, 0)) {
+        Py_DECREF(new_op);
+        return NULL;
+    }
+
+    if (kwds_size != 0 && frozendict_merge(new_op, kwds, 0)) {
+        Py_DECREF(new_op);
+        return NULL;
+    }
+
+    if (kwds_size == 0) {
+        if (arg != NULL && PyAnyDict_CheckExact(arg)) {
+            frozendict_derive_hash_merge(self, new_op, arg);
+        }
+    }
+    else if (arg == NULL) {
+        frozendict_derive_hash_merge(self, new_op, kwds);
+    }
+
+    ASSERT_CONSISTENT(new_op);
+
+    return new_op;
+}
+
+static PyObject* frozendict_set_many(PyObject* self, PyObject* arg) {
+    return frozendict_update_many(self, arg, NULL);
+}
+
+static PyObject* frozendict_update(
+    PyObject* self,
+    PyObject* args,
+    PyObject* kwds
+) {
+    PyObject* arg = NULL;
+
+    if (! PyArg_UnpackTuple(args, "update", 0, 1, &arg)) {
+        return NULL;
+    }
+
+    return frozendict_update_many(self, arg, kwds);
+}
+
+/* If the hash of self is cached, sets the hash of new_op, that is self
+ * without the items flagged in deleted. */
+
+static void frozendict_derive_hash_delete_many(
+    PyObject* self,
+    PyObject* new_op,
+    const char* deleted
+) {
+    const PyFrozenDictObject* mp = (PyFrozenDictObject*) self;
+    Py_uhash_t acc;
+
+    if (
+        mp->ma_hash == MINUSONE_HASH ||
+        frozendict_hash_unfinalize(mp->ma_hash, mp->ma_used, &acc)
+    ) {
+        return;
+    }
+
+    PyDictKeyEntry* entries = DK_ENTRIES(mp->ma_keys);
+
+    for (Py_ssize_t i = 0; i < mp->ma_used; i++) {
+        if (
+            deleted[i] &&
+            frozendict_hash_toggle_item(
+                &acc,
+                entries[i].me_hash,
+                frozendict_entry_value((PyDictObject*) mp, i)
+            )
+        ) {
+            return;
+        }
+    }
+
+    PyFrozenDictObject* new_mp = (PyFrozenDictObject*) new_op;
+    new_mp->ma_hash = frozendict_hash_finalize(acc, new_mp->ma_used);
+}
+
+/* Returns self without the deleted_num items flagged in deleted, or
+ * self itself if none is flagged. */
+
+static PyObject* frozendict_delete_flagged(
+    PyObject* self,
+    const char* deleted,
+    const Py_ssize_t deleted_num
+) {
+    const Py_ssize_t size = ((PyDictObject*) self)->ma_used;
+
+    if (deleted_num == 0) {
+        Py_INCREF(self);
+        return self;
+    }
+
+    if (deleted_num == size) {
+        return PyObject_CallObject((PyObject*) Py_TYPE(self), NULL);
+    }
+
+    PyObject* new_op = frozendict_new_presized(self, size - deleted_num);
+
+    if (new_op == NULL) {
+        return NULL;
+    }
+
+    frozendict_copy_entries(self, new_op, deleted);
+    frozendict_derive_hash_delete_many(self, new_op, deleted);
+    ASSERT_CONSISTENT(new_op);
+
+    return new_op;
+}
+
+static PyObject* frozendict_delete_many(PyObject* self, PyObject* keys) {
+    PyObject* it = PyObject_GetIter(keys);
+
+    if (it == NULL) {
+        return NULL;
+    }
+
+    PyDictObject* mp = (PyDictObject*) self;
+    const Py_ssize_t size = mp->ma_used;
+    char* deleted = NULL;
+    Py_ssize_t deleted_num = 0;
+    PyObject* new_op = NULL;
+    PyObject* key;
+    Py_ssize_t ix;
+
+    while ((key = PyIter_Next(it)) != NULL) {
+        ix = dict_get_index(mp, key);
+
+        if (ix == DKIX_EMPTY) {
+            _PyErr_SetKeyError(key);
+        }
+
+        Py_DECREF(key);
+
+        if (ix < 0) {
+            goto end;
+        }
+
+        if (deleted == NULL) {
+            deleted = PyMem_Calloc(size, sizeof(char));
+
+            if (deleted == NULL) {
+                PyErr_NoMemory();
+                goto end;
+            }
+        }
+
+        if (! deleted[ix]) {
+            deleted[ix] = 1;
+            deleted_num++;
+        }
+    }
+
+    if (PyErr_Occurred()) {
+        goto end;
+    }
+
+    new_op = frozendict_delete_flagged(self, deleted, deleted_num);
+
+end:
+    Py_DECREF(it);
+    PyMem_Free(deleted);
+
+    return new_op;
+}
+
+
+/* Set operations */
+
+/* Flags in found the items of self whose keys are in other, that can
+ * be a dict, a set or any iterable of keys. If other is an exact dict
+ * or set, the smaller of the two is iterated and the stored hashes are
+ * reused. Returns the number of items flagged, or -1 on error. */
+
+static Py_ssize_t frozendict_find_keys(
+    PyObject* self,
+    PyObject* other,
+    char* found
+) {
+    PyDictObject* mp = (PyDictObject*) self;
+    const Py_ssize_t size = mp->ma_used;
+    Py_ssize_t found_num = 0;
+    Py_ssize_t pos = 0;
+    Py_ssize_t ix;
+    PyObject* key;
+    PyObject* value;
+    Py_hash_t hash;
+
+    const int is_dict = PyAnyDict_CheckExact(other);
+
+    if (is_dict || PyAnySet_CheckExact(other)) {
+        const Py_ssize_t other_size = (is_dict
+            ? ((PyDictObject*) other)->ma_used
+            : PySet_GET_SIZE(other)
+        );
+
+        if (size <= other_size) {
+            PyDictKeyEntry* entries = DK_ENTRIES(mp->ma_keys);
+
+            for (Py_ssize_t i = 0; i < size; i++) {
+                key = entries[i].me_key;
+                Py_INCREF(key);
+
+                if (is_dict) {
+                    ix = frozendict_lookup_index(
+                        (PyDictObject*) other,
+                        key,
+                        entries[i].me_hash
+                    );
+                }
+                else {
+                    const int contains = PySet_Contains(other, key);
+                    ix = contains < 0 ? DKIX_ERROR : (contains ? i : DKIX_EMPTY);
+                }
+
+                Py_DECREF(key);
+
+                if (ix == DKIX_ERROR) {
+                    return -1;
+                }
+
+                if (ix != DKIX_EMPTY) {
+                    found[i] = 1;
+                    found_num++;
+                }
+            }
+
+            return found_num;
+        }
+
+        while (is_dict
+            ? _d_PyDict_Next(other, &pos, &key, &value, &hash)
+            : _PySet_NextEntry(other, &pos, &key, &hash)
+        ) {
+            Py_INCREF(key);
+            ix = frozendict_lookup_index(mp, key, hash);
+            Py_DECREF(key);
+
+            if (ix == DKIX_ERROR) {
+                return -1;
+            }
+
+            if (ix >= 0 && ! found[ix]) {
+                found[ix] = 1;
+                found_num++;
+            }
+        }
+
+        return found_num;
+    }
+
+    PyObject* it = PyObject_GetIter(other);
+
+    if (it == NULL) {
+        return -1;
+    }
+
+    while ((key = PyIter_Next(it)) != NULL) {
+        ix = dict_get_index(mp, key);
+        Py_DECREF(key);
+
+        if (ix == DKIX_ERROR) {
+            Py_DECREF(it);
+            return -1;
+        }
+
+        if (ix >= 0 && ! found[ix]) {
+            found[ix] = 1;
+            found_num++;
+        }
+    }
+
+    Py_DECREF(it);
+
+    if (PyErr_Occurred()) {
+        return -1;
+    }
+
+    return found_num;
+}
+
+/* Returns self with only the items whose keys are in other, if keep is
+ * true, or without them otherwise. The keys of a keys view are read from
+ * its mapping. */
+
+static PyObject* frozendict_filter_keys(
+    PyObject* self,
+    PyObject* other,
+    const int keep
+) {
+    const Py_ssize_t size = ((PyDictObject*) self)->ma_used;
+
+    if (
+        PyAnyDictKeys_Check(other) &&
+        ((_PyDictViewObject*) other)->dv_dict != NULL
+    ) {
+        other = (PyObject*) ((_PyDictViewObject*) other)->dv_dict;
+    }
+
+    if (size == 0 || (keep && other == self)) {
+        Py_INCREF(self);
+        return self;
+    }
+
+    char* found = PyMem_Calloc(size, sizeof(char));
+
+    if (found == NULL) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+
+    Py_ssize_t found_num = frozendict_find_keys(self, other, found);
+    PyObject* new_op = NULL;
+
+    if (found_num >= 0) {
+        if (keep) {
+            for (Py_ssize_t i = 0; i < size; i++) {
+                found[i] = ! found[i];
+            }
+
+            found_num = size - found_num;
+        }
+
+        new_op = frozendict_delete_flagged(self, found, found_num);
+    }
+
+    PyMem_Free(found);
+
+    return new_op;
+}
+
+static PyObject* frozendict_filter_keys_many(
+    PyObject* self,
+    PyObject* args,
+    const int keep
+) {
+    Py_INCREF(self);
+    PyObject* res = self;
+    PyObject* new_op;
+
+    for (Py_ssize_t i = 0; i < PyTuple_GET_SIZE(args); i++) {
+        new_op = frozendict_filter_keys(res, PyTuple_GET_ITEM(args, i), keep);
+        Py_DECREF(res);
+
+        if (new_op == NULL) {
+            return NULL;
+        }
+
+        res = new_op;
+    }
+
+    return res;
+}
+
+static PyObject* frozendict_intersection(PyObject* self, PyObject* args) {
+    return frozendict_filter_keys_many(self, args, 1);
+}
+
+static PyObject* frozendict_difference(PyObject* self, PyObject* args) {
+    return frozendict_filter_keys_many(self, args, 0);
+}
+
+static PyObject* frozendict_union(PyObject* self, PyObject* args) {
+    Py_INCREF(self);
+    PyObject* res = self;
+    PyObject* new_op;
+    PyObject* arg;
+
+    for (Py_ssize_t i = 0; i < PyTuple_GET_SIZE(args); i++) {
+        arg = PyTuple_GET_ITEM(args, i);
+
+        if (PyAnyDict_CheckExact(arg)) {
+            if (((PyDictObject*) arg)->ma_used == 0) {
+                continue;
+            }
+
+            if (
+                Py_TYPE(arg) == Py_TYPE(res) &&
+                ((PyDictObject*) res)->ma_used == 0
+            ) {
+                Py_INCREF(arg);
+                Py_DECREF(res);
+                res = arg;
+                continue;
+            }
+        }
+
+        new_op = frozendict_update_many(res, arg, NULL);
+        Py_DECREF(res);
+
+        if (new_op == NULL) {
+            return NULL;
+        }
+
+        res = new_op;
+    }
+
+    return res;
+}
+
+/* Returns other, if it's a dict or a frozendict, or a new dict built
+ * from it. */
+
+static PyObject* frozendict_as_anydict(PyObject* other) {
+    if (PyAnyDict_Check(other)) {
+        Py_INCREF(other);
+        return other;
+    }
+
+    return PyObject_CallFunctionObjArgs((PyObject*) &PyDict_Type, other, NULL);
+}
+
+/* Returns the items of self whose keys are not in other, followed by the
+ * items of other whose keys are not in self. The keys of other are
+ * looked up in self with their stored hash. */
+
+static PyObject* frozendict_symmetric_difference_dict(
+    PyObject* self,
+    PyObject* other
+) {
+    PyDictObject* mp = (PyDictObject*) self;
+    PyDictObject* other_mp = (PyDictObject*) other;
+    const Py_ssize_t size = mp->ma_used;
+
+    if (other_mp->ma_used == 0) {
+        Py_INCREF(self);
+        return self;
+    }
+
+    const uint64_t version_tag = other_mp->ma_version_tag;
+    const Py_ssize_t other_entries = other_mp->ma_keys->dk_nentries;
+    char* found = PyMem_Calloc(size + other_entries, sizeof(char));
+
+    if (found == NULL) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+
+    // the items of other that are missing in self are flagged after the
+    // ones of self, by their position in the table of other
+    char* missing = found + size;
+    Py_ssize_t found_num = 0;
+    Py_ssize_t missing_num = 0;
+    PyObject* new_op = NULL;
+    Py_ssize_t pos = 0;
+    Py_ssize_t ix;
+    PyObject* key;
+    PyObject* value;
+    Py_hash_t hash;
+
+    while (_d_PyDict_Next(other, &pos, &key, &value, &hash)) {
+        Py_INCREF(key);
+        ix = frozendict_lookup_index(mp, key, hash);
+        Py_DECREF(key);
+
+        if (ix == DKIX_ERROR) {
+            goto end;
+        }
+
+        if (other_mp->ma_version_tag != version_tag) {
+            PyErr_SetString(
+                PyExc_RuntimeError,
+                "dictionary changed during iteration"
+            );
+
+            goto end;
+        }
+
+        if (ix >= 0) {
+            if (! found[ix]) {
+                found[ix] = 1;
+                found_num++;
+            }
+        }
+        else {
+            missing[pos - 1] = 1;
+            missing_num++;
+        }
+    }
+
+    if (missing_num == 0) {
+        new_op = frozendict_delete_flagged(self, found, found_num);
+        goto end;
+    }
+
+    new_op = frozendict_new_presized(self, size - found_num + missing_num);
+
+    if (new_op == NULL) {
+        goto end;
+    }
+
+    frozendict_copy_entries(self, new_op, found);
+    pos = 0;
+
+    while (_d_PyDict_Next(other, &pos, &key, &value, &hash)) {
+        if (other_mp->ma_version_tag != version_tag) {
+            PyErr_SetString(
+                PyExc_RuntimeError,
+                "dictionary changed during iteration"
+            );
+
+            Py_CLEAR(new_op);
+            goto end;
+        }
+
+        if (
+            missing[pos - 1] &&
+            frozendict_insert((PyDictObject*) new_op, key, hash, value, 0)
+        ) {
+            Py_CLEAR(new_op);
+            goto end;
+        }
+    }
+
+    ASSERT_CONSISTENT(new_op);
+
+end:
+    PyMem_Free(found);
+
+    return new_op;
+}
+
+static PyObject* frozendict_symmetric_difference(
+    PyObject* self,
+    PyObject* other
+) {
+    PyObject* other_dict = frozendict_as_anydict(other);
+
+    if (other_dict == NULL) {
+        return NULL;
+    }
+
+    PyObject* res = frozendict_symmetric_difference_dict(self, other_dict);
+    Py_DECREF(other_dict);
+
+    return res;
+}
+
+/* Returns 1 if the dict or frozendict mp has the item (key, value),
+ * 0 if not, -1 on error. The key is looked up with its known hash. */
+
+static int frozendict_has_item(
+    PyObject* mp,
+    PyObject* key,
+    const Py_hash_t hash,
+    PyObject* value
+) {
+    Py_INCREF(key);
+    Py_INCREF(value);
+    const Py_ssize_t ix = frozendict_lookup_index((PyDictObject*) mp, key, hash);
+    int cmp;
+
+    if (ix < 0) {
+        cmp = ix == DKIX_ERROR ? -1 : 0;
+    }
+    else {
+        PyObject* mp_value = frozendict_entry_value((PyDictObject*) mp, ix);
+        Py_INCREF(mp_value);
+        cmp = PyObject_RichCompareBool(value, mp_value, Py_EQ);
+        Py_DECREF(mp_value);
+    }
+
+    Py_DECREF(key);
+    Py_DECREF(value);
+
+    return cmp;
+}
+
+/* Returns 1 if every item of a is also an item of b, 0 if not, -1 on
+ * error. If only_keys is true, only the keys are checked. The keys are
+ * looked up in b with their stored hash. */
+
+static int frozendict_submapping(
+    PyObject* a,
+    PyObject* b,
+    const int only_keys
+) {
+    if (a == b) {
+        return 1;
+    }
+
+    if (((PyDictObject*) a)->ma_used > ((PyDictObject*) b)->ma_used) {
+        return 0;
+    }
+
+    Py_ssize_t pos = 0;
+    Py_ssize_t ix;
+    PyObject* key;
+    PyObject* value;
+    Py_hash_t hash;
+    int cmp = 1;
+
+    while (_d_PyDict_Next(a, &pos, &key, &value, &hash)) {
+        if (only_keys) {
+            Py_INCREF(key);
+            ix = frozendict_lookup_index((PyDictObject*) b, key, hash);
+            Py_DECREF(key);
+            cmp = ix == DKIX_ERROR ? -1 : ix >= 0;
+        }
+        else {
+            cmp = frozendict_has_item(b, key, hash, value);
+        }
+
+        if (cmp <= 0) {
+            break;
+        }
+    }
+
+    return cmp;
+}
+
+/* Implements issubset() and issuperset(), and <=, <, >= and >, that
+ * compare the items as the dict items views do. */
+
+static PyObject* frozendict_compare_items(
+    PyObject* self,
+    PyObject* other,
+    int op
+) {
+    PyObject* a = self;
+    PyObject* b = other;
+
+    if (op == Py_GE || op == Py_GT) {
+        a = other;
+        b = self;
+    }
+
+    if (
+        (op == Py_LT || op == Py_GT) &&
+        ((PyDictObject*) a)->ma_used >= ((PyDictObject*) b)->ma_used
+    ) {
+        Py_RETURN_FALSE;
+    }
+
+    const int cmp = frozendict_submapping(a, b, 0);
+
+    if (cmp < 0) {
+        return NULL;
+    }
+
+    return PyBool_FromLong(cmp);
+}
+
+static PyObject* frozendict_issubset(PyObject* self, PyObject* other) {
+    PyObject* other_dict = frozendict_as_anydict(other);
+
+    if (other_dict == NULL) {
+        return NULL;
+    }
+
+    PyObject* res = frozendict_compare_items(self, other_dict, Py_LE);
+    Py_DECREF(other_dict);
+
+    return res;
+}
+
+static PyObject* frozendict_issuperset(PyObject* self, PyObject* other) {
+    PyObject* other_dict = frozendict_as_anydict(other);
+
+    if (other_dict == NULL) {
+        return NULL;
+    }
+
+    PyObject* res = frozendict_compare_items(self, other_dict, Py_GE);
+    Py_DECREF(other_dict);
+
+    return res;
+}
+
+static PyObject* frozendict_optimize(
+    PyObject* self,
+    PyObject* args,
+    PyObject* kwds
+) {
+    static char* kwlist[] = {"index", NULL};
+    const char* index = "perfect";
+
+    if (! PyArg_ParseTupleAndKeywords(args, kwds, "|$s:optimize", kwlist, &index)) {
+        return NULL;
+    }
+
+    const int perfect = strcmp(index, "perfect") == 0;
+
+    if (! perfect && strcmp(index, "groups") != 0) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "index must be 'perfect' or 'groups', not '%s'",
+            index
+        );
+
+        return NULL;
+    }
+
+    PyFrozenDictObject* mp = (PyFrozenDictObject*) self;
+
+    // the shared tables can't have an index owned by mp
+    if (
+        mp->ma_index == NULL
+        && mp->ma_values == NULL
+        && mp->ma_used > 0
+        && mp->ma_used <= FROZENDICT_INDEX_MAX_SIZE
+    ) {
+        if (perfect && frozendict_perfect_new(mp)) {
+            return NULL;
+        }
+
+        // keys with the same hash can't have a perfect hash
+        if (mp->ma_index == NULL && frozendict_groups_new(mp)) {
+            return NULL;
+        }
+    }
+
+    Py_INCREF(self);
+    return self;
+}
+
+static PyObject* frozendict_sizeof(
+    PyObject* self,
+    PyObject* Py_UNUSED(ignored)
+) {
+    const PyFrozenDictObject* mp = (PyFrozenDictObject*) self;
+    Py_ssize_t res = _PyObject_SIZE(Py_TYPE(self));
+
+    // the keys of the empty frozendicts and of the split frozendicts
+    // are shared
+    if (mp->ma_keys->dk_refcnt == 1) {
+        res += _d_PyDict_KeysSize(mp->ma_keys);
+    }
+
+    if (mp->ma_values != NULL) {
+        res += mp->ma_used * sizeof(PyObject*);
+    }
+
+    const PyFrozenDictIndex* index = mp->ma_index;
+
+    if (index != NULL) {
+        res += index->memsize;
+    }
+
+    return PyLong_FromSsize_t(res);
+}
+
+static const PyObject* frozendict_key(
+    PyObject* self, 
+    PyObject *const *args, 
+    Py_ssize_t nargs
+) {
+    if (! _PyArg_CheckPositional("key", nargs, 0, 1)) {
+        return NULL;
+    }
+
+    Py_ssize_t index;
+    Py_ssize_t passed_index;
+    PyDictObject* d = (PyDictObject*) self;
+    const Py_ssize_t size = d->ma_used;
+
+    if (nargs > 0) {
+        index = PyLong_AsSsize_t(args[0]);
+        passed_index = index;
+
+        if (index < 0) {
+            if (PyErr_Occurred()) {
+                return NULL;
+            }
+
+            index += size;
+        }
+    }
+    else {
+        index = 0;
+        passed_index = index;
+    }
+
+    const Py_ssize_t maxindex = size - 1;
+
+    if (index > maxindex || index < 0) {
+        PyErr_Format(
+            PyExc_IndexError, 
+            "%s index %zd out of range %zd",
+            Py_TYPE(self)->tp_name,
+            passed_index,
+            maxindex
+        );
+
+        return NULL;
+    }
+
+    const PyObject* res = DK_ENTRIES(d->ma_keys)[index].me_key;
+    Py_INCREF(res);
+
+    return res;
+}
+
+static const PyObject* frozendict_value(
+    PyObject* self, 
+    PyObject *const *args, 
+    Py_ssize_t nargs
+) {
+    if (! _PyArg_CheckPositional("value", nargs, 0, 1)) {
+        return NULL;
+    }
+
+    Py_ssize_t index;
+    Py_ssize_t passed_index;
+    PyDictObject* d = (PyDictObject*) self;
+    const Py_ssize_t size = d->ma_used;
+
+    if (nargs > 0) {
+        index = PyLong_AsSsize_t(args[0]);
+        passed_index = index;
+
+        if (index < 0) {
+            if (PyErr_Occurred()) {
+                return NULL;
+            }
+
+            index += size;
+        }
+    }
+    else {
+        index = 0;
+        passed_index = index;
+    }
+
+    const Py_ssize_t maxindex = size - 1;
+
+    if (index > maxindex || index < 0) {
+        PyErr_Format(
+            PyExc_IndexError, 
+            "%s index %zd out of range %zd",
+            Py_TYPE(self)->tp_name,
+            passed_index,
+            maxindex
+        );
+
+        return NULL;
+    }
+
+    const PyObject* res = frozendict_entry_value(d, index);
+    Py_INCREF(res);
+
+    return res;
+}
+
+static const PyObject* frozendict_item(
+    PyObject* self, 
+    PyObject *const *args, 
+    Py_ssize_t nargs
+) {
+    if (! _PyArg_CheckPositional("item", nargs, 0, 1)) {
+        return NULL;
+    }
+
+    Py_ssize_t index;
+    Py_ssize_t passed_index;
+    PyDictObject* d = (PyDictObject*) self;
+    const Py_ssize_t size = d->ma_used;
+
+    if (nargs > 0) {
+        index = PyLong_AsSsize_t(args[0]);
+        passed_index = index;
+
+        if (index < 0) {
+            if (PyErr_Occurred()) {
+                return NULL;
+            }
+
+            index += size;
+        }
+    }
+    else {
+        index = 0;
+        passed_index = index;
+    }
+
+    const Py_ssize_t maxindex = size - 1;
+
+    if (index > maxindex || index < 0) {
+        PyErr_Format(
+            PyExc_IndexError, 
+            "%s index %zd out of range %zd",
+            Py_TYPE(self)->tp_name,
+            passed_index,
+            maxindex
+        );
+
+        return NULL;
+    }
+
+    PyObject* key = DK_ENTRIES(d->ma_keys)[index].me_key;
+    Py_INCREF(key);
+    PyObject* val = frozendict_entry_value(d, index);
+    Py_INCREF(val);
+
+    const PyObject* res = PyTuple_New(2);
+    PyTuple_SET_ITEM(res, 0, key);
+    PyTuple_SET_ITEM(res, 1, val);
+
+    return res;
+}
+
+/* Schemas */
+
+/* The frozendicts created by a schema share its table, see
+ * frozendict_new_split(). */
+
+typedef struct {
+    PyObject_HEAD
+    PyTypeObject* type;
+    // NULL if the schema has no keys
+    PyDictKeysObject* keys;
+} PyFrozenDictSchemaObject;
+
+static PyObject* frozendict_schema(PyObject* type, PyObject* keys) {
+    PyObject* tuple = PySequence_Tuple(keys);
+
+    if (tuple == NULL) {
+        return NULL;
+    }
+
+    const Py_ssize_t size = PyTuple_GET_SIZE(tuple);
+    PyDictKeysObject* new_keys = NULL;
+
+    if (size > 0) {
+        PyObject* d = frozendict_fromkeys_impl(
+            &PyFrozenDict_Type,
+            tuple,
+            Py_None
+        );
+
+        if (d == NULL) {
+            Py_DECREF(tuple);
+            return NULL;
+        }
+
+        PyDictObject* mp = (PyDictObject*) d;
+
+        if (mp->ma_used != size) {
+            PyErr_SetString(
+                PyExc_ValueError,
+                "schema keys must be unique"
+            );
+
+            Py_DECREF(d);
+            Py_DECREF(tuple);
+            return NULL;
+        }
+
+        new_keys = frozendict_new_split_keys(mp->ma_keys, size);
+        Py_DECREF(d);
+
+        if (new_keys == NULL) {
+            Py_DECREF(tuple);
+            return NULL;
+        }
+    }
+
+    Py_DECREF(tuple);
+
+    PyFrozenDictSchemaObject* schema = PyObject_GC_New(
+        PyFrozenDictSchemaObject,
+        &PyFrozenDictSchema_Type
+    );
+
+    if (schema == NULL) {
+        if (new_keys != NULL) {
+            dictkeys_decref(new_keys);
+        }
+
+        return NULL;
+    }
+
+    Py_INCREF(type);
+    schema->type = (PyTypeObject*) type;
+    schema->keys = new_keys;
+
+    PyObject_GC_Track(schema);
+
+    return (PyObject*) schema;
+}
+
+static PyObject* frozendict_schema_call(
+    PyFrozenDictSchemaObject* schema,
+    PyObject* args,
+    PyObject* kwds
+) {
+    PyObject* arg;
+
+    if (! _PyArg_NoKeywords("schema", kwds)) {
+        return NULL;
+    }
+
+    if (! PyArg_UnpackTuple(args, "schema", 1, 1, &arg)) {
+        return NULL;
+    }
+
+    PyObject* seq = PySequence_Fast(arg, "schema values must be iterable");
+
+    if (seq == NULL) {
+        return NULL;
+    }
+
+    const Py_ssize_t size = PySequence_Fast_GET_SIZE(seq);
+    PyDictKeysObject* keys = schema->keys;
+    const Py_ssize_t expected = keys == NULL ? 0 : keys->dk_nentries;
+
+    if (size != expected) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "schema expected %zd values, got %zd",
+            expected,
+            size
+        );
+
+        Py_DECREF(seq);
+        return NULL;
+    }
+
+    PyObject* type = (PyObject*) schema->type;
+
+    if (size == 0) {
+        Py_DECREF(seq);
+        return PyObject_CallObject(type, NULL);
+    }
+
+    PyObject* res = frozendict_new_split(keys, size);
+
+    if (res == NULL) {
+        Py_DECREF(seq);
+        return NULL;
+    }
+
+    PyObject** values = PySequence_Fast_ITEMS(seq);
+    const PyDictKeyEntry* entries = DK_ENTRIES(keys);
+
+    for (Py_ssize_t i = 0; i < size; i++) {
+        frozendict_split_init_value((PyFrozenDictObject*) res, i, values[i]);
+
+        // the shared table doesn't track its keys
+        if (
+            ! _PyObject_GC_IS_TRACKED(res)
+            && _PyObject_GC_MAY_BE_TRACKED(entries[i].me_key)
+        ) {
+            PyObject_GC_Track(res);
+        }
+    }
+
+    Py_DECREF(seq);
+
+    if (schema->type == &PyFrozenDict_Type) {
+        return res;
+    }
+
+    PyObject* sub_res = PyObject_CallFunctionObjArgs(type, res, NULL);
+    Py_DECREF(res);
+
+    return sub_res;
+}
+
+static int frozendict_schema_traverse(
+    PyFrozenDictSchemaObject* schema,
+    visitproc visit,
+    void* arg
+) {
+    Py_VISIT(schema->type);
+
+    PyDictKeysObject* keys = schema->keys;
+
+    // see frozendict_traverse()
+    if (keys != NULL && keys->dk_refcnt == 1) {
+        PyDictKeyEntry* entries = DK_ENTRIES(keys);
+
+        for (Py_ssize_t i = 0; i < keys->dk_nentries; i++) {
+            Py_VISIT(entries[i].me_key);
+        }
+    }
+
+    return 0;
+}
+
+static int frozendict_schema_clear(PyFrozenDictSchemaObject* schema) {
+    PyDictKeysObject* keys = schema->keys;
+
+    Py_CLEAR(schema->type);
+
+    // the frozendicts created by the schema keep their own reference
+    if (keys != NULL) {
+        schema->keys = NULL;
+        dictkeys_decref(keys);
+    }
+
+    return 0;
+}
+
+static void frozendict_schema_dealloc(PyFrozenDictSchemaObject* schema) {
+    PyObject_GC_UnTrack(schema);
+    frozendict_schema_clear(schema);
+    PyObject_GC_Del(schema);
+}
+
+static PyObject* frozendict_schema_keys(
+    PyFrozenDictSchemaObject* schema,
+    void* Py_UNUSED(closure)
+) {
+    PyDictKeysObject* keys = schema->keys;
+
+    if (keys == NULL) {
+        return PyTuple_New(0);
+    }
+
+    const Py_ssize_t size = keys->dk_nentries;
+    PyObject* res = PyTuple_New(size);
+
+    if (res == NULL) {
+        return NULL;
+    }
+
+    PyDictKeyEntry* entries = DK_ENTRIES(keys);
+    PyObject* key;
+
+    for (Py_ssize_t i = 0; i < size; i++) {
+        key = entries[i].me_key;
+        Py_INCREF(key);
+        PyTuple_SET_ITEM(res, i, key);
+    }
+
+    return res;
+}
+
+static PyObject* frozendict_schema_repr(PyFrozenDictSchemaObject* schema) {
+    PyObject* keys = frozendict_schema_keys(schema, NULL);
+
+    if (keys == NULL) {
+        return NULL;
+    }
+
+    PyObject* res = PyUnicode_FromFormat(
+        "%s.schema(%R)",
+        schema->type->tp_name,
+        keys
+    );
+
+    Py_DECREF(keys);
+
+    return res;
+}
+
+static PyGetSetDef frozendict_schema_getset[] = {
+    {"keys", (getter) frozendict_schema_keys, NULL,
+     "The keys of the dictionaries created by the schema.", NULL},
+    {NULL}
+};
+
+/* Builders */
+
+/* A builder fills a private, exact frozendict with frozendict_insert(),
+ * and finish() hands it to the caller after frozendict_compact(). The
+ * deleted items leave holes in the table, as in dict, that are removed
+ * by frozendict_resize(). The builders created by evolver() start from
+ * their frozendict, and copy it only at the first change. */
+
+typedef struct {
+    PyObject_HEAD
+    PyTypeObject* type;
+    // the frozendict returned by finish() if nothing changed, or NULL
+    PyObject* base;
+    // the frozendict being filled, or NULL until the first change
+    PyObject* mp;
+    // the number of changes running, that can call the builder again
+    // through the __eq__ and __hash__ of the keys
+    Py_ssize_t writers;
+} PyFrozenDictBuilderObject;
+
+/* Returns a new builder of type, that steals the reference to mp. */
+
+static PyObject* frozendict_builder_new(
+    PyTypeObject* type,
+    PyObject* base,
+    PyObject* mp
+) {
+    PyFrozenDictBuilderObject* builder = PyObject_GC_New(
+        PyFrozenDictBuilderObject,
+        &PyFrozenDictBuilder_Type
+    );
+
+    if (builder == NULL) {
+        Py_XDECREF(mp);
+        return NULL;
+    }
+
+    Py_INCREF(type);
+    builder->type = type;
+    Py_XINCREF(base);
+    builder->base = base;
+    builder->mp = mp;
+    builder->writers = 0;
+
+    PyObject_GC_Track(builder);
+
+    return (PyObject*) builder;
+}
+
+static PyObject* frozendict_builder(
+    PyObject* type,
+    PyObject* args,
+    PyObject* kwds
+) {
+    static char* kwlist[] = {"reserve", NULL};
+    Py_ssize_t reserve = 0;
+
+    if (! PyArg_ParseTupleAndKeywords(
+        args,
+        kwds,
+        "|$n:builder",
+        kwlist,
+        &reserve
+    )) {
+        return NULL;
+    }
+
+    if (reserve < 0) {
+        PyErr_SetString(PyExc_ValueError, "reserve must be non-negative");
+        return NULL;
+    }
+
+    PyObject* mp = frozendict_new_presized_type(
+        &PyFrozenDict_Type,
+        reserve,
+        lookdict_unicode_nodummy
+    );
+
+    if (mp == NULL) {
+        return NULL;
+    }
+
+    return frozendict_builder_new((PyTypeObject*) type, NULL, mp);
+}
+
+static PyObject* frozendict_evolver(
+    PyObject* self,
+    PyObject* Py_UNUSED(ignored)
+) {
+    return frozendict_builder_new(Py_TYPE(self), self, NULL);
+}
+
+/* Returns the frozendict read by builder: the one being filled, or the
+ * base, or NULL if the builder is empty. */
+
+static inline PyDictObject* frozendict_builder_current(
+    const PyFrozenDictBuilderObject* builder
+) {
+    if (builder->mp != NULL) {
+        return (PyDictObject*) builder->mp;
+    }
+
+    return (PyDictObject*) builder->base;
+}
+
+/* Returns the frozendict filled by builder. At the first change, it's
+ * a copy of the base with room for another item. Returns NULL on
+ * errors. */
+
+static PyDictObject* frozendict_builder_mp(
+    PyFrozenDictBuilderObject* builder
+) {
+    if (builder->mp != NULL) {
+        return (PyDictObject*) builder->mp;
+    }
+
+    PyDictObject* base = (PyDictObject*) builder->base;
+    PyObject* mp;
+
+    if (base == NULL || base->ma_used == 0) {
+        mp = frozendict_new_presized_type(
+            &PyFrozenDict_Type,
+            0,
+            lookdict_unicode_nodummy
+        );
+    }
+    else {
+        mp = frozendict_new_presized_type(
+            &PyFrozenDict_Type,
+            base->ma_used + 1,
+            frozendict_keys_lookup(base)
+        );
+
+        if (mp != NULL) {
+            frozendict_copy_entries((PyObject*) base, mp, NULL);
+        }
+    }
+
+    builder->mp = mp;
+
+    return (PyDictObject*) mp;
+}
+
+/* Returns the index of the slot of the indices of keys that points to
+ * the ix-th entry, that has the hash hash. */
+
+static Py_ssize_t frozendict_builder_find_slot(
+    const PyDictKeysObject* keys,
+    const Py_hash_t hash,
+    const Py_ssize_t ix
+) {
+    const size_t mask = DK_MASK(keys);
+    size_t perturb = (size_t) hash;
+    size_t i = (size_t) hash & mask;
+
+    while (dictkeys_get_index(keys, i) != ix) {
+        perturb >>= PERTURB_SHIFT;
+        i = (i*5 + perturb + 1) & mask;
+    }
+
+    return i;
+}
+
+/* Deletes key from mp, leaving a dummy in the indices and a hole in the
+ * entries, as delitem_common() of CPython. Raises a KeyError if key is
+ * not in mp. */
+
+static int frozendict_builder_delitem(PyDictObject* mp, PyObject* key) {
+    Py_hash_t hash;
+
+    if (
+        ! PyUnicode_CheckExact(key) ||
+        (hash = ((PyASCIIObject*) key)->hash) == -1
+    ) {
+        hash = PyObject_Hash(key);
+
+        if (hash == -1) {
+            return -1;
+        }
+    }
+
+    PyObject* old_value;
+    const Py_ssize_t ix = mp->ma_keys->dk_lookup(mp, key, hash, &old_value);
+
+    if (ix == DKIX_ERROR) {
+        return -1;
+    }
+
+    if (ix == DKIX_EMPTY) {
+        _PyErr_SetKeyError(key);
+        return -1;
+    }
+
+    PyDictKeysObject* keys = mp->ma_keys;
+
+    // the lookups for str keys without dummies can't skip them
+    if (frozendict_lookup_is_unicode(keys->dk_lookup)) {
+        keys->dk_lookup = lookdict;
+    }
+
+    dictkeys_set_index(
+        keys,
+        frozendict_builder_find_slot(keys, hash, ix),
+        DKIX_DUMMY
+    );
+
+    PyDictKeyEntry* ep = &DK_ENTRIES(keys)[ix];
+    PyObject* old_key = ep->me_key;
+    ep->me_key = NULL;
+    ep->me_value = NULL;
+    mp->ma_used--;
+
+    Py_DECREF(old_key);
+    Py_DECREF(old_value);
+
+    return 0;
+}
+
+static int frozendict_builder_ass_sub(
+    PyFrozenDictBuilderObject* builder,
+    PyObject* key,
+    PyObject* value
+) {
+    PyDictObject* mp = frozendict_builder_mp(builder);
+
+    if (mp == NULL) {
+        return -1;
+    }
+
+    int res;
+    builder->writers++;
+
+    if (value == NULL) {
+        res = frozendict_builder_delitem(mp, key);
+    }
+    else {
+        res = frozendict_setitem((PyObject*) mp, key, value, 0);
+    }
+
+    builder->writers--;
+
+    return res;
+}
+
+/* Looks up key in the frozendict read by builder. Returns 1 and a
+ * borrowed reference to the value in value if it's found, 0 if not, -1
+ * on errors. */
+
+static int frozendict_builder_lookup(
+    PyFrozenDictBuilderObject* builder,
+    PyObject* key,
+    PyObject** value
+) {
+    Py_hash_t hash;
+
+    if (
+        ! PyUnicode_CheckExact(key) ||
+        (hash = ((PyASCIIObject*) key)->hash) == -1
+    ) {
+        hash = PyObject_Hash(key);
+
+        if (hash == -1) {
+            return -1;
+        }
+    }
+
+    PyDictObject* mp = frozendict_builder_current(builder);
+
+    if (mp == NULL) {
+        return 0;
+    }
+
+    const Py_ssize_t ix = mp->ma_keys->dk_lookup(mp, key, hash, value);
+
+    if (ix == DKIX_ERROR) {
+        return -1;
+    }
+
+    return *value != NULL;
+}
+
+static PyObject* frozendict_builder_subscript(
+    PyFrozenDictBuilderObject* builder,
+    PyObject* key
+) {
+    PyObject* value;
+    const int found = frozendict_builder_lookup(builder, key, &value);
+
+    if (found < 0) {
+        return NULL;
+    }
+
+    if (found == 0) {
+        _PyErr_SetKeyError(key);
+        return NULL;
+    }
+
+    Py_INCREF(value);
+    return value;
+}
+
+static int frozendict_builder_contains(
+    PyFrozenDictBuilderObject* builder,
+    PyObject* key
+) {
+    PyObject* value;
+
+    return frozendict_builder_lookup(builder, key, &value);
+}
+
+static Py_ssize_t frozendict_builder_length(
+    PyFrozenDictBuilderObject* builder
+) {
+    const PyDictObject* mp = frozendict_builder_current(builder);
+
+    if (mp == NULL) {
+        return 0;
+    }
+
+    return mp->ma_used;
+}
+
+static PyObject* frozendict_builder_update(
+    PyFrozenDictBuilderObject* builder,
+    PyObject* args,
+    PyObject* kwds
+) {
+    PyObject* arg = NULL;
+
+    if (! PyArg_UnpackTuple(args, "update", 0, 1, &arg)) {
+        return NULL;
+    }
+
+    PyDictObject* mp = frozendict_builder_mp(builder);
+
+    if (mp == NULL) {
+        return NULL;
+    }
+
+    int res = 0;
+    builder->writers++;
+
+    if (arg != NULL) {
+        res = frozendict_update_arg((PyObject*) mp, arg, 0);
+    }
+
+    if (res == 0 && kwds != NULL) {
+        if (PyArg_ValidateKeywordArguments(kwds)) {
+            res = frozendict_merge((PyObject*) mp, kwds, 0);
+        }
+        else {
+            res = -1;
+        }
+    }
+
+    builder->writers--;
+
+    if (res < 0) {
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+}
+
+/* Returns the frozendict filled by the builder, and makes it the base
+ * of the builder, so the next changes copy it. On errors, the changes
+ * since the last finish() are lost. */
+
+static PyObject* frozendict_builder_finish(
+    PyFrozenDictBuilderObject* builder,
+    PyObject* Py_UNUSED(ignored)
+) {
+    if (builder->writers > 0) {
+        PyErr_SetString(
+            PyExc_RuntimeError,
+            "frozendict builder finished while it was changing"
+        );
+
+        return NULL;
+    }
+
+    PyObject* res = builder->mp;
+
+    if (res == NULL) {
+        res = builder->base;
+        Py_INCREF(res);
+        return res;
+    }
+
+    builder->mp = NULL;
+
+    PyDictObject* mp = (PyDictObject*) res;
+
+    if (mp->ma_keys->dk_nentries != mp->ma_used) {
+        // removes the holes, and gives back the faster lookup to the
+        // tables with only str keys
+        if (frozendict_resize(mp, estimate_keysize(mp->ma_used))) {
+            Py_DECREF(res);
+            return NULL;
+        }
+
+        mp->ma_keys->dk_lookup = lookdict_unicode_nodummy;
+        frozendict_check_appended_keys(res, 0);
+    }
+
+    ((PyFrozenDictObject*) res)->ma_hash = MINUSONE_HASH;
+    mp->ma_version_tag = DICT_NEXT_VERSION();
+
+    PyObject* type = (PyObject*) builder->type;
+
+    if (mp->ma_used == 0) {
+        Py_DECREF(res);
+        res = PyObject_CallObject(type, NULL);
+    }
+    else {
+        res = frozendict_compact(res);
+
+        if (res != NULL && builder->type != &PyFrozenDict_Type) {
+            PyObject* sub_res = PyObject_CallFunctionObjArgs(type, res, NULL);
+            Py_DECREF(res);
+            res = sub_res;
+        }
+    }
+
+    if (res == NULL) {
+        return NULL;
+    }
+
+    PyObject* old_base = builder->base;
+    Py_INCREF(res);
+    builder->base = res;
+    Py_XDECREF(old_base);
+
+    return res;
+}
+
+static int frozendict_builder_traverse(
+    PyFrozenDictBuilderObject* builder,
+    visitproc visit,
+    void* arg
+) {
+    Py_VISIT(builder->type);
+    Py_VISIT(builder->base);
+    Py_VISIT(builder->mp);
+
+    return 0;
+}
+
+static int frozendict_builder_clear(PyFrozenDictBuilderObject* builder) {
+    Py_CLEAR(builder->type);
+    Py_CLEAR(builder->base);
+    Py_CLEAR(builder->mp);
+
+    return 0;
+}
+
+static void frozendict_builder_dealloc(PyFrozenDictBuilderObject* builder) {
+    PyObject_GC_UnTrack(builder);
+    frozendict_builder_clear(builder);
+    PyObject_GC_Del(builder);
+}
+
+PyDoc_STRVAR(frozendict_builder_update_doc,
+"update($self, other=(), /, **kwds)\n"
+"--\n"
+"\n"
+"Adds the items of other and kwds, as dict.update().   ");
+
+PyDoc_STRVAR(frozendict_builder_finish_doc,
+"finish($self, /)\n"
+"--\n"
+"\n"
+"Returns the dictionary built. The builder can still be changed: the \n"
+"changes are applied to a copy of it.   ");
+
+static PyMethodDef frozendict_builder_methods[] = {
+    {"update", (PyCFunction)(void(*)(void)) frozendict_builder_update,
+     METH_VARARGS | METH_KEYWORDS, frozendict_builder_update_doc},
+    {"finish", (PyCFunction) frozendict_builder_finish, METH_NOARGS,
+     frozendict_builder_finish_doc},
+    {NULL, NULL}
+};
+
+static PyMappingMethods frozendict_builder_as_mapping = {
+    .mp_length = (lenfunc) frozendict_builder_length,
+    .mp_subscript = (binaryfunc) frozendict_builder_subscript,
+    .mp_ass_subscript = (objobjargproc) frozendict_builder_ass_sub,
+};
+
+static PySequenceMethods frozendict_builder_as_sequence = {
+    .sq_contains = (objobjproc) frozendict_builder_contains,
+};
+
+/* Moves */
+
+/* Returns 1 if the table of the dict d can be moved to a frozendict by
+ * frozendict_steal_dict(): d must be an exact dict, with a combined
+ * table that's not empty. The split tables are shared with other dicts,
+ * and the empty ones are shared by all the dicts. */
+
+static inline int frozendict_can_steal(PyObject* d) {
+    return (
+        PyDict_CheckExact(d)
+        && ((PyDictObject*) d)->ma_values == NULL
+        && ((PyDictObject*) d)->ma_used > 0
+    );
+}
+
+/* Returns a new, exact frozendict with the table of the dict d, and
+ * leaves d empty, see frozendict_can_steal(). The keys and the values
+ * are moved, so their references are not touched. The table is copied
+ * only to remove the holes left by the deletions, or to give the small
+ * layout to the frozendicts with few items. On errors, d is left
+ * untouched, unless the error comes from frozendict_compact(). */
+
+static PyObject* frozendict_steal_dict(PyDictObject* d) {
+    assert(frozendict_can_steal((PyObject*) d));
+
+    PyDictKeysObject* keys = d->ma_keys;
+    const Py_ssize_t used = d->ma_used;
+
+    assert(keys->dk_refcnt == 1);
+
+    // the table that d gets in place of keys. It's freed by
+    // PyDict_Clear(), that also changes the version of d
+    PyDictKeysObject* empty_keys = new_keys_object(PyDict_MINSIZE);
+
+    if (empty_keys == NULL) {
+        return NULL;
+    }
+
+    PyObject* self = frozendict_new_barebone(&PyFrozenDict_Type);
+
+    if (self == NULL) {
+        dictkeys_decref(empty_keys);
+        return NULL;
+    }
+
+    PyFrozenDictObject* mp = (PyFrozenDictObject*) self;
+    mp->ma_keys = keys;
+    mp->ma_used = used;
+
+    if (keys->dk_nentries != used) {
+        // on success, keys is freed
+        if (frozendict_resize((PyDictObject*) mp, estimate_keysize(used))) {
+            mp->ma_keys = NULL;
+            mp->ma_used = 0;
+            Py_DECREF(self);
+            dictkeys_decref(empty_keys);
+            return NULL;
+        }
+
+        mp->ma_keys->dk_lookup = lookdict_unicode_nodummy;
+        frozendict_check_appended_keys(self, 0);
+    }
+
+    d->ma_keys = empty_keys;
+    d->ma_used = 0;
+    PyDict_Clear((PyObject*) d);
+
+    if (_PyObject_GC_IS_TRACKED(d)) {
+        PyObject_GC_Track(self);
+    }
+
+    mp->ma_version_tag = DICT_NEXT_VERSION();
+    ASSERT_CONSISTENT(mp);
+
+    if (used <= FROZENDICT_SMALL_MAX_SIZE) {
+        return frozendict_compact(self);
+    }
+
+    // unlike frozendict_compact(), the room for other items is kept,
+    // since an exact copy of a big table costs as much as the copy of
+    // the dict that is avoided
+    return self;
+}
+
+static PyObject* frozendict_take(PyObject* type, PyObject* d) {
+    if (! PyDict_CheckExact(d)) {
+        PyErr_Format(
+            PyExc_TypeError,
+            "take() argument must be a dict, not %.200s",
+            Py_TYPE(d)->tp_name
+        );
+
+        return NULL;
+    }
+
+    PyObject* res;
+
+    if (frozendict_can_steal(d)) {
+        res = frozendict_steal_dict((PyDictObject*) d);
+    }
+    else {
+        res = PyObject_CallFunctionObjArgs(
+            (PyObject*) &PyFrozenDict_Type,
+            d,
+            NULL
+        );
+
+        if (res != NULL) {
+            PyDict_Clear(d);
+        }
+    }
+
+    if (res != NULL && type != (PyObject*) &PyFrozenDict_Type) {
+        PyObject* sub_res = PyObject_CallFunctionObjArgs(type, res, NULL);
+        Py_DECREF(res);
+        res = sub_res;
+    }
+
+    return res;
+}
+
+static PyObject* frozendict_intern(PyObject* type, PyObject* fd) {
+    if (! PyAnyFrozenDict_Check(fd)) {
+        PyErr_Format(
+            PyExc_TypeError,
+            "intern() argument must be a frozendict, not %.200s",
+            Py_TYPE(fd)->tp_name
+        );
+
+        return NULL;
+    }
+
+    return frozendict_intern_impl(fd);
+}
+
+/* Object snapshots */
+
+/* Returns a new exact frozendict with the items of the dict d. As
+ * frozendict(d), but without the parsing of the arguments. */
+
+static PyObject* frozendict_from_dict(PyObject* d) {
+    assert(PyAnyDict_Check(d));
+
+    PyObject* self = frozendict_new_barebone(&PyFrozenDict_Type);
+
+    if (self == NULL) {
+        return NULL;
+    }
+
+    PyFrozenDictObject* mp = (PyFrozenDictObject*) self;
+
+    if (frozendict_merge(self, d, 1) < 0) {
+        Py_DECREF(self);
+        return NULL;
+    }
+
+    PyObject* empty = frozendict_create_empty(mp, &PyFrozenDict_Type, 1);
+
+    if (empty != NULL) {
+        return empty;
+    }
+
+    self = frozendict_compact(self);
+
+    if (self == NULL) {
+        return NULL;
+    }
+
+    ((PyFrozenDictObject*) self)->ma_version_tag = DICT_NEXT_VERSION();
+
+    return self;
+}
+
+/* Returns a new exact frozendict with the items of the temporary dict d,
+ * moving its table if possible, see frozendict_steal_dict(). */
+
+static PyObject* frozendict_from_temporary_dict(PyObject* d) {
+    if (frozendict_can_steal(d)) {
+        return frozendict_steal_dict((PyDictObject*) d);
+    }
+
+    return frozendict_from_dict(d);
+}
+
+/* Returns the frozendict of the fields of the namedtuple o, or NULL
+ * without an exception if o is not a namedtuple. */
+
+static PyObject* frozendict_from_namedtuple(PyObject* o, int* error) {
+    _Py_IDENTIFIER(_fields);
+
+    PyObject* fields = _PyType_LookupId(Py_TYPE(o), &PyId__fields);
+    const Py_ssize_t size = PyTuple_GET_SIZE(o);
+
+    if (
+        fields == NULL
+        || ! PyTuple_Check(fields)
+        || PyTuple_GET_SIZE(fields) != size
+    ) {
+        return NULL;
+    }
+
+    PyObject* d = _PyDict_NewPresized(size);
+
+    if (d == NULL) {
+        *error = 1;
+        return NULL;
+    }
+
+    for (Py_ssize_t i = 0; i < size; i++) {
+        if (
+            PyDict_SetItem(
+                d,
+                PyTuple_GET_ITEM(fields, i),
+                PyTuple_GET_ITEM(o, i)
+            ) < 0
+        ) {
+            Py_DECREF(d);
+            *error = 1;
+            return NULL;
         }
+    }
 
-        new_i = i - deleted;
+    PyObject* res = frozendict_from_temporary_dict(d);
+    Py_DECREF(d);
 
-        old_entry = &old_entries[i];
-        hash = old_entry->me_hash;
-        key = old_entry->me_key;
-        value = old_entry->me_value;
-        Py_INCREF(key);
-        Py_INCREF(value);
-        hashpos = find_empty_slot(new_keys, hash);
-        dictkeys_set_index(new_keys, hashpos, new_i);
-        new_entry = &new_entries[new_i];
-        new_entry->me_key = key;
-        new_entry->me_hash = hash;
-        new_entry->me_value = value;
+    if (res == NULL) {
+        *error = 1;
     }
 
-    new_mp->ma_used = sizemm;
-    new_keys->dk_usable -= sizemm;
-    new_keys->dk_nentries = sizemm;
-
-    ASSERT_CONSISTENT(new_mp);
-    
-    return new_op;
+    return res;
 }
 
+/* Stores in the dict *d the values of the __slots__ of o that are set,
+ * from the base classes to the type of o. *d is created at the first
+ * value. The slots are read from the members of the classes created by
+ * Python, so no descriptor is called. Sets has_slots to 1 if a class
+ * defines __slots__. */
 
-static const PyObject* frozendict_key(
-    PyObject* self, 
-    PyObject *const *args, 
-    Py_ssize_t nargs
+static int frozendict_slots_update(
+    PyObject** d,
+    PyObject* o,
+    int* has_slots
 ) {
-    if (! _PyArg_CheckPositional("key", nargs, 0, 1)) {
-        return NULL;
+    _Py_IDENTIFIER(__slots__);
+
+    PyObject* slots_name = _PyUnicode_FromId(&PyId___slots__);
+
+    if (slots_name == NULL) {
+        return -1;
     }
 
-    Py_ssize_t index;
-    Py_ssize_t passed_index;
-    PyDictObject* d = (PyDictObject*) self;
-    const Py_ssize_t size = d->ma_used;
+    PyObject* mro = Py_TYPE(o)->tp_mro;
+    PyTypeObject* base;
+    PyMemberDef* member;
+    PyObject* key;
+    PyObject* value;
+    int err;
 
-    if (nargs > 0) {
-        index = PyLong_AsSsize_t(args[0]);
-        passed_index = index;
+    for (Py_ssize_t i = PyTuple_GET_SIZE(mro) - 1; i >= 0; i--) {
+        base = (PyTypeObject*) PyTuple_GET_ITEM(mro, i);
 
-        if (index < 0) {
+        if (! (base->tp_flags & Py_TPFLAGS_HEAPTYPE)) {
+            continue;
+        }
+
+        if (PyDict_GetItemWithError(base->tp_dict, slots_name) == NULL) {
             if (PyErr_Occurred()) {
-                return NULL;
+                return -1;
             }
 
-            index += size;
+            continue;
         }
-    }
-    else {
-        index = 0;
-        passed_index = index;
-    }
-
-    const Py_ssize_t maxindex = size - 1;
 
-    if (index > maxindex || index < 0) {
-        PyErr_Format(
-            PyExc_IndexError, 
-            "%s index %zd out of range %zd",
-            Py_TYPE(self)->tp_name,
-            passed_index,
-            maxindex
-        );
+        *has_slots = 1;
 
-        return NULL;
-    }
+        for (member = base->tp_members; member->name != NULL; member++) {
+            if (member->type != T_OBJECT_EX || (member->flags & READONLY)) {
+                continue;
+            }
 
-    const PyObject* res = DK_ENTRIES(d->ma_keys)[index].me_key;
-    Py_INCREF(res);
+            value = *(PyObject**) ((char*) o + member->offset);
 
-    return res;
-}
+            // an unset slot
+            if (value == NULL) {
+                continue;
+            }
 
-static const PyObject* frozendict_value(
-    PyObject* self, 
-    PyObject *const *args, 
-    Py_ssize_t nargs
-) {
-    if (! _PyArg_CheckPositional("value", nargs, 0, 1)) {
-        return NULL;
-    }
+            if (*d == NULL) {
+                *d = PyDict_New();
 
-    Py_ssize_t index;
-    Py_ssize_t passed_index;
-    PyDictObject* d = (PyDictObject*) self;
-    const Py_ssize_t size = d->ma_used;
+                if (*d == NULL) {
+                    return -1;
+                }
+            }
 
-    if (nargs > 0) {
-        index = PyLong_AsSsize_t(args[0]);
-        passed_index = index;
+            key = PyUnicode_FromString(member->name);
 
-        if (index < 0) {
-            if (PyErr_Occurred()) {
-                return NULL;
+            if (key == NULL) {
+                return -1;
             }
 
-            index += size;
+            PyUnicode_InternInPlace(&key);
+            err = PyDict_SetItem(*d, key, value);
+            Py_DECREF(key);
+
+            if (err < 0) {
+                return -1;
+            }
         }
     }
-    else {
-        index = 0;
-        passed_index = index;
+
+    return 0;
+}
+
+/* Returns a new exact frozendict with the state of the object o: the
+ * fields of a namedtuple, or the values of the __slots__ followed by the
+ * items of the __dict__. */
+
+static PyObject* frozendict_from_object_impl(PyObject* o) {
+    if (PyTuple_Check(o)) {
+        int error = 0;
+        PyObject* res = frozendict_from_namedtuple(o, &error);
+
+        if (res != NULL || error) {
+            return res;
+        }
     }
 
-    const Py_ssize_t maxindex = size - 1;
+    PyObject** dictptr = _PyObject_GetDictPtr(o);
+    PyObject* dict = dictptr == NULL ? NULL : *dictptr;
+    PyObject* d = NULL;
+    int has_slots = 0;
 
-    if (index > maxindex || index < 0) {
+    if (frozendict_slots_update(&d, o, &has_slots) < 0) {
+        Py_XDECREF(d);
+        return NULL;
+    }
+
+    if (! has_slots && dictptr == NULL) {
         PyErr_Format(
-            PyExc_IndexError, 
-            "%s index %zd out of range %zd",
-            Py_TYPE(self)->tp_name,
-            passed_index,
-            maxindex
+            PyExc_TypeError,
+            "from_object() argument must have a __dict__, __slots__ or "
+            "_fields, not %.200s",
+            Py_TYPE(o)->tp_name
         );
 
         return NULL;
     }
 
-    const PyObject* res = DK_ENTRIES(d->ma_keys)[index].me_value;
-    Py_INCREF(res);
+    if (d == NULL) {
+        if (dict != NULL) {
+            // only the __dict__: its table is copied as it is, see
+            // frozendict_merge()
+            return frozendict_from_dict(dict);
+        }
+
+        d = PyDict_New();
+
+        if (d == NULL) {
+            return NULL;
+        }
+    }
+
+    PyObject* res = NULL;
+
+    if (dict == NULL || PyDict_Update(d, dict) == 0) {
+        res = frozendict_from_temporary_dict(d);
+    }
+
+    Py_DECREF(d);
 
     return res;
 }
 
-static const PyObject* frozendict_item(
-    PyObject* self, 
-    PyObject *const *args, 
-    Py_ssize_t nargs
-) {
-    if (! _PyArg_CheckPositional("item", nargs, 0, 1)) {
-        return NULL;
+static PyObject* frozendict_from_object(PyObject* type, PyObject* o) {
+    PyObject* res = frozendict_from_object_impl(o);
+
+    if (res != NULL && type != (PyObject*) &PyFrozenDict_Type) {
+        PyObject* sub_res = PyObject_CallFunctionObjArgs(type, res, NULL);
+        Py_DECREF(res);
+        res = sub_res;
     }
 
-    Py_ssize_t index;
-    Py_ssize_t passed_index;
-    PyDictObject* d = (PyDictObject*) self;
-    const Py_ssize_t size = d->ma_used;
+    return res;
+}
 
-    if (nargs > 0) {
-        index = PyLong_AsSsize_t(args[0]);
-        passed_index = index;
+/* Keys frozenset */
 
-        if (index < 0) {
-            if (PyErr_Occurred()) {
-                return NULL;
-            }
+/* Returns a new set, or a frozenset if frozen is true, with the keys of
+ * the frozendict mp. CPython fills a set from an exact dict with the
+ * hashes stored in its table, so the set is filled from a copy of the
+ * header of mp typed as dict. The copy lives only during the call, and
+ * it's only iterated. */
 
-            index += size;
-        }
-    }
-    else {
-        index = 0;
-        passed_index = index;
+static PyObject* frozendict_keys_set_new(PyObject* mp, const int frozen) {
+    PyFrozenDictObject header = *((PyFrozenDictObject*) mp);
+    header.ob_base.ob_type = &PyDict_Type;
+
+    if (frozen) {
+        return PyFrozenSet_New((PyObject*) &header);
     }
 
-    const Py_ssize_t maxindex = size - 1;
+    return PySet_New((PyObject*) &header);
+}
 
-    if (index > maxindex || index < 0) {
-        PyErr_Format(
-            PyExc_IndexError, 
-            "%s index %zd out of range %zd",
-            Py_TYPE(self)->tp_name,
-            passed_index,
-            maxindex
-        );
+static PyObject* frozendict_keys_frozenset(
+    PyObject* self,
+    PyObject* Py_UNUSED(ignored)
+) {
+    PyFrozenDictObject* mp = (PyFrozenDictObject*) self;
 
-        return NULL;
-    }
+    if (mp->ma_keys_set == NULL) {
+        PyObject* keys_set = frozendict_keys_set_new(self, 1);
 
-    PyObject* key = DK_ENTRIES(d->ma_keys)[index].me_key;
-    Py_INCREF(key);
-    PyObject* val = DK_ENTRIES(d->ma_keys)[index].me_value;
-    Py_INCREF(val);
+        if (keys_set == NULL) {
+            return NULL;
+        }
 
-    const PyObject* res = PyTuple_New(2);
-    PyTuple_SET_ITEM(res, 0, key);
-    PyTuple_SET_ITEM(res, 1, val);
+        // the __eq__ of the keys could have cached another frozenset
+        if (mp->ma_keys_set == NULL) {
+            mp->ma_keys_set = keys_set;
+        }
+        else {
+            Py_DECREF(keys_set);
+        }
+    }
 
-    return res;
+    Py_INCREF(mp->ma_keys_set);
+    return mp->ma_keys_set;
 }
 
 PyDoc_STRVAR(frozendict_set_doc,
@@ -1346,6 +4688,141 @@ PyDoc_STRVAR(frozendict_delete_doc,
 "\n"
 "Returns a copy of the dictionary without the item of the corresponding key.   ");
 
+PyDoc_STRVAR(frozendict_set_many_doc,
+"set_many($self, mapping_or_pairs, /)\n"
+"--\n"
+"\n"
+"Returns a copy of the dictionary with the items of the mapping or of the \n"
+"iterable of (key, value) pairs. The dictionary is copied only once.   ");
+
+PyDoc_STRVAR(frozendict_delete_many_doc,
+"delete_many($self, keys, /)\n"
+"--\n"
+"\n"
+"Returns a copy of the dictionary without the items of the corresponding \n"
+"keys. The dictionary is copied only once.   ");
+
+PyDoc_STRVAR(frozendict_update_doc,
+"update($self[, mapping_or_pairs], /, **kwargs)\n"
+"--\n"
+"\n"
+"Returns a copy of the dictionary updated as dict.update() does. The \n"
+"dictionary is copied only once.   ");
+
+PyDoc_STRVAR(frozendict_union_doc,
+"union($self, *others)\n"
+"--\n"
+"\n"
+"Returns a copy of the dictionary updated with the mappings or the \n"
+"iterables of (key, value) pairs, as | does.   ");
+
+PyDoc_STRVAR(frozendict_intersection_doc,
+"intersection($self, *others)\n"
+"--\n"
+"\n"
+"Returns a copy of the dictionary with only the items whose keys are in \n"
+"all the others, that can be mappings or iterables of keys.   ");
+
+PyDoc_STRVAR(frozendict_difference_doc,
+"difference($self, *others)\n"
+"--\n"
+"\n"
+"Returns a copy of the dictionary without the items whose keys are in \n"
+"the others, that can be mappings or iterables of keys.   ");
+
+PyDoc_STRVAR(frozendict_symmetric_difference_doc,
+"symmetric_difference($self, other, /)\n"
+"--\n"
+"\n"
+"Returns the items of the dictionary whose keys are not in other, \n"
+"followed by the items of other whose keys are not in the dictionary.   ");
+
+PyDoc_STRVAR(frozendict_issubset_doc,
+"issubset($self, other, /)\n"
+"--\n"
+"\n"
+"Returns True if every item of the dictionary is also an item of \n"
+"other.   ");
+
+PyDoc_STRVAR(frozendict_issuperset_doc,
+"issuperset($self, other, /)\n"
+"--\n"
+"\n"
+"Returns True if every item of other is also an item of the \n"
+"dictionary.   ");
+
+PyDoc_STRVAR(frozendict_keys_frozenset_doc,
+"keys_frozenset($self, /)\n"
+"--\n"
+"\n"
+"Returns a frozenset with the keys of the dictionary. The frozenset is \n"
+"built once and cached.   ");
+
+PyDoc_STRVAR(frozendict_optimize_doc,
+"optimize($self, /, *, index='perfect')\n"
+"--\n"
+"\n"
+"Builds an index of the keys for faster lookups and returns the \n"
+"dictionary itself. If index is 'perfect', it builds a minimal perfect \n"
+"hash, so every lookup is a single probe. If index is 'groups', or the \n"
+"keys have not all different hashes, it builds a table probed 16 slots \n"
+"at a time, that touches the items only when 7 bits of their hash \n"
+"match. If the dictionary is already optimized, it's returned \n"
+"unchanged.   ");
+
+PyDoc_STRVAR(frozendict_schema_doc,
+"schema(keys, /)\n"
+"--\n"
+"\n"
+"Returns a callable that creates dictionaries with the keys, in order, \n"
+"from an iterable of as many values. The dictionaries created share the \n"
+"keys, so they store only their values.   ");
+
+PyDoc_STRVAR(frozendict_to_dict_doc,
+"to_dict($self, /, *, deep=False)\n"
+"--\n"
+"\n"
+"Returns a new dict with the items of the dictionary. If deep is true, \n"
+"the values that are frozendicts are converted too, recursively.   ");
+
+PyDoc_STRVAR(frozendict_take_doc,
+"take($type, d, /)\n"
+"--\n"
+"\n"
+"Returns a new dictionary with the items of the dict d, and leaves d \n"
+"empty. The items are moved, not copied, if d has its own table.   ");
+
+PyDoc_STRVAR(frozendict_intern_doc,
+"intern($type, fd, /)\n"
+"--\n"
+"\n"
+"Returns the canonical frozendict equal to fd, that is fd itself if \n"
+"no equal frozendict was interned before and is still alive.   ");
+
+PyDoc_STRVAR(frozendict_from_object_doc,
+"from_object($type, o, /)\n"
+"--\n"
+"\n"
+"Returns a new dictionary with the state of the object o: the fields \n"
+"of a namedtuple, or the values of the __slots__ that are set, \n"
+"followed by the items of the __dict__.   ");
+
+PyDoc_STRVAR(frozendict_builder_doc,
+"builder($type, /, *, reserve=0)\n"
+"--\n"
+"\n"
+"Returns a builder of a new dictionary, with room for reserve items. \n"
+"The builder supports item assignment, deletion and update(), and \n"
+"finish() returns the dictionary built.   ");
+
+PyDoc_STRVAR(frozendict_evolver_doc,
+"evolver($self, /)\n"
+"--\n"
+"\n"
+"Returns a builder that starts from the dictionary. The dictionary is \n"
+"copied only at the first change, so if nothing changed finish() \n"
+"returns the dictionary itself.   ");
+
 PyDoc_STRVAR(frozendict_key_doc,
 "key($self[, index], /)\n"
 "--\n"
@@ -1374,7 +4851,7 @@ static PyMethodDef frozendict_mapp_methods[] = {
     DICT___CONTAINS___METHODDEF
     {"__getitem__", (PyCFunction)(void(*)(void))dict_subscript,        METH_O | METH_COEXIST,
      getitem__doc__},
-    {"__sizeof__",      (PyCFunction)(void(*)(void))dict_sizeof,       METH_NOARGS,
+    {"__sizeof__",      (PyCFunction)frozendict_sizeof, METH_NOARGS,
      sizeof__doc__},
     DICT_GET_METHODDEF
     {"keys",            frozendictkeys_new,             METH_NOARGS,
@@ -1385,6 +4862,22 @@ static PyMethodDef frozendict_mapp_methods[] = {
     values__doc__},
     {"fromkeys",        (PyCFunction)(void(*)(void))dict_fromkeys, METH_FASTCALL|METH_CLASS, 
     dict_fromkeys__doc__},
+    {"schema",          frozendict_schema,              METH_O|METH_CLASS,
+    frozendict_schema_doc},
+    {"take",            frozendict_take,                METH_O|METH_CLASS,
+    frozendict_take_doc},
+    {"intern",          frozendict_intern,              METH_O|METH_CLASS,
+    frozendict_intern_doc},
+    {"from_object",     frozendict_from_object,         METH_O|METH_CLASS,
+    frozendict_from_object_doc},
+    {"builder",         (PyCFunction)(void(*)(void))frozendict_builder,
+                        METH_VARARGS|METH_KEYWORDS|METH_CLASS,
+    frozendict_builder_doc},
+    {"evolver",         frozendict_evolver,             METH_NOARGS,
+    frozendict_evolver_doc},
+    {"to_dict",         (PyCFunction)(void(*)(void))frozendict_to_dict,
+                        METH_VARARGS|METH_KEYWORDS,
+    frozendict_to_dict_doc},
     {"copy",            (PyCFunction)frozendict_copy,   METH_NOARGS,
      copy__doc__},
     {"__copy__",        (PyCFunction)frozendict_copy,   METH_NOARGS,
@@ -1403,6 +4896,39 @@ static PyMethodDef frozendict_mapp_methods[] = {
     {"delete",          (PyCFunction)(void(*)(void))
                         frozendict_delete,              METH_FASTCALL,
     frozendict_delete_doc},
+    {"set_many",        (PyCFunction)
+                        frozendict_set_many,            METH_O,
+    frozendict_set_many_doc},
+    {"delete_many",     (PyCFunction)
+                        frozendict_delete_many,         METH_O,
+    frozendict_delete_many_doc},
+    {"update",          (PyCFunction)(void(*)(void))
+                        frozendict_update,              METH_VARARGS | METH_KEYWORDS,
+    frozendict_update_doc},
+    {"keys_frozenset",  (PyCFunction)
+                        frozendict_keys_frozenset,      METH_NOARGS,
+    frozendict_keys_frozenset_doc},
+    {"union",           (PyCFunction)
+                        frozendict_union,               METH_VARARGS,
+    frozendict_union_doc},
+    {"intersection",    (PyCFunction)
+                        frozendict_intersection,        METH_VARARGS,
+    frozendict_intersection_doc},
+    {"difference",      (PyCFunction)
+                        frozendict_difference,          METH_VARARGS,
+    frozendict_difference_doc},
+    {"symmetric_difference", (PyCFunction)
+                        frozendict_symmetric_difference, METH_O,
+    frozendict_symmetric_difference_doc},
+    {"issubset",        (PyCFunction)
+                        frozendict_issubset,            METH_O,
+    frozendict_issubset_doc},
+    {"issuperset",      (PyCFunction)
+                        frozendict_issuperset,          METH_O,
+    frozendict_issuperset_doc},
+    {"optimize",        (PyCFunction)(void(*)(void))
+                        frozendict_optimize,            METH_VARARGS | METH_KEYWORDS,
+    frozendict_optimize_doc},
     {"key",             (PyCFunction)(void(*)(void))
                         frozendict_key,                 METH_FASTCALL,
     frozendict_key_doc},
@@ -1534,16 +5060,22 @@ static PyObject* frozendict_vectorcall(PyObject* type,
     }
 
     if (kwnames != NULL) {
-        if (mp->ma_keys == NULL) {
-            mp->ma_keys = new_keys_object(PyDict_MINSIZE);
-        }
-
         size = (
             kwnames == NULL
             ? 0
             : PyTuple_GET_SIZE(kwnames)
         );
 
+        if (mp->ma_keys == NULL) {
+            // the keyword arguments have no duplicates
+            mp->ma_keys = frozendict_new_keys_fit(size);
+
+            if (mp->ma_keys == NULL) {
+                Py_DECREF(self);
+                return NULL;
+            }
+        }
+
         if (mp->ma_keys->dk_usable < size) {
             if (frozendict_resize((PyDictObject*) self, estimate_keysize(mp->ma_used + size))) {
                return NULL;
@@ -1564,6 +5096,14 @@ static PyObject* frozendict_vectorcall(PyObject* type,
         return self_empty;
     }
     
+    self = frozendict_compact(self);
+
+    if (self == NULL) {
+        return NULL;
+    }
+
+    mp = (PyFrozenDictObject*) self;
+    
     mp->ma_version_tag = DICT_NEXT_VERSION();
     
     ASSERT_CONSISTENT(mp);
@@ -1613,6 +5153,14 @@ static PyObject* _frozendict_new(
         return empty;
     }
     
+    self = frozendict_compact(self);
+
+    if (self == NULL) {
+        return NULL;
+    }
+
+    mp = (PyFrozenDictObject*) self;
+    
     mp->ma_version_tag = DICT_NEXT_VERSION();
     
     return self;
@@ -1627,7 +5175,23 @@ static PyObject* frozendict_or(PyObject *self, PyObject *other) {
         Py_RETURN_NOTIMPLEMENTED;
     }
 
-    PyObject* new = frozendict_clone(self);
+    PyObject* new;
+
+    if (PyAnyDict_CheckExact(other)) {
+        // if all the keys are in self, only the values are copied
+        new = frozendict_split_update((PyFrozenDictObject*) self, other);
+
+        if (new != NULL) {
+            frozendict_derive_hash_merge(self, new, other);
+            return new;
+        }
+
+        if (PyErr_Occurred()) {
+            return NULL;
+        }
+    }
+
+    new = frozendict_clone(self);
 
     if (new == NULL) {
         return NULL;
@@ -1638,13 +5202,105 @@ static PyObject* frozendict_or(PyObject *self, PyObject *other) {
         return NULL;
     }
 
+    if (PyAnyDict_CheckExact(other)) {
+        frozendict_derive_hash_merge(self, new, other);
+    }
+
     return new;
 }
 
+static PyObject* frozendict_and(PyObject *self, PyObject *other) {
+    if (
+        ! PyAnyFrozenDict_Check(self) || 
+        ! (
+            PyAnyDict_Check(other) ||
+            PyAnySet_Check(other) ||
+            PyAnyDictKeys_Check(other)
+        )
+    ) {
+        Py_RETURN_NOTIMPLEMENTED;
+    }
+
+    return frozendict_filter_keys(self, other, 1);
+}
+
+static PyObject* frozendict_sub(PyObject *self, PyObject *other) {
+    if (
+        ! PyAnyFrozenDict_Check(self) || 
+        ! (
+            PyAnyDict_Check(other) ||
+            PyAnySet_Check(other) ||
+            PyAnyDictKeys_Check(other)
+        )
+    ) {
+        Py_RETURN_NOTIMPLEMENTED;
+    }
+
+    return frozendict_filter_keys(self, other, 0);
+}
+
+static PyObject* frozendict_xor(PyObject *self, PyObject *other) {
+    if (! PyAnyFrozenDict_Check(self) || ! PyAnyDict_Check(other)) {
+        Py_RETURN_NOTIMPLEMENTED;
+    }
+
+    return frozendict_symmetric_difference_dict(self, other);
+}
+
 static PyNumberMethods frozendict_as_number = {
+    .nb_subtract = frozendict_sub,
+    .nb_and = frozendict_and,
+    .nb_xor = frozendict_xor,
     .nb_or = frozendict_or,
 };
 
+static PyObject* frozendict_richcompare(
+    PyObject* self,
+    PyObject* other,
+    int op
+) {
+    if (op == Py_EQ || op == Py_NE || ! PyAnyDict_Check(other)) {
+        return dict_richcompare(self, other, op);
+    }
+
+    return frozendict_compare_items(self, other, op);
+}
+
+/* Unlike dict_traverse() of CPython, it visits the keys of all the
+ * tables but the ones with only str keys, since the small, split and
+ * optimized frozendicts have their own lookups, whatever the type of
+ * the keys. */
+
+static int frozendict_traverse(PyObject* op, visitproc visit, void* arg) {
+    PyDictObject* mp = (PyDictObject*) op;
+    PyDictKeysObject* keys = mp->ma_keys;
+
+    Py_VISIT(((PyFrozenDictObject*) op)->ma_keys_set);
+
+    if (keys == NULL) {
+        return 0;
+    }
+
+    // a shared table is visited only by its last owner, or the GC would
+    // count its references to the keys more than once
+    const int visit_keys = (
+        keys->dk_refcnt == 1
+        && keys->dk_lookup != lookdict_unicode_nodummy
+    );
+
+    PyDictKeyEntry* entries = DK_ENTRIES(keys);
+
+    for (Py_ssize_t i = 0; i < keys->dk_nentries; i++) {
+        Py_VISIT(frozendict_entry_value(mp, i));
+
+        if (visit_keys) {
+            Py_VISIT(entries[i].me_key);
+        }
+    }
+
+    return 0;
+}
+
 #define FROZENDICT_CLASS_NAME "frozendict"
 #define FROZENDICT_MODULE_NAME "frozendict"
 #define FROZENDICT_FULL_NAME FROZENDICT_MODULE_NAME "." FROZENDICT_CLASS_NAME
@@ -1670,7 +5326,7 @@ static PyTypeObject PyFrozenDict_Type = {
     FROZENDICT_FULL_NAME,                       /* tp_name */
     sizeof(PyFrozenDictObject),                 /* tp_basicsize */
     0,                                          /* tp_itemsize */
-    (destructor)dict_dealloc,                   /* tp_dealloc */
+    (destructor)frozendict_dealloc,             /* tp_dealloc */
     0,                                          /* tp_vectorcall_offset */
     0,                                          /* tp_getattr */
     0,                                          /* tp_setattr */
@@ -1688,10 +5344,10 @@ static PyTypeObject PyFrozenDict_Type = {
     Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC
         | Py_TPFLAGS_BASETYPE,                  /* tp_flags */
     frozendict_doc,                             /* tp_doc */
-    dict_traverse,                              /* tp_traverse */
+    frozendict_traverse,                        /* tp_traverse */
     0,                                          /* tp_clear */
-    dict_richcompare,                     /* tp_richcompare */
-    0,                                          /* tp_weaklistoffset */
+    frozendict_richcompare,               /* tp_richcompare */
+    offsetof(PyFrozenDictObject, ma_weakreflist), /* tp_weaklistoffset */
     (getiterfunc)frozendict_iter,               /* tp_iter */
     0,                                          /* tp_iternext */
     frozendict_mapp_methods,                    /* tp_methods */
@@ -1790,7 +5446,7 @@ static PyObject* frozendictiter_iternextvalue(dictiterobject* di) {
         return NULL;
     }
 
-    PyObject* val = DK_ENTRIES(d->ma_keys)[pos].me_value;
+    PyObject* val = frozendict_entry_value(d, pos);
     assert(val != NULL);
     di->di_pos++;
     di->len--;
@@ -1850,7 +5506,7 @@ static PyObject* frozendictiter_iternextitem(dictiterobject* di) {
 
     PyDictKeyEntry* entry_ptr = &DK_ENTRIES(d->ma_keys)[pos];
     PyObject* key = entry_ptr->me_key;
-    PyObject* val = entry_ptr->me_value;
+    PyObject* val = frozendict_entry_value(d, pos);
     assert(key != NULL);
     assert(val != NULL);
     di->di_pos++;
@@ -1915,6 +5571,346 @@ static PyTypeObject PyFrozenDictIterItem_Type = {
     0,
 };
 
+/*** set operations of keys and items ***/
+
+/* Returns a new set with the keys of the view. If the view is a keys
+ * view of a frozendict, the stored hashes or the cached keys frozenset
+ * are used. */
+
+static PyObject* frozendictviews_to_set(PyObject* view) {
+    if (! PyObject_TypeCheck(view, &PyFrozenDictKeys_Type)) {
+        return dictviews_to_set(view);
+    }
+
+    PyFrozenDictObject* mp = (PyFrozenDictObject*) (
+        ((_PyDictViewObject*) view)->dv_dict
+    );
+
+    if (mp->ma_keys_set != NULL) {
+        return PySet_New(mp->ma_keys_set);
+    }
+
+    return frozendict_keys_set_new((PyObject*) mp, 0);
+}
+
+/* Returns a new reference to the operand of a set method: a frozenset
+ * with the keys, if op is a keys view of a frozendict, or op itself. */
+
+static PyObject* frozendictviews_operand(PyObject* op) {
+    if (! PyObject_TypeCheck(op, &PyFrozenDictKeys_Type)) {
+        Py_INCREF(op);
+        return op;
+    }
+
+    PyFrozenDictObject* mp = (PyFrozenDictObject*) (
+        ((_PyDictViewObject*) op)->dv_dict
+    );
+
+    if (mp->ma_keys_set != NULL) {
+        Py_INCREF(mp->ma_keys_set);
+        return mp->ma_keys_set;
+    }
+
+    return frozendict_keys_set_new((PyObject*) mp, 1);
+}
+
+/* Returns 1 if self is a keys view of a frozendict and other is not an
+ * items view, so the keys of self can be used directly. An items view as
+ * self or other is left to the dict implementation, since its items can
+ * be unhashable. */
+
+static int frozendictkeys_check_fast(PyObject* self, PyObject* other) {
+    return (
+        PyObject_TypeCheck(self, &PyFrozenDictKeys_Type) &&
+        ! PyAnyDictItems_Check(other)
+    );
+}
+
+/* Returns a set with the keys of self, a keys view of a frozendict,
+ * updated by the set method with other. */
+
+static PyObject* frozendictkeys_set_op(
+    PyObject* self,
+    PyObject* other,
+    _Py_Identifier* method
+) {
+    PyObject* result = frozendictviews_to_set(self);
+
+    if (result == NULL) {
+        return NULL;
+    }
+
+    PyObject* operand = frozendictviews_operand(other);
+
+    if (operand == NULL) {
+        Py_DECREF(result);
+        return NULL;
+    }
+
+    PyObject* tmp = _PyObject_CallMethodIdObjArgs(
+        result,
+        method,
+        operand,
+        NULL
+    );
+    Py_DECREF(operand);
+
+    if (tmp == NULL) {
+        Py_DECREF(result);
+        return NULL;
+    }
+
+    Py_DECREF(tmp);
+    return result;
+}
+
+/* Adds to result the items of the dict or frozendict a that are also
+ * items of b, if contained is true, or the ones that are not, if it's
+ * false. The keys are looked up in b with their stored hash. Returns -1
+ * on error. */
+
+static int frozendictitems_add_filtered(
+    PyObject* result,
+    PyObject* a,
+    PyObject* b,
+    const int contained
+) {
+    Py_ssize_t pos = 0;
+    PyObject* key;
+    PyObject* value;
+    PyObject* item;
+    Py_hash_t hash;
+    int cmp;
+
+    while (_d_PyDict_Next(a, &pos, &key, &value, &hash)) {
+        // a can be a dict changed by the __eq__ of the keys
+        Py_INCREF(key);
+        Py_INCREF(value);
+        cmp = frozendict_has_item(b, key, hash, value);
+        item = NULL;
+
+        if (cmp == contained) {
+            item = PyTuple_Pack(2, key, value);
+        }
+
+        Py_DECREF(key);
+        Py_DECREF(value);
+
+        if (cmp < 0) {
+            return -1;
+        }
+
+        if (cmp != contained) {
+            continue;
+        }
+
+        if (item == NULL) {
+            return -1;
+        }
+
+        cmp = PySet_Add(result, item);
+        Py_DECREF(item);
+
+        if (cmp < 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* Returns 1 if self and other are items views and one of them is a view
+ * of a frozendict, so they can be walked directly. */
+
+static int frozendictitems_check_pair(PyObject* self, PyObject* other) {
+    return (
+        PyAnyDictItems_Check(self) &&
+        PyAnyDictItems_Check(other) && (
+            PyObject_TypeCheck(self, &PyFrozenDictItems_Type) ||
+            PyObject_TypeCheck(other, &PyFrozenDictItems_Type)
+        )
+    );
+}
+
+/* Returns a new set with the items of self that are, if op is '&', or
+ * are not, if op is '-', items of other. If op is '^', the items of
+ * other that are not in self are added too. */
+
+static PyObject* frozendictitems_set_op(
+    PyObject* self,
+    PyObject* other,
+    const char op
+) {
+    PyObject* a = (PyObject*) ((_PyDictViewObject*) self)->dv_dict;
+    PyObject* b = (PyObject*) ((_PyDictViewObject*) other)->dv_dict;
+    PyObject* result = PySet_New(NULL);
+
+    if (result == NULL) {
+        return NULL;
+    }
+
+    int res;
+
+    if (op == '&') {
+        // the smaller one is walked
+        if (((PyDictObject*) a)->ma_used > ((PyDictObject*) b)->ma_used) {
+            res = frozendictitems_add_filtered(result, b, a, 1);
+        }
+        else {
+            res = frozendictitems_add_filtered(result, a, b, 1);
+        }
+    }
+    else {
+        res = frozendictitems_add_filtered(result, a, b, 0);
+
+        if (res == 0 && op == '^') {
+            res = frozendictitems_add_filtered(result, b, a, 0);
+        }
+    }
+
+    if (res < 0) {
+        Py_DECREF(result);
+        return NULL;
+    }
+
+    return result;
+}
+
+static PyObject* frozendictviews_sub(PyObject* self, PyObject* other) {
+    if (frozendictitems_check_pair(self, other)) {
+        return frozendictitems_set_op(self, other, '-');
+    }
+
+    if (frozendictkeys_check_fast(self, other)) {
+        _Py_IDENTIFIER(difference_update);
+
+        return frozendictkeys_set_op(self, other, &PyId_difference_update);
+    }
+
+    return dictviews_sub(self, other);
+}
+
+static PyObject* frozendictviews_and(PyObject* self, PyObject* other) {
+    if (frozendictitems_check_pair(self, other)) {
+        return frozendictitems_set_op(self, other, '&');
+    }
+
+    if (frozendictkeys_check_fast(self, other)) {
+        _Py_IDENTIFIER(intersection_update);
+
+        return frozendictkeys_set_op(self, other, &PyId_intersection_update);
+    }
+
+    return _d_PyDictView_Intersect(self, other);
+}
+
+static PyObject* frozendictviews_xor(PyObject* self, PyObject* other) {
+    if (frozendictitems_check_pair(self, other)) {
+        return frozendictitems_set_op(self, other, '^');
+    }
+
+    if (frozendictkeys_check_fast(self, other)) {
+        _Py_IDENTIFIER(symmetric_difference_update);
+
+        return frozendictkeys_set_op(
+            self,
+            other,
+            &PyId_symmetric_difference_update
+        );
+    }
+
+    return dictviews_xor(self, other);
+}
+
+static PyObject* frozendictviews_or(PyObject* self, PyObject* other) {
+    if (frozendictkeys_check_fast(self, other)) {
+        _Py_IDENTIFIER(update);
+
+        return frozendictkeys_set_op(self, other, &PyId_update);
+    }
+
+    return dictviews_or(self, other);
+}
+
+static PyNumberMethods frozendictviews_as_number = {
+    .nb_subtract = frozendictviews_sub,
+    .nb_and = frozendictviews_and,
+    .nb_xor = frozendictviews_xor,
+    .nb_or = frozendictviews_or,
+};
+
+/* Compares the keys or the items of two views walking the tables, or
+ * the keys of a view of a frozendict with a set using the cached keys
+ * frozenset. */
+
+static PyObject* frozendictview_richcompare(
+    PyObject* self,
+    PyObject* other,
+    int op
+) {
+    const int only_keys = PyAnyDictKeys_Check(self);
+
+    if (
+        only_keys
+            ? ! PyAnyDictKeys_Check(other)
+            : ! PyAnyDictItems_Check(other)
+    ) {
+        if (! only_keys || ! PyAnySet_Check(other)) {
+            return dictview_richcompare(self, other, op);
+        }
+
+        PyObject* keys_set = frozendict_keys_frozenset(
+            (PyObject*) ((_PyDictViewObject*) self)->dv_dict,
+            NULL
+        );
+
+        if (keys_set == NULL) {
+            return NULL;
+        }
+
+        PyObject* res = PyObject_RichCompare(keys_set, other, op);
+        Py_DECREF(keys_set);
+
+        return res;
+    }
+
+    PyObject* a = (PyObject*) ((_PyDictViewObject*) self)->dv_dict;
+    PyObject* b = (PyObject*) ((_PyDictViewObject*) other)->dv_dict;
+
+    if (op == Py_GE || op == Py_GT) {
+        PyObject* tmp = a;
+        a = b;
+        b = tmp;
+    }
+
+    const Py_ssize_t len_a = ((PyDictObject*) a)->ma_used;
+    const Py_ssize_t len_b = ((PyDictObject*) b)->ma_used;
+    int cmp;
+
+    switch (op) {
+        case Py_EQ:
+        case Py_NE:
+            cmp = len_a == len_b;
+            break;
+        case Py_LT:
+        case Py_GT:
+            cmp = len_a < len_b;
+            break;
+        default:
+            cmp = 1;
+    }
+
+    if (cmp) {
+        cmp = frozendict_submapping(a, b, only_keys);
+
+        if (cmp < 0) {
+            return NULL;
+        }
+    }
+
+    return PyBool_FromLong(op == Py_NE ? ! cmp : cmp);
+}
+
 /*** dict_keys ***/
 
 static PyObject *
@@ -1938,7 +5934,7 @@ static PyTypeObject PyFrozenDictKeys_Type = {
     0,                                          /* tp_setattr */
     0,                                          /* tp_as_async */
     (reprfunc)dictview_repr,                    /* tp_repr */
-    &dictviews_as_number,                       /* tp_as_number */
+    &frozendictviews_as_number,                 /* tp_as_number */
     &dictkeys_as_sequence,                      /* tp_as_sequence */
     0,                                          /* tp_as_mapping */
     0,                                          /* tp_hash */
@@ -1951,7 +5947,7 @@ static PyTypeObject PyFrozenDictKeys_Type = {
     0,                                          /* tp_doc */
     (traverseproc)dictview_traverse,            /* tp_traverse */
     0,                                          /* tp_clear */
-    dictview_richcompare,                       /* tp_richcompare */
+    frozendictview_richcompare,                 /* tp_richcompare */
     0,                                          /* tp_weaklistoffset */
     (getiterfunc)frozendictkeys_iter,                 /* tp_iter */
     0,                                          /* tp_iternext */
@@ -1988,7 +5984,7 @@ static PyTypeObject PyFrozenDictItems_Type = {
     0,                                          /* tp_setattr */
     0,                                          /* tp_as_async */
     (reprfunc)dictview_repr,                    /* tp_repr */
-    &dictviews_as_number,                       /* tp_as_number */
+    &frozendictviews_as_number,                 /* tp_as_number */
     &dictitems_as_sequence,                     /* tp_as_sequence */
     0,                                          /* tp_as_mapping */
     0,                                          /* tp_hash */
@@ -2001,7 +5997,7 @@ static PyTypeObject PyFrozenDictItems_Type = {
     0,                                          /* tp_doc */
     (traverseproc)dictview_traverse,            /* tp_traverse */
     0,                                          /* tp_clear */
-    dictview_richcompare,                       /* tp_richcompare */
+    frozendictview_richcompare,                 /* tp_richcompare */
     0,                                          /* tp_weaklistoffset */
     (getiterfunc)frozendictitems_iter,          /* tp_iter */
     0,                                          /* tp_iternext */
@@ -2065,6 +6061,52 @@ frozendictvalues_new(PyObject *dict, PyObject *Py_UNUSED(ignored))
     return _d_PyDictView_New(dict, &PyFrozenDictValues_Type);
 }
 
+PyDoc_STRVAR(frozendict_schema_type_doc,
+"Creates dictionaries with the keys of the schema, in order, and the \n"
+"values of the iterable passed. The dictionaries share the keys, so they \n"
+"store only their values.   ");
+
+static PyTypeObject PyFrozenDictSchema_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = FROZENDICT_MODULE_NAME ".schema",
+    .tp_basicsize = sizeof(PyFrozenDictSchemaObject),
+    .tp_dealloc = (destructor) frozendict_schema_dealloc,
+    .tp_repr = (reprfunc) frozendict_schema_repr,
+    .tp_call = (ternaryfunc) frozendict_schema_call,
+    .tp_getattro = PyObject_GenericGetAttr,
+    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,
+    .tp_doc = frozendict_schema_type_doc,
+    .tp_traverse = (traverseproc) frozendict_schema_traverse,
+    .tp_clear = (inquiry) frozendict_schema_clear,
+    .tp_getset = frozendict_schema_getset,
+};
+
+PyDoc_STRVAR(frozendict_builder_type_doc,
+"Builds a dictionary in place, without intermediate dicts. finish() \n"
+"returns the dictionary built.   ");
+
+static PyTypeObject PyFrozenDictBuilder_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = FROZENDICT_MODULE_NAME ".builder",
+    .tp_basicsize = sizeof(PyFrozenDictBuilderObject),
+    .tp_dealloc = (destructor) frozendict_builder_dealloc,
+    .tp_as_sequence = &frozendict_builder_as_sequence,
+    .tp_as_mapping = &frozendict_builder_as_mapping,
+    .tp_hash = PyObject_HashNotImplemented,
+    .tp_getattro = PyObject_GenericGetAttr,
+    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,
+    .tp_doc = frozendict_builder_type_doc,
+    .tp_traverse = (traverseproc) frozendict_builder_traverse,
+    .tp_clear = (inquiry) frozendict_builder_clear,
+    .tp_methods = frozendict_builder_methods,
+};
+
+#include "frozendictjson.c"
+#include "frozendictfreeze.c"
+#include "frozendictintern.c"
+#include "frozendictthaw.c"
+#include "frozenmapobject.c"
+
 static int
 frozendict_exec(PyObject *m)
 {
@@ -2074,6 +6116,10 @@ frozendict_exec(PyObject *m)
         goto fail;
     }
 
+    if (frozendict_init_dict_lookups() < 0) {
+        goto fail;
+    }
+
     if (PyType_Ready(&PyFrozenDictIterKey_Type) < 0) {
         goto fail;
     }
@@ -2098,6 +6144,18 @@ frozendict_exec(PyObject *m)
         goto fail;
     }
     
+    if (PyType_Ready(&PyFrozenDictSchema_Type) < 0) {
+        goto fail;
+    }
+
+    if (PyType_Ready(&PyFrozenDictBuilder_Type) < 0) {
+        goto fail;
+    }
+    
+    if (frozenmap_exec(m) < 0) {
+        goto fail;
+    }
+
     PyModule_AddObject(m, FROZENDICT_CLASS_NAME, (PyObject *)&PyFrozenDict_Type);
     return 0;
  fail:
@@ -2110,13 +6168,25 @@ static struct PyModuleDef_Slot frozendict_slots[] = {
     {0, NULL},
 };
 
+static PyMethodDef frozendict_module_methods[] = {
+    {"json_dumps", (PyCFunction)(void(*)(void)) frozendict_json_dumps,
+     METH_VARARGS | METH_KEYWORDS, frozendict_json_dumps_doc},
+    {"json_loads", (PyCFunction) frozendict_json_loads, METH_O,
+     frozendict_json_loads_doc},
+    {"_deepfreeze", (PyCFunction) frozendict_deepfreeze, METH_VARARGS,
+     frozendict_deepfreeze_doc},
+    {"_deepthaw", (PyCFunction) frozendict_deepthaw, METH_VARARGS,
+     frozendict_deepthaw_doc},
+    {NULL, NULL} /* sentinel */
+};
+
 static struct PyModuleDef frozendictmodule = {
     PyModuleDef_HEAD_INIT,
     FROZENDICT_MODULE_NAME,   /* name of module */
     NULL, /* module documentation, may be NULL */
     0,       /* size of per-interpreter state of the module,
                  or -1 if the module keeps state in global variables. */
-    NULL,
+    frozendict_module_methods,
     frozendict_slots,
     NULL,
     NULL,
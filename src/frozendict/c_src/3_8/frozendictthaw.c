@@ -0,0 +1,453 @@
+/* deepthaw
+ *
+ * _deepthaw() is the engine of cool.deepthaw(), the inverse of
+ * deepfreeze(). The inverse converters are resolved by cool.py once for
+ * every type, as for deepfreeze(), in a tuple (kind, None, inverse).
+ *
+ * A frozendict becomes a dict with a copy of its table, and a tuple a
+ * list with a copy of its items; then the items of the new container
+ * are replaced in place by their thawed values. The other converted
+ * objects are converted by inverse, and the items of the result are
+ * thawed if it's a mutable mapping or sequence.
+ *
+ * The containers are created before their items are thawed and stored
+ * in a memo by id(), so, as copy.deepcopy() does, an object nested more
+ * than once is thawed once, and the cycles are preserved. The tree is
+ * walked with an explicit stack of frames. */
+
+// keep in sync with the _THAW_* constants of cool.py
+enum {
+    FROZENDICT_THAW_NONE = 0,
+    FROZENDICT_THAW_MAPPING = 1,
+    FROZENDICT_THAW_SEQUENCE = 2,
+    FROZENDICT_THAW_CONTAINER = 3,
+};
+
+typedef struct {
+    int type;
+    // the new mutable container
+    PyObject* res;
+    // the list of the items of a generic container, or NULL
+    PyObject* items;
+    // 1 if the items are (key, value) pairs
+    int is_mapping;
+    Py_ssize_t size;
+    // index of the next item to thaw
+    Py_ssize_t i;
+} FrozendictThawFrame;
+
+typedef struct {
+    PyObject* resolve;
+    PyObject* resolutions;
+    // (MutableMapping, MutableSequence)
+    PyObject* containers;
+    // id(object) -> thawed object
+    PyObject* memo;
+    // the objects in the memo, so their ids can't be reused
+    PyObject* memo_objects;
+    FrozendictThawFrame* frames;
+    Py_ssize_t frames_len;
+    Py_ssize_t frames_size;
+} FrozendictThawer;
+
+/* Returns a new list with the items of the tuple o. */
+
+static PyObject* frozendict_thaw_tuple(PyObject* o) {
+    const Py_ssize_t n = PyTuple_GET_SIZE(o);
+    PyObject* res = PyList_New(n);
+
+    if (res == NULL) {
+        return NULL;
+    }
+
+    PyObject* item;
+
+    for (Py_ssize_t i = 0; i < n; i++) {
+        item = PyTuple_GET_ITEM(o, i);
+        Py_INCREF(item);
+        PyList_SET_ITEM(res, i, item);
+    }
+
+    return res;
+}
+
+/* Pushes a new frame for the items of res, the new container. The
+ * items of a generic container are listed first, since inverse
+ * converters can return any mutable mapping or sequence. */
+
+static int frozendict_thaw_push(
+    FrozendictThawer* th,
+    PyObject* res,
+    const int type
+) {
+    if (th->frames_len == th->frames_size) {
+        const Py_ssize_t new_size = th->frames_size * 2;
+        FrozendictThawFrame* frames = PyMem_Realloc(
+            th->frames,
+            new_size * sizeof(FrozendictThawFrame)
+        );
+
+        if (frames == NULL) {
+            PyErr_NoMemory();
+            return -1;
+        }
+
+        th->frames = frames;
+        th->frames_size = new_size;
+    }
+
+    FrozendictThawFrame* frame = &th->frames[th->frames_len];
+    memset(frame, 0, sizeof(FrozendictThawFrame));
+    th->frames_len++;
+
+    frame->type = type;
+    frame->res = res;
+    Py_INCREF(res);
+
+    switch (type) {
+        case FROZENDICT_THAW_MAPPING:
+            frame->size = ((PyDictObject*) res)->ma_used;
+            return 0;
+        case FROZENDICT_THAW_SEQUENCE:
+            frame->size = PyList_GET_SIZE(res);
+            return 0;
+    }
+
+    frame->is_mapping = PyDict_Check(res);
+
+    if (! frame->is_mapping && ! PyList_Check(res)) {
+        frame->is_mapping = PyObject_IsInstance(
+            res,
+            PyTuple_GET_ITEM(th->containers, 0)
+        );
+
+        if (frame->is_mapping < 0) {
+            return -1;
+        }
+    }
+
+    frame->items = (
+        frame->is_mapping
+        ? PyMapping_Items(res)
+        : PySequence_List(res)
+    );
+
+    if (frame->items == NULL) {
+        return -1;
+    }
+
+    frame->size = PyList_GET_SIZE(frame->items);
+
+    return 0;
+}
+
+/* Returns 1 if the items of res, the result of a generic inverse
+ * converter, must be thawed. */
+
+static int frozendict_thaw_is_container(
+    FrozendictThawer* th,
+    PyObject* o,
+    PyObject* res
+) {
+    if (res == o) {
+        return 0;
+    }
+
+    if (PyDict_Check(res) || PyList_Check(res)) {
+        return 1;
+    }
+
+    return PyObject_IsInstance(res, th->containers);
+}
+
+/* Returns the thawed o, a new reference. If it's a new container, a
+ * frame for its items is pushed. */
+
+static PyObject* frozendict_thaw_visit(FrozendictThawer* th, PyObject* o) {
+    PyObject* resolution = frozendict_freeze_resolution(
+        th->resolve,
+        th->resolutions,
+        o
+    );
+
+    if (resolution == NULL) {
+        return NULL;
+    }
+
+    const long kind = PyLong_AsLong(PyTuple_GET_ITEM(resolution, 0));
+
+    if (kind == FROZENDICT_THAW_NONE) {
+        Py_INCREF(o);
+        return o;
+    }
+
+    PyObject* memo_key = PyLong_FromVoidPtr(o);
+
+    if (memo_key == NULL) {
+        return NULL;
+    }
+
+    PyObject* res = PyDict_GetItemWithError(th->memo, memo_key);
+
+    if (res != NULL || PyErr_Occurred()) {
+        Py_DECREF(memo_key);
+        Py_XINCREF(res);
+        return res;
+    }
+
+    // a converter can register a new one, that clears the resolutions
+    Py_INCREF(resolution);
+
+    PyObject* inverse = PyTuple_GET_ITEM(resolution, 2);
+    int type = (int) kind;
+
+    if (
+        kind == FROZENDICT_THAW_MAPPING
+        && inverse == (PyObject*) &PyDict_Type
+        && PyAnyFrozenDict_Check(o)
+    ) {
+        res = frozendict_new_dict((PyDictObject*) o);
+    }
+    else if (
+        kind == FROZENDICT_THAW_SEQUENCE
+        && inverse == (PyObject*) &PyList_Type
+        && PyTuple_Check(o)
+    ) {
+        res = frozendict_thaw_tuple(o);
+    }
+    else if (kind < FROZENDICT_THAW_NONE || kind > FROZENDICT_THAW_CONTAINER) {
+        if (! PyErr_Occurred()) {
+            PyErr_Format(PyExc_ValueError, "unknown thaw kind %ld", kind);
+        }
+    }
+    else {
+        type = FROZENDICT_THAW_CONTAINER;
+        res = PyObject_CallFunctionObjArgs(inverse, o, NULL);
+    }
+
+    int err = res == NULL;
+
+    if (! err) {
+        err = PyDict_SetItem(th->memo, memo_key, res) < 0;
+    }
+
+    if (! err) {
+        err = PyList_Append(th->memo_objects, o) < 0;
+    }
+
+    if (! err) {
+        int push;
+
+        if (type == FROZENDICT_THAW_CONTAINER) {
+            push = frozendict_thaw_is_container(th, o, res);
+        }
+        else if (type == FROZENDICT_THAW_MAPPING) {
+            push = ((PyDictObject*) o)->ma_used > 0;
+        }
+        else {
+            push = PyTuple_GET_SIZE(o) > 0;
+        }
+
+        err = push < 0 || (push && frozendict_thaw_push(th, res, type) < 0);
+    }
+
+    if (err) {
+        Py_CLEAR(res);
+    }
+
+    Py_DECREF(resolution);
+    Py_DECREF(memo_key);
+
+    return res;
+}
+
+/* Replaces the item i of the container of frame with value, that is its
+ * thawed item. Steals the reference to value. */
+
+static int frozendict_thaw_set(
+    FrozendictThawFrame* frame,
+    const Py_ssize_t i,
+    PyObject* value
+) {
+    PyObject* res = frame->res;
+
+    if (frame->type == FROZENDICT_THAW_MAPPING) {
+        // the dict is new, and not seen by any code yet
+        PyDictKeysObject* keys = ((PyDictObject*) res)->ma_keys;
+        Py_SETREF(DK_ENTRIES(keys)[i].me_value, value);
+
+        if (
+            ! _PyObject_GC_IS_TRACKED(res)
+            && _PyObject_GC_MAY_BE_TRACKED(value)
+        ) {
+            PyObject_GC_Track(res);
+        }
+
+        return 0;
+    }
+
+    if (frame->type == FROZENDICT_THAW_SEQUENCE) {
+        Py_SETREF(PyList_GET_ITEM(res, i), value);
+        return 0;
+    }
+
+    PyObject* key;
+    int err;
+
+    if (frame->is_mapping) {
+        key = PyTuple_GET_ITEM(PyList_GET_ITEM(frame->items, i), 0);
+        err = PyObject_SetItem(res, key, value);
+    }
+    else {
+        key = PyLong_FromSsize_t(i);
+
+        if (key == NULL) {
+            Py_DECREF(value);
+            return -1;
+        }
+
+        err = PyObject_SetItem(res, key, value);
+        Py_DECREF(key);
+    }
+
+    Py_DECREF(value);
+
+    return err;
+}
+
+/* Returns the item i of the container of frame, borrowed. */
+
+static PyObject* frozendict_thaw_get(
+    FrozendictThawFrame* frame,
+    const Py_ssize_t i
+) {
+    switch (frame->type) {
+        case FROZENDICT_THAW_MAPPING: {
+            PyDictKeysObject* keys = ((PyDictObject*) frame->res)->ma_keys;
+            return DK_ENTRIES(keys)[i].me_value;
+        }
+        case FROZENDICT_THAW_SEQUENCE:
+            return PyList_GET_ITEM(frame->res, i);
+    }
+
+    PyObject* item = PyList_GET_ITEM(frame->items, i);
+
+    return frame->is_mapping ? PyTuple_GET_ITEM(item, 1) : item;
+}
+
+static PyObject* frozendict_thaw_walk(FrozendictThawer* th, PyObject* o) {
+    PyObject* res = frozendict_thaw_visit(th, o);
+
+    if (res == NULL) {
+        return NULL;
+    }
+
+    FrozendictThawFrame* frame;
+    PyObject* item;
+    PyObject* value;
+    Py_ssize_t frame_i;
+    Py_ssize_t i;
+
+    while (th->frames_len > 0) {
+        frame_i = th->frames_len - 1;
+        frame = &th->frames[frame_i];
+
+        if (frame->i == frame->size) {
+            Py_DECREF(frame->res);
+            Py_XDECREF(frame->items);
+            th->frames_len--;
+            continue;
+        }
+
+        i = frame->i++;
+        item = frozendict_thaw_get(frame, i);
+
+        // the item is kept alive by the frozen object
+        value = frozendict_thaw_visit(th, item);
+
+        if (value == NULL) {
+            Py_DECREF(res);
+            return NULL;
+        }
+
+        if (value == item) {
+            Py_DECREF(value);
+            continue;
+        }
+
+        // the frames can be moved by the push
+        if (frozendict_thaw_set(&th->frames[frame_i], i, value) < 0) {
+            Py_DECREF(res);
+            return NULL;
+        }
+    }
+
+    return res;
+}
+
+static PyObject* frozendict_deepthaw(
+    PyObject* Py_UNUSED(module),
+    PyObject* args
+) {
+    PyObject* o;
+    FrozendictThawer th;
+
+    if (! PyArg_ParseTuple(
+        args,
+        "OOO!O!:_deepthaw",
+        &o,
+        &th.resolve,
+        &PyDict_Type,
+        &th.resolutions,
+        &PyTuple_Type,
+        &th.containers
+    )) {
+        return NULL;
+    }
+
+    if (PyTuple_GET_SIZE(th.containers) != 2) {
+        PyErr_SetString(
+            PyExc_ValueError,
+            "containers must be (MutableMapping, MutableSequence)"
+        );
+
+        return NULL;
+    }
+
+    th.memo = PyDict_New();
+    th.memo_objects = PyList_New(0);
+    th.frames_len = 0;
+    th.frames_size = 16;
+    th.frames = PyMem_New(FrozendictThawFrame, th.frames_size);
+
+    PyObject* res = NULL;
+
+    if (th.memo == NULL || th.memo_objects == NULL || th.frames == NULL) {
+        if (th.frames == NULL) {
+            PyErr_NoMemory();
+        }
+    }
+    else {
+        res = frozendict_thaw_walk(&th, o);
+    }
+
+    // on errors, the frames of the unfinished containers are left
+    for (Py_ssize_t i = 0; i < th.frames_len; i++) {
+        Py_DECREF(th.frames[i].res);
+        Py_XDECREF(th.frames[i].items);
+    }
+
+    PyMem_Free(th.frames);
+    Py_XDECREF(th.memo);
+    Py_XDECREF(th.memo_objects);
+
+    return res;
+}
+
+PyDoc_STRVAR(frozendict_deepthaw_doc,
+"_deepthaw($module, o, resolve, resolutions, containers, /)\n"
+"--\n"
+"\n"
+"Engine of deepthaw(). resolve(type) returns the tuple (kind, None, \n"
+"inverse) of a type, and resolutions caches them by type. The items of \n"
+"the results of inverse are thawed if they're instances of containers.   ");
@@ -0,0 +1,1186 @@
+/* deepfreeze
+ *
+ * _deepfreeze() is the engine of cool.deepfreeze(). The converters
+ * registered by register() are still resolved by cool.py, but only once
+ * for every concrete type: the resolution is a tuple (kind, freeze,
+ * inverse), that is stored in a dict by type and reused for all the
+ * objects of that type. cool.py clears the dict when the registry
+ * changes.
+ *
+ * The dicts, frozendicts, lists and tuples converted with the default
+ * converters are rebuilt here, without copying them first. A frozendict
+ * or a tuple with no item to convert is returned as it is.
+ *
+ * The tree is walked with an explicit stack of frames, one for every
+ * container that is being frozen, so its depth is limited only by the
+ * memory. Every object that is not immutable is frozen once: the result
+ * is stored in a memo by id(), and reused if the object is found again.
+ * An object found again while its items are being frozen is a circular
+ * reference.
+ *
+ * If the previous frozen tree is given, every object is paired with the
+ * object of previous in the same place. A frozen object equal to its
+ * pair, with the same type, is replaced by the pair, and a frozendict or
+ * a tuple whose items are all replaced by their pairs is not built at
+ * all: it's the pair.
+ *
+ * If intern is true, the frozendicts of the result are replaced by their
+ * canonical objects, see frozendictintern.c, and the exact strs are
+ * interned as sys.intern() does. Tuples can't be interned, since they
+ * have no weak references, but their items are. */
+
+// keep in sync with the _FREEZE_* constants of cool.py
+enum {
+    FROZENDICT_FREEZE_IMMUTABLE = 0,
+    FROZENDICT_FREEZE_OBJECT = 1,
+    FROZENDICT_FREEZE_PLAIN = 2,
+    FROZENDICT_FREEZE_CONTAINER = 3,
+};
+
+// how a frame builds its result
+enum {
+    // a frozendict from an exact dict or frozendict
+    FROZENDICT_FRAME_MAPPING,
+    // a tuple from an exact list or tuple
+    FROZENDICT_FRAME_SEQUENCE,
+    // freeze() of a copy of the object, updated with the frozen items
+    FROZENDICT_FRAME_GENERIC,
+};
+
+typedef struct {
+    int type;
+    // the object, that is kept alive by the memo
+    PyObject* o;
+    PyObject* memo_key;
+    PyObject* resolution;
+    // the copy of the generic frames, or NULL
+    PyObject* o_copy;
+    // the memory of keys and values
+    PyObject** items;
+    // keys of the items, or NULL if the keys are the indexes
+    PyObject** keys;
+    Py_hash_t* hashes;
+    // values of the items, replaced by the frozen ones
+    PyObject** values;
+    Py_ssize_t size;
+    // index of the next item to freeze
+    Py_ssize_t i;
+    int changed;
+    // the pair of o in previous, or NULL
+    PyObject* prev;
+    // the pair of the item i, or NULL
+    PyObject* item_prev;
+    // 1 if the result can't be prev
+    int differs;
+} FrozendictFreezeFrame;
+
+typedef struct {
+    PyObject* resolve;
+    PyObject* resolutions;
+    PyObject* error;
+    int intern;
+    // id(object) -> frozen object, or the memo itself while the items of
+    // the object are being frozen
+    PyObject* memo;
+    // the objects in the memo, so their ids can't be reused
+    PyObject* memo_objects;
+    FrozendictFreezeFrame* frames;
+    Py_ssize_t frames_len;
+    Py_ssize_t frames_size;
+} FrozendictFreezer;
+
+/* Returns the resolution of the type of o, a borrowed tuple (kind,
+ * freeze, inverse), calling resolve only if it's not in resolutions. */
+
+static PyObject* frozendict_freeze_resolution(
+    PyObject* resolve,
+    PyObject* resolutions,
+    PyObject* o
+) {
+    PyObject* type = (PyObject*) Py_TYPE(o);
+    PyObject* res = PyDict_GetItemWithError(resolutions, type);
+
+    if (res != NULL || PyErr_Occurred()) {
+        return res;
+    }
+
+    res = PyObject_CallFunctionObjArgs(resolve, type, NULL);
+
+    if (res == NULL) {
+        return NULL;
+    }
+
+    if (
+        ! PyTuple_CheckExact(res)
+        || PyTuple_GET_SIZE(res) != 3
+        || ! PyLong_CheckExact(PyTuple_GET_ITEM(res, 0))
+    ) {
+        Py_DECREF(res);
+        PyErr_SetString(
+            PyExc_TypeError,
+            "resolve must return a tuple (kind, freeze, inverse)"
+        );
+
+        return NULL;
+    }
+
+    const int err = PyDict_SetItem(resolutions, type, res);
+    Py_DECREF(res);
+
+    if (err < 0) {
+        return NULL;
+    }
+
+    // the dict keeps it alive
+    return res;
+}
+
+/* Returns a new, exact frozendict with the n keys, hashes and values,
+ * that must be unique keys. The table has room for exactly n items. */
+
+static PyObject* frozendict_freeze_new_mapping(
+    PyObject** keys,
+    const Py_hash_t* hashes,
+    PyObject** values,
+    const Py_ssize_t n
+) {
+    PyObject* self = frozendict_new_barebone(&PyFrozenDict_Type);
+
+    if (self == NULL) {
+        return NULL;
+    }
+
+    PyFrozenDictObject* mp = (PyFrozenDictObject*) self;
+
+    if (n == 0) {
+        return frozendict_create_empty(mp, &PyFrozenDict_Type, 1);
+    }
+
+    PyDictKeysObject* new_keys = frozendict_new_keys_fit(n);
+
+    if (new_keys == NULL) {
+        Py_DECREF(self);
+        return NULL;
+    }
+
+    PyDictKeyEntry* entries = DK_ENTRIES(new_keys);
+    int track = 0;
+
+    for (Py_ssize_t i = 0; i < n; i++) {
+        Py_INCREF(keys[i]);
+        Py_INCREF(values[i]);
+        entries[i].me_key = keys[i];
+        entries[i].me_hash = hashes[i];
+        entries[i].me_value = values[i];
+
+        if (! PyUnicode_CheckExact(keys[i])) {
+            new_keys->dk_lookup = lookdict;
+        }
+
+        if (
+            _PyObject_GC_MAY_BE_TRACKED(keys[i])
+            || _PyObject_GC_MAY_BE_TRACKED(values[i])
+        ) {
+            track = 1;
+        }
+    }
+
+    build_indices(new_keys, entries, n);
+    new_keys->dk_usable = 0;
+    new_keys->dk_nentries = n;
+
+    mp->ma_keys = new_keys;
+    mp->ma_used = n;
+    mp->ma_version_tag = DICT_NEXT_VERSION();
+
+    if (track) {
+        PyObject_GC_Track(self);
+    }
+
+    ASSERT_CONSISTENT(mp);
+
+    return frozendict_compact(self);
+}
+
+/* Allocates the arrays of the size items of frame. The keys, if any,
+ * are before the values. */
+
+static int frozendict_freeze_frame_alloc(
+    FrozendictFreezeFrame* frame,
+    const Py_ssize_t size,
+    const int with_keys
+) {
+    frame->items = PyMem_New(PyObject*, (with_keys ? 2 * size : size) + 1);
+
+    if (frame->items == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    frame->keys = with_keys ? frame->items : NULL;
+    frame->values = with_keys ? frame->items + size : frame->items;
+
+    return 0;
+}
+
+/* Reads the items of the exact dict or frozendict o in frame. The items
+ * are read before they're frozen, since a converter can change a
+ * dict. */
+
+static int frozendict_freeze_frame_mapping(
+    FrozendictFreezeFrame* frame,
+    PyObject* o
+) {
+    const Py_ssize_t n = ((PyDictObject*) o)->ma_used;
+
+    if (frozendict_freeze_frame_alloc(frame, n, 1) < 0) {
+        return -1;
+    }
+
+    frame->hashes = PyMem_New(Py_hash_t, n + 1);
+
+    if (frame->hashes == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    PyObject** keys = frame->keys;
+    PyObject** values = frame->values;
+    Py_hash_t* hashes = frame->hashes;
+    Py_ssize_t size = 0;
+
+    if (PyDict_Check(o)) {
+        Py_ssize_t pos = 0;
+
+        while (_PyDict_Next(
+            o,
+            &pos,
+            &keys[size],
+            &values[size],
+            &hashes[size]
+        )) {
+            Py_INCREF(keys[size]);
+            Py_INCREF(values[size]);
+            size++;
+        }
+    }
+    else {
+        PyDictObject* mp = (PyDictObject*) o;
+        const PyDictKeyEntry* entries = DK_ENTRIES(mp->ma_keys);
+
+        for (; size < n; size++) {
+            keys[size] = entries[size].me_key;
+            hashes[size] = entries[size].me_hash;
+            values[size] = frozendict_entry_value(mp, size);
+            Py_INCREF(keys[size]);
+            Py_INCREF(values[size]);
+        }
+    }
+
+    frame->size = size;
+
+    return 0;
+}
+
+/* Reads the items of the exact list or tuple o in frame. */
+
+static int frozendict_freeze_frame_sequence(
+    FrozendictFreezeFrame* frame,
+    PyObject* o
+) {
+    PyObject* items = PyList_CheckExact(o) ? PyList_AsTuple(o) : o;
+
+    if (items == NULL) {
+        return -1;
+    }
+
+    const Py_ssize_t n = PyTuple_GET_SIZE(items);
+    int err = frozendict_freeze_frame_alloc(frame, n, 0);
+
+    if (err == 0) {
+        for (Py_ssize_t i = 0; i < n; i++) {
+            frame->values[i] = PyTuple_GET_ITEM(items, i);
+            Py_INCREF(frame->values[i]);
+        }
+
+        frame->size = n;
+    }
+
+    if (items != o) {
+        Py_DECREF(items);
+    }
+
+    return err;
+}
+
+/* Returns the list of the items of o_copy, as cool.getItems() iterates
+ * them: the pairs of a dict, the items of any other iterable. Sets
+ * is_mapping to 1 for the pairs. */
+
+static PyObject* frozendict_freeze_copy_items(
+    PyObject* o_copy,
+    int* is_mapping
+) {
+    *is_mapping = PyDict_Check(o_copy);
+
+    if (*is_mapping) {
+        return PyDict_Items(o_copy);
+    }
+
+    PyObject* abc = PyImport_ImportModule("collections.abc");
+
+    if (abc == NULL) {
+        return NULL;
+    }
+
+    PyObject* mapping = PyObject_GetAttrString(abc, "Mapping");
+    Py_DECREF(abc);
+
+    if (mapping == NULL) {
+        return NULL;
+    }
+
+    *is_mapping = PyObject_IsInstance(o_copy, mapping);
+    Py_DECREF(mapping);
+
+    if (*is_mapping < 0) {
+        return NULL;
+    }
+
+    if (! *is_mapping) {
+        return PySequence_List(o_copy);
+    }
+
+    // dict.items() refuses the mappings that are not dicts, as
+    // deepfreeze() always did
+    PyObject* view = PyObject_CallMethod(
+        (PyObject*) &PyDict_Type,
+        "items",
+        "O",
+        o_copy
+    );
+
+    if (view == NULL) {
+        return NULL;
+    }
+
+    PyObject* items = PySequence_List(view);
+    Py_DECREF(view);
+
+    return items;
+}
+
+/* Prepares the generic frame of o: o is converted by inverse, if it's
+ * not None, and copied by copy.copy(). The items of the copy are read
+ * in frame. */
+
+static int frozendict_freeze_frame_generic(
+    FrozendictFreezeFrame* frame,
+    PyObject* o,
+    PyObject* inverse
+) {
+    PyObject* src;
+
+    if (inverse == Py_None) {
+        Py_INCREF(o);
+        src = o;
+    }
+    else {
+        src = PyObject_CallFunctionObjArgs(inverse, o, NULL);
+
+        if (src == NULL) {
+            return -1;
+        }
+    }
+
+    PyObject* copy = PyImport_ImportModule("copy");
+
+    if (copy == NULL) {
+        Py_DECREF(src);
+        return -1;
+    }
+
+    frame->o_copy = PyObject_CallMethod(copy, "copy", "O", src);
+    Py_DECREF(copy);
+    Py_DECREF(src);
+
+    if (frame->o_copy == NULL) {
+        return -1;
+    }
+
+    int is_mapping;
+    PyObject* items = frozendict_freeze_copy_items(frame->o_copy, &is_mapping);
+
+    if (items == NULL) {
+        return -1;
+    }
+
+    const Py_ssize_t n = PyList_GET_SIZE(items);
+
+    if (frozendict_freeze_frame_alloc(frame, n, is_mapping) < 0) {
+        Py_DECREF(items);
+        return -1;
+    }
+
+    PyObject* item;
+
+    for (Py_ssize_t i = 0; i < n; i++) {
+        item = PyList_GET_ITEM(items, i);
+
+        if (is_mapping) {
+            frame->keys[i] = PyTuple_GET_ITEM(item, 0);
+            Py_INCREF(frame->keys[i]);
+            item = PyTuple_GET_ITEM(item, 1);
+        }
+
+        Py_INCREF(item);
+        frame->values[i] = item;
+        frame->size = i + 1;
+    }
+
+    Py_DECREF(items);
+
+    return 0;
+}
+
+static void frozendict_freeze_frame_clear(FrozendictFreezeFrame* frame) {
+    for (Py_ssize_t i = 0; i < frame->size; i++) {
+        if (frame->keys != NULL) {
+            Py_DECREF(frame->keys[i]);
+        }
+
+        Py_DECREF(frame->values[i]);
+    }
+
+    PyMem_Free(frame->items);
+    PyMem_Free(frame->hashes);
+    Py_XDECREF(frame->o_copy);
+    Py_XDECREF(frame->resolution);
+    Py_XDECREF(frame->memo_key);
+    Py_XDECREF(frame->prev);
+}
+
+/* Pushes a new frame for the container o, that has the resolution
+ * resolution and the pair prev, and marks it as in progress in the
+ * memo. */
+
+static int frozendict_freeze_push(
+    FrozendictFreezer* fr,
+    PyObject* o,
+    PyObject* resolution,
+    PyObject* memo_key,
+    PyObject* prev
+) {
+    if (fr->frames_len == fr->frames_size) {
+        const Py_ssize_t new_size = fr->frames_size * 2;
+        FrozendictFreezeFrame* frames = PyMem_Realloc(
+            fr->frames,
+            new_size * sizeof(FrozendictFreezeFrame)
+        );
+
+        if (frames == NULL) {
+            PyErr_NoMemory();
+            return -1;
+        }
+
+        fr->frames = frames;
+        fr->frames_size = new_size;
+    }
+
+    FrozendictFreezeFrame* frame = &fr->frames[fr->frames_len];
+    memset(frame, 0, sizeof(FrozendictFreezeFrame));
+    fr->frames_len++;
+
+    frame->o = o;
+    frame->memo_key = memo_key;
+    frame->resolution = resolution;
+    frame->prev = prev;
+    frame->differs = prev == NULL;
+    Py_INCREF(memo_key);
+    Py_INCREF(resolution);
+    Py_XINCREF(prev);
+
+    if (PyDict_SetItem(fr->memo, memo_key, fr->memo) < 0) {
+        return -1;
+    }
+
+    PyObject* freeze = PyTuple_GET_ITEM(resolution, 1);
+    PyObject* inverse = PyTuple_GET_ITEM(resolution, 2);
+
+    if (freeze == (PyObject*) &PyFrozenDict_Type) {
+        if (
+            (inverse == Py_None && PyDict_CheckExact(o))
+            || (
+                inverse == (PyObject*) &PyDict_Type
+                && PyFrozenDict_CheckExact(o)
+            )
+        ) {
+            frame->type = FROZENDICT_FRAME_MAPPING;
+
+            if (
+                prev != NULL
+                && (
+                    Py_TYPE(prev) != &PyFrozenDict_Type
+                    || ((PyDictObject*) prev)->ma_used
+                        != ((PyDictObject*) o)->ma_used
+                )
+            ) {
+                frame->differs = 1;
+            }
+
+            return frozendict_freeze_frame_mapping(frame, o);
+        }
+    }
+    else if (freeze == (PyObject*) &PyTuple_Type) {
+        if (
+            (inverse == Py_None && PyList_CheckExact(o))
+            || (inverse == (PyObject*) &PyList_Type && PyTuple_CheckExact(o))
+        ) {
+            frame->type = FROZENDICT_FRAME_SEQUENCE;
+
+            if (
+                prev != NULL
+                && (! PyTuple_CheckExact(prev) || Py_SIZE(prev) != Py_SIZE(o))
+            ) {
+                frame->differs = 1;
+            }
+
+            return frozendict_freeze_frame_sequence(frame, o);
+        }
+    }
+
+    frame->type = FROZENDICT_FRAME_GENERIC;
+
+    return frozendict_freeze_frame_generic(frame, o, inverse);
+}
+
+/* Returns the result of frame, whose items are all frozen. */
+
+static PyObject* frozendict_freeze_frame_result(FrozendictFreezeFrame* frame) {
+    PyObject* o = frame->o;
+
+    if (frame->type != FROZENDICT_FRAME_GENERIC && ! frame->differs) {
+        Py_INCREF(frame->prev);
+        return frame->prev;
+    }
+
+    switch (frame->type) {
+        case FROZENDICT_FRAME_MAPPING:
+            if (! frame->changed && ! PyDict_Check(o)) {
+                Py_INCREF(o);
+                return o;
+            }
+
+            return frozendict_freeze_new_mapping(
+                frame->keys,
+                frame->hashes,
+                frame->values,
+                frame->size
+            );
+        case FROZENDICT_FRAME_SEQUENCE: {
+            if (! frame->changed && PyTuple_CheckExact(o)) {
+                Py_INCREF(o);
+                return o;
+            }
+
+            PyObject* res = PyTuple_New(frame->size);
+
+            if (res == NULL) {
+                return NULL;
+            }
+
+            for (Py_ssize_t i = 0; i < frame->size; i++) {
+                Py_INCREF(frame->values[i]);
+                PyTuple_SET_ITEM(res, i, frame->values[i]);
+            }
+
+            return res;
+        }
+    }
+
+    PyObject* index;
+    int err;
+
+    for (Py_ssize_t i = 0; i < frame->size; i++) {
+        if (frame->keys != NULL) {
+            err = PyObject_SetItem(
+                frame->o_copy,
+                frame->keys[i],
+                frame->values[i]
+            );
+        }
+        else {
+            index = PyLong_FromSsize_t(i);
+
+            if (index == NULL) {
+                return NULL;
+            }
+
+            err = PyObject_SetItem(frame->o_copy, index, frame->values[i]);
+            Py_DECREF(index);
+        }
+
+        if (err < 0) {
+            return NULL;
+        }
+    }
+
+    return PyObject_CallFunctionObjArgs(
+        PyTuple_GET_ITEM(frame->resolution, 1),
+        frame->o_copy,
+        NULL
+    );
+}
+
+/* Freezes an object without a converter: its __dict__, if it has one,
+ * or the object itself, if it's hashable. Otherwise raises TypeError
+ * with the message msg. */
+
+static PyObject* frozendict_freeze_object(PyObject* o, PyObject* msg) {
+    _Py_IDENTIFIER(__dict__);
+
+    PyObject* dict = _PyObject_GetAttrId(o, &PyId___dict__);
+
+    if (dict != NULL) {
+        PyObject* res;
+
+        // an instance __dict__ is copied with its table, see
+        // frozendict_from_object()
+        if (PyAnyDict_Check(dict)) {
+            res = frozendict_from_dict(dict);
+        }
+        else {
+            res = PyObject_CallFunctionObjArgs(
+                (PyObject*) &PyFrozenDict_Type,
+                dict,
+                NULL
+            );
+        }
+
+        Py_DECREF(dict);
+
+        return res;
+    }
+
+    if (! PyErr_ExceptionMatches(PyExc_AttributeError)) {
+        return NULL;
+    }
+
+    PyErr_Clear();
+
+    if (PyObject_Hash(o) != -1) {
+        Py_INCREF(o);
+        return o;
+    }
+
+    if (! PyErr_ExceptionMatches(PyExc_TypeError)) {
+        return NULL;
+    }
+
+    PyErr_SetObject(PyExc_TypeError, msg);
+
+    return NULL;
+}
+
+/* Returns 1 if the frozen object res can be replaced by its pair prev:
+ * they have the same type and they're equal. The items of frozendicts
+ * and tuples are compared in the same way, so True doesn't replace 1,
+ * and the keys of frozendicts must be in the same order. */
+
+static int frozendict_freeze_same(PyObject* res, PyObject* prev) {
+    if (res == prev) {
+        return 1;
+    }
+
+    if (Py_TYPE(res) != Py_TYPE(prev)) {
+        return 0;
+    }
+
+    const int is_tuple = PyTuple_Check(res);
+
+    if (! is_tuple && ! PyAnyFrozenDict_Check(res)) {
+        return PyObject_RichCompareBool(res, prev, Py_EQ);
+    }
+
+    if (is_tuple && Py_SIZE(res) != Py_SIZE(prev)) {
+        return 0;
+    }
+
+    PyDictObject* mp = (PyDictObject*) res;
+    PyDictObject* prev_mp = (PyDictObject*) prev;
+
+    if (! is_tuple) {
+        const Py_hash_t hash = ((PyFrozenDictObject*) res)->ma_hash;
+        const Py_hash_t prev_hash = ((PyFrozenDictObject*) prev)->ma_hash;
+
+        if (
+            mp->ma_used != prev_mp->ma_used
+            || (
+                hash != MINUSONE_HASH
+                && prev_hash != MINUSONE_HASH
+                && hash != prev_hash
+            )
+        ) {
+            return 0;
+        }
+    }
+
+    if (Py_EnterRecursiveCall(" while comparing frozen objects")) {
+        return -1;
+    }
+
+    const Py_ssize_t size = is_tuple ? Py_SIZE(res) : mp->ma_used;
+    int cmp = 1;
+
+    for (Py_ssize_t i = 0; i < size && cmp > 0; i++) {
+        if (is_tuple) {
+            cmp = frozendict_freeze_same(
+                PyTuple_GET_ITEM(res, i),
+                PyTuple_GET_ITEM(prev, i)
+            );
+        }
+        else {
+            cmp = frozendict_freeze_same(
+                DK_ENTRIES(mp->ma_keys)[i].me_key,
+                DK_ENTRIES(prev_mp->ma_keys)[i].me_key
+            );
+
+            if (cmp > 0) {
+                cmp = frozendict_freeze_same(
+                    frozendict_entry_value(mp, i),
+                    frozendict_entry_value(prev_mp, i)
+                );
+            }
+        }
+    }
+
+    Py_LeaveRecursiveCall();
+
+    return cmp;
+}
+
+/* Returns res, or its pair prev if it can replace res. Steals the
+ * reference to res. */
+
+static PyObject* frozendict_freeze_reuse(PyObject* res, PyObject* prev) {
+    if (prev == NULL || res == prev) {
+        return res;
+    }
+
+    const int same = frozendict_freeze_same(res, prev);
+
+    if (same == 0) {
+        return res;
+    }
+
+    Py_DECREF(res);
+
+    if (same < 0) {
+        return NULL;
+    }
+
+    Py_INCREF(prev);
+    return prev;
+}
+
+/* Sets the item_prev of frame, the pair of its next item: the item with
+ * the same key of a frozendict, or the item with the same index of a
+ * tuple. A key in another place of the frozendict sets differs. */
+
+static int frozendict_freeze_item_prev(FrozendictFreezeFrame* frame) {
+    PyObject* prev = frame->prev;
+    const Py_ssize_t i = frame->i;
+
+    frame->item_prev = NULL;
+
+    if (prev == NULL) {
+        return 0;
+    }
+
+    if (frame->keys == NULL) {
+        if (PyTuple_Check(prev) && i < PyTuple_GET_SIZE(prev)) {
+            frame->item_prev = PyTuple_GET_ITEM(prev, i);
+        }
+
+        return 0;
+    }
+
+    if (! PyAnyFrozenDict_Check(prev)) {
+        return 0;
+    }
+
+    PyDictObject* mp = (PyDictObject*) prev;
+    PyObject* key = frame->keys[i];
+
+    if (i < mp->ma_used && DK_ENTRIES(mp->ma_keys)[i].me_key == key) {
+        frame->item_prev = frozendict_entry_value(mp, i);
+        return 0;
+    }
+
+    const Py_hash_t hash = (
+        frame->hashes != NULL
+        ? frame->hashes[i]
+        : PyObject_Hash(key)
+    );
+
+    if (hash == -1) {
+        return -1;
+    }
+
+    const Py_ssize_t ix = frozendict_lookup_index(mp, key, hash);
+
+    if (ix == DKIX_ERROR) {
+        return -1;
+    }
+
+    if (ix >= 0) {
+        frame->item_prev = frozendict_entry_value(mp, ix);
+    }
+
+    if (ix != i) {
+        frame->differs = 1;
+        return 0;
+    }
+
+    // an equal key, that can have another type
+    const int same = frozendict_freeze_same(
+        key,
+        DK_ENTRIES(mp->ma_keys)[i].me_key
+    );
+
+    if (same < 0) {
+        return -1;
+    }
+
+    if (! same) {
+        frame->differs = 1;
+    }
+
+    return 0;
+}
+
+/* Returns the canonical object of res, if fr interns the frozen objects
+ * and res can be interned, or res. Steals the reference to res. */
+
+static PyObject* frozendict_freeze_intern(
+    FrozendictFreezer* fr,
+    PyObject* res
+) {
+    if (res == NULL || ! fr->intern) {
+        return res;
+    }
+
+    if (PyUnicode_CheckExact(res)) {
+        PyUnicode_InternInPlace(&res);
+        return res;
+    }
+
+    if (! PyAnyFrozenDict_Check(res)) {
+        return res;
+    }
+
+    PyObject* canon = frozendict_intern_impl(res);
+
+    if (canon == NULL) {
+        // an unhashable frozendict is left as it is
+        if (! PyErr_ExceptionMatches(PyExc_TypeError)) {
+            Py_DECREF(res);
+            return NULL;
+        }
+
+        PyErr_Clear();
+        return res;
+    }
+
+    Py_DECREF(res);
+    return canon;
+}
+
+/* Stores in the memo res, the frozen o, and keeps o alive. */
+
+static int frozendict_freeze_memo_set(
+    FrozendictFreezer* fr,
+    PyObject* o,
+    PyObject* memo_key,
+    PyObject* res
+) {
+    if (PyDict_SetItem(fr->memo, memo_key, res) < 0) {
+        return -1;
+    }
+
+    return PyList_Append(fr->memo_objects, o);
+}
+
+/* Freezes o, that has the pair prev. Returns 1 and sets res to the
+ * frozen object if it's available now, or returns 0 if a frame for o is
+ * pushed, so its items must be frozen first. Returns -1 on errors. */
+
+static int frozendict_freeze_visit(
+    FrozendictFreezer* fr,
+    PyObject* o,
+    PyObject* prev,
+    PyObject** res
+) {
+    PyObject* resolution = frozendict_freeze_resolution(
+        fr->resolve,
+        fr->resolutions,
+        o
+    );
+
+    if (resolution == NULL) {
+        return -1;
+    }
+
+    const long kind = PyLong_AsLong(PyTuple_GET_ITEM(resolution, 0));
+
+    if (kind == FROZENDICT_FREEZE_IMMUTABLE) {
+        Py_INCREF(o);
+        *res = o;
+        return 1;
+    }
+
+    PyObject* memo_key = PyLong_FromVoidPtr(o);
+
+    if (memo_key == NULL) {
+        return -1;
+    }
+
+    PyObject* memo_res = PyDict_GetItemWithError(fr->memo, memo_key);
+
+    if (memo_res != NULL) {
+        Py_DECREF(memo_key);
+
+        if (memo_res == fr->memo) {
+            PyErr_Format(
+                fr->error,
+                "circular reference to an object of type %.100s",
+                Py_TYPE(o)->tp_name
+            );
+
+            return -1;
+        }
+
+        Py_INCREF(memo_res);
+        *res = memo_res;
+        return 1;
+    }
+
+    if (PyErr_Occurred()) {
+        Py_DECREF(memo_key);
+        return -1;
+    }
+
+    // a converter can register a new one, that clears the resolutions
+    Py_INCREF(resolution);
+
+    PyObject* freeze = PyTuple_GET_ITEM(resolution, 1);
+    PyObject* frozen = NULL;
+    int ret = -1;
+
+    switch (kind) {
+        case FROZENDICT_FREEZE_OBJECT:
+            frozen = frozendict_freeze_object(o, freeze);
+            break;
+        case FROZENDICT_FREEZE_PLAIN:
+            frozen = PyObject_CallFunctionObjArgs(freeze, o, NULL);
+            break;
+        case FROZENDICT_FREEZE_CONTAINER:
+            ret = frozendict_freeze_push(fr, o, resolution, memo_key, prev);
+            ret = ret < 0 ? -1 : 0;
+            break;
+        default:
+            if (! PyErr_Occurred()) {
+                PyErr_Format(
+                    PyExc_ValueError,
+                    "unknown freeze kind %ld",
+                    kind
+                );
+            }
+    }
+
+    if (frozen != NULL) {
+        if (frozendict_freeze_memo_set(fr, o, memo_key, frozen) < 0) {
+            Py_DECREF(frozen);
+        }
+        else {
+            *res = frozen;
+            ret = 1;
+        }
+    }
+    else if (ret == 0 && PyList_Append(fr->memo_objects, o) < 0) {
+        ret = -1;
+    }
+
+    Py_DECREF(resolution);
+    Py_DECREF(memo_key);
+
+    return ret;
+}
+
+/* Freezes o, that has the pair prev, walking its items with the stack
+ * of frames of fr. */
+
+static PyObject* frozendict_freeze_walk(
+    FrozendictFreezer* fr,
+    PyObject* o,
+    PyObject* prev
+) {
+    PyObject* res;
+    int ret = frozendict_freeze_visit(fr, o, prev, &res);
+
+    if (ret != 0) {
+        if (ret < 0) {
+            return NULL;
+        }
+
+        return frozendict_freeze_intern(fr, frozendict_freeze_reuse(res, prev));
+    }
+
+    FrozendictFreezeFrame* frame;
+    PyObject* item;
+
+    while (1) {
+        frame = &fr->frames[fr->frames_len - 1];
+
+        if (frame->i < frame->size) {
+            if (frozendict_freeze_item_prev(frame) < 0) {
+                return NULL;
+            }
+
+            item = frame->values[frame->i];
+            ret = frozendict_freeze_visit(fr, item, frame->item_prev, &res);
+
+            if (ret < 0) {
+                return NULL;
+            }
+
+            if (ret == 0) {
+                // the frames can be moved by the push
+                continue;
+            }
+
+            res = frozendict_freeze_intern(
+                fr,
+                frozendict_freeze_reuse(res, frame->item_prev)
+            );
+
+            if (res == NULL) {
+                return NULL;
+            }
+        }
+        else {
+            res = frozendict_freeze_frame_result(frame);
+
+            // the other frames build their pair, if it can replace them
+            if (res != NULL && frame->type == FROZENDICT_FRAME_GENERIC) {
+                res = frozendict_freeze_reuse(res, frame->prev);
+            }
+
+            res = frozendict_freeze_intern(fr, res);
+
+            if (res == NULL) {
+                return NULL;
+            }
+
+            if (PyDict_SetItem(fr->memo, frame->memo_key, res) < 0) {
+                Py_DECREF(res);
+                return NULL;
+            }
+
+            frozendict_freeze_frame_clear(frame);
+            fr->frames_len--;
+
+            if (fr->frames_len == 0) {
+                return res;
+            }
+
+            frame = &fr->frames[fr->frames_len - 1];
+        }
+
+        // res is the frozen item of frame
+        item = frame->values[frame->i];
+
+        if (res != item) {
+            frame->changed = 1;
+        }
+
+        if (res != frame->item_prev) {
+            frame->differs = 1;
+        }
+
+        frame->values[frame->i] = res;
+        frame->i++;
+        Py_DECREF(item);
+    }
+}
+
+static PyObject* frozendict_deepfreeze(
+    PyObject* Py_UNUSED(module),
+    PyObject* args
+) {
+    PyObject* o;
+    PyObject* prev;
+    FrozendictFreezer fr;
+
+    if (! PyArg_ParseTuple(
+        args,
+        "OOO!OOp:_deepfreeze",
+        &o,
+        &fr.resolve,
+        &PyDict_Type,
+        &fr.resolutions,
+        &fr.error,
+        &prev,
+        &fr.intern
+    )) {
+        return NULL;
+    }
+
+    if (prev == Py_None) {
+        prev = NULL;
+    }
+
+    fr.memo = PyDict_New();
+    fr.memo_objects = PyList_New(0);
+    fr.frames_len = 0;
+    fr.frames_size = 16;
+    fr.frames = PyMem_New(FrozendictFreezeFrame, fr.frames_size);
+
+    PyObject* res = NULL;
+
+    if (fr.memo == NULL || fr.memo_objects == NULL || fr.frames == NULL) {
+        if (fr.frames == NULL) {
+            PyErr_NoMemory();
+        }
+    }
+    else {
+        res = frozendict_freeze_walk(&fr, o, prev);
+    }
+
+    // on errors, the frames of the unfinished containers are left
+    for (Py_ssize_t i = 0; i < fr.frames_len; i++) {
+        frozendict_freeze_frame_clear(&fr.frames[i]);
+    }
+
+    PyMem_Free(fr.frames);
+
+    if (fr.memo != NULL) {
+        // the containers still in progress are marked by the memo itself
+        PyDict_Clear(fr.memo);
+        Py_DECREF(fr.memo);
+    }
+
+    Py_XDECREF(fr.memo_objects);
+
+    return res;
+}
+
+PyDoc_STRVAR(frozendict_deepfreeze_doc,
+"_deepfreeze($module, o, resolve, resolutions, error, previous, intern, /)\n"
+"--\n"
+"\n"
+"Engine of deepfreeze(). resolve(type) returns the tuple (kind, freeze, \n"
+"inverse) of a type, and resolutions caches them by type. A circular \n"
+"reference raises error. The objects equal to the ones of previous, or \n"
+"None, are replaced by them. If intern is true, the frozendicts and the \n"
+"strs of the result are interned.   ");
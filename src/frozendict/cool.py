@@ -1,4 +1,5 @@
-from collections.abc import MutableMapping, MutableSequence, MutableSet
+from collections.abc import Mapping, MutableMapping, MutableSequence
+from collections.abc import MutableSet, Sequence
 from enum import Enum
 from types import MappingProxyType
 
@@ -68,7 +69,8 @@ def register(to_convert, converter, *, inverse = False):
     
     If `inverse` is True, the conversion is considered from an immutable 
     type to a mutable one. This make it possible to convert mutable
-    objects nested in the registered immutable one.
+    objects nested in the registered immutable one, and it's used by
+    `deepthaw()`.
     """
     
     if not issubclass(type(to_convert), type):
@@ -103,6 +105,8 @@ def register(to_convert, converter, *, inverse = False):
         freeze_conversion_map = _freeze_conversion_map_custom
     
     freeze_conversion_map[to_convert] = converter
+    _freeze_resolutions.clear()
+    _thaw_resolutions.clear()
 
 
 def unregister(type, inverse = False):
@@ -121,6 +125,9 @@ def unregister(type, inverse = False):
         del freeze_conversion_map[type]
     except KeyError:
         raise FreezeError(f"{type.__name__} is not registered")
+    
+    _freeze_resolutions.clear()
+    _thaw_resolutions.clear()
 
 
 def getFreezeConversionMap():
@@ -159,11 +166,611 @@ def getFreezeTypes():
 
 _freeze_types_plain = (MutableSet, bytearray, array)
 
+# exact types that deepfreeze() returns as they are, if they have no
+# converter. Their subclasses can have a __dict__
+_freeze_types_immutable = frozenset((
+    str, bytes, int, float, complex, bool, type(None), frozenset,
+))
+
+# kinds of resolution, see _getFreezeResolution(). Keep in sync with
+# the C extension
+_FREEZE_IMMUTABLE = 0
+_FREEZE_OBJECT = 1
+_FREEZE_PLAIN = 2
+_FREEZE_CONTAINER = 3
+
+# resolutions of the types with the registered converters, cleared by
+# register() and unregister()
+_freeze_resolutions = {}
+
+
+def _getFreezeResolution(
+        type_o,
+        custom_converters,
+        custom_inverse_converters
+):
+    r"""
+    Returns how deepfreeze() converts the objects of type `type_o`, as a
+    tuple `(kind, freeze, inverse)`:
+    
+    - `_FREEZE_IMMUTABLE`: the object is returned as it is
+    - `_FREEZE_OBJECT`: the frozendict of the `__dict__` of the object
+      is returned, or the object itself, if it's hashable. Otherwise,
+      TypeError is raised with the message `freeze`
+    - `_FREEZE_PLAIN`: `freeze(o)` is returned
+    - `_FREEZE_CONTAINER`: the object is converted with `inverse`, if
+      it's not None, and copied. The items of the copy are frozen, and
+      `freeze(copy)` is returned
+    
+    The result depends only on the type, so deepfreeze() computes it
+    once for every type.
+    """
+    
+    from collections import abc
+    
+    if issubclass(type_o, (_LazyFrozenMapping, _LazyFrozenSequence)):
+        # a lazy proxy of deepfreeze() is frozen as the object it
+        # materializes to
+        return (_FREEZE_PLAIN, _materializeLazy, None)
+    
+    freeze_types = tuple(custom_converters) + getFreezeTypes()
+    
+    base_type_o = None
+    
+    for freeze_type in freeze_types:
+        if issubclass(type_o, freeze_type):
+            base_type_o = freeze_type
+            break
+    
+    if base_type_o is None:
+        if type_o in _freeze_types_immutable:
+            return (_FREEZE_IMMUTABLE, None, None)
+        
+        supported_types = ", ".join((x.__name__ for x in freeze_types))
+        
+        err = (
+            f"type {type_o} is not hashable or is not equal or a " +
+            f"subclass of the supported types: {supported_types}"
+        )
+        
+        return (_FREEZE_OBJECT, err, None)
+    
+    freeze_conversion_map = getFreezeConversionMap() | custom_converters
+    
+    if (
+        base_type_o in _freeze_types_plain or 
+        not issubclass(type_o, abc.Iterable) or 
+        issubclass(type_o, memoryview) or 
+        hasattr(type_o, "isalpha")
+    ):
+        return (_FREEZE_PLAIN, freeze_conversion_map[base_type_o], None)
+    
+    freeze_conversion_inverse_map = (
+        getFreezeConversionInverseMap() |
+        custom_inverse_converters
+    )
+    
+    inverse = freeze_conversion_inverse_map.get(base_type_o)
+    
+    try:
+        freeze = freeze_conversion_map[base_type_o]
+    except KeyError:
+        if base_type_o in freeze_conversion_inverse_map:
+            freeze = type_o
+        else:  # pragma: no cover
+            raise
+    
+    return (_FREEZE_CONTAINER, freeze, inverse)
+
+
+def _freezeObject(o, err):
+    from frozendict import frozendict
+    
+    # this is before hash check because all object in Python are
+    # hashable by default, if not explicitly suppressed
+    try:
+        o.__dict__
+    except AttributeError:
+        pass
+    else:
+        return frozendict(o.__dict__)
+    
+    try:
+        hash(o)
+    except TypeError:
+        pass
+    else:
+        # without a converter, we can only hope that
+        # hashable == immutable
+        return o
+    
+    raise TypeError(err)
+
+
+def _freezeSame(o, previous):
+    # the items of frozendicts and tuples are compared in the same way,
+    # so True doesn't replace 1. The keys of frozendicts must be in the
+    # same order
+    from frozendict import frozendict
+    
+    if o is previous:
+        return True
+    
+    if type(o) is not type(previous):
+        return False
+    
+    if isinstance(o, frozendict):
+        return len(o) == len(previous) and all(
+            _freezeSame(k, k_prev) and _freezeSame(v, v_prev)
+            for (k, v), (k_prev, v_prev) in zip(o.items(), previous.items())
+        )
+    
+    if isinstance(o, tuple):
+        return len(o) == len(previous) and all(
+            _freezeSame(v, v_prev) for v, v_prev in zip(o, previous)
+        )
+    
+    return o == previous
+
+
+def _freezeReuse(o, previous):
+    if previous is not _freeze_no_previous and _freezeSame(o, previous):
+        return previous
+    
+    return o
+
+
+def _freezeIntern(o):
+    # the canonical object of a frozen object, if it can be interned.
+    # Tuples have no weak references, so they can't be interned
+    from frozendict import frozendict
+    from sys import intern
+    
+    if type(o) is str:
+        return intern(o)
+    
+    if isinstance(o, frozendict):
+        try:
+            return frozendict.intern(o)
+        except TypeError:
+            # unhashable
+            pass
+    
+    return o
+
+
+def _getFreezePrevious(previous, key):
+    # the object of previous with the key of a frozen mapping, or the
+    # index of a frozen sequence
+    from frozendict import frozendict
+    
+    if isinstance(previous, (frozendict, tuple)):
+        try:
+            return previous[key]
+        except (KeyError, IndexError, TypeError):
+            pass
+    
+    return _freeze_no_previous
+
+
+# marks in the memo of deepfreeze() the objects whose items are being
+# frozen
+_freeze_in_progress = object()
+
+# the previous of the objects that have no previous in deepfreeze()
+_freeze_no_previous = object()
+
+
+def _deepfreeze_py(o, resolve, resolutions, error, previous, intern):
+    from copy import copy
+    
+    # id(object) -> frozen object
+    memo = {}
+    
+    # the objects in the memo, so their ids can't be reused
+    memo_objects = []
+    
+    # a frame for every container whose items are being frozen:
+    # [id, copy, freeze, keys, values, index of the next value, previous]
+    frames = []
+    
+    def visit(o, previous):
+        # returns the frozen o, or _freeze_in_progress if a frame for o
+        # is pushed
+        type_o = type(o)
+        
+        try:
+            kind, freeze, inverse = resolutions[type_o]
+        except KeyError:
+            kind, freeze, inverse = resolutions[type_o] = resolve(type_o)
+        
+        if kind == _FREEZE_IMMUTABLE:
+            return o
+        
+        id_o = id(o)
+        
+        try:
+            res = memo[id_o]
+        except KeyError:
+            pass
+        else:
+            if res is _freeze_in_progress:
+                raise error(
+                    "circular reference to an object of type " +
+                    type_o.__name__
+                )
+            
+            return res
+        
+        memo_objects.append(o)
+        
+        if kind == _FREEZE_OBJECT:
+            res = _freezeObject(o, freeze)
+        elif kind == _FREEZE_PLAIN:
+            res = freeze(o)
+        else:
+            res = _freeze_in_progress
+            o_copy = copy(o if inverse is None else inverse(o))
+            items = list(getItems(o_copy)(o_copy))
+            keys = [k for k, _ in items]
+            values = [v for _, v in items]
+            frames.append([id_o, o_copy, freeze, keys, values, 0, previous])
+        
+        memo[id_o] = res
+        
+        return res
+    
+    def reuse(o, previous):
+        res = _freezeReuse(o, previous)
+        
+        return _freezeIntern(res) if intern else res
+    
+    if previous is None:
+        previous = _freeze_no_previous
+    
+    res = visit(o, previous)
+    
+    if res is not _freeze_in_progress:
+        return reuse(res, previous)
+    
+    while frames:
+        frame = frames[-1]
+        values = frame[4]
+        i = frame[5]
+        
+        if i < len(values):
+            previous = _getFreezePrevious(frame[6], frame[3][i])
+            res = visit(values[i], previous)
+            
+            if res is _freeze_in_progress:
+                continue
+            
+            res = reuse(res, previous)
+        else:
+            id_o, o_copy, freeze, keys, _, _, previous = frames.pop()
+            
+            for k, v in zip(keys, values):
+                o_copy[k] = v
+            
+            res = freeze(o_copy)
+            res = memo[id_o] = reuse(res, previous)
+            
+            if not frames:
+                break
+            
+            frame = frames[-1]
+            i = frame[5]
+        
+        frame[4][i] = res
+        frame[5] = i + 1
+    
+    return res
+
+
+try:
+    from frozendict._frozendict import _deepfreeze
+except ImportError:
+    _deepfreeze = _deepfreeze_py
+
+
+class _LazyFreezer:
+    r"""
+    Freezes the objects of a lazy deepfreeze(), one level at a time.
+    """
+    
+    __slots__ = ("resolve", "resolutions", "intern")
+    
+    def __init__(self, resolve, resolutions, intern):
+        self.resolve = resolve
+        self.resolutions = resolutions
+        self.intern = intern
+    
+    def freeze(self, o):
+        r"""
+        Returns a lazy proxy of `o`, if it's a container that would be
+        frozen in a frozendict or a tuple, or the frozen `o`.
+        """
+        
+        from frozendict import frozendict
+        
+        type_o = type(o)
+        
+        try:
+            kind, freeze, inverse = self.resolutions[type_o]
+        except KeyError:
+            kind, freeze, inverse = self.resolutions[type_o] = (
+                self.resolve(type_o)
+            )
+        
+        if kind == _FREEZE_CONTAINER:
+            if freeze is frozendict:
+                src = o if inverse is None else inverse(o)
+                
+                # the top level is copied now, the items when read
+                return _LazyFrozenMapping(self, dict(src))
+            
+            if freeze is tuple:
+                src = o if inverse is None else inverse(o)
+                
+                return _LazyFrozenSequence(self, tuple(src))
+        
+        return self.deepfreeze(o)
+    
+    def deepfreeze(self, o):
+        return _deepfreeze(
+            o,
+            self.resolve,
+            self.resolutions,
+            FreezeError,
+            None,
+            self.intern
+        )
+    
+    def canonical(self, o):
+        r"""
+        Returns the canonical object of a materialized proxy, if the
+        freezer interns the frozen objects, or the object itself.
+        """
+        
+        return _freezeIntern(o) if self.intern else o
+
+
+# the items of a lazy proxy of deepfreeze() that are not frozen yet
+_freeze_not_read = object()
+
+
+def _materializeLazy(o):
+    if isinstance(o, (_LazyFrozenMapping, _LazyFrozenSequence)):
+        return o._materialize()
+    
+    return o
+
+
+def _getLazyJsonDefault(default = None):
+    r"""
+    Returns the default of json_dumps(), that serializes the lazy proxies
+    of deepfreeze() as the objects they materialize to, and passes the
+    other objects to `default`.
+    """
+    
+    def lazyJsonDefault(o):
+        res = _materializeLazy(o)
+        
+        if res is not o:
+            return res
+        
+        if default is None:
+            raise TypeError(
+                f"Object of type {o.__class__.__name__} " + 
+                "is not JSON serializable"
+            )
+        
+        return default(o)
+    
+    return lazyJsonDefault
+
+
+class _LazyFrozenMapping(Mapping):
+    r"""
+    The read-only proxy returned by `deepfreeze(o, lazy=True)` for the
+    objects frozen in a frozendict. Every value is frozen when it's
+    read the first time. The hash and the comparisons use the
+    frozendict of all the frozen values, and so do the methods of
+    frozendict that are not defined here.
+    """
+    
+    __slots__ = ("_freezer", "_items", "_frozen", "_materialized")
+    
+    def __init__(self, freezer, items):
+        self._freezer = freezer
+        self._items = items
+        self._frozen = {}
+        self._materialized = None
+    
+    def __getitem__(self, key):
+        try:
+            return self._frozen[key]
+        except KeyError:
+            pass
+        
+        value = self._freezer.freeze(self._items[key])
+        
+        return self._frozen.setdefault(key, value)
+    
+    def __iter__(self):
+        return iter(self._items)
+    
+    def __reversed__(self):
+        # dicts are reversible only from Python 3.8
+        return reversed(tuple(self._items))
+    
+    def __len__(self):
+        return len(self._items)
+    
+    def __contains__(self, key):
+        return key in self._items
+    
+    def _materialize(self):
+        r"""
+        Returns the frozendict of all the frozen values. The values
+        never read are frozen by deepfreeze() in one go.
+        """
+        
+        from frozendict import frozendict
+        
+        res = self._materialized
+        
+        if res is None:
+            frozen = self._frozen
+            
+            res = self._freezer.canonical(frozendict({
+                key: (
+                    _materializeLazy(frozen[key])
+                    if key in frozen
+                    else self._freezer.deepfreeze(value)
+                )
+                for key, value in self._items.items()
+            }))
+            
+            self._materialized = res
+        
+        return res
+    
+    def __hash__(self):
+        return hash(self._materialize())
+    
+    def __eq__(self, other):
+        return self._materialize() == _materializeLazy(other)
+    
+    def __ne__(self, other):
+        return self._materialize() != _materializeLazy(other)
+    
+    def __or__(self, other):
+        return self._materialize() | _materializeLazy(other)
+    
+    def __ror__(self, other):
+        return _materializeLazy(other) | self._materialize()
+    
+    def __repr__(self):
+        return repr(self._materialize())
+    
+    def __reduce__(self):
+        return self._materialize().__reduce__()
+    
+    def __copy__(self):
+        return self
+    
+    def __deepcopy__(self, memo):
+        return self
+    
+    def __getattr__(self, name):
+        if name.startswith("_"):
+            raise AttributeError(name)
+        
+        return getattr(self._materialize(), name)
+
+
+class _LazyFrozenSequence(Sequence):
+    r"""
+    The read-only proxy returned by `deepfreeze(o, lazy=True)` for the
+    objects frozen in a tuple. Every item is frozen when it's read the
+    first time. The hash and the comparisons use the tuple of all the
+    frozen items.
+    """
+    
+    __slots__ = ("_freezer", "_items", "_frozen", "_materialized")
+    
+    def __init__(self, freezer, items):
+        self._freezer = freezer
+        self._items = items
+        self._frozen = [_freeze_not_read] * len(items)
+        self._materialized = None
+    
+    def __getitem__(self, index):
+        if isinstance(index, slice):
+            return tuple(
+                self[i] for i in range(*index.indices(len(self._items)))
+            )
+        
+        frozen = self._frozen[index]
+        
+        if frozen is _freeze_not_read:
+            frozen = self._freezer.freeze(self._items[index])
+            self._frozen[index] = frozen
+        
+        return frozen
+    
+    def __len__(self):
+        return len(self._items)
+    
+    def _materialize(self):
+        r"""
+        Returns the tuple of all the frozen items. The items never read
+        are frozen by deepfreeze() in one go.
+        """
+        
+        res = self._materialized
+        
+        if res is None:
+            res = tuple(
+                self._freezer.deepfreeze(item)
+                if frozen is _freeze_not_read
+                else _materializeLazy(frozen)
+                for item, frozen in zip(self._items, self._frozen)
+            )
+            
+            self._materialized = res
+        
+        return res
+    
+    def __hash__(self):
+        return hash(self._materialize())
+    
+    def __eq__(self, other):
+        return self._materialize() == _materializeLazy(other)
+    
+    def __ne__(self, other):
+        return self._materialize() != _materializeLazy(other)
+    
+    def __lt__(self, other):
+        return self._materialize() < _materializeLazy(other)
+    
+    def __le__(self, other):
+        return self._materialize() <= _materializeLazy(other)
+    
+    def __gt__(self, other):
+        return self._materialize() > _materializeLazy(other)
+    
+    def __ge__(self, other):
+        return self._materialize() >= _materializeLazy(other)
+    
+    def __add__(self, other):
+        return self._materialize() + _materializeLazy(other)
+    
+    def __radd__(self, other):
+        return _materializeLazy(other) + self._materialize()
+    
+    def __repr__(self):
+        return repr(self._materialize())
+    
+    def __reduce__(self):
+        return (tuple, (self._materialize(), ))
+    
+    def __copy__(self):
+        return self
+    
+    def __deepcopy__(self, memo):
+        return self
+
 
 def deepfreeze(
         o,
         custom_converters = None,
-        custom_inverse_converters = None
+        custom_inverse_converters = None,
+        *,
+        previous = None,
+        lazy = False,
+        intern = False
 ):
     r"""
     Converts the object and all the objects nested in it in its
@@ -178,14 +785,38 @@ def deepfreeze(
     
     By default, if the type is not registered and has a `__dict__`
     attribute, it's converted to the `frozendict` of that `__dict__`.
+    The objects with `__slots__` can be registered with
+    `frozendict.from_object()` as converter.
     
     This function assumes that hashable == immutable (that is not
     always true).
     
-    This function uses recursion, with all the limits of recursions in
-    Python.
+    The converter of every type is resolved only once, until the
+    conversion map changes. With the C extension, a frozendict or a
+    tuple that contains only frozen objects is returned as it is.
     
-    Where is a good old tail call when you need it?
+    Every object is converted only once: if it's nested more than once,
+    all the occurrences are the same frozen object. A circular
+    reference raises FreezeError. The nesting is not limited by the
+    recursion limit.
+    
+    `previous` can be the result of a previous deepfreeze(). Every
+    frozen object that is equal to the object in the same place of
+    `previous`, and has the same type, is replaced by the latter, that
+    keeps its cached hash. With the C extension, the unchanged
+    subtrees are not rebuilt.
+    
+    If `lazy` is true, an object that would be frozen in a frozendict or
+    in a tuple is returned as a read-only proxy of it. Its top level is
+    copied immediately, but every item is frozen only when it's read the
+    first time, and the nested containers become lazy proxies too. The
+    hash and the comparisons of a proxy freeze it completely. The
+    nested objects must not change while the proxy is in use.
+    
+    If `intern` is true, every frozendict of the result is replaced by
+    its canonical object, see `frozendict.intern()`, and every str by
+    `sys.intern()` of it, so equal subtrees built separately share the
+    same objects. Tuples can't be interned, but their items are.
     """
     
     from frozendict import frozendict
@@ -226,91 +857,242 @@ def deepfreeze(
                 "`custom_inverse_converters`parameter is not a callable"
             )
     
-    type_o = type(o)
+    if custom_converters or custom_inverse_converters:
+        resolutions = {}
+    else:
+        resolutions = _freeze_resolutions
     
-    freeze_types = tuple(custom_converters.keys()) + getFreezeTypes()
+    def resolve(type_o):
+        return _getFreezeResolution(
+            type_o,
+            custom_converters,
+            custom_inverse_converters
+        )
     
-    base_type_o = None
+    if lazy:
+        if previous is not None:
+            raise ValueError("`previous` can't be used with `lazy`")
+        
+        return _LazyFreezer(resolve, resolutions, intern).freeze(o)
     
-    for freeze_type in freeze_types:
-        if isinstance(o, freeze_type):
-            base_type_o = freeze_type
+    return _deepfreeze(
+        o,
+        resolve,
+        resolutions,
+        FreezeError,
+        previous,
+        intern
+    )
+
+
+# kinds of resolution, see _getThawResolution(). Keep in sync with the C
+# extension
+_THAW_NONE = 0
+_THAW_MAPPING = 1
+_THAW_SEQUENCE = 2
+_THAW_CONTAINER = 3
+
+# the mutable containers whose items deepthaw() thaws, if an inverse
+# converter returns them
+_thaw_types_container = (MutableMapping, MutableSequence)
+
+# resolutions of the types with the registered inverse converters,
+# cleared by register() and unregister()
+_thaw_resolutions = {}
+
+
+def _getThawResolution(type_o, custom_inverse_converters):
+    r"""
+    Returns how deepthaw() converts the objects of type `type_o`, as a
+    tuple `(kind, None, inverse)`:
+    
+    - `_THAW_NONE`: the object has no inverse converter, and it's
+      returned as it is
+    - `_THAW_MAPPING`: a frozendict, converted to a dict
+    - `_THAW_SEQUENCE`: a tuple, converted to a list
+    - `_THAW_CONTAINER`: the object is converted with `inverse`
+    
+    The items of the result are thawed too. The inverse converter of the
+    nearest base class of `type_o` wins.
+    """
+    
+    from frozendict import frozendict
+    
+    if issubclass(type_o, (_LazyFrozenMapping, _LazyFrozenSequence)):
+        # a lazy proxy of deepfreeze() is thawed as the object it
+        # materializes to
+        if issubclass(type_o, _LazyFrozenMapping):
+            type_frozen = frozendict
+        else:
+            type_frozen = tuple
+        
+        _, _, inverse = _getThawResolution(
+            type_frozen,
+            custom_inverse_converters
+        )
+        
+        if inverse is None:
+            return (_THAW_CONTAINER, None, _materializeLazy)
+        
+        return (_THAW_CONTAINER, None, lambda o: inverse(o._materialize()))
+    
+    inverse_map = (
+        getFreezeConversionInverseMap() |
+        custom_inverse_converters
+    )
+    
+    inverse = None
+    
+    for base in type_o.__mro__:
+        if base in inverse_map:
+            inverse = inverse_map[base]
             break
+    else:
+        for base, converter in inverse_map.items():
+            if issubclass(type_o, base):
+                inverse = converter
+                break
     
-    if base_type_o is None:
-        # this is before hash check because all object in Python are
-        # hashable by default, if not explicitly suppressed
+    if inverse is None:
+        return (_THAW_NONE, None, None)
+    
+    if inverse is dict and issubclass(type_o, frozendict):
+        return (_THAW_MAPPING, None, inverse)
+    
+    if inverse is list and issubclass(type_o, tuple):
+        return (_THAW_SEQUENCE, None, inverse)
+    
+    return (_THAW_CONTAINER, None, inverse)
+
+
+def _deepthaw_py(o, resolve, resolutions, containers):
+    from collections.abc import Mapping
+    
+    # id(object) -> thawed object
+    memo = {}
+    
+    # the objects in the memo, so their ids can't be reused
+    memo_objects = []
+    
+    # a frame for every new container whose items are being thawed:
+    # [container, keys, values, index of the next value]
+    frames = []
+    
+    def visit(o):
+        type_o = type(o)
+        
         try:
-            o.__dict__
-        except AttributeError:
-            pass
-        else:
-            return frozendict(o.__dict__)
+            kind, _, inverse = resolutions[type_o]
+        except KeyError:
+            kind, _, inverse = resolutions[type_o] = resolve(type_o)
+        
+        if kind == _THAW_NONE:
+            return o
+        
+        id_o = id(o)
         
         try:
-            hash(o)
-        except TypeError:
+            return memo[id_o]
+        except KeyError:
             pass
-        else:
-            # without a converter, we can only hope that
-            # hashable == immutable
-            return o
         
-        supported_types = ", ".join((x.__name__ for x in freeze_types))
+        res = memo[id_o] = inverse(o)
+        memo_objects.append(o)
         
-        err = (
-            f"type {type_o} is not hashable or is not equal or a " +
-            f"subclass of the supported types: {supported_types}"
-        )
+        if res is not o and isinstance(res, containers):
+            if isinstance(res, Mapping):
+                items = list(res.items())
+            else:
+                items = list(enumerate(res))
+            
+            keys = [k for k, _ in items]
+            values = [v for _, v in items]
+            frames.append([res, keys, values, 0])
         
-        raise TypeError(err)
-    
-    freeze_conversion_map = getFreezeConversionMap()
+        return res
     
-    freeze_conversion_map = freeze_conversion_map | custom_converters
+    res = visit(o)
     
-    if base_type_o in _freeze_types_plain:
-        return freeze_conversion_map[base_type_o](o)
+    while frames:
+        frame = frames[-1]
+        values = frame[2]
+        i = frame[3]
+        
+        if i == len(values):
+            frames.pop()
+            continue
+        
+        frame[3] = i + 1
+        value = visit(values[i])
+        
+        if value is not values[i]:
+            frame[0][frame[1][i]] = value
     
-    if not isIterableNotString(o):
-        return freeze_conversion_map[base_type_o](o)
+    return res
+
+
+try:
+    from frozendict._frozendict import _deepthaw
+except ImportError:
+    _deepthaw = _deepthaw_py
+
+
+def deepthaw(o, custom_inverse_converters = None):
+    r"""
+    Converts the object and all the objects nested in it in their
+    mutable counterparts. It's the inverse of deepfreeze().
     
-    freeze_conversion_inverse_map = getFreezeConversionInverseMap()
+    The conversion map is in getFreezeConversionInverseMap(): by
+    default, a frozendict becomes a dict, a tuple a list and a
+    MappingProxyType a dict. You can register a new conversion using
+    `register(type, converter, inverse = True)`, or pass a map of custom
+    inverse converters with `custom_inverse_converters`. The items of
+    the object returned by a converter are thawed too, if it's a
+    mutable mapping or a mutable sequence.
     
-    freeze_conversion_inverse_map = (
-        freeze_conversion_inverse_map |
-        custom_inverse_converters
-    )
+    The objects without an inverse converter are returned as they are,
+    and their items are not thawed.
     
-    frozen_type = base_type_o in freeze_conversion_inverse_map
+    As copy.deepcopy(), every object is converted only once: if it's
+    nested more than once, all the occurrences are the same mutable
+    object. With the C extension, a frozendict is converted copying its
+    table in one go.
+    """
     
-    if frozen_type:
-        o = freeze_conversion_inverse_map[base_type_o](o)
+    from frozendict import frozendict
     
-    from copy import copy
+    if custom_inverse_converters is None:
+        custom_inverse_converters = frozendict()
     
-    o_copy = copy(o)
+    for type_i, converter in custom_inverse_converters.items():
+        if not issubclass(type(type_i), type):
+            raise ValueError(
+                f"{type_i} in `custom_inverse_converters` parameter " +
+                "is not a type"
+            )
+        
+        try:
+            converter.__call__
+        except AttributeError:
+            raise ValueError(
+                f"converter for {type_i} in " +
+                "`custom_inverse_converters` parameter is not a callable"
+            )
     
-    for k, v in getItems(o_copy)(o_copy):
-        o_copy[k] = deepfreeze(
-            v,
-            custom_converters = custom_converters,
-            custom_inverse_converters = custom_inverse_converters
-        )
+    if custom_inverse_converters:
+        resolutions = {}
+    else:
+        resolutions = _thaw_resolutions
     
-    try:
-        freeze = freeze_conversion_map[base_type_o]
-    except KeyError:
-        if frozen_type:
-            freeze = type_o
-        else:  # pragma: no cover
-            raise
+    def resolve(type_o):
+        return _getThawResolution(type_o, custom_inverse_converters)
     
-    return freeze(o_copy)
+    return _deepthaw(o, resolve, resolutions, _thaw_types_container)
 
 
 __all__ = (
     deepfreeze.__name__, 
+    deepthaw.__name__, 
     register.__name__, 
     unregister.__name__, 
     getFreezeConversionMap.__name__, 
@@ -322,7 +1104,9 @@ __all__ = (
 del MappingProxyType
 del array
 del frozendict
+del Mapping
 del MutableMapping
 del MutableSequence
+del Sequence
 del MutableSet
 del Enum
@@ -100,10 +100,13 @@ def patchOrUnpatchOrjson(*, patch, warn = True):  # pragma: no cover
     
     if patch:
         from frozendict import frozendict
+        from frozendict.cool import _materializeLazy
         
         def frozendictOrjsonDumps(obj, *args, **kwargs):
+            obj = _materializeLazy(obj)
+            
             if isinstance(obj, frozendict):
-                obj = dict(obj)
+                obj = obj.to_dict(deep=True)
             
             return oldOrjsonDumps(obj, *args, **kwargs)
         
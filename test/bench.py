@@ -6,7 +6,7 @@ from copy import copy
 from time import time
 
 import immutables
-from frozendict import frozendict
+from frozendict import frozendict, frozenmap
 from math import sqrt
 
 
@@ -41,7 +41,8 @@ def autorange(
     globals=None,
     ratio=1000,
     bench_time=10,
-    number=None
+    number=None,
+    loops=None
 ):
     if setup is None:
         setup = "pass"
@@ -49,7 +50,12 @@ def autorange(
     t = timeit.Timer(stmt=stmt, setup=setup, globals=globals)
     break_immediately = False
     
-    if number is None:
+    if loops is not None:
+        # the statement can run only `loops` times after every setup
+        break_immediately = number is not None
+        number = loops
+        repeat = 1
+    elif number is None:
         # get automatically the number of needed loops
         a = t.autorange()
         
@@ -141,10 +147,14 @@ def main(number):
     
     bench_constr_kwargs_name = "constructor(kwargs)"
     bench_hash_name = "hash"
+    bench_hash_cold_name = "hash (not cached)"
     bench_set_name = "set"
     bench_delete_name = "set"
+    bench_set_many_name = "set_many(20)"
     bench_copy_name = "copy"
     bench_fromkeys_name = "fromkeys"
+    bench_to_dict_name = "to dict"
+    bench_json_dumps_name = "json dumps"
     
     benchmarks = (
         {
@@ -210,6 +220,16 @@ def main(number):
             "code": "fromkeys(keys)", 
             "setup": "fromkeys = type(o).fromkeys; keys = o.keys()", 
         },
+        {
+            "name": bench_to_dict_name, 
+            "code": None, 
+            "setup": "pass", 
+        },
+        {
+            "name": bench_json_dumps_name, 
+            "code": None, 
+            "setup": "from frozendict import json_dumps; from json import dumps", 
+        },
         {
             "name": bench_set_name, 
             "code": None, 
@@ -220,11 +240,31 @@ def main(number):
             "code": None, 
             "setup": "pass", 
         },
+        {
+            "name": bench_set_many_name, 
+            "code": None, 
+            "setup": (
+                "overrides = dict.fromkeys(" + 
+                "tuple(d)[::max(len(d) // 20, 1)], getUuid())"
+            ), 
+        },
         {
             "name": bench_hash_name,
             "code": "hash(o)",
             "setup": "pass",
         },
+        {
+            "name": bench_hash_cold_name,
+            # every object is built in the setup and hashed once, so
+            # only the hash is timed. The construction is timed by
+            # "constructor(d)"
+            "code": "hash(next(objs))",
+            "setup": (
+                "klass = type(o); " +
+                "objs = iter([klass(d) for _ in range(loops)])"
+            ),
+            "loops": 100,
+        },
     )
     
     dict_collection = []
@@ -242,12 +282,14 @@ def main(number):
 
         fd1 = frozendict(d1)
         fd2 = frozendict(d2)
+        fm1 = frozenmap(d1)
+        fm2 = frozenmap(d2)
         m1 = immutables.Map(d1)
         m2 = immutables.Map(d2)
         
         dict_collection.append({
-            "str": ((d1, fd1, m1), str_key),
-            "int": ((d2, fd2, m2), int_key)
+            "str": ((d1, fd1, fm1, m1), str_key),
+            "int": ((d2, fd2, fm2, m2), int_key)
         })
     
     sep_n = 72
@@ -269,7 +311,10 @@ def main(number):
                 
                 for o in dicts:
                     if (
-                        benchmark["name"] == bench_hash_name and
+                        benchmark["name"] in (
+                            bench_hash_name, 
+                            bench_hash_cold_name, 
+                        ) and
                         type(o) is dict
                     ):
                         continue
@@ -288,6 +333,31 @@ def main(number):
                         else:
                             benchmark["code"] = "o.delete(one_key)"
                     
+                    if benchmark["name"] == bench_set_many_name:
+                        if type(o) is frozenmap:
+                            continue
+                        
+                        if type(o) is dict:
+                            benchmark["code"] = "o.copy().update(overrides)"
+                        elif type(o) is immutables.Map:
+                            benchmark["code"] = "o.update(overrides)"
+                        else:
+                            benchmark["code"] = "o.set_many(overrides)"
+                    
+                    if benchmark["name"] == bench_to_dict_name:
+                        if type(o) is frozendict:
+                            benchmark["code"] = "o.to_dict()"
+                        else:
+                            benchmark["code"] = "dict(o)"
+                    
+                    if benchmark["name"] == bench_json_dumps_name:
+                        if type(o) is frozendict:
+                            benchmark["code"] = "json_dumps(o)"
+                        elif type(o) is dict:
+                            benchmark["code"] = "dumps(o)"
+                        else:
+                            continue
+                    
                     if benchmark["name"] == bench_copy_name:
                         if type(o) is immutables.Map:
                             benchmark["code"] = "copy(o)"
@@ -311,8 +381,10 @@ def main(number):
                             "d": d.copy(),
                             "one_key": one_key,
                             "copy": copy,
+                            "loops": benchmark.get("loops"),
                         },
                         number = number,
+                        loops = benchmark.get("loops"),
                     )
 
                     print(print_tpl.format(
@@ -325,6 +397,176 @@ def main(number):
                     ))
     
     print(sep_major * sep_n)
+    
+    main_lookup(number)
+    main_equal(number)
+    main_take(number)
+
+
+def main_lookup(number):
+    # compares the lookups of frozendict with and without optimize()
+    dictionary_sizes = (1000, 100000, 1000000)
+    lookups_num = 1000
+    
+    print_tpl = (
+        "Name: {name: <25} Size: {size: >7}; Keys: {keys: >3}; " +
+        "Type: {type: >10}; Time: {time:.2e}; Sigma: {sigma:.0e}"
+    )
+    
+    benchmarks = (
+        {
+            "name": "lookup hit (x{})".format(lookups_num), 
+            "keys_name": "hits", 
+        },
+        {
+            "name": "lookup miss (x{})".format(lookups_num), 
+            "keys_name": "misses", 
+        },
+    )
+    
+    sep_n = 72
+    sep_major = "#"
+    
+    for n in dictionary_sizes:
+        keys = [getUuid() for _ in range(n)]
+        fd = frozendict(dict.fromkeys(keys, 0))
+        fd_optimized = frozendict(dict.fromkeys(keys, 0)).optimize()
+        fd_groups = frozendict(dict.fromkeys(keys, 0)).optimize(index="groups")
+        
+        keys_collection = {
+            "hits": keys[::max(n // lookups_num, 1)][:lookups_num],
+            "misses": [getUuid() for _ in range(lookups_num)],
+        }
+        
+        for benchmark in benchmarks:
+            print(sep_major * sep_n)
+            
+            for (type_name, o) in (
+                ("frozendict", fd), 
+                ("optimized", fd_optimized), 
+                ("groups", fd_groups), 
+            ):
+                bench_res = autorange(
+                    stmt = "for k in keys: k in o", 
+                    globals = {
+                        "o": o,
+                        "keys": keys_collection[benchmark["keys_name"]],
+                    },
+                    number = number,
+                )
+                
+                print(print_tpl.format(
+                    name = "`{}`;".format(benchmark["name"]), 
+                    keys = "str", 
+                    size = n, 
+                    type = type_name, 
+                    time = bench_res[0],
+                    sigma = bench_res[1],  
+                ))
+    
+    print(sep_major * sep_n)
+
+
+def main_equal(number):
+    # compares two dictionaries with the same keys, where the second one
+    # is equal, differs only in the last value, or differs and both
+    # have a cached hash
+    dictionary_sizes = (5, 1000, 100000)
+    
+    print_tpl = (
+        "Name: {name: <25} Size: {size: >7}; Keys: {keys: >3}; " +
+        "Type: {type: >10}; Time: {time:.2e}; Sigma: {sigma:.0e}"
+    )
+    
+    benchmarks = ("equal", "differs in last value", "differs in hash")
+    
+    sep_n = 72
+    sep_major = "#"
+    
+    for n in dictionary_sizes:
+        d = {getUuid(): getUuid() for _ in range(n)}
+        last_key = tuple(d)[-1]
+        d_other = dict(d)
+        d_other[last_key] = getUuid()
+        
+        for benchmark in benchmarks:
+            print(sep_major * sep_n)
+            
+            for klass in (dict, frozendict):
+                if benchmark == "differs in hash" and klass is dict:
+                    continue
+                
+                o = klass(d)
+                
+                if benchmark == "equal":
+                    o2 = klass(d)
+                else:
+                    o2 = klass(d_other)
+                
+                if benchmark == "differs in hash":
+                    hash(o)
+                    hash(o2)
+                
+                bench_res = autorange(
+                    stmt = "o == o2", 
+                    globals = {"o": o, "o2": o2},
+                    number = number,
+                )
+                
+                print(print_tpl.format(
+                    name = "`{}`;".format(benchmark), 
+                    keys = "str", 
+                    size = n, 
+                    type = klass.__name__, 
+                    time = bench_res[0],
+                    sigma = bench_res[1],  
+                ))
+    
+    print(sep_major * sep_n)
+
+
+def main_take(number):
+    # freezes a temporary dict, that is copied by the constructor or
+    # moved by take(). The copy of the dict is timed alone too, since
+    # every statement makes one
+    dictionary_sizes = (5, 1000, 100000)
+    
+    print_tpl = (
+        "Name: {name: <25} Size: {size: >7}; Keys: {keys: >3}; " +
+        "Type: {type: >10}; Time: {time:.2e}; Sigma: {sigma:.0e}"
+    )
+    
+    benchmarks = (
+        ("d.copy()", "d.copy()"),
+        ("klass(d2)", "d2 = d.copy(); klass(d2)"),
+        ("klass(d.copy())", "klass(d.copy())"),
+        ("klass.take(d.copy())", "klass.take(d.copy())"),
+    )
+    
+    sep_n = 72
+    sep_major = "#"
+    
+    for n in dictionary_sizes:
+        d = {getUuid(): getUuid() for _ in range(n)}
+        print(sep_major * sep_n)
+        
+        for (name, stmt) in benchmarks:
+            bench_res = autorange(
+                stmt = stmt, 
+                globals = {"d": d, "klass": frozendict},
+                number = number,
+            )
+            
+            print(print_tpl.format(
+                name = "`{}`;".format(name), 
+                keys = "str", 
+                size = n, 
+                type = frozendict.__name__, 
+                time = bench_res[0],
+                sigma = bench_res[1],  
+            ))
+    
+    print(sep_major * sep_n)
 
 
 if __name__ == "__main__":
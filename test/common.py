@@ -1,5 +1,11 @@
+import functools
+import gc
+import itertools
+import operator
 import pickle
 import sys
+import weakref
+from collections import namedtuple
 from collections.abc import MutableMapping
 from copy import deepcopy
 
@@ -12,6 +18,10 @@ pyversion_major = pyversion[0]
 pyversion_minor = pyversion[1]
 
 
+class CycleKey:
+    pass
+
+
 class Map(MutableMapping):
     def __init__(self, *args, **kwargs):
         self._dict = dict(*args, **kwargs)
@@ -32,6 +42,42 @@ class Map(MutableMapping):
         return len(self._dict)
 
 
+class BadHash:
+    def __init__(self, x, h):
+        self.x = x
+        self.h = h
+
+    def __hash__(self):
+        return self.h
+
+    def __eq__(self, other):
+        return isinstance(other, BadHash) and self.x == other.x
+
+
+class HashError:
+    def __hash__(self):
+        raise ValueError("hash error")
+
+
+class StrEqual:
+    def __init__(self, s):
+        self.s = s
+
+    def __hash__(self):
+        return hash(self.s)
+
+    def __eq__(self, other):
+        return other == self.s
+
+
+class CaseInsensitiveStr(str):
+    def __hash__(self):
+        return hash(self.lower())
+
+    def __eq__(self, other):
+        return isinstance(other, str) and self.lower() == other.lower()
+
+
 # noinspection PyMethodMayBeStatic
 class FrozendictCommonTest(FrozendictTestBase):
     @property
@@ -112,6 +158,28 @@ class FrozendictCommonTest(FrozendictTestBase):
     def test_equals_dict(self, fd, fd_dict):
         assert fd == fd_dict
 
+    def test_equals_hashed(self, fd, fd_dict):
+        fd_other = fd.set("Hicks", "Mitch")
+        hash(fd)
+        hash(fd_other)
+        assert fd != fd_other
+        assert not (fd == fd_other)
+        fd_same = self.FrozendictClass(fd_dict)
+        hash(fd_same)
+        assert fd == fd_same
+        assert self.FrozendictClass({1: 1}) == self.FrozendictClass({1: 1.0})
+
+    def test_equals_same_keys(self, fd, fd_dict):
+        assert fd == fd.set("Hicks", "Bill")
+        assert fd != fd.set("Hicks", "Mitch")
+        assert fd.set("Hicks", "Mitch") == dict(fd_dict, Hicks="Mitch")
+        dict_hole = dict(fd_dict, Brignano="Enrico")
+        del dict_hole["Brignano"]
+        assert fd == dict_hole
+        del dict_hole["Guzzanti"]
+        dict_hole["Guzzanti"] = "Corrado"
+        assert fd == dict_hole
+
     @pytest.mark.parametrize(
             "protocol",
             range(pickle.HIGHEST_PROTOCOL + 1)
@@ -128,6 +196,52 @@ class FrozendictCommonTest(FrozendictTestBase):
     def test_todict(self, fd, fd_dict):
         assert dict(fd) == fd_dict
 
+    @pytest.mark.parametrize("size", [1, 5, 8, 100])
+    def test_to_dict(self, size):
+        fd_dict = {str(i): i for i in range(size + 1)}
+        # leaves a dummy in the indices
+        fd_dict.popitem()
+        fd = self.FrozendictClass(fd_dict)
+        d = fd.to_dict()
+        assert type(d) is dict
+        assert d == fd_dict
+        assert list(d) == list(fd_dict)
+        del d["0"]
+        d[1] = 2
+        d[str(size)] = size
+        assert d[1] == 2
+        assert d[str(size)] == size
+        assert "0" not in d
+        assert fd == fd_dict
+
+    def test_to_dict_deep(self, fd_dict):
+        inner = self.FrozendictClass(a=self.FrozendictClass(b=1))
+        fd = self.FrozendictClass(fd_dict, inner=inner)
+        assert type(fd.to_dict()["inner"]) is self.FrozendictClass
+        d = fd.to_dict(deep=True)
+        assert d == dict(fd_dict, inner={"a": {"b": 1}})
+        assert type(d["inner"]) is dict
+        assert type(d["inner"]["a"]) is dict
+        assert any(type(key) is self.FrozendictClass for key in d)
+
+    def test_to_dict_schema(self):
+        person = self.FrozendictClass.schema(("name", "surname"))
+        d = person(("Bill", "Hicks")).to_dict()
+        assert d == {"name": "Bill", "surname": "Hicks"}
+        d[1] = 2
+        assert d["surname"] == "Hicks"
+
+    def test_reduce_dict(self, fd, fd_dict):
+        d = fd.__reduce__()[1][0]
+        assert d == fd_dict
+        del d["Hicks"]
+        d[1] = 2
+        assert d == {
+            "Guzzanti": "Corrado",
+            self.FrozendictClass({1: 2}): "frozen",
+            1: 2,
+        }
+
     def test_get(self, fd):
         assert fd.get("Guzzanti") == "Corrado"
 
@@ -271,6 +385,43 @@ class FrozendictCommonTest(FrozendictTestBase):
         res = frozenset(fd_dict.items()) ^ frozenset(fd_dict_2.items())
         assert fd.items() ^ fd2.items() == res
 
+    def test_and_items_keys(self):
+        fd_items = self.FrozendictClass({"a": [1], "b": 0})
+        fd_keys = self.FrozendictClass(b=0)
+        
+        if not self.is_mapping_implemented:
+            # the dict views of python < 3.10 hash all the items
+            return
+        
+        # no item is a key, so the unhashable items are not hashed
+        assert fd_items.items() & fd_keys.keys() == set()
+        assert fd_keys.keys() & fd_items.items() == set()
+        assert fd_items.items() & fd_items.keys() == set()
+
+    @pytest.mark.parametrize("op", [
+        operator.sub,
+        operator.or_,
+        operator.xor,
+    ])
+    def test_set_op_items_keys(self, op):
+        fd_items = self.FrozendictClass({"a": 1, "b": 0})
+        fd_keys = self.FrozendictClass(b=0, c=2)
+        dict_items = dict(fd_items)
+        dict_keys = dict(fd_keys)
+        
+        res = op(dict_items.items(), dict_keys.keys())
+        assert op(fd_items.items(), fd_keys.keys()) == res
+        res = op(dict_keys.keys(), dict_items.items())
+        assert op(fd_keys.keys(), fd_items.items()) == res
+        
+        fd_unhashable = fd_items.set("a", [1])
+        
+        with pytest.raises(TypeError):
+            op(fd_unhashable.items(), fd_keys.keys())
+        
+        with pytest.raises(TypeError):
+            op(fd_keys.keys(), fd_unhashable.items())
+
     @pytest.mark.parametrize(
             "protocol",
             range(pickle.HIGHEST_PROTOCOL + 1)
@@ -381,6 +532,56 @@ class FrozendictCommonTest(FrozendictTestBase):
         assert hash(fd)
         assert hash(fd) == hash(fd_eq)
 
+    def test_hash_is_frozenset_of_items(self, fd, fd_empty):
+        assert hash(fd) == hash(frozenset(fd.items()))
+        assert hash(fd_empty) == hash(frozenset())
+
+    def test_hash_derived(self, fd, fd_dict):
+        hash(fd)
+        key = tuple(fd_dict)[-1]
+        
+        fds = (
+            fd.set(key, 1000), 
+            fd.set("new", 1000), 
+            fd.setdefault("new", 1000), 
+            fd.delete(key), 
+            fd | {key: 1000, "new": 1000}, 
+        )
+        
+        for fd_derived in fds:
+            expected = hash(frozenset(fd_derived.items()))
+            assert hash(fd_derived) == expected
+
+    def test_hash_derived_unhashable(self, fd):
+        hash(fd)
+        fd_unhashable = fd.set("new", [])
+        
+        with pytest.raises(TypeError):
+            hash(fd_unhashable)
+
+    def test_hash_derived_error(self, fd):
+        hash(fd)
+        
+        # the error of the value hash is raised only by hash(), as if the
+        # hash of fd was not cached
+        fd_error = fd.set("new", HashError())
+        assert fd_error["new"].__class__ is HashError
+        
+        with pytest.raises(ValueError):
+            hash(fd_error)
+        
+        fd_error = fd.setdefault("new", HashError())
+        
+        with pytest.raises(ValueError):
+            hash(fd_error)
+        
+        fd_error = fd | {"new": HashError()}
+        
+        with pytest.raises(ValueError):
+            hash(fd_error)
+        
+        hash(fd_error.delete("new"))
+
     def test_unhashable_value(self, fd_unhashable):
         with pytest.raises(TypeError):
             hash(fd_unhashable)
@@ -422,6 +623,777 @@ class FrozendictCommonTest(FrozendictTestBase):
         fd3 = f2.delete("a")
         assert fd3 == fd_dict
 
+    def test_set_many(self, fd, fd_dict):
+        items = {"Guzzanti": "Sabina", "a": "b", 1: 2}
+        fd_dict.update(items)
+        assert fd.set_many(items) == fd_dict
+        assert fd.set_many(items.items()) == fd_dict
+        assert fd.set_many(iter(items.items())) == fd_dict
+        assert fd.set_many({}) == fd
+        assert fd.set_many(items)[1] == 2
+
+    def test_set_many_big(self, fd, fd_dict):
+        items = {i: i for i in range(100)}
+        fd_dict.update(items)
+        fd_big = fd.set_many(items)
+        assert fd_big == fd_dict
+        assert tuple(fd_big) == tuple(fd_dict)
+
+    def test_set_many_bad_seq(self, fd):
+        with pytest.raises(TypeError):
+            fd.set_many([1])
+
+        with pytest.raises(ValueError):
+            fd.set_many([(1, 2, 3)])
+
+    def test_delete_many(self, fd, fd_dict):
+        del fd_dict["Guzzanti"]
+        del fd_dict["Hicks"]
+        assert fd.delete_many(("Guzzanti", "Hicks", "Hicks")) == fd_dict
+        assert fd.delete_many(iter(("Guzzanti", "Hicks"))) == fd_dict
+        assert fd.delete_many(()) is fd
+        assert fd.delete_many(tuple(fd)) == {}
+
+    def test_delete_many_missing(self, fd):
+        with pytest.raises(KeyError):
+            fd.delete_many(("Guzzanti", "Brignano"))
+
+    def test_set_many_key_equal_to_str(self, fd, fd_dict):
+        key = StrEqual("Brignano")
+        items = [(1, 2), (key, "Enrico"), ("Brignano", "Giorgio")]
+        fd_dict.update(items)
+        fd2 = fd.set_many(items)
+        assert fd2 == fd_dict
+        assert len(fd2) == len(fd_dict)
+        assert fd2["Brignano"] == "Giorgio"
+
+        fd3 = fd.update({1: 2, key: "Enrico"}, Brignano="Giorgio")
+        assert fd3 == fd_dict
+        assert len(fd3) == len(fd_dict)
+
+    def test_set_many_str_subclass_key(self):
+        d = {f"k{i}": i for i in range(20)}
+        key = CaseInsensitiveStr("X")
+
+        for fd in (
+            self.FrozendictClass(d),
+            self.FrozendictClass.take(dict(d)),
+            self.FrozendictClass(d).set("k0", 0),
+        ):
+            assert fd.update({key: 1}).get("x") == 1
+            assert fd.set_many({key: 1}).get("x") == 1
+            assert fd.set(key, 1).get("x") == 1
+            assert fd.setdefault(key, 1).get("x") == 1
+            assert (fd | {key: 1}).get("x") == 1
+            evolver = fd.evolver()
+            evolver[key] = 1
+            assert evolver.finish().get("x") == 1
+
+    def test_update_kwargs(self, fd, fd_dict):
+        assert fd.update(Brignano="Enrico") == dict(fd_dict, Brignano="Enrico")
+        assert fd.update() == fd
+
+    def test_hash_derived_many(self, fd, fd_dict):
+        hash(fd)
+        key = tuple(fd_dict)[-1]
+
+        fds = (
+            fd.set_many({key: 1000, "new": 1000}),
+            fd.set_many(((key, 1000), ("new", 1000))),
+            fd.delete_many((key, )),
+            fd.update(new=1000),
+        )
+
+        for fd_derived in fds:
+            expected = hash(frozenset(fd_derived.items()))
+            assert hash(fd_derived) == expected
+
+    def test_and(self, fd, fd_dict):
+        del fd_dict["Hicks"]
+        assert fd & dict.fromkeys((*fd_dict, "Brignano")) == fd_dict
+        assert fd & (set(fd_dict) | {"Brignano"}) == fd_dict
+        assert fd & frozenset(fd) is fd
+        assert fd & fd.keys() is fd
+        assert fd & fd_dict.keys() == fd_dict
+        assert fd & self.FrozendictClass(fd).keys() == fd
+        assert fd & {} == {}
+        assert tuple(fd & dict.fromkeys(reversed(tuple(fd)))) == tuple(fd)
+
+    def test_and_big(self, fd, fd_dict):
+        big = set(range(100)) | {"Guzzanti"}
+        assert fd & big == {"Guzzanti": "Corrado"}
+        assert fd & dict.fromkeys(big) == {"Guzzanti": "Corrado"}
+
+    def test_intersection(self, fd, fd_dict):
+        del fd_dict["Hicks"]
+        assert fd.intersection(fd_dict) == fd_dict
+        assert fd.intersection(iter(("Guzzanti", "Brignano"))) == {"Guzzanti": "Corrado"}
+        assert fd.intersection(fd_dict, ["Hicks"]) == {}
+        assert fd.intersection() is fd
+        assert fd.intersection(fd.keys()) is fd
+
+    def test_sub(self, fd, fd_dict):
+        del fd_dict["Hicks"]
+        assert fd - {"Hicks", "Brignano"} == fd_dict
+        assert fd - {"Hicks": None} == fd_dict
+        assert fd - {"Brignano"} is fd
+        assert fd - frozenset(fd) == {}
+        assert fd - fd.keys() == {}
+        assert fd - fd_dict.keys() == {"Hicks": "Bill"}
+
+    def test_difference(self, fd, fd_dict):
+        del fd_dict["Hicks"]
+        assert fd.difference(["Hicks"]) == fd_dict
+        assert fd.difference(["Hicks"], iter(fd_dict)) == {}
+        assert fd.difference() is fd
+
+    def test_xor(self, fd, fd_dict):
+        other = {"Hicks": "Bill", "Brignano": "Enrico"}
+        del fd_dict["Hicks"]
+        fd_dict["Brignano"] = "Enrico"
+        res = fd ^ other
+        assert res == fd_dict
+        assert tuple(res) == tuple(fd_dict)
+        assert fd ^ {} is fd
+        assert fd ^ fd == {}
+
+    def test_symmetric_difference(self, fd, fd_dict):
+        del fd_dict["Guzzanti"]
+        assert fd.symmetric_difference([("Guzzanti", "Sabina")]) == fd_dict
+
+    def test_union(self, fd, fd_dict):
+        fd_dict["Brignano"] = "Enrico"
+        fd_dict[1] = 2
+        assert fd.union({"Brignano": "Enrico"}, [(1, 2)]) == fd_dict
+        assert fd.union() is fd
+        assert fd.union({}) is fd
+
+    def test_set_operators_not_implemented(self, fd):
+        with pytest.raises(TypeError):
+            fd & ["Guzzanti"]
+
+        with pytest.raises(TypeError):
+            fd - ["Guzzanti"]
+
+        with pytest.raises(TypeError):
+            fd ^ {"Guzzanti"}
+
+        with pytest.raises(TypeError):
+            fd <= {"Guzzanti"}
+
+    def test_subset(self, fd, fd_dict):
+        sub = dict(fd_dict)
+        del sub["Hicks"]
+        assert sub <= fd
+        assert sub < fd
+        assert fd >= sub
+        assert fd > sub
+        assert fd <= fd_dict
+        assert not fd < fd_dict
+        assert not fd <= sub
+        assert not fd > fd_dict
+        assert fd.issubset(fd_dict)
+        assert fd.issuperset(sub.items())
+        assert not fd.issuperset({"Hicks": "Mitch"})
+
+    def test_subset_values(self, fd, fd_dict):
+        fd_dict["Hicks"] = "Mitch"
+        fd_dict["Brignano"] = "Enrico"
+        assert not fd <= fd_dict
+        assert not fd_dict >= fd
+
+    def test_hash_derived_set_operations(self, fd, fd_dict):
+        hash(fd)
+
+        fds = (
+            fd & {"Guzzanti"},
+            fd - {"Guzzanti"},
+            fd ^ {"Guzzanti": "Corrado", "Brignano": "Enrico"},
+        )
+
+        for fd_derived in fds:
+            expected = hash(frozenset(fd_derived.items()))
+            assert hash(fd_derived) == expected
+
+    def test_keys_frozenset(self, fd, fd_dict):
+        res = fd.keys_frozenset()
+        assert res == frozenset(fd_dict)
+        assert type(res) is frozenset
+        
+        if self.c_ext:
+            assert fd.keys_frozenset() is res
+        
+        assert self.FrozendictClass().keys_frozenset() == frozenset()
+
+    def test_keys_set_operations(self, fd, fd_dict):
+        other = {"Guzzanti": 1, "Brignano": 2}
+        
+        for op in ("__and__", "__or__", "__sub__", "__xor__"):
+            for operand in (other.keys(), set(other), ["Brignano"]):
+                res = getattr(fd.keys(), op)(operand)
+                assert type(res) is set
+                assert res == getattr(fd_dict.keys(), op)(operand)
+            
+            res = getattr(fd.keys(), op)(fd.delete("Guzzanti").keys())
+            expected = getattr(fd_dict.keys(), op)(fd_dict.keys() - {"Guzzanti"})
+            assert res == expected
+        
+        assert set(other) - fd.keys() == {"Brignano"}
+        assert ["Brignano"] | fd.keys() == fd_dict.keys() | {"Brignano"}
+
+    def test_items_set_operations(self, fd, fd_dict):
+        other = {"Guzzanti": "Corrado", "Hicks": "Mitch"}
+        
+        for op in ("__and__", "__or__", "__sub__", "__xor__"):
+            for operand in (other.items(), set(other.items()), [("Hicks", "Bill")]):
+                res = getattr(fd.items(), op)(operand)
+                assert type(res) is set
+                assert res == getattr(fd_dict.items(), op)(operand)
+        
+
+    def test_views_compare(self, fd, fd_dict):
+        assert fd.keys() == fd_dict.keys()
+        assert fd.keys() == set(fd_dict)
+        assert fd.keys() == self.FrozendictClass(fd).keys()
+        assert fd.keys() != fd.delete("Guzzanti").keys()
+        assert fd.keys() > fd.delete("Guzzanti").keys()
+        assert fd.keys() >= set(fd_dict)
+        assert not fd.keys() < set(fd_dict)
+        assert fd.keys() <= frozenset(fd_dict) | {"Brignano"}
+        assert fd.items() == fd_dict.items()
+        assert fd.items() != fd.set("Hicks", "Mitch").items()
+        assert fd.items() >= fd.delete("Hicks").items()
+        assert not fd.items() <= fd.set("Hicks", "Mitch").items()
+        assert fd.items() < fd.set("Brignano", "Enrico").items()
+        assert fd.items() == set(fd_dict.items())
+        assert (fd.keys() == fd.items()) == (fd_dict.keys() == fd_dict.items())
+
+    def test_optimize(self, fd, fd_dict):
+        assert fd.optimize() is fd
+        assert fd.optimize() is fd
+        assert fd == fd_dict
+        
+        for k, v in fd_dict.items():
+            assert fd[k] == v
+            assert k in fd
+        
+        assert "Brignano" not in fd
+        assert fd.get(1) is None
+        assert fd.set("Brignano", "Enrico") == dict(fd_dict, Brignano="Enrico")
+        assert fd.set(1, 2)[1] == 2
+        assert 1 not in fd
+        del fd_dict["Hicks"]
+        assert fd.delete("Hicks") == fd_dict
+
+    @pytest.mark.parametrize(
+            "index",
+            ("perfect", "groups")
+    )
+    def test_optimize_big(self, index):
+        d = {i: i for i in range(1000)}
+        d.update({str(i): i for i in range(1000)})
+        fd = self.FrozendictClass(d).optimize(index=index)
+        
+        for k, v in d.items():
+            assert fd[k] == v
+        
+        for k in (-1, 1000, "-1", "1000", 0.5, (1, )):
+            assert k not in fd
+        
+        assert fd == d
+        assert dict(fd) == d
+
+    @pytest.mark.parametrize(
+            "index",
+            ("perfect", "groups")
+    )
+    def test_optimize_same_hash(self, index):
+        d = {BadHash(i, 7): i for i in range(10)}
+        d.update({BadHash(i, i): i for i in range(10, 100)})
+        fd = self.FrozendictClass(d).optimize(index=index)
+        
+        for k, v in d.items():
+            assert fd[k] == v
+        
+        assert BadHash(100, 7) not in fd
+        assert BadHash(100, 50) not in fd
+
+    def test_optimize_bad_index(self, fd):
+        with pytest.raises(ValueError):
+            fd.optimize(index="Guzzanti")
+        
+        with pytest.raises(TypeError):
+            fd.optimize("groups")
+
+    def test_optimize_sizeof(self):
+        if not self.c_ext:
+            pytest.skip("indexes are implemented only in the C extension")
+        
+        for index in ("perfect", "groups"):
+            fd = self.FrozendictClass({i: i for i in range(100)})
+            size = fd.__sizeof__()
+            assert fd.optimize(index=index).__sizeof__() > size
+
+    def test_sizeof_exact(self):
+        if not self.c_ext:
+            pytest.skip("exact tables are implemented only in the C extension")
+        
+        d = {str(i): i for i in range(100)}
+        size = self.FrozendictClass(d).__sizeof__()
+        assert size < d.__sizeof__()
+        assert self.FrozendictClass(d.items()).__sizeof__() == size
+        assert self.FrozendictClass(list(d.items()) * 2).__sizeof__() == size
+        assert self.FrozendictClass(**d).__sizeof__() == size
+        assert self.FrozendictClass.fromkeys(list(d), 0).__sizeof__() == size
+
+    @pytest.mark.parametrize("size", range(1, 11))
+    def test_small(self, size):
+        d = {str(i): i for i in range(size // 2)}
+        d.update({BadHash(i, 7): i for i in range(size // 2, size)})
+        fd = self.FrozendictClass(d)
+
+        assert fd == d
+        assert list(fd) == list(d)
+        assert fd.key(-1) == list(d)[-1]
+
+        for k, v in d.items():
+            assert fd[k] == v
+
+        assert str(size) not in fd
+        assert BadHash(size, 7) not in fd
+        assert pickle.loads(pickle.dumps(fd, protocol=-1)) == fd
+        assert fd.set(str(size), -1) == {**d, str(size): -1}
+        assert fd.delete(list(d)[0]) == dict(list(d.items())[1:])
+        assert fd.optimize() == d
+
+    def test_schema(self):
+        keys = ("a", BadHash(1, 7), 3)
+        schema = self.FrozendictClass.schema(keys)
+        d = dict(zip(keys, ("x", [1], None)))
+        fd = schema(iter(("x", [1], None)))
+
+        assert type(fd) is self.FrozendictClass
+        assert schema.keys == keys
+        assert fd == d
+        assert d == fd
+        assert fd == schema(["x", [1], None])
+        assert fd != schema(["x", [2], None])
+        assert list(fd.items()) == list(d.items())
+
+        if self.is_reversed_implemented:
+            assert list(reversed(fd)) == list(reversed(keys))
+
+        assert fd.value(-2) == [1]
+        assert fd.item(0) == ("a", "x")
+        assert "b" not in fd
+        assert fd.set("a", "y") == {**d, "a": "y"}
+        assert fd.delete(3) == {"a": "x", keys[1]: [1]}
+        assert fd | {"b": 0} == {**d, "b": 0}
+        assert pickle.loads(pickle.dumps(fd, protocol=-1)) == fd
+        assert fd.optimize() == d
+
+        fd_hashable = schema([1, 2, 3])
+        fd_dict = self.FrozendictClass(zip(keys, (1, 2, 3)))
+        assert hash(fd_hashable) == hash(fd_dict)
+
+    def test_set_existing_key_big(self):
+        d = {str(i): i for i in range(20)}
+        fd = self.FrozendictClass(d)
+        fd_set = fd.set("3", [3])
+        fd_set_2 = fd_set.set("4", 4.0)
+
+        assert fd_set == {**d, "3": [3]}
+        assert fd_set_2 == {**d, "3": [3], "4": 4.0}
+        assert fd_set_2.set("new", 0) == {**fd_set_2, "new": 0}
+        assert fd_set_2.delete("0") == {k: v for k, v in fd_set_2.items() if k != "0"}
+        assert fd_set_2 | {"1": 1, "2": 2} == {**fd_set_2, "1": 1, "2": 2}
+        assert fd_set_2.update(a=1) == {**fd_set_2, "a": 1}
+        assert fd_set_2.set_many({"5": 5}) == {**fd_set_2, "5": 5}
+        assert pickle.loads(pickle.dumps(fd_set_2, protocol=-1)) == fd_set_2
+        assert fd.set("4", 4.0) == fd.set_many({"4": 4.0})
+
+        fd_hashable = fd.set("3", 0)
+        assert hash(fd_hashable) == hash(self.FrozendictClass({**d, "3": 0}))
+        assert hash(fd_hashable.set("3", 3)) == hash(fd)
+
+    def test_set_existing_key_sizeof(self):
+        if not self.c_ext or self.is_subclass:
+            pytest.skip(
+                "the shared keys are implemented only in the C extension, "
+                "and not for subclasses"
+            )
+
+        fd = self.FrozendictClass({str(i): i for i in range(100)})
+        fd_set = fd.set("1", 0)
+
+        # fd_set_2 shares the keys of fd_set
+        fd_set_2 = fd_set.set("2", 0)
+        assert fd_set_2.__sizeof__() < fd.__sizeof__() / 2
+
+    def test_schema_empty(self):
+        schema = self.FrozendictClass.schema([])
+        assert schema([]) == self.FrozendictClass()
+
+    def test_schema_sizeof(self):
+        if not self.c_ext or self.is_subclass:
+            pytest.skip(
+                "the shared keys are implemented only in the C extension, "
+                "and not for subclasses"
+            )
+        
+
+        keys = [str(i) for i in range(8)]
+        fd = self.FrozendictClass.schema(keys)(range(8))
+        fd_dict = self.FrozendictClass(zip(keys, range(8)))
+        assert fd.__sizeof__() < fd_dict.__sizeof__()
+
+    def test_schema_duplicate_keys(self):
+        with pytest.raises(ValueError):
+            self.FrozendictClass.schema("aba")
+
+    def test_schema_key_equal_to_str(self):
+        key = StrEqual("a")
+
+        with pytest.raises(ValueError):
+            self.FrozendictClass.schema((1, key, "a"))
+
+        fd = self.FrozendictClass.schema((1, key, "b"))("xyz")
+        assert fd == {1: "x", "a": "y", "b": "z"}
+        assert fd["a"] == "y"
+        assert fd.set("a", 0) == {1: "x", "a": 0, "b": "z"}
+
+    @pytest.mark.parametrize("values", ([1], [1, 2, 3]))
+    def test_schema_wrong_size(self, values):
+        schema = self.FrozendictClass.schema("ab")
+
+        with pytest.raises(ValueError):
+            schema(values)
+
+    def test_builder(self, fd_dict):
+        builder = self.FrozendictClass.builder(reserve=2)
+        
+        for k, v in fd_dict.items():
+            builder[k] = v
+        
+        builder["Brignano"] = "Enrico"
+        del builder["Brignano"]
+        assert len(builder) == len(fd_dict)
+        assert builder["Hicks"] == "Bill"
+        assert "Hicks" in builder
+        assert "Brignano" not in builder
+        res = builder.finish()
+        assert type(res) is self.FrozendictClass
+        assert res == fd_dict
+        assert list(res) == list(fd_dict)
+        assert builder.finish() is res
+
+    def test_builder_update(self, fd_dict):
+        builder = self.FrozendictClass.builder()
+        builder.update(fd_dict, Brignano="Enrico")
+        builder.update([(1, 2)])
+        res = builder.finish()
+        assert res == {**fd_dict, "Brignano": "Enrico", 1: 2}
+        assert res[1] == 2
+
+    def test_builder_update_key_equal_to_str(self, fd_dict):
+        key = StrEqual("Brignano")
+        builder = self.FrozendictClass.builder()
+        builder.update({1: 2, key: "Enrico"}, Brignano="Giorgio")
+        builder.update(fd_dict)
+        assert len(builder) == len(fd_dict) + 2
+        assert builder["Brignano"] == "Giorgio"
+        builder["Brignano"] = "Enrico"
+        res = builder.finish()
+        assert res == {**fd_dict, 1: 2, "Brignano": "Enrico"}
+        assert len(res) == len(fd_dict) + 2
+
+    def test_builder_many_deletions(self):
+        builder = self.FrozendictClass.builder()
+        
+        for i in range(100):
+            builder[str(i)] = i
+        
+        for i in range(0, 100, 2):
+            del builder[str(i)]
+        
+        builder["0"] = 0
+        res = builder.finish()
+        expected = {str(i): i for i in range(1, 100, 2)}
+        expected["0"] = 0
+        assert res == expected
+        assert list(res) == list(expected)
+
+    def test_builder_empty(self):
+        assert self.FrozendictClass.builder().finish() == {}
+        builder = self.FrozendictClass.builder()
+        builder["a"] = 1
+        del builder["a"]
+        assert builder.finish() == self.FrozendictClass()
+
+    def test_builder_bad(self, fd):
+        with pytest.raises(ValueError):
+            self.FrozendictClass.builder(reserve=-1)
+        
+        builder = fd.evolver()
+        
+        with pytest.raises(KeyError):
+            del builder["Brignano"]
+        
+        with pytest.raises(KeyError):
+            builder["Brignano"]
+        
+        with pytest.raises(TypeError):
+            builder[[]] = 1
+        
+        with pytest.raises(TypeError):
+            hash(builder)
+        
+        assert builder.finish() == fd
+
+    def test_evolver(self, fd, fd_dict):
+        evolver = fd.evolver()
+        assert evolver.finish() is fd
+        evolver["Hicks"] = "Mitch"
+        del evolver["Guzzanti"]
+        res = evolver.finish()
+        assert type(res) is self.FrozendictClass
+        assert res == {"Hicks": "Mitch", self.FrozendictClass({1: 2}): "frozen"}
+        assert fd == fd_dict
+        evolver["Brignano"] = "Enrico"
+        assert evolver.finish() == dict(res, Brignano="Enrico")
+        assert res == {"Hicks": "Mitch", self.FrozendictClass({1: 2}): "frozen"}
+
+    def test_take(self, fd_dict):
+        d = dict(fd_dict)
+        res = self.FrozendictClass.take(d)
+        assert type(res) is self.FrozendictClass
+        assert res == fd_dict
+        assert list(res) == list(fd_dict)
+        assert d == {}
+        d["Brignano"] = "Enrico"
+        assert d == {"Brignano": "Enrico"}
+
+    def test_take_big(self):
+        d = {str(i): i for i in range(100)}
+        
+        for i in range(0, 100, 3):
+            del d[str(i)]
+        
+        d[1] = 2
+        d_copy = dict(d)
+        res = self.FrozendictClass.take(d)
+        assert res == d_copy
+        assert list(res) == list(d_copy)
+        assert res["4"] == 4
+        assert "3" not in res
+        assert d == {}
+        assert hash(self.FrozendictClass(a=res.set(1, 3))) != -1
+
+    def test_take_shared_keys(self):
+        class A:
+            pass
+        
+        a = A()
+        a.x = 1
+        a.y = 2
+        res = self.FrozendictClass.take(vars(a))
+        assert res == {"x": 1, "y": 2}
+        assert vars(a) == {}
+
+    def test_take_empty(self):
+        d = {}
+        assert self.FrozendictClass.take(d) == {}
+        assert d == {}
+
+    def test_take_bad(self, fd):
+        class DictSubclass(dict):
+            pass
+        
+        for arg in (fd, [("a", 1)], DictSubclass(a=1)):
+            with pytest.raises(TypeError):
+                self.FrozendictClass.take(arg)
+
+    def test_intern(self, fd_dict):
+        fd = self.FrozendictClass(fd_dict, intern_test=1)
+        fd_equal = self.FrozendictClass(fd_dict, intern_test=1)
+        assert fd is not fd_equal
+        assert self.FrozendictClass.intern(fd) is fd
+        assert self.FrozendictClass.intern(fd_equal) is fd
+        fd_true = self.FrozendictClass(fd_dict, intern_test=True)
+        assert self.FrozendictClass.intern(fd_true) is fd_true
+        fd_reversed = self.FrozendictClass(reversed(tuple(fd.items())))
+        assert self.FrozendictClass.intern(fd_reversed) is fd_reversed
+
+    def test_intern_same_hash(self, fd_dict):
+        fd_true = self.FrozendictClass(fd_dict, intern_hash_test=True)
+        fd_one = self.FrozendictClass(fd_dict, intern_hash_test=1)
+        assert hash(fd_true) == hash(fd_one)
+        assert self.FrozendictClass.intern(fd_true) is fd_true
+        assert self.FrozendictClass.intern(fd_one) is fd_one
+        fd_one_equal = self.FrozendictClass(fd_dict, intern_hash_test=1)
+        assert self.FrozendictClass.intern(fd_one_equal) is fd_one
+        fd_true_equal = self.FrozendictClass(fd_dict, intern_hash_test=True)
+        assert self.FrozendictClass.intern(fd_true_equal) is fd_true
+
+    def test_intern_subclass_first(self):
+        class Sub(self.FrozendictClass):
+            pass
+        
+        fd_sub = Sub(intern_sub_test=1)
+        fd = self.FrozendictClass(intern_sub_test=1)
+        assert self.FrozendictClass.intern(fd_sub) is fd_sub
+        assert self.FrozendictClass.intern(fd) is fd
+        assert self.FrozendictClass.intern(
+            self.FrozendictClass(intern_sub_test=1)
+        ) is fd
+        del fd_sub
+        gc.collect()
+        assert self.FrozendictClass.intern(fd) is fd
+
+    def test_intern_weak(self):
+        fd = self.FrozendictClass(intern_weak_test=1)
+        ref = weakref.ref(fd)
+        assert ref() is fd
+        assert self.FrozendictClass.intern(fd) is fd
+        del fd
+        gc.collect()
+        assert ref() is None
+        fd_equal = self.FrozendictClass(intern_weak_test=1)
+        assert self.FrozendictClass.intern(fd_equal) is fd_equal
+
+    def test_intern_bad(self):
+        for arg in ({"a": 1}, (1, 2)):
+            with pytest.raises(TypeError):
+                self.FrozendictClass.intern(arg)
+        
+        with pytest.raises(TypeError):
+            self.FrozendictClass.intern(self.FrozendictClass(a=[]))
+
+    def test_from_object(self):
+        class A:
+            def __init__(self, x, y):
+                self.x = x
+                self.y = y
+        
+        A(1, 2)
+        a = A("Hicks", [1])
+        res = self.FrozendictClass.from_object(a)
+        assert type(res) is self.FrozendictClass
+        assert res == {"x": "Hicks", "y": [1]}
+        assert list(res) == ["x", "y"]
+        assert res["y"] is a.y
+        del a.x
+        assert self.FrozendictClass.from_object(a) == {"y": [1]}
+
+    def test_from_object_slots(self):
+        class A:
+            __slots__ = ("b", "__c", "a")
+            
+            def __init__(self):
+                self.a = 1
+                self._A__c = 2
+        
+        class B(A):
+            __slots__ = ("d", "__dict__")
+            
+            def __init__(self):
+                super().__init__()
+                self.d = 3
+                self.e = 4
+        
+        class Empty:
+            __slots__ = ()
+        
+        res = self.FrozendictClass.from_object(B())
+        assert res == {"_A__c": 2, "a": 1, "d": 3, "e": 4}
+        assert list(res) == ["_A__c", "a", "d", "e"]
+        assert self.FrozendictClass.from_object(Empty()) == {}
+
+    def test_from_object_namedtuple(self):
+        Point = namedtuple("Point", "x y")
+        res = self.FrozendictClass.from_object(Point(1, [2]))
+        assert res == {"x": 1, "y": [2]}
+        assert list(res) == ["x", "y"]
+
+    def test_from_object_bad(self):
+        for arg in (1, "Hicks", (1, 2), [1], object()):
+            with pytest.raises(TypeError):
+                self.FrozendictClass.from_object(arg)
+
+    def test_instance_dict(self):
+        class A:
+            def __init__(self):
+                for i in range(10):
+                    setattr(self, f"a{i}", i)
+        
+        A()
+        a = A()
+        res = self.FrozendictClass(vars(a))
+        assert res == vars(a)
+        assert list(res) == list(vars(a))
+        assert res["a7"] == 7
+        assert "a10" not in res
+        assert hash(res) == hash(self.FrozendictClass(dict(vars(a))))
+
+    def test_temporary_dict(self, fd_dict):
+        d = dict(fd_dict)
+        assert self.FrozendictClass(d) == fd_dict
+        assert d == fd_dict
+        assert self.FrozendictClass(dict(fd_dict)) == fd_dict
+        assert self.FrozendictClass({str(i): i for i in range(100)}) == {
+            str(i): i for i in range(100)
+        }
+
+    def test_temporary_dict_reused(self, fd_dict):
+        make = functools.partial(self.FrozendictClass, dict(fd_dict))
+        assert make() == fd_dict
+        assert make() == fd_dict
+
+        d = dict(fd_dict)
+        res = list(itertools.starmap(self.FrozendictClass, [(d, )]))
+        assert res == [fd_dict]
+        assert d == fd_dict
+
+    def test_gc_key_cycle_optimized(self):
+        key = CycleKey()
+        key.fd = self.FrozendictClass({key: 1, "a": 2}).optimize()
+        ref = weakref.ref(key)
+        del key
+        gc.collect()
+        assert ref() is None
+
+    def test_gc_key_cycle_small(self):
+        key = CycleKey()
+        key.fd = self.FrozendictClass({key: 1})
+        ref = weakref.ref(key)
+        del key
+        gc.collect()
+        assert ref() is None
+
+    def test_gc_key_cycle_set(self):
+        key = CycleKey()
+        key.fd = self.FrozendictClass.fromkeys([key, *range(20)], 1).set(key, 2)
+        ref = weakref.ref(key)
+        del key
+        gc.collect()
+        assert ref() is None
+
+    def test_gc_key_cycle_split(self):
+        key = CycleKey()
+        key.fd = self.FrozendictClass.schema((key, "a"))((1, 2))
+        ref = weakref.ref(key)
+        del key
+        gc.collect()
+        assert ref() is None
+
+    def test_dealloc_deep(self):
+        fd = self.FrozendictClass()
+        
+        for _ in range(100000):
+            fd = self.FrozendictClass(a=fd)
+        
+        del fd
+
     def test_key(self, fd):
         assert fd.key() == fd.key(0) == "Guzzanti"
         assert fd.key(1) == fd.key(-2) == "Hicks"
@@ -478,9 +1450,10 @@ class FrozendictCommonTest(FrozendictTestBase):
         with pytest.raises(AttributeError):
             fd.popitem()
 
-    def test_update(self, fd):
-        with pytest.raises(AttributeError):
-            fd.update({"Brignano": "Enrico"})
+    def test_update(self, fd, fd_dict):
+        fd2 = fd.update({"Brignano": "Enrico"}, Hicks="Jonah")
+        assert fd2 == {**fd_dict, "Brignano": "Enrico", "Hicks": "Jonah"}
+        assert fd == fd_dict
 
     def test_delattr(self, fd):
         with pytest.raises(AttributeError):
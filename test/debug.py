@@ -6,9 +6,12 @@ import frozendict
 assert frozendict.c_ext
 
 from frozendict import frozendict
+from frozendict import json_dumps, json_loads, deepfreeze, deepthaw
+from frozendict import FreezeError
 from uuid import uuid4
 import pickle
 from copy import copy, deepcopy
+from collections import namedtuple
 from collections.abc import MutableMapping
 import tracemalloc
 import gc
@@ -1064,6 +1067,507 @@ def func_110():
 functions.append(func_110)
 
 
+@trace()
+def func_111():
+    hash(frozendict_class(dict_1))
+
+
+functions.append(func_111)
+
+
+@trace()
+def func_112():
+    try:
+        hash(frozendict_class(dict_unashable))
+    except TypeError:
+        pass
+
+
+functions.append(func_112)
+
+
+@trace()
+def func_113():
+    hash(fd_1.set(1, 2))
+
+
+functions.append(func_113)
+
+
+@trace()
+def func_114():
+    try:
+        hash(fd_1.set(1, []))
+    except TypeError:
+        pass
+
+
+functions.append(func_114)
+
+
+@trace()
+def func_115():
+    hash(fd_1 | dict_1)
+
+
+functions.append(func_115)
+
+
+@trace()
+def func_116():
+    hash(fd_1.set_many(dict_2))
+
+
+functions.append(func_116)
+
+
+@trace()
+def func_117():
+    fd_1.set_many(dict_1_items)
+
+
+functions.append(func_117)
+
+
+@trace()
+def func_118():
+    hash(fd_1.delete_many(tuple(dict_1)[::2]))
+
+
+functions.append(func_118)
+
+
+@trace()
+def func_119():
+    try:
+        fd_1.delete_many((key_in, key_notin))
+    except KeyError:
+        pass
+
+
+functions.append(func_119)
+
+
+@trace()
+def func_120():
+    fd_1.update(dict_2, a=1)
+
+
+functions.append(func_120)
+
+
+@trace()
+def func_121():
+    fd = frozendict_class(dict_1).optimize()
+    fd[key_in]
+    key_notin in fd
+
+
+functions.append(func_121)
+
+
+@trace()
+def func_122():
+    fd = frozendict_class(dict_1).optimize()
+    fd.set(key_in, 1)[key_in]
+    fd.delete(key_in)
+    fd.__reduce__()
+
+
+functions.append(func_122)
+
+
+@trace()
+def func_123():
+    fd = frozendict_class(dict_1).optimize(index="groups")
+    fd[key_in]
+    key_notin in fd
+    fd.set(key_in, 1)[key_in]
+
+
+functions.append(func_123)
+
+
+@trace()
+def func_124():
+    frozendict_class(list(dict_1.items()) * 2)
+    frozendict_class(**dict_1)
+    frozendict_class.fromkeys(dict_1)
+
+
+functions.append(func_124)
+
+
+@trace()
+def func_125():
+    fd = frozendict_class(a=[1], b=2)
+    fd["a"]
+    "c" in fd
+    list(fd.items())
+    fd.set("c", 3).delete("a")
+
+
+functions.append(func_125)
+
+
+def func_126():
+    schema = frozendict_class.schema(("a", "b"))
+    fd = schema(([1], 2))
+    fd["a"]
+    "c" in fd
+    list(fd.items())
+    fd == schema(([1], 2))
+    fd.set("c", 3).delete("a")
+
+
+functions.append(func_126)
+
+
+def func_127():
+    fd = frozendict_class({str(i): [i] for i in range(20)})
+    fd_set = fd.set("1", 1).set("2", 2)
+    fd_set["3"]
+    list(fd_set.items())
+    fd_set | {"4": 4}
+    fd_set.set("c", 3).delete("5")
+
+
+functions.append(func_127)
+
+
+def func_128():
+    fd = frozendict_class({str(i): [i] for i in range(20)})
+    other = {str(i): [i] for i in range(10, 30)}
+    fd & other
+    fd & set(other)
+    fd - other
+    fd.intersection(iter(other), ["1"])
+    fd.difference(other, frozenset("23"))
+    fd ^ other
+    fd.union(other, [("a", 1)])
+    fd <= other
+    fd > fd.delete("1")
+    fd.issuperset(other.items())
+
+
+functions.append(func_128)
+
+
+def func_129():
+    fd = frozendict_class({str(i): i for i in range(20)})
+    other = frozendict_class({str(i): i for i in range(10, 30)})
+    fd.keys_frozenset()
+    fd.keys_frozenset()
+    fd.keys() & other.keys()
+    fd.keys() - set(other)
+    fd.keys() ^ ["a", "1"]
+    fd.keys() | other.keys()
+    fd.keys() == other.keys()
+    fd.keys() <= set(other)
+    fd.items() & other.items()
+    fd.items() - other.items()
+    fd.items() ^ dict(other).items()
+    fd.items() | [("a", 1)]
+    fd.items() >= other.items()
+
+
+functions.append(func_129)
+
+
+def func_130():
+    builder = frozendict_class.builder(reserve=5)
+    
+    for i in range(20):
+        builder[str(i)] = [i]
+    
+    for i in range(0, 20, 3):
+        del builder[str(i)]
+    
+    builder.update({"a": [1]}, b=[2])
+    builder.update([(1, 2)])
+    len(builder)
+    "1" in builder
+    builder["1"]
+    fd = builder.finish()
+    builder.finish()
+    evolver = fd.evolver()
+    evolver.finish()
+    evolver["c"] = [3]
+    del evolver["a"]
+    evolver.finish()
+    evolver["self"] = evolver
+    
+    try:
+        del evolver["Brignano"]
+    except KeyError:
+        pass
+
+
+functions.append(func_130)
+
+def func_131():
+    d = {str(i): [i] for i in range(20)}
+    
+    for i in range(0, 20, 3):
+        del d[str(i)]
+    
+    frozendict_class.take(d)
+    frozendict_class.take({"a": [1], 1: [2]})
+    frozendict_class.take({})
+    frozendict_class({str(i): [i] for i in range(20)})
+    frozendict_class({"a": [1]})
+    
+    try:
+        frozendict_class.take([("a", 1)])
+    except TypeError:
+        pass
+    else:
+        raise ValueError()
+
+functions.append(func_131)
+
+def func_132():
+    fd = frozendict_class(dict_1, a=frozendict_class(b=[1]))
+    fd.to_dict()
+    fd.to_dict(deep=True)
+    frozendict_class().to_dict()
+    frozendict_class.schema(("a", 1))(([1], [2])).to_dict()
+    d = fd.__reduce__()[1][0]
+    d[1] = [2]
+    del d["a"]
+    
+    try:
+        fd.to_dict(True)
+    except TypeError:
+        pass
+    else:
+        raise ValueError()
+
+functions.append(func_132)
+
+def func_133():
+    fd = frozendict_class(dict_1, a=frozendict_class(b=[1, 2.5, None]))
+    json_dumps(fd)
+    json_dumps(fd, sort_keys=True, ensure_ascii=False)
+    json_dumps([fd, ("é", {1: True})], separators=(",", ":"))
+    json_dumps(fd, default=str)
+    json_dumps({"a": object()}, default=str)
+    
+    try:
+        json_dumps(frozendict_class(a=object()))
+    except TypeError:
+        pass
+    else:
+        raise ValueError()
+    
+    try:
+        json_dumps({(1, ): 1})
+    except TypeError:
+        pass
+    else:
+        raise ValueError()
+
+functions.append(func_133)
+
+def func_134():
+    json_loads('{"a": [1, 2.5, null, true, "\\u00e9"], "b": {"c": {}}, "a": []}')
+    json_loads(b'[{"a": 1}, {"a": 2}, []]')
+    json_loads('{' + ",".join(f'"k{i}": [{i}]' for i in range(20)) + '}')
+    json_loads('"\\ud83d\\ude00"')
+    json_loads("123456789012345678901234567890")
+    
+    for document in ('{"a": [1, {"b": 2}', '[1, 2,]', '"\\x"', '{"a": 1} 2'):
+        try:
+            json_loads(document)
+        except ValueError:
+            pass
+        else:
+            raise ValueError()
+
+functions.append(func_134)
+
+def func_135():
+    fd = frozendict_class(dict_1, a=frozendict_class(b=[1, (2, [3])]))
+    deepfreeze(fd)
+    deepfreeze([dict_1, (1, [2]), {"a": {"b": [bytearray(b"x")]}}])
+    deepfreeze(frozendict_class(a=(1, 2)))
+    deepfreeze([{str(i): [i] for i in range(20)}])
+    
+    try:
+        deepfreeze([{"a": [{1, 2}, [[]], slice(1)]}])
+    except TypeError:
+        pass
+    else:
+        raise ValueError()
+
+functions.append(func_135)
+
+def func_136():
+    shared = [1, {"a": [bytearray(b"x")]}]
+    deepfreeze([shared, frozendict_class(a=shared), (shared, )])
+    deepfreeze(frozendict_class(a=[frozendict_class(b=[])] * 3))
+    
+    o = []
+    
+    for _ in range(1000):
+        o = [o, {"a": o}]
+    
+    deepfreeze(o)
+    
+    o = [1, {}]
+    o[1]["a"] = [o]
+    
+    try:
+        deepfreeze(o)
+    except FreezeError:
+        pass
+    else:
+        raise ValueError()
+    
+    try:
+        deepfreeze([[1, [2, {"a": [set()]}]], slice(1)])
+    except TypeError:
+        pass
+    else:
+        raise ValueError()
+
+functions.append(func_136)
+
+def func_137():
+    o = {"a": [1, {"b": [2, bytearray(b"x")]}], "c": {1, 2}, 1: (3, [4])}
+    old = deepfreeze(o)
+    hash(old)
+    deepfreeze(o, previous=old)
+    deepfreeze({"a": [1, {"b": [3]}], 1: [True]}, previous=old)
+    deepfreeze({"c": {1}, "a": [1]}, previous=old)
+    deepfreeze([o, o], previous=frozendict_class(a=1))
+    deepfreeze(frozendict_class(dict_1), previous=frozendict_class(dict_1))
+    
+    try:
+        deepfreeze({"a": [1, {"b": slice(1)}]}, previous=old)
+    except TypeError:
+        pass
+    else:
+        raise ValueError()
+
+functions.append(func_137)
+
+def func_138():
+    fd = frozendict_class(dict_1, a=(1, frozendict_class(b=((2, ), ))))
+    deepthaw(fd)
+    deepthaw([fd, (fd, fd), frozenset([1])])
+    deepthaw(deepfreeze({"a": [1, {"b": [2, bytearray(b"x")]}]}))
+    deepthaw(frozendict_class(a=(), b=frozendict_class()))
+    
+    o = ()
+    
+    for _ in range(1000):
+        o = (o, frozendict_class(a=o))
+    
+    deepthaw(o)
+    
+    def thaw_error(x):
+        raise ZeroDivisionError()
+    
+    try:
+        deepthaw((1, (2, fd)), custom_inverse_converters={int: thaw_error})
+    except ZeroDivisionError:
+        pass
+    else:
+        raise ValueError()
+    
+    deepthaw((1, (2, fd)), custom_inverse_converters={int: lambda x: [x]})
+
+functions.append(func_138)
+
+def func_139():
+    o = {"a": [1, {"b": [2, {3}]}], "c": frozendict_class(d=[bytearray(b"x")])}
+    res = deepfreeze(o, lazy=True)
+    res["a"][1]["b"][1]
+    list(res["c"].items())
+    hash(res)
+    res == deepfreeze(o)
+    
+    res = deepfreeze([o, [o]], lazy=True)
+    res[1][0]["a"][0]
+    res[0:1]
+    hash(res)
+    
+    try:
+        hash(deepfreeze({"a": [1, slice(1)]}, lazy=True))
+    except TypeError:
+        pass
+    else:
+        raise ValueError()
+
+functions.append(func_139)
+
+
+def func_140():
+    fd = frozendict_class(a=1, b=(2, 3))
+    fd_equal = frozendict_class(a=1, b=(2, 3))
+    
+    if frozendict_class.intern(fd) is not fd:
+        raise ValueError()
+    
+    if frozendict_class.intern(fd_equal) is not fd:
+        raise ValueError()
+    
+    frozendict_class.intern(frozendict_class(a=True, b=(2, 3)))
+    
+    try:
+        frozendict_class.intern(frozendict_class(a=[]))
+    except TypeError:
+        pass
+    else:
+        raise ValueError()
+    
+    o = [{"a": [1, "x"]}, {"a": [1, "x"]}, frozendict_class(c=[2])]
+    res = deepfreeze(o, intern=True)
+    
+    if res[0] is not res[1]:
+        raise ValueError()
+    
+    hash(deepfreeze({"a": [1, {"b": 2}]}, lazy=True, intern=True))
+
+functions.append(func_140)
+
+
+class FromObjectSlots:
+    __slots__ = ("a", "__b", "c")
+    
+    def __init__(self):
+        self.a = 1
+        self._FromObjectSlots__b = [2]
+
+
+class FromObjectDict:
+    def __init__(self):
+        self.a = 1
+        self.b = [2]
+
+
+FromObjectDict()
+FromObjectNamedTuple = namedtuple("FromObjectNamedTuple", "a b")
+
+
+def func_141():
+    frozendict_class.from_object(FromObjectSlots())
+    frozendict_class.from_object(FromObjectDict())
+    frozendict_class(vars(FromObjectDict()))
+    frozendict_class.from_object(FromObjectNamedTuple(1, [2]))
+    deepfreeze([FromObjectDict()])
+    
+    try:
+        frozendict_class.from_object(1)
+    except TypeError:
+        pass
+    else:
+        raise ValueError()
+
+functions.append(func_141)
+
+
 print_sep()
 
 for frozendict_class in (frozendict, F):
@@ -1,3 +1,4 @@
+import sys
 from collections import OrderedDict
 from collections.abc import MutableSequence, Sequence
 from enum import Enum
@@ -255,3 +256,367 @@ def test_get_items():
 def test_no_dict_and_hash(no_dict_and_hash):
     with pytest.raises(TypeError):
         cool.deepfreeze(no_dict_and_hash)
+
+
+def test_deepfreeze_containers():
+    o = [{"a": [1, (2, [3])]}, (frozendict(b = [4]), ), OrderedDict(c = [])]
+    
+    assert cool.deepfreeze(o) == (
+        frozendict(a = (1, (2, (3, )))),
+        (frozendict(b = (4, )), ),
+        frozendict(c = ()),
+    )
+
+
+def test_deepfreeze_frozen():
+    o = frozendict(a = (1, frozendict(b = "x")), c = frozenset())
+    res = cool.deepfreeze(o)
+    
+    assert res == o
+    
+    if cool.c_ext:
+        assert res is o
+
+
+def test_deepfreeze_original_unchanged():
+    o = (1, [2], frozendict(a = [3]))
+    res = cool.deepfreeze(o)
+    
+    assert res == (1, (2, ), frozendict(a = (3, )))
+    assert o == (1, [2], frozendict(a = [3]))
+
+
+def test_register_after_deepfreeze(a):
+    assert cool.deepfreeze([a]) == (frozendict(a.__dict__), )
+    
+    cool.register(A, custom_a_converter)
+    
+    try:
+        assert cool.deepfreeze([a]) == (custom_a_converter(a), )
+    finally:
+        cool.unregister(A)
+    
+    assert cool.deepfreeze([a]) == (frozendict(a.__dict__), )
+
+
+def test_deepfreeze_custom_not_cached(a):
+    assert cool.deepfreeze(
+        [a],
+        custom_converters={A: custom_a_converter}
+    ) == (custom_a_converter(a), )
+    
+    assert cool.deepfreeze([a]) == (frozendict(a.__dict__), )
+
+
+def test_deepfreeze_str_subclass():
+    class S(str):
+        pass
+    
+    s = S("x")
+    s.y = 1
+    
+    assert cool.deepfreeze(s) == frozendict(y = 1)
+    assert cool.deepfreeze("x") == "x"
+
+
+def test_deepfreeze_shared():
+    shared = [1, {"a": [2]}]
+    res = cool.deepfreeze({"x": shared, "y": (shared, )})
+    
+    assert res == frozendict(
+        x = (1, frozendict(a = (2, ))),
+        y = ((1, frozendict(a = (2, ))), ),
+    )
+    
+    assert res["x"] is res["y"][0]
+
+
+def test_deepfreeze_circular():
+    l = [1]
+    l.append([l])
+    
+    with pytest.raises(FreezeError):
+        cool.deepfreeze(l)
+    
+    d = {}
+    d["a"] = (d, )
+    
+    with pytest.raises(FreezeError):
+        cool.deepfreeze(d)
+
+
+def test_deepfreeze_deep():
+    o = []
+    
+    for _ in range(100000):
+        o = [o]
+    
+    res = cool.deepfreeze(o)
+    
+    for _ in range(100000):
+        res = res[0]
+    
+    assert res == ()
+
+
+def test_deepfreeze_previous():
+    old = cool.deepfreeze({"db": {"host": "a", "opts": [1]}, "log": {"x": 1}})
+    hash(old)
+    new = cool.deepfreeze(
+        {"db": {"host": "b", "opts": [1]}, "log": {"x": 1}},
+        previous = old
+    )
+    
+    assert new == frozendict(
+        db = frozendict(host = "b", opts = (1, )),
+        log = frozendict(x = 1),
+    )
+    
+    assert new["log"] is old["log"]
+    assert new["db"]["opts"] is old["db"]["opts"]
+    assert new["db"] is not old["db"]
+
+
+def test_deepfreeze_previous_unchanged():
+    o = {"a": [1, {"b": 2}], "c": {3, 4}}
+    old = cool.deepfreeze(o)
+    
+    assert cool.deepfreeze(o, previous = old) is old
+
+
+def test_deepfreeze_previous_types():
+    old = cool.deepfreeze({"a": [1], "b": {"c": 1}})
+    new = cool.deepfreeze({"a": [True], "b": {"c": 1.0}}, previous = old)
+    
+    assert type(new["a"][0]) is bool
+    assert type(new["b"]["c"]) is float
+
+
+def test_deepfreeze_previous_order():
+    old = cool.deepfreeze({"a": 1, "b": 2})
+    new = cool.deepfreeze({"b": 2, "a": 1}, previous = old)
+    
+    assert list(new) == ["b", "a"]
+
+
+def test_deepfreeze_previous_other_shape():
+    assert cool.deepfreeze([1, [2]], previous = frozendict(a = 1)) == (1, (2, ))
+    assert cool.deepfreeze({"a": [1]}, previous = (1, )) == frozendict(a = (1, ))
+
+
+def test_deepthaw():
+    o = {"a": [1, {"b": [2, [3]]}], "c": {1, 2}, "d": "x"}
+    res = cool.deepthaw(cool.deepfreeze(o))
+    
+    assert res == {"a": [1, {"b": [2, [3]]}], "c": frozenset({1, 2}), "d": "x"}
+    assert type(res) is dict
+    assert type(res["a"][1]) is dict
+
+
+def test_deepthaw_types():
+    class FrozendictSub(frozendict):
+        pass
+    
+    assert cool.deepthaw(MappingProxyType({"a": (1, )})) == {"a": [1]}
+    assert cool.deepthaw(FrozendictSub(a = ())) == {"a": []}
+    assert cool.deepthaw(5) == 5
+
+
+def test_deepthaw_shared():
+    shared = (1, 2)
+    res = cool.deepthaw(frozendict(a = shared, b = shared))
+    
+    assert res["a"] is res["b"]
+
+
+def test_deepthaw_deep():
+    o = ()
+    
+    for _ in range(100000):
+        o = (o, )
+    
+    res = cool.deepthaw(o)
+    
+    for _ in range(100000):
+        res = res[0]
+    
+    assert res == []
+
+
+def test_deepthaw_inverse(a):
+    cool.register(A, lambda x: [x.x, (1, )], inverse = True)
+    
+    try:
+        assert cool.deepthaw((a, )) == [[a.x, [1]]]
+    finally:
+        cool.unregister(A, inverse = True)
+    
+    assert cool.deepthaw((a, )) == [a]
+
+
+def test_deepthaw_custom_inverse(a):
+    res = cool.deepthaw(
+        (a, ),
+        custom_inverse_converters = {A: lambda x: {"x": (x.x, )}}
+    )
+    
+    assert res == [{"x": [a.x]}]
+
+
+def test_deepfreeze_lazy():
+    o = {"a": [1, {"b": [2, {3}]}], "c": {"d": bytearray(b"x")}}
+    exp = cool.deepfreeze(o)
+    res = cool.deepfreeze(o, lazy = True)
+    
+    assert len(res) == 2
+    assert list(res) == ["a", "c"]
+    assert res["a"][1]["b"] == (2, frozenset({3}))
+    assert res["a"] is res["a"]
+    assert res == exp
+    assert exp == res
+    assert hash(res) == hash(exp)
+    assert res.set("e", 1) == exp.set("e", 1)
+
+
+def test_deepfreeze_lazy_sequence():
+    res = cool.deepfreeze([1, [2], {"a": [3]}], lazy = True)
+    
+    assert len(res) == 3
+    assert res[-1]["a"] == (3, )
+    assert res[1:] == ((2, ), frozendict(a = (3, )))
+    assert res == (1, (2, ), frozendict(a = (3, )))
+    assert hash(res) == hash((1, (2, ), frozendict(a = (3, ))))
+
+
+def test_deepfreeze_lazy_snapshot():
+    o = {"a": 1}
+    res = cool.deepfreeze(o, lazy = True)
+    o["b"] = 2
+    
+    assert res == frozendict(a = 1)
+
+
+def test_deepfreeze_lazy_on_read():
+    res = cool.deepfreeze({"a": 1, "b": [NoDictAndHash(1)]}, lazy = True)
+    
+    assert res["a"] == 1
+    
+    b = res["b"]
+    
+    with pytest.raises(TypeError):
+        b[0]
+    
+    with pytest.raises(TypeError):
+        hash(res)
+
+
+def test_deepfreeze_lazy_circular():
+    l = [1]
+    l.append(l)
+    res = cool.deepfreeze({"l": l}, lazy = True)
+    
+    assert res["l"][1][1][0] == 1
+    
+    with pytest.raises(FreezeError):
+        hash(res)
+
+
+def test_deepfreeze_lazy_previous():
+    with pytest.raises(ValueError):
+        cool.deepfreeze({}, lazy = True, previous = frozendict())
+
+
+def test_deepfreeze_lazy_nested():
+    o = {"a": [1, {"b": [2]}]}
+    exp = cool.deepfreeze(o)
+    lazy = cool.deepfreeze(o, lazy = True)
+    lazy["a"][1]
+    
+    for res in (
+        cool.deepfreeze({"x": lazy}),
+        cool.deepfreeze(frozendict(x = lazy)),
+        cool.deepfreeze({"x": lazy}, previous = frozendict(x = exp)),
+    ):
+        assert type(res["x"]) is frozendict
+        assert type(res["x"]["a"]) is tuple
+        assert res == frozendict(x = exp)
+    
+    res = cool.deepfreeze([lazy, lazy["a"]])
+    
+    assert type(res[1]) is tuple
+    assert res == (exp, exp["a"])
+    assert cool.deepfreeze(lazy) == exp
+
+
+def test_deepthaw_lazy():
+    o = {"a": [1, {"b": [2]}], "c": {"d": 3}}
+    lazy = cool.deepfreeze(o, lazy = True)
+    lazy["a"][1]
+    
+    res = cool.deepthaw(lazy)
+    
+    assert type(res) is dict
+    assert type(res["a"][1]) is dict
+    assert res == o
+    assert cool.deepthaw((lazy, lazy["a"])) == [o, o["a"]]
+    assert cool.deepthaw(frozendict(x = lazy)) == {"x": o}
+    
+    seq = cool.deepfreeze([1, {"a": [2]}], lazy = True)
+    
+    assert cool.deepthaw(seq) == [1, {"a": [2]}]
+    assert cool.deepthaw(
+        lazy,
+        custom_inverse_converters = {frozendict: lambda fd: list(fd)}
+    ) == ["a", "c"]
+
+
+def test_deepfreeze_intern():
+    s = "".join(["intern", "_test"])
+    o = [{"a": [1, s]}, {"a": [1, s]}, {"a": [True, s]}]
+    res = cool.deepfreeze(o, intern = True)
+    
+    assert res[0] is res[1]
+    assert res[2] is not res[0]
+    assert res[0] == res[2]
+    assert res[0] is frozendict.intern(frozendict(a = (1, "intern_test")))
+    assert res[0]["a"][1] is sys.intern("intern_test")
+    assert cool.deepfreeze(o) == res
+
+
+def test_deepfreeze_intern_same_hash():
+    o = [{"intern_hash": True}, {"intern_hash": 1}]
+    res = cool.deepfreeze(o, intern = True)
+    res_2 = cool.deepfreeze(o[::-1], intern = True)
+    
+    assert res[0] is res_2[1]
+    assert res[1] is res_2[0]
+    assert res[1] is frozendict.intern(frozendict(intern_hash = 1))
+
+
+def test_deepfreeze_intern_unhashable():
+    res = cool.deepfreeze(
+        [{"a": A(1)}],
+        custom_converters = {A: lambda a: [a.x]},
+        intern = True
+    )
+    
+    assert res == (frozendict(a = [1]), )
+
+
+def test_deepfreeze_intern_lazy():
+    s = "".join(["intern_lazy", "_test"])
+    res = cool.deepfreeze({"s": s, "l": [{"a": 1}]}, lazy = True, intern = True)
+    
+    assert res["s"] is sys.intern("intern_lazy_test")
+    assert res == frozendict(s = s, l = (frozendict(a = 1), ))
+
+
+def test_deepfreeze_from_object(no_dict_and_hash):
+    cool.register(NoDictAndHash, frozendict.from_object)
+    
+    try:
+        res = cool.deepfreeze([no_dict_and_hash])
+    finally:
+        cool.unregister(NoDictAndHash)
+    
+    assert res == (frozendict(x = 3), )
@@ -0,0 +1,227 @@
+import pickle
+from collections.abc import Mapping
+
+import pytest
+from frozendict import frozendict, frozenmap
+
+
+class BadHash:
+    def __init__(self, x, h):
+        self.x = x
+        self.h = h
+
+    def __hash__(self):
+        return self.h
+
+    def __eq__(self, other):
+        return isinstance(other, BadHash) and self.x == other.x
+
+
+class HashError:
+    def __hash__(self):
+        raise ValueError("hash error")
+
+
+class FrozenmapSubclass(frozenmap):
+    pass
+
+
+@pytest.fixture
+def fm_dict():
+    return {
+        "Guzzanti": "Corrado",
+        "Hicks": "Bill",
+        frozendict({1: 2}): "frozen",
+    }
+
+
+@pytest.fixture
+def fm(fm_dict):
+    return frozenmap(fm_dict)
+
+
+@pytest.fixture
+def big_dict():
+    res = {i: str(i) for i in range(1000)}
+
+    # keys with the same hash and with the same folded 32 bit hash
+    res.update({BadHash(i, 7): i for i in range(5)})
+    res.update({BadHash(i, (i << 32) | 7): i for i in range(5)})
+
+    return res
+
+
+@pytest.fixture
+def big_fm(big_dict):
+    return frozenmap(big_dict)
+
+
+def test_constructor(fm_dict, fm):
+    assert frozenmap(fm_dict.items()) == fm
+    assert frozenmap(**{"a": 1}) == {"a": 1}
+    assert frozenmap(fm_dict, a=1) == {**fm_dict, "a": 1}
+    assert frozenmap(fm) is fm
+    assert frozenmap() == {}
+    assert isinstance(fm, Mapping)
+
+
+def test_constructor_bad_seq():
+    with pytest.raises(TypeError):
+        frozenmap([1])
+
+    with pytest.raises(ValueError):
+        frozenmap([(1, 2, 3)])
+
+
+def test_getitem(fm_dict, fm):
+    for k, v in fm_dict.items():
+        assert fm[k] == v
+        assert k in fm
+
+    with pytest.raises(KeyError):
+        fm["Frusciante"]
+
+    assert fm.get("Frusciante", 1) == 1
+    assert "Frusciante" not in fm
+
+
+def test_eq(fm_dict, fm):
+    assert fm == fm_dict
+    assert fm_dict == fm
+    assert fm == frozendict(fm_dict)
+    assert fm == frozenmap(fm_dict)
+    assert fm != fm.set("Guzzanti", "Sabina")
+    assert fm != [1]
+
+
+def test_hash(fm_dict, fm):
+    assert hash(fm) == hash(frozenset(fm_dict.items()))
+    assert hash(fm) == hash(frozendict(fm_dict))
+
+
+def test_unhashable_value():
+    fm = frozenmap(a=[])
+
+    with pytest.raises(TypeError):
+        hash(fm)
+
+
+def test_hash_derived_error(fm):
+    hash(fm)
+
+    # the error of the value hash is raised only by hash(), as if the hash
+    # of fm was not cached
+    fm_error = fm.set("new", HashError())
+
+    with pytest.raises(ValueError):
+        hash(fm_error)
+
+    with pytest.raises(ValueError):
+        hash(fm_error)
+
+    hash(fm_error.delete("new"))
+
+    fm_unhashable = fm.set("new", [])
+
+    with pytest.raises(TypeError):
+        hash(fm_unhashable)
+
+
+def test_set(big_dict, big_fm):
+    hash(big_fm)
+
+    for k in list(big_dict)[::10]:
+        new_fm = big_fm.set(k, -1)
+        assert new_fm[k] == -1
+        assert new_fm == {**big_dict, k: -1}
+        assert hash(new_fm) == hash(frozenset(new_fm.items()))
+
+    new_fm = big_fm.set("new", 1)
+    assert new_fm == {**big_dict, "new": 1}
+    assert big_fm == big_dict
+    assert big_fm.set(0, big_dict[0]) is big_fm
+
+
+def test_setdefault(big_dict, big_fm):
+    assert big_fm.setdefault(0, -1) is big_fm
+    assert big_fm.setdefault("new") == {**big_dict, "new": None}
+
+
+def test_delete(big_dict, big_fm):
+    hash(big_fm)
+    keys = list(big_dict)
+
+    for k in keys[:-10:10] + keys[-10:]:
+        new_fm = big_fm.delete(k)
+        assert len(new_fm) == len(big_dict) - 1
+        assert k not in new_fm
+        assert hash(new_fm) == hash(frozenset(new_fm.items()))
+
+    assert big_fm == big_dict
+
+    with pytest.raises(KeyError):
+        big_fm.delete("Frusciante")
+
+
+def test_delete_all(big_dict, big_fm):
+    fm = big_fm
+
+    for k in big_dict:
+        fm = fm.delete(k)
+
+    assert fm == {}
+    assert len(fm) == 0
+
+
+def test_key_value_item(big_fm):
+    keys = tuple(big_fm)
+
+    for i in (0, 1, 500, -1, -len(keys)):
+        assert big_fm.key(i) == keys[i]
+        assert big_fm.value(i) == big_fm[keys[i]]
+        assert big_fm.item(i) == (keys[i], big_fm[keys[i]])
+
+    assert big_fm.key() == keys[0]
+
+    with pytest.raises(IndexError):
+        big_fm.key(len(keys))
+
+
+def test_views(fm_dict, fm):
+    assert len(fm.keys()) == len(fm_dict)
+    assert fm.keys() == fm_dict.keys()
+    assert fm.items() == fm_dict.items()
+    assert sorted(map(str, fm.values())) == sorted(map(str, fm_dict.values()))
+    assert ("Hicks", "Bill") in fm.items()
+    assert "Bill" in fm.values()
+    assert fm.keys() & {"Hicks"} == {"Hicks"}
+    assert {"Hicks", 1} - fm.keys() == {1}
+    assert fm.keys() | {1} == set(fm_dict) | {1}
+    assert fm.keys() ^ {"Hicks"} == set(fm_dict) ^ {"Hicks"}
+    assert fm.keys().isdisjoint({1})
+
+
+def test_or(fm_dict, fm):
+    assert fm | {"a": 1} == {**fm_dict, "a": 1}
+    assert fm | frozenmap(Hicks=1) == {**fm_dict, "Hicks": 1}
+    assert fm == fm_dict
+
+
+def test_pickle(big_fm):
+    assert pickle.loads(pickle.dumps(big_fm, protocol=-1)) == big_fm
+
+
+def test_repr(fm_dict, fm):
+    assert repr(fm) == f"frozendict.frozenmap({dict(fm)!r})"
+
+
+def test_subclass(fm_dict):
+    fm = FrozenmapSubclass(fm_dict)
+    assert type(fm.set("a", 1)) is FrozenmapSubclass
+    assert type(fm.delete("Hicks")) is FrozenmapSubclass
+    assert type(fm.copy()) is FrozenmapSubclass
+    assert repr(fm) == f"FrozenmapSubclass({dict(fm)!r})"
+
+
+def test_fromkeys():
+    assert frozenmap.fromkeys("abc", 1) == dict.fromkeys("abc", 1)
@@ -0,0 +1,324 @@
+import json
+from decimal import Decimal
+
+import frozendict as cool
+import pytest
+from frozendict import frozendict
+
+
+class S(str):
+    pass
+
+
+class I(int):
+    pass
+
+
+class F(float):
+    pass
+
+
+class D(dict):
+    pass
+
+
+class FrozendictSub(frozendict):
+    pass
+
+
+class A:
+    def __init__(self, x):
+        self.x = x
+        self.y = str(x)
+
+
+values = [
+    None,
+    True,
+    False,
+    0,
+    -1,
+    2 ** 63 - 1,
+    -2 ** 63,
+    2 ** 100,
+    1.5,
+    -0.0,
+    1e300,
+    "",
+    "abc",
+    "\"\\\b\f\n\r\t\x00\x1f\x7f",
+    "èé\U0001f600中",
+    S("str"),
+    I(7),
+    F(2.5),
+    [],
+    (),
+    {},
+    [1, (2, [3])],
+]
+
+
+def test_json_dumps_values():
+    for value in values:
+        assert cool.json_dumps(value) == json.dumps(value)
+        assert cool.json_dumps([value]) == json.dumps([value])
+
+
+def test_json_dumps_frozendict():
+    for i, value in enumerate(values):
+        fd = frozendict(a = value, b = frozendict(c = value), d = [i])
+        exp = json.dumps(fd.to_dict(deep = True))
+        assert cool.json_dumps(fd) == exp
+        assert cool.json_dumps(FrozendictSub(fd)) == exp
+
+
+def test_json_dumps_big():
+    fd = frozendict({str(i): [i, float(i), None] for i in range(1000)})
+    
+    assert cool.json_dumps(fd) == json.dumps(dict(fd))
+    assert cool.json_dumps(fd.delete("500")) == json.dumps(
+        fd.delete("500").to_dict()
+    )
+
+
+def test_json_dumps_split():
+    fds = [frozendict(A(i).__dict__) for i in range(3)]
+    
+    assert cool.json_dumps(fds) == json.dumps([fd.to_dict() for fd in fds])
+
+
+def test_json_dumps_keys():
+    d = {"a": 1, 2: 2, 1.5: 3, True: 4, None: 5, I(6): 6}
+    
+    assert cool.json_dumps(frozendict(d)) == json.dumps(d)
+    assert cool.json_dumps(D(d)) == json.dumps(d)
+
+
+@pytest.mark.parametrize("kwargs", [
+    {"ensure_ascii": False},
+    {"sort_keys": True},
+    {"separators": (",", ":")},
+    {"separators": [";", "="]},
+    {"sort_keys": True, "ensure_ascii": False, "separators": (",", ":")},
+])
+def test_json_dumps_options(kwargs):
+    d = {"z": ["èé\U0001f600", 1.5], "a": {"y": None, "b": ()}, "é": 1}
+    fd = frozendict(d)
+    
+    assert cool.json_dumps(fd, **kwargs) == json.dumps(d, **kwargs)
+    assert cool.json_dumps(D(d), **kwargs) == json.dumps(d, **kwargs)
+
+
+def test_json_dumps_nan():
+    values = [float("nan"), float("inf"), -float("inf")]
+    
+    assert cool.json_dumps(values) == json.dumps(values)
+    
+    for value in values:
+        with pytest.raises(ValueError):
+            cool.json_dumps(frozendict(a = value), allow_nan = False)
+
+
+def test_json_dumps_bad_keys():
+    fd = frozendict({"a": 1, (1, ): 2, "b": 3})
+    
+    with pytest.raises(TypeError):
+        cool.json_dumps(fd)
+    
+    assert cool.json_dumps(fd, skipkeys = True) == '{"a": 1, "b": 3}'
+
+
+def test_json_dumps_default():
+    fd = frozendict(a = Decimal("1.5"), b = [{1, 2}])
+    
+    with pytest.raises(TypeError):
+        cool.json_dumps(fd)
+    
+    def default(o):
+        return sorted(o) if isinstance(o, set) else str(o)
+    
+    assert cool.json_dumps(fd, default = default) == '{"a": "1.5", "b": [[1, 2]]}'
+
+
+def test_json_dumps_default_error():
+    def default(o):
+        raise ZeroDivisionError()
+    
+    with pytest.raises(ZeroDivisionError):
+        cool.json_dumps(frozendict(a = object()), default = default)
+
+
+def test_json_dumps_circular():
+    lst = []
+    fd = frozendict(a = lst)
+    lst.append(fd)
+    
+    with pytest.raises(ValueError, match = "Circular reference detected"):
+        cool.json_dumps(fd)
+    
+    with pytest.raises(ValueError, match = "Circular reference detected"):
+        cool.json_dumps(object(), default = lambda o: [o])
+    
+    shared = [1]
+    assert cool.json_dumps([shared, shared]) == "[[1], [1]]"
+
+
+def test_json_dumps_lazy():
+    o = {"a": [1, {"b": [2, 3]}], "c": {"d": None}}
+    lazy = cool.deepfreeze(o, lazy = True)
+    lazy["a"][1]
+    
+    assert cool.json_dumps(lazy) == json.dumps(o)
+    assert cool.json_dumps([lazy["a"]]) == json.dumps([o["a"]])
+    assert cool.json_dumps(lazy, sort_keys = True) == json.dumps(o, sort_keys = True)
+    
+    fd = frozendict(a = cool.deepfreeze([1], lazy = True), b = Decimal("1.5"))
+    assert cool.json_dumps(fd, default = str) == '{"a": [1], "b": "1.5"}'
+    
+    with pytest.raises(TypeError):
+        cool.json_dumps(fd)
+
+
+def test_json_encoder_lazy():
+    o = {"a": [1, {"b": [2, 3]}], "c": {"d": None}}
+    lazy = cool.deepfreeze(o, lazy = True)
+    
+    assert json.dumps(lazy, cls = cool.FrozendictJsonEncoder) == json.dumps(o)
+
+
+def test_orjson_lazy():
+    orjson = pytest.importorskip("orjson")
+    
+    if not cool.c_ext:
+        pytest.skip("orjson is patched only for the C extension")
+    
+    o = {"a": [1, {"b": [2, 3]}], "c": {"d": None}}
+    lazy = cool.deepfreeze(o, lazy = True)
+    
+    assert orjson.loads(orjson.dumps(lazy)) == o
+
+
+def test_json_dumps_bad_separators():
+    with pytest.raises((TypeError, ValueError)):
+        cool.json_dumps({}, separators = (",", ))
+    
+    with pytest.raises((TypeError, ValueError)):
+        cool.json_dumps({}, separators = 5)
+
+
+def test_json_dumps_positional_options():
+    with pytest.raises(TypeError):
+        # noinspection PyArgumentList
+        cool.json_dumps({}, True)
+
+
+def freeze_json(value):
+    if type(value) is list:
+        return tuple(freeze_json(x) for x in value)
+    
+    if type(value) is dict:
+        return frozendict({k: freeze_json(v) for k, v in value.items()})
+    
+    return value
+
+
+documents = [
+    '{"a": [1, 2.5, null, true, false, "x"], "b": {"c": {}}, "d": []}',
+    '[{"a": 1}, {"a": 2, "b": [[], [[3]]]}]',
+    '"\\u00e9\\ud83d\\ude00\\n\\"\\\\\\/"',
+    '  -12345678901234567890  ',
+    '[1e5, -0.0, 1.5E-3, 123456789012345678, -0]',
+    '{' + ",".join(f'"k{i}": {i}' for i in range(100)) + '}',
+]
+
+
+@pytest.mark.parametrize("document", documents)
+def test_json_loads(document):
+    res = cool.json_loads(document)
+    exp = freeze_json(json.loads(document))
+    
+    assert res == exp
+    assert cool.json_loads(document.encode()) == exp
+    assert cool.json_loads(bytearray(document.encode())) == exp
+
+
+def test_json_loads_types():
+    res = cool.json_loads('{"a": [1, {"b": [2]}]}')
+    
+    assert type(res) is frozendict
+    assert type(res["a"]) is tuple
+    assert type(res["a"][1]) is frozendict
+    assert type(res["a"][1]["b"]) is tuple
+    assert hash(res) == hash(frozendict(a = (1, frozendict(b = (2, )))))
+
+
+def test_json_loads_empty():
+    assert cool.json_loads("{}") == frozendict()
+    assert cool.json_loads("[]") == ()
+
+
+def test_json_loads_repeated_keys():
+    res = cool.json_loads('{"a": 1, "b": 2, "a": 3}')
+    
+    assert res == frozendict(a = 3, b = 2)
+    assert list(res) == ["a", "b"]
+
+
+def test_json_loads_interned_keys():
+    key = "a key" * 10
+    res = cool.json_loads(f'[{{"{key}": 1}}, {{"{key}": 2}}]')
+    
+    assert next(iter(res[0])) is next(iter(res[1]))
+
+
+def test_json_loads_nan():
+    res = cool.json_loads("[NaN, Infinity, -Infinity]")
+    
+    assert res[0] != res[0]
+    assert res[1:] == (float("inf"), -float("inf"))
+
+
+def test_json_loads_bom():
+    assert cool.json_loads(b'\xef\xbb\xbf[1]') == (1, )
+    
+    with pytest.raises(json.JSONDecodeError):
+        cool.json_loads('﻿[1]')
+
+
+@pytest.mark.parametrize("document", [
+    "", "[", '{"a" 1}', '{"a": 1,}', "[1,]", '"abc', '"\\x"', "nul", "01",
+    "[1] 2", '{1: 2}', '"\x00"',
+])
+def test_json_loads_invalid(document):
+    with pytest.raises(json.JSONDecodeError) as exc_info:
+        cool.json_loads(document)
+    
+    with pytest.raises(json.JSONDecodeError) as exp_info:
+        json.loads(document)
+    
+    assert exc_info.value.msg == exp_info.value.msg
+    assert exc_info.value.pos == exp_info.value.pos
+
+
+def test_json_loads_bad_type():
+    with pytest.raises(TypeError):
+        # noinspection PyTypeChecker
+        cool.json_loads(1)
+
+
+def test_json_loads_lines(tmp_path):
+    path = tmp_path / "test.jsonl"
+    path.write_text('{"a": [1]}\n\n[2, 3]\n"x"\n', encoding = "utf-8")
+    exp = [frozendict(a = (1, )), (2, 3), "x"]
+    
+    with open(path, encoding = "utf-8") as fp:
+        assert list(cool.json_loads_lines(fp)) == exp
+    
+    with open(path, "rb") as fp:
+        assert list(cool.json_loads_lines(fp)) == exp
+
+
+def test_json_roundtrip():
+    fd = frozendict(a = (1, 2.5, None), b = frozendict(c = "é"))
+    
+    assert cool.json_loads(cool.json_dumps(fd)) == fd